@@ -22,6 +22,7 @@
 #include <QtNetwork/QLocalSocket>
 #include <KIOCore/kfileitem.h>
 #include <QDir>
+#include <QSet>
 #include <QTimer>
 #include "ownclouddolphinpluginhelper.h"
 
@@ -33,6 +34,12 @@ class OwncloudDolphinPlugin : public KOverlayIconPlugin
     typedef QHash<QByteArray, QByteArray> StatusMap;
     StatusMap m_status;
 
+    // Directories whose entries were requested with RETRIEVE_DIRECTORY_STATUS
+    // and whose STATUS_BATCH:END did not arrive yet
+    QSet<QByteArray> m_pendingDirectories;
+    // Directories whose batch arrived, the client pushes the changes in them from then on
+    QSet<QByteArray> m_retrievedDirectories;
+
 public:
 
     OwncloudDolphinPlugin() {
@@ -50,10 +57,24 @@ public:
         QDir localPath(url.toLocalFile());
         const QByteArray localFile = localPath.canonicalPath().toUtf8();
 
-        helper->sendCommand(QByteArray("RETRIEVE_FILE_STATUS:" + localFile + "\n"));
-
         StatusMap::iterator it = m_status.find(localFile);
-        if (it != m_status.constEnd()) {
+        if (helper->hasDirectoryStatus()) {
+            // One request for all entries of the directory
+            const QByteArray directory = localFile.left(localFile.lastIndexOf('/'));
+            if (directory.isEmpty() || m_pendingDirectories.contains(directory)) {
+                // The batch of the directory answers this one too
+            } else if (!m_retrievedDirectories.contains(directory)) {
+                m_pendingDirectories.insert(directory);
+                helper->sendCommand(QByteArray("RETRIEVE_DIRECTORY_STATUS:" + directory + "\n"));
+            } else if (it == m_status.end()) {
+                // Not part of the batch of its directory
+                helper->sendCommand(QByteArray("RETRIEVE_FILE_STATUS:" + localFile + "\n"));
+            }
+        } else {
+            helper->sendCommand(QByteArray("RETRIEVE_FILE_STATUS:" + localFile + "\n"));
+        }
+
+        if (it != m_status.end()) {
             return  overlaysForString(*it);
         }
         return QStringList();
@@ -82,6 +103,20 @@ private:
 
     void slotCommandRecieved(const QByteArray &line) {
 
+        if (line.startsWith("VERSION:")) {
+            // (Re)connected, the statuses have to be retrieved again
+            m_pendingDirectories.clear();
+            m_retrievedDirectories.clear();
+            return;
+        }
+
+        if (line.startsWith("STATUS_BATCH:END:")) {
+            const QByteArray directory = line.mid(qstrlen("STATUS_BATCH:END:"));
+            if (m_pendingDirectories.remove(directory))
+                m_retrievedDirectories.insert(directory);
+            return;
+        }
+
         QList<QByteArray> tokens = line.split(':');
         if (tokens.count() != 3)
             return;
@@ -52,6 +52,12 @@ bool OwncloudDolphinPluginHelper::isConnected() const
     return _socket.state() == QLocalSocket::ConnectedState;
 }
 
+bool OwncloudDolphinPluginHelper::hasDirectoryStatus() const
+{
+    auto version = _version.split('.');
+    return version.value(0) == "1" && version.value(1).toInt() >= 2;
+}
+
 void OwncloudDolphinPluginHelper::sendCommand(const char* data)
 {
     _socket.write(data);
@@ -60,7 +66,9 @@ void OwncloudDolphinPluginHelper::sendCommand(const char* data)
 
 void OwncloudDolphinPluginHelper::slotConnected()
 {
-    sendCommand("VERSION:\n");
+    // 1.2: status pushes come in batches of STATUS lines and
+    // RETRIEVE_DIRECTORY_STATUS is available
+    sendCommand("VERSION:1.2\n");
     sendCommand("GET_STRINGS:\n");
 }
 
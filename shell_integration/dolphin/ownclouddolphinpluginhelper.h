@@ -47,6 +47,9 @@ public:
 
     QByteArray version() { return _version; }
 
+    /// Whether the client answers RETRIEVE_DIRECTORY_STATUS (socket API 1.2)
+    bool hasDirectoryStatus() const;
+
 signals:
     void commandRecieved(const QByteArray &cmd);
 
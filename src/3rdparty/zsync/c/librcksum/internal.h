@@ -87,6 +87,10 @@ struct rcksum_state {
 
     /* local id offset, used in upload mode to match blocks */
     int lid_offset;
+
+    /* Number of threads rcksum_submit_source_file may use to pread() and
+     * scan segments of the source file; 0 picks one per online CPU. */
+    int scan_threads;
 };
 
 #define BITHASHBITS 3
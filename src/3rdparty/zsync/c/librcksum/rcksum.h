@@ -59,6 +59,11 @@ void rcksum_add_target_block(struct rcksum_state* z, zs_blockid b, struct rsum r
 int rcksum_submit_blocks(struct rcksum_state* z, const unsigned char* data, zs_blockid bfrom, zs_blockid bto);
 int rcksum_submit_source_data(struct rcksum_state* z, unsigned char* data, size_t len, off_t offset, bool remote);
 int rcksum_submit_source_file(struct rcksum_state* z, FILE* f, int progress, bool remote);
+/* Sequential fread() based scan; rcksum_submit_source_file falls back to it
+ * in upload mode, for sources without a size or file descriptor and when the
+ * threaded pread() scan fails. */
+int rcksum_submit_source_stream(struct rcksum_state* z, FILE* f, int progress, bool remote);
+void rcksum_set_scan_threads(struct rcksum_state* z, int threads);
 
 /* This reads back in data which is already known. */
 ssize_t rcksum_read_known_data(struct rcksum_state *z, unsigned char *buf,
@@ -30,6 +30,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#if !defined(_WIN32)
+# include <pthread.h>
+# define RCKSUM_THREADED_SCAN 1
+#endif
+
 #ifdef WITH_DMALLOC
 # include <dmalloc.h>
 #endif
@@ -459,12 +464,12 @@ static off_t get_file_size(FILE* f) {
     return st.st_size;
 }
 
-/* rcksum_submit_source_file(self, stream, progress)
+/* rcksum_submit_source_stream(self, stream, progress, remote)
  * Read the given stream, applying the rsync rolling checksum algorithm to
  * identify any blocks of data in common with the target file. Blocks found are
  * written to our working target output. Progress reports if progress != 0
  */
-int rcksum_submit_source_file(struct rcksum_state *z, FILE * f, int progress, bool remote) {
+int rcksum_submit_source_stream(struct rcksum_state *z, FILE * f, int progress, bool remote) {
     /* Track progress */
     int got_blocks = 0;
     off_t in = 0;
@@ -534,3 +539,344 @@ int rcksum_submit_source_file(struct rcksum_state *z, FILE * f, int progress, bo
     }
     return got_blocks;
 }
+
+#ifdef RCKSUM_THREADED_SCAN
+
+/* Parallel scan of a source file.
+ *
+ * The window start positions of the file are cut into one segment per thread.
+ * Each thread pread()s its segment chunk by chunk, reading blocksize bytes
+ * beyond it, and rolls the checksum over it. Blocks whose MD4 matches are
+ * written to the working output right away - pwrite() at the offset of the
+ * block, so two threads finding the same block write the same bytes - and
+ * their ids are recorded. Threads only read the hash tables and ranges; the
+ * calling thread then merges the recorded ids, which is the only place that
+ * updates the hash chains and ranges of the state.
+ *
+ * The source is not mmap()ed: it is a user file which may be truncated while
+ * we scan it, and that must not end in SIGBUS. */
+
+/* Window positions per pread() chunk, in blocks; each thread holds one chunk
+ * plus a block of lookahead. */
+#define SCAN_CHUNK_BLOCKS 8
+
+/* Don't bother with another thread for less than this many blocks of data. */
+#define SCAN_MIN_BLOCKS_PER_THREAD 4
+#define SCAN_MAX_THREADS 8
+
+struct scan_segment {
+    const struct rcksum_state *z;
+    int fd;                     /* of the source file */
+    off_t from, to;             /* window start positions [from, to) */
+
+    zs_blockid *matches;
+    size_t nmatches, allocated;
+    unsigned char *claimed;     /* blocks this segment already matched */
+    int failed;
+};
+
+static int scan_add_match(struct scan_segment *s, zs_blockid id) {
+    if (s->nmatches == s->allocated) {
+        size_t n = s->allocated ? 2 * s->allocated : 64;
+        zs_blockid *m = realloc(s->matches, n * sizeof *m);
+        if (!m)
+            return 0;
+        s->matches = m;
+        s->allocated = n;
+    }
+    s->matches[s->nmatches++] = id;
+    return 1;
+}
+
+/* Writes one verified block to the working output. */
+static int scan_write_block(const struct rcksum_state *z, const unsigned char *data,
+                            zs_blockid id) {
+    const off_t offset = ((off_t) id) << z->blockshift;
+    size_t done = 0;
+
+    while (done < z->blocksize) {
+        ssize_t rc = pwrite(z->fd, data + done, z->blocksize - done, offset + done);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            return 0;
+        }
+        done += rc;
+    }
+    return 1;
+}
+
+/* Thread safe counterpart of check_checksums_on_hash_chain: writes and
+ * records every block on the chain whose checksums match the window at data.
+ * Blocks matched earlier in the same segment are skipped, like the sequential
+ * scan does by removing them from the hash. */
+static int scan_check_chain(struct scan_segment *s, const struct hash_entry *e,
+                            struct rsum r, const unsigned char *data) {
+    const struct rcksum_state *z = s->z;
+    unsigned char md4sum[CHECKSUM_SIZE];
+    int done_md4 = 0;
+    int got = 0;
+
+    for (; e; e = e->next) {
+        zs_blockid id;
+
+        if (e->r.a != (r.a & z->rsum_a_mask) || e->r.b != r.b)
+            continue;
+        id = get_HE_blockid(z, e);
+        if (s->claimed[id >> 3] & (1 << (id & 7)))
+            continue;
+
+        if (!done_md4) {
+            rcksum_calc_checksum(md4sum, data, z->blocksize);
+            done_md4 = 1;
+        }
+        if (memcmp(md4sum, e->checksum, z->checksum_bytes))
+            continue;
+
+        if (!scan_write_block(z, data, id) || !scan_add_match(s, id)) {
+            s->failed = 1;
+            return got;
+        }
+        s->claimed[id >> 3] |= 1 << (id & 7);
+        got++;
+    }
+    return got;
+}
+
+/* Reads len bytes at offset, zero filling whatever lies beyond EOF. */
+static int scan_read(int fd, unsigned char *buf, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t rc = pread(fd, buf + done, len - done, offset + done);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            return 0;
+        }
+        if (rc == 0)
+            break;
+        done += rc;
+    }
+    memset(buf + done, 0, len - done);
+    return 1;
+}
+
+static void *scan_segment_run(void *arg) {
+    struct scan_segment *s = arg;
+    const struct rcksum_state *z = s->z;
+    const size_t bs = z->blocksize;
+    const int bshift = z->blockshift;
+    struct rsum r = { 0, 0 };
+    int have_r = 0;
+    size_t skip = 0;
+    off_t pos = s->from;
+    unsigned char *data = malloc(SCAN_CHUNK_BLOCKS * bs + bs);
+
+    if (!data) {
+        s->failed = 1;
+        return NULL;
+    }
+
+    while (pos < s->to && !s->failed) {
+        /* data[] holds the windows starting at [pos, pos + nwin), plus the
+         * byte needed to roll the checksum on to pos + nwin */
+        const size_t nwin = s->to - pos < (off_t)(SCAN_CHUNK_BLOCKS * bs)
+            ? (size_t)(s->to - pos) : SCAN_CHUNK_BLOCKS * bs;
+        size_t x = skip;
+
+        if (!scan_read(s->fd, data, nwin + bs, pos)) {
+            s->failed = 1;
+            break;
+        }
+        if (!have_r && x < nwin)
+            r = rcksum_calc_rsum_block(data + x, bs);
+
+        {
+            /* The hot loop: keep the rolling checksum and the table
+             * parameters in registers rather than going through z. */
+            const unsigned char *const bithash = z->bithash;
+            const uint64_t bithashmask = z->bithashmask;
+            const uint64_t hashmask = z->hashmask;
+            const rsum_component_type amask = z->rsum_a_mask;
+            const unsigned short hshift = z->hash_func_shift;
+            rsum_component_type a = r.a, b = r.b;
+
+            while (x < nwin) {
+                const struct hash_entry *e;
+                uint64_t h = b;
+                h ^= (a & amask) << hshift;
+
+                if ((bithash[(h & bithashmask) >> 3] & (1 << (h & 7)))
+                    && (e = z->rsum_hash[h & hashmask]) != NULL) {
+                    struct rsum cur;
+                    cur.a = a;
+                    cur.b = b;
+                    if (scan_check_chain(s, e, cur, data + x)) {
+                        /* Target blocks are blocksize apart; skip over this
+                         * one. */
+                        x += bs;
+                        if (x < nwin) {
+                            r = rcksum_calc_rsum_block(data + x, bs);
+                            a = r.a;
+                            b = r.b;
+                        }
+                        continue;
+                    }
+                }
+                UPDATE_RSUM(a, b, data[x], data[x + bs], bshift);
+                x++;
+            }
+            r.a = a;
+            r.b = b;
+        }
+
+        /* A match may have skipped beyond this chunk; the rsum then has to be
+         * computed from scratch in the next one. */
+        have_r = x == nwin;
+        skip = x - nwin;
+        pos += nwin;
+    }
+    free(data);
+    return NULL;
+}
+
+/* Record the blocks a segment wrote as known. Returns the number of blocks
+ * obtained. */
+static int scan_merge_segment(struct rcksum_state *z, const struct scan_segment *s) {
+    int got_blocks = 0;
+    size_t i;
+
+    for (i = 0; i < s->nmatches; i++) {
+        const zs_blockid id = s->matches[i];
+
+        /* An earlier segment may have found the same block already */
+        if (already_got_block(z, id))
+            continue;
+        remove_block_from_hash(z, id);
+        add_to_ranges(z, id);
+        z->stats.stronghit++;
+        got_blocks++;
+    }
+    return got_blocks;
+}
+
+static int scan_threads_for(const struct rcksum_state *z, off_t size) {
+    long n = z->scan_threads;
+    off_t max_by_size;
+
+    if (n <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        if (n <= 0)
+            n = 1;
+        if (n > SCAN_MAX_THREADS)
+            n = SCAN_MAX_THREADS;
+    }
+
+    max_by_size = size / (off_t)(z->blocksize * SCAN_MIN_BLOCKS_PER_THREAD);
+    if (n > max_by_size)
+        n = max_by_size > 0 ? (long)max_by_size : 1;
+    return (int)n;
+}
+
+/* submit_source_threaded(self, fd, size)
+ * Scans the size bytes of fd with scan_threads_for() threads. Returns the
+ * number of blocks obtained, or -1 if the scan could not be completed, in
+ * which case no block has been recorded as known. */
+static int submit_source_threaded(struct rcksum_state *z, int fd, off_t size) {
+    const size_t claimed_size = ((size_t)z->blocks + 7) / 8 + 1;
+    const int nthreads = scan_threads_for(z, size);
+    struct scan_segment *segs;
+    pthread_t *threads;
+    int *started;
+    int i, got_blocks = -1;
+
+    segs = calloc(nthreads, sizeof *segs);
+    threads = calloc(nthreads, sizeof *threads);
+    started = calloc(nthreads, sizeof *started);
+    if (!segs || !threads || !started)
+        goto out;
+
+    for (i = 0; i < nthreads; i++) {
+        segs[i].z = z;
+        segs[i].fd = fd;
+        segs[i].from = size * i / nthreads;
+        segs[i].to = size * (i + 1) / nthreads;
+        segs[i].claimed = calloc(claimed_size, 1);
+        if (!segs[i].claimed)
+            goto out;
+    }
+
+    /* The first segment is scanned by the calling thread itself */
+    for (i = 1; i < nthreads; i++)
+        started[i] = pthread_create(&threads[i], NULL, scan_segment_run, &segs[i]) == 0;
+    scan_segment_run(&segs[0]);
+    for (i = 1; i < nthreads; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            scan_segment_run(&segs[i]);
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        if (segs[i].failed)
+            goto out;
+    }
+    got_blocks = 0;
+    for (i = 0; i < nthreads; i++)
+        got_blocks += scan_merge_segment(z, &segs[i]);
+
+out:
+    if (segs) {
+        for (i = 0; i < nthreads; i++) {
+            free(segs[i].matches);
+            free(segs[i].claimed);
+        }
+    }
+    free(segs);
+    free(threads);
+    free(started);
+    return got_blocks;
+}
+
+#endif /* RCKSUM_THREADED_SCAN */
+
+/* rcksum_submit_source_file(self, stream, progress, remote)
+ * As rcksum_submit_source_stream, but where possible scans the file with
+ * several threads. Upload mode (remote) keeps its own sequential bookkeeping
+ * in the state, so it always takes the stream path.
+ */
+int rcksum_submit_source_file(struct rcksum_state *z, FILE * f, int progress, bool remote) {
+#ifdef RCKSUM_THREADED_SCAN
+    off_t size;
+    int got_blocks;
+    int fd = fileno(f);
+    struct progress *p = NULL;
+
+    if (remote || fd == -1)
+        return rcksum_submit_source_stream(z, f, progress, remote);
+
+    size = get_file_size(f);
+    if (size <= 0)
+        return rcksum_submit_source_stream(z, f, progress, remote);
+
+    if (!z->rsum_hash)
+        if (!build_hash(z))
+            return 0;
+
+    if (progress) {
+        p = start_progress();
+        do_progress(p, 0, 0);
+    }
+    got_blocks = submit_source_threaded(z, fd, size);
+    if (progress)
+        end_progress(p, got_blocks < 0 ? 0 : 2);
+
+    if (got_blocks < 0)
+        return rcksum_submit_source_stream(z, f, progress, remote);
+    return got_blocks;
+#else
+    return rcksum_submit_source_stream(z, f, progress, remote);
+#endif
+}
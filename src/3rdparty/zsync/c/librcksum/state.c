@@ -67,6 +67,7 @@ struct rcksum_state *rcksum_init(zs_blockid nblocks, size_t blocksize,
     z->rsum_bits = rsum_bytes * 8;
     z->checksum_bytes = checksum_bytes;
     z->lid_offset = 0;
+    z->scan_threads = 0;
 
     z->context = blocksize;
 
@@ -119,6 +120,13 @@ struct rcksum_state *rcksum_init(zs_blockid nblocks, size_t blocksize,
     return NULL;
 }
 
+/* rcksum_set_scan_threads(self, threads)
+ * Limits the number of threads used to scan a source file for known blocks.
+ * 0 (the default) uses one thread per online CPU, 1 disables threading. */
+void rcksum_set_scan_threads(struct rcksum_state *z, int threads) {
+    z->scan_threads = threads < 0 ? 0 : threads;
+}
+
 /* rcksum_filename(self)
  * Returns temporary filename to caller as malloced string.
  * Ownership of the file passes to the caller - the function returns NULL if
@@ -340,6 +340,15 @@ static void do_zstream(FILE * fin, FILE * fout, const char *bufsofar, size_t got
 
 #endif
 
+int zsyncfile_write_blocksums(
+        unsigned char *buf, size_t got, FILE *fout, zsyncfile_state *state) {
+    /* The SHA-1 sum, unlike our internal block-based sums, is on the whole file and nothing else - no padding */
+    SHA1Update(&state->shactx, buf, got);
+
+    state->len += got;
+    return write_block_sums(buf, got, fout, state);
+}
+
 int zsyncfile_read_stream_write_blocksums(
         FILE *fin, FILE *fout, int no_look_inside, zsyncfile_state *state) {
     unsigned char *buf = malloc(state->blocksize);
@@ -363,11 +372,7 @@ int zsyncfile_read_stream_write_blocksums(
             (void)no_look_inside;
 #endif
 
-            /* The SHA-1 sum, unlike our internal block-based sums, is on the whole file and nothing else - no padding */
-            SHA1Update(&state->shactx, buf, got);
-
-            result = write_block_sums(buf, got, fout, state);
-            state->len += got;
+            result = zsyncfile_write_blocksums(buf, got, fout, state);
         }
         else {
             if (ferror(fin)) {
@@ -57,6 +57,18 @@ void zsyncfile_finish(zsyncfile_state **state_ptr);
 int zsyncfile_read_stream_write_blocksums(
         FILE *fin, FILE *fout, int no_look_inside, zsyncfile_state *state);
 
+/* Writes to the zsync stream fout the blocksums for the got bytes in buf and
+ * adds them to the whole-file checksum.
+ *
+ * Lets callers that read the data themselves feed it block by block. buf
+ * must have room for state->blocksize bytes since a short last block is zero
+ * padded in place; only the last call may pass fewer than blocksize bytes.
+ *
+ * Returns 0 on success
+ */
+int zsyncfile_write_blocksums(
+        unsigned char *buf, size_t got, FILE *fout, zsyncfile_state *state);
+
 /* Decide how many bytes from the rsum hash and checksum hash per block to keep for
  * a file with the given length and blocksize. Also decide on seq_matches.
  */
@@ -148,9 +148,13 @@ QByteArray findBestChecksum(const QByteArray &checksums)
         || -1 != (i = checksums.indexOf("MD5:"))
         || -1 != (i = checksums.indexOf("Adler32:"))) {
         // Now i is the start of the best checksum
-        // Grab it until the next space or end of string.
+        // Grab it until the next space, the end of a nested element
+        // like <checksum> or the end of string.
         auto checksum = checksums.mid(i);
-        return checksum.mid(0, checksum.indexOf(" "));
+        int end = 0;
+        while (end < checksum.size() && checksum[end] != ' ' && checksum[end] != '<')
+            ++end;
+        return checksum.left(end);
     }
     return QByteArray();
 }
@@ -204,6 +208,72 @@ static bool checksumComputationEnabled()
     return enabled;
 }
 
+ChecksumCalculator::ChecksumCalculator(const QByteArray &checksumType)
+    : _checksumType(checksumType)
+{
+    if (checksumType.isEmpty()) {
+        return;
+    }
+    if (!checksumComputationEnabled()) {
+        qCWarning(lcChecksums) << "Checksum computation disabled by environment variable";
+        return;
+    }
+
+    if (checksumType == checkSumMD5C) {
+        _cryptoHash.reset(new QCryptographicHash(QCryptographicHash::Md5));
+    } else if (checksumType == checkSumSHA1C) {
+        _cryptoHash.reset(new QCryptographicHash(QCryptographicHash::Sha1));
+    } else if (checksumType == checkSumSHA2C) {
+        _cryptoHash.reset(new QCryptographicHash(QCryptographicHash::Sha256));
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    else if (checksumType == checkSumSHA3C) {
+        _cryptoHash.reset(new QCryptographicHash(QCryptographicHash::Sha3_256));
+    }
+#endif
+#ifdef ZLIB_FOUND
+    else if (checksumType == checkSumAdlerC) {
+        _isAdler32 = true;
+        _adler32 = adler32(0L, Z_NULL, 0);
+    }
+#endif
+    else {
+        qCWarning(lcChecksums) << "Unknown checksum type:" << checksumType;
+    }
+}
+
+ChecksumCalculator::~ChecksumCalculator()
+{
+}
+
+bool ChecksumCalculator::isValid() const
+{
+    return _cryptoHash || _isAdler32;
+}
+
+void ChecksumCalculator::addData(const char *data, qint64 length)
+{
+    if (_cryptoHash) {
+        _cryptoHash->addData(data, length);
+    }
+#ifdef ZLIB_FOUND
+    else if (_isAdler32) {
+        _adler32 = adler32(_adler32, reinterpret_cast<const Bytef *>(data), static_cast<uInt>(length));
+    }
+#endif
+}
+
+QByteArray ChecksumCalculator::result()
+{
+    if (_cryptoHash) {
+        return _cryptoHash->result().toHex();
+    }
+    if (_isAdler32) {
+        return QByteArray::number(_adler32, 16);
+    }
+    return QByteArray();
+}
+
 ComputeChecksum::ComputeChecksum(QObject *parent)
     : QObject(parent)
 {
@@ -323,19 +393,26 @@ ValidateChecksumHeader::ValidateChecksumHeader(QObject *parent)
 {
 }
 
-ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+bool ValidateChecksumHeader::readExpectedChecksum(const QByteArray &checksumHeader)
 {
     // If the incoming header is empty no validation can happen. Just continue.
     if (checksumHeader.isEmpty()) {
         emit validated(QByteArray(), QByteArray());
-        return nullptr;
+        return false;
     }
 
     if (!parseChecksumHeader(checksumHeader, &_expectedChecksumType, &_expectedChecksum)) {
         qCWarning(lcChecksums) << "Checksum header malformed:" << checksumHeader;
         emit validationFailed(tr("O cabeçalho da soma de verificação está incorreto."));
-        return nullptr;
+        return false;
     }
+    return true;
+}
+
+ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+{
+    if (!readExpectedChecksum(checksumHeader))
+        return nullptr;
 
     auto calculator = new ComputeChecksum(this);
     calculator->setChecksumType(_expectedChecksumType);
@@ -356,6 +433,13 @@ void ValidateChecksumHeader::start(std::unique_ptr<QIODevice> device, const QByt
         calculator->start(std::move(device));
 }
 
+void ValidateChecksumHeader::validate(const QByteArray &checksumHeader,
+    const QByteArray &checksumType, const QByteArray &checksum)
+{
+    if (readExpectedChecksum(checksumHeader))
+        slotChecksumCalculated(checksumType, checksum);
+}
+
 void ValidateChecksumHeader::slotChecksumCalculated(const QByteArray &checksumType,
     const QByteArray &checksum)
 {
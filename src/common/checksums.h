@@ -24,6 +24,7 @@
 #include <QObject>
 #include <QByteArray>
 #include <QFutureWatcher>
+#include <QCryptographicHash>
 
 #include <memory>
 
@@ -75,6 +76,43 @@ QByteArray OCSYNC_EXPORT calcSha1(QIODevice *device);
 QByteArray OCSYNC_EXPORT calcAdler32(QIODevice *device);
 #endif
 
+/**
+ * Computes a checksum incrementally from data that is fed to it.
+ *
+ * Useful when a single read of a file has to feed several consumers,
+ * like the content checksum, the transmission checksum and the zsync
+ * block sums on upload.
+ * \ingroup libsync
+ */
+class OCSYNC_EXPORT ChecksumCalculator
+{
+public:
+    /**
+     * Prepares the calculation for \a checksumType.
+     *
+     * For an empty or unknown type, or when checksum computations are
+     * disabled, isValid() is false and result() returns a null array.
+     */
+    explicit ChecksumCalculator(const QByteArray &checksumType);
+    ~ChecksumCalculator();
+
+    QByteArray checksumType() const { return _checksumType; }
+    bool isValid() const;
+
+    void addData(const char *data, qint64 length);
+
+    /// The hex encoded checksum of all data added so far. Call at most once.
+    QByteArray result();
+
+private:
+    Q_DISABLE_COPY(ChecksumCalculator)
+
+    QByteArray _checksumType;
+    std::unique_ptr<QCryptographicHash> _cryptoHash;
+    bool _isAdler32 = false;
+    quint32 _adler32 = 0;
+};
+
 /**
  * Computes the checksum of a file.
  * \ingroup libsync
@@ -164,6 +202,14 @@ public:
      */
     void start(std::unique_ptr<QIODevice> device, const QByteArray &checksumHeader);
 
+    /**
+     * Check an already computed checksum against the provided checksumHeader
+     *
+     * Like start(), but for data that was hashed while it was received.
+     * The signals are emitted before this returns.
+     */
+    void validate(const QByteArray &checksumHeader, const QByteArray &checksumType, const QByteArray &checksum);
+
 signals:
     void validated(const QByteArray &checksumType, const QByteArray &checksum);
     void validationFailed(const QString &errMsg);
@@ -172,6 +218,8 @@ private slots:
     void slotChecksumCalculated(const QByteArray &checksumType, const QByteArray &checksum);
 
 private:
+    /// Returns false if the header already decided the result
+    bool readExpectedChecksum(const QByteArray &checksumHeader);
     ComputeChecksum *prepareStart(const QByteArray &checksumHeader);
 
     QByteArray _expectedChecksumType;
@@ -432,6 +432,60 @@ void SqlQuery::bindValue(int pos, const QVariant &value)
     ASSERT(res == SQLITE_OK);
 }
 
+void SqlQuery::bindInt64(int pos, qint64 value)
+{
+    qCDebug(lcSql) << "SQL bind" << pos << value;
+
+    if (!_stmt) {
+        ASSERT(false);
+        return;
+    }
+
+    int res = sqlite3_bind_int64(_stmt, pos, value);
+    if (res != SQLITE_OK) {
+        qCWarning(lcSql) << "ERROR binding SQL value:" << value << "error:" << res;
+    }
+    ASSERT(res == SQLITE_OK);
+}
+
+void SqlQuery::bindUtf8(int pos, const QByteArray &value)
+{
+    qCDebug(lcSql) << "SQL bind" << pos << value;
+
+    if (!_stmt) {
+        ASSERT(false);
+        return;
+    }
+
+    // Holding a reference keeps the data alive and unchanged, so sqlite
+    // doesn't need its own copy
+    if (_boundData.size() <= pos)
+        _boundData.resize(pos + 1);
+    _boundData[pos] = value;
+    const QByteArray &data = _boundData.at(pos);
+    int res = sqlite3_bind_text(_stmt, pos, data.constData(), data.size(), SQLITE_STATIC);
+    if (res != SQLITE_OK) {
+        qCWarning(lcSql) << "ERROR binding SQL value:" << value << "error:" << res;
+    }
+    ASSERT(res == SQLITE_OK);
+}
+
+void SqlQuery::bindNull(int pos)
+{
+    qCDebug(lcSql) << "SQL bind" << pos << "NULL";
+
+    if (!_stmt) {
+        ASSERT(false);
+        return;
+    }
+
+    int res = sqlite3_bind_null(_stmt, pos);
+    if (res != SQLITE_OK) {
+        qCWarning(lcSql) << "ERROR binding SQL NULL, error:" << res;
+    }
+    ASSERT(res == SQLITE_OK);
+}
+
 bool SqlQuery::nullValue(int index)
 {
     return sqlite3_column_type(_stmt, index) == SQLITE_NULL;
@@ -439,7 +493,9 @@ bool SqlQuery::nullValue(int index)
 
 QString SqlQuery::stringValue(int index)
 {
-    return QString::fromUtf16(static_cast<const ushort *>(sqlite3_column_text16(_stmt, index)));
+    // The database is UTF-8, reading UTF-16 would make sqlite convert first
+    return QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(_stmt, index)),
+        sqlite3_column_bytes(_stmt, index));
 }
 
 int SqlQuery::intValue(int index)
@@ -458,6 +514,13 @@ QByteArray SqlQuery::baValue(int index)
         sqlite3_column_bytes(_stmt, index));
 }
 
+QByteArray SqlQuery::baValueView(int index)
+{
+    // sqlite3_column_text() zero-terminates, so the view works with C string functions
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(sqlite3_column_text(_stmt, index)),
+        sqlite3_column_bytes(_stmt, index));
+}
+
 QString SqlQuery::error() const
 {
     return _error;
@@ -484,6 +547,7 @@ void SqlQuery::finish()
         return;
     SQLITE_DO(sqlite3_finalize(_stmt));
     _stmt = 0;
+    _boundData.clear();
     if (_sqldb) {
         _sqldb->_queries.remove(this);
     }
@@ -495,6 +559,9 @@ void SqlQuery::reset_and_clear_bindings()
         SQLITE_DO(sqlite3_reset(_stmt));
         SQLITE_DO(sqlite3_clear_bindings(_stmt));
     }
+    // Keep the capacity, the same positions get bound again
+    for (auto &data : _boundData)
+        data.clear();
 }
 
 bool SqlQuery::initOrReset(const QByteArray &sql, OCC::SqlDatabase &db)
@@ -22,6 +22,7 @@
 #include <QObject>
 #include <QVariant>
 #include <QSet>
+#include <QVector>
 
 #include "ocsynclib.h"
 
@@ -126,6 +127,12 @@ public:
     int intValue(int index);
     quint64 int64Value(int index);
     QByteArray baValue(int index);
+    /**
+     * Like baValue(), but without copying the data: the result points into
+     * sqlite's zero-terminated buffer and is only valid until the next call
+     * to next(), reset_and_clear_bindings() or finish().
+     */
+    QByteArray baValueView(int index);
     bool isSelect();
     bool isPragma();
     bool exec();
@@ -138,6 +145,21 @@ public:
     NextResult next();
 
     void bindValue(int pos, const QVariant &value);
+
+    /// Binds an integer without boxing it into a QVariant
+    void bindInt64(int pos, qint64 value);
+
+    /**
+     * Binds UTF-8 text without copying it.
+     *
+     * The query keeps a reference to the byte array until the bindings are
+     * cleared, so temporaries are fine. Only the data of a
+     * QByteArray::fromRawData() must outlive that.
+     */
+    void bindUtf8(int pos, const QByteArray &value);
+
+    void bindNull(int pos);
+
     QString lastQuery() const;
     int numRowsAffected();
     void reset_and_clear_bindings();
@@ -150,6 +172,8 @@ private:
     QString _error;
     int _errId;
     QByteArray _sql;
+    // The data bound with bindUtf8(), by position
+    QVector<QByteArray> _boundData;
 };
 
 } // namespace OCC
@@ -21,6 +21,8 @@
 #include <QLoggingCategory>
 #include <QStringList>
 #include <QElapsedTimer>
+#include <QThread>
+#include <QDateTime>
 #include <QUrl>
 #include <QDir>
 #include <sqlite3.h>
@@ -59,7 +61,7 @@ static void fillFileRecordFromGetQuery(SyncJournalFileRecord &rec, SqlQuery &que
     rec._type = static_cast<ItemType>(query.intValue(3));
     rec._etag = query.baValue(4);
     rec._fileId = query.baValue(5);
-    rec._remotePerm = RemotePermissions::fromDbValue(query.baValue(6));
+    rec._remotePerm = RemotePermissions::fromDbValue(query.baValueView(6));
     rec._fileSize = query.int64Value(7);
     rec._serverHasIgnoredFiles = (query.intValue(8) > 0);
     rec._checksumHeader = query.baValue(9);
@@ -93,7 +95,12 @@ SyncJournalDb::SyncJournalDb(const QString &dbFilePath, QObject *parent)
     , _mutex(QMutex::Recursive)
     , _transaction(0)
     , _metadataTableIsEmpty(false)
+    , _groupCommitTimer(new QTimer(this))
 {
+    _groupCommitTimer->setSingleShot(true);
+    _groupCommitTimer->setInterval(_groupCommitInterval);
+    connect(_groupCommitTimer, &QTimer::timeout, this, [this] { flushGroupCommit(QStringLiteral("group commit timeout")); });
+
     // Allow forcing the journal mode for debugging
     static QByteArray envJournalMode = qgetenv("OWNCLOUD_SQLITE_JOURNAL_MODE");
     _journalMode = envJournalMode;
@@ -447,6 +454,21 @@ bool SyncJournalDb::checkConnect()
         return sqlFail("Create table uploadinfo", createQuery);
     }
 
+    // zsync block sums of the last synced version of files
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS zsyncmetadata("
+                        "path VARCHAR(4096),"
+                        "etag VARCHAR(32),"
+                        "contentChecksum TEXT,"
+                        "metadata BLOB,"
+                        "size INTEGER(8),"
+                        "lastUsed INTEGER(8),"
+                        "PRIMARY KEY(path)"
+                        ");");
+
+    if (!createQuery.exec()) {
+        return sqlFail("Create table zsyncmetadata", createQuery);
+    }
+
     // create the blacklist table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS blacklist ("
                         "path VARCHAR(4096),"
@@ -497,6 +519,22 @@ bool SyncJournalDb::checkConnect()
         return sqlFail("Create table datafingerprint", createQuery);
     }
 
+    // create the local discovery tables.
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS localdiscovery("
+                        "lastFullDiscovery INTEGER,"
+                        "watchedUntil INTEGER"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail("Create table localdiscovery", createQuery);
+    }
+
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS localdiscoverypaths("
+                        "path TEXT PRIMARY KEY"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail("Create table localdiscoverypaths", createQuery);
+    }
+
     // create the flags table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS flags ("
                         "path TEXT PRIMARY KEY,"
@@ -607,6 +645,10 @@ bool SyncJournalDb::checkConnect()
         return sqlFail("prepare _deleteUploadInfoQuery", _deleteUploadInfoQuery);
     }
 
+    if (!_deleteZsyncMetadataQuery.initOrReset("DELETE FROM zsyncmetadata WHERE path=?1", _db)) {
+        return sqlFail("prepare _deleteZsyncMetadataQuery", _deleteZsyncMetadataQuery);
+    }
+
     QByteArray sql("SELECT lastTryEtag, lastTryModtime, retrycount, errorstring, lastTryTime, ignoreDuration, renameTarget, errorCategory, requestId "
                    "FROM blacklist WHERE path=?1");
     if (Utility::fsCasePreserving()) {
@@ -640,6 +682,7 @@ void SyncJournalDb::close()
     qCInfo(lcDb) << "Closing DB" << _dbFile;
 
     commitTransaction();
+    _groupCommitPending = 0;
     _db.close();
     clearEtagStorageFilter();
     _metadataTableIsEmpty = false;
@@ -758,6 +801,16 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal("update database structure: add contentChecksumTypeId col");
     }
 
+    if (1) {
+        SqlQuery query(_db);
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_content_checksum ON metadata(contentChecksum);");
+        if (!query.exec()) {
+            sqlFail("updateMetadataTableStructure: create index contentChecksum", query);
+            re = false;
+        }
+        commitInternal("update database structure: add contentChecksum index");
+    }
+
     auto uploadInfoColumns = tableColumns("uploadinfo");
     if (uploadInfoColumns.isEmpty())
         return false;
@@ -919,22 +972,22 @@ bool SyncJournalDb::setFileRecord(const SyncJournalFileRecord &_record)
             return false;
         }
 
-        _setFileRecordQuery.bindValue(1, phash);
-        _setFileRecordQuery.bindValue(2, plen);
-        _setFileRecordQuery.bindValue(3, record._path);
-        _setFileRecordQuery.bindValue(4, record._inode);
-        _setFileRecordQuery.bindValue(5, 0); // uid Not used
-        _setFileRecordQuery.bindValue(6, 0); // gid Not used
-        _setFileRecordQuery.bindValue(7, 0); // mode Not used
-        _setFileRecordQuery.bindValue(8, record._modtime);
-        _setFileRecordQuery.bindValue(9, record._type);
-        _setFileRecordQuery.bindValue(10, etag);
-        _setFileRecordQuery.bindValue(11, fileId);
-        _setFileRecordQuery.bindValue(12, remotePerm);
-        _setFileRecordQuery.bindValue(13, record._fileSize);
-        _setFileRecordQuery.bindValue(14, record._serverHasIgnoredFiles ? 1 : 0);
-        _setFileRecordQuery.bindValue(15, checksum);
-        _setFileRecordQuery.bindValue(16, contentChecksumTypeId);
+        _setFileRecordQuery.bindInt64(1, phash);
+        _setFileRecordQuery.bindInt64(2, plen);
+        _setFileRecordQuery.bindUtf8(3, record._path);
+        _setFileRecordQuery.bindInt64(4, record._inode);
+        _setFileRecordQuery.bindInt64(5, 0); // uid Not used
+        _setFileRecordQuery.bindInt64(6, 0); // gid Not used
+        _setFileRecordQuery.bindInt64(7, 0); // mode Not used
+        _setFileRecordQuery.bindInt64(8, record._modtime);
+        _setFileRecordQuery.bindInt64(9, record._type);
+        _setFileRecordQuery.bindUtf8(10, etag);
+        _setFileRecordQuery.bindUtf8(11, fileId);
+        _setFileRecordQuery.bindUtf8(12, remotePerm);
+        _setFileRecordQuery.bindInt64(13, record._fileSize);
+        _setFileRecordQuery.bindInt64(14, record._serverHasIgnoredFiles ? 1 : 0);
+        _setFileRecordQuery.bindUtf8(15, checksum);
+        _setFileRecordQuery.bindInt64(16, contentChecksumTypeId);
 
         if (!_setFileRecordQuery.exec()) {
             return false;
@@ -984,6 +1037,18 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
 
 
 bool SyncJournalDb::getFileRecord(const QByteArray &filename, SyncJournalFileRecord *rec)
+{
+    // Reset the output var in case the caller is reusing it.
+    Q_ASSERT(rec);
+    rec->_path.clear();
+    Q_ASSERT(!rec->isValid());
+
+    if (filename.isEmpty())
+        return true;
+    return getFileRecordByPHash(getPHash(filename), rec);
+}
+
+bool SyncJournalDb::getFileRecordByPHash(qint64 phash, SyncJournalFileRecord *rec)
 {
     QMutexLocker locker(&_mutex);
 
@@ -998,27 +1063,25 @@ bool SyncJournalDb::getFileRecord(const QByteArray &filename, SyncJournalFileRec
     if (!checkConnect())
         return false;
 
-    if (!filename.isEmpty()) {
-        if (!_getFileRecordQuery.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE phash=?1"), _db))
-            return false;
+    if (!_getFileRecordQuery.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE phash=?1"), _db))
+        return false;
 
-        _getFileRecordQuery.bindValue(1, getPHash(filename));
+    _getFileRecordQuery.bindInt64(1, phash);
 
-        if (!_getFileRecordQuery.exec()) {
-            close();
-            return false;
-        }
+    if (!_getFileRecordQuery.exec()) {
+        close();
+        return false;
+    }
 
-        auto next = _getFileRecordQuery.next();
-        if (!next.ok) {
-            QString err = _getFileRecordQuery.error();
-            qCWarning(lcDb) << "No journal entry found for " << filename << "Error: " << err;
-            close();
-            return false;
-        }
-        if (next.hasData) {
-            fillFileRecordFromGetQuery(*rec, _getFileRecordQuery);
-        }
+    auto next = _getFileRecordQuery.next();
+    if (!next.ok) {
+        QString err = _getFileRecordQuery.error();
+        qCWarning(lcDb) << "No journal entry found for phash" << phash << "Error: " << err;
+        close();
+        return false;
+    }
+    if (next.hasData) {
+        fillFileRecordFromGetQuery(*rec, _getFileRecordQuery);
     }
     return true;
 }
@@ -1041,7 +1104,7 @@ bool SyncJournalDb::getFileRecordByInode(quint64 inode, SyncJournalFileRecord *r
     if (!_getFileRecordQueryByInode.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE inode=?1"), _db))
         return false;
 
-    _getFileRecordQueryByInode.bindValue(1, inode);
+    _getFileRecordQueryByInode.bindInt64(1, inode);
 
     if (!_getFileRecordQueryByInode.exec())
         return false;
@@ -1068,7 +1131,7 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     if (!_getFileRecordQueryByFileId.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE fileid=?1"), _db))
         return false;
 
-    _getFileRecordQueryByFileId.bindValue(1, fileId);
+    _getFileRecordQueryByFileId.bindUtf8(1, fileId);
 
     if (!_getFileRecordQueryByFileId.exec())
         return false;
@@ -1088,6 +1151,72 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     return true;
 }
 
+bool SyncJournalDb::getFileRecordsByChecksum(const QByteArray &checksumHeader, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    QByteArray checksumType;
+    QByteArray checksum;
+    if (!parseChecksumHeader(checksumHeader, &checksumType, &checksum) || checksum.isEmpty() || _metadataTableIsEmpty)
+        return true; // no error, yet nothing found
+
+    if (!checkConnect())
+        return false;
+
+    if (!_getFileRecordQueryByChecksum.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY
+                                                       " WHERE contentChecksum=?1 AND contentchecksumtype.name=?2 AND type=?3"),
+            _db))
+        return false;
+
+    _getFileRecordQueryByChecksum.bindUtf8(1, checksum);
+    _getFileRecordQueryByChecksum.bindUtf8(2, checksumType);
+    _getFileRecordQueryByChecksum.bindInt64(3, ItemTypeFile);
+
+    if (!_getFileRecordQueryByChecksum.exec())
+        return false;
+
+    forever {
+        auto next = _getFileRecordQueryByChecksum.next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, _getFileRecordQueryByChecksum);
+        rowCallback(rec);
+    }
+
+    return true;
+}
+
+bool SyncJournalDb::listFileIdentities(const std::function<void(qint64, quint64, const QByteArray &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_metadataTableIsEmpty)
+        return true;
+
+    if (!checkConnect())
+        return false;
+
+    SqlQuery query(_db);
+    if (query.prepare("SELECT phash, inode, fileid FROM metadata") != 0)
+        return false;
+    if (!query.exec())
+        return false;
+
+    forever {
+        auto next = query.next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+        rowCallback(static_cast<qint64>(query.int64Value(0)), query.int64Value(1), query.baValue(2));
+    }
+    return true;
+}
+
 bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
 {
     QMutexLocker locker(&_mutex);
@@ -1124,7 +1253,7 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
             return false;
         }
         query = &_getFilesBelowPathQuery;
-        query->bindValue(1, path);
+        query->bindUtf8(1, path);
     }
 
     if (!query->exec()) {
@@ -1161,7 +1290,7 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
             GET_FILE_RECORD_QUERY " WHERE parent_hash(path) = ?1 ORDER BY path||'/' ASC"), _db))
         return false;
 
-    _listFilesInPathQuery.bindValue(1, getPHash(path));
+    _listFilesInPathQuery.bindInt64(1, getPHash(path));
 
     if (!_listFilesInPathQuery.exec())
         return false;
@@ -1173,12 +1302,15 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
         if (!next.hasData)
             break;
 
-        SyncJournalFileRecord rec;
-        fillFileRecordFromGetQuery(rec, _listFilesInPathQuery);
-        if (!rec._path.startsWith(path) || rec._path.indexOf("/", path.size() + 1) > 0) {
-            qWarning(lcDb) << "hash collision " << path << rec._path;
+        // Check for collisions before copying the row
+        const QByteArray rowPath = _listFilesInPathQuery.baValueView(0);
+        if (!rowPath.startsWith(path) || rowPath.indexOf("/", path.size() + 1) > 0) {
+            qWarning(lcDb) << "hash collision " << path << rowPath;
             continue;
         }
+
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, _listFilesInPathQuery);
         rowCallback(rec);
     }
 
@@ -1529,6 +1661,116 @@ QVector<uint> SyncJournalDb::deleteStaleUploadInfos(const QSet<QString> &keep)
     return ids;
 }
 
+QByteArray SyncJournalDb::getZsyncMetadata(const QString &file, const QByteArray &etag, const QByteArray &contentChecksum)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_zsyncMetadataCacheLimit <= 0 || etag.isEmpty() || contentChecksum.isEmpty() || !checkConnect()) {
+        return QByteArray();
+    }
+
+    if (!_getZsyncMetadataQuery.initOrReset(QByteArrayLiteral(
+            "SELECT metadata FROM zsyncmetadata WHERE path=?1 AND etag=?2 AND contentChecksum=?3"), _db)) {
+        return QByteArray();
+    }
+    _getZsyncMetadataQuery.bindValue(1, file);
+    _getZsyncMetadataQuery.bindValue(2, etag);
+    _getZsyncMetadataQuery.bindValue(3, contentChecksum);
+
+    if (!_getZsyncMetadataQuery.exec() || !_getZsyncMetadataQuery.next().hasData) {
+        return QByteArray();
+    }
+    const QByteArray metadata = _getZsyncMetadataQuery.baValue(0);
+
+    // Remember the use for the size limit
+    SqlQuery query(_db);
+    query.prepare("UPDATE zsyncmetadata SET lastUsed=?2 WHERE path=?1");
+    query.bindValue(1, file);
+    query.bindValue(2, QDateTime::currentMSecsSinceEpoch());
+    query.exec();
+
+    return metadata;
+}
+
+void SyncJournalDb::setZsyncMetadata(const QString &file, const QByteArray &etag, const QByteArray &contentChecksum, const QByteArray &metadata)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (!checkConnect()) {
+        return;
+    }
+
+    if (_zsyncMetadataCacheLimit <= 0 || metadata.size() > _zsyncMetadataCacheLimit
+        || etag.isEmpty() || contentChecksum.isEmpty()) {
+        _deleteZsyncMetadataQuery.reset_and_clear_bindings();
+        _deleteZsyncMetadataQuery.bindValue(1, file);
+        _deleteZsyncMetadataQuery.exec();
+        return;
+    }
+
+    if (!_setZsyncMetadataQuery.initOrReset(QByteArrayLiteral(
+            "INSERT OR REPLACE INTO zsyncmetadata "
+            "(path, etag, contentChecksum, metadata, size, lastUsed) "
+            "VALUES ( ?1 , ?2, ?3 , ?4 , ?5 , ?6 )"), _db)) {
+        return;
+    }
+    _setZsyncMetadataQuery.bindValue(1, file);
+    _setZsyncMetadataQuery.bindValue(2, etag);
+    _setZsyncMetadataQuery.bindValue(3, contentChecksum);
+    _setZsyncMetadataQuery.bindValue(4, metadata);
+    _setZsyncMetadataQuery.bindValue(5, metadata.size());
+    _setZsyncMetadataQuery.bindValue(6, QDateTime::currentMSecsSinceEpoch());
+    if (!_setZsyncMetadataQuery.exec()) {
+        return;
+    }
+
+    applyZsyncMetadataCacheLimit();
+}
+
+void SyncJournalDb::deleteStaleZsyncMetadata()
+{
+    QMutexLocker locker(&_mutex);
+
+    if (!checkConnect()) {
+        return;
+    }
+
+    // Entries are only useful while they describe the synced version of a file
+    SqlQuery delQuery("DELETE FROM zsyncmetadata WHERE NOT EXISTS "
+                      "(SELECT 1 FROM metadata WHERE metadata.path = zsyncmetadata.path AND metadata.md5 = zsyncmetadata.etag);",
+        _db);
+    delQuery.exec();
+
+    applyZsyncMetadataCacheLimit();
+}
+
+void SyncJournalDb::setZsyncMetadataCacheLimit(qint64 bytes)
+{
+    QMutexLocker locker(&_mutex);
+    _zsyncMetadataCacheLimit = bytes;
+}
+
+void SyncJournalDb::applyZsyncMetadataCacheLimit()
+{
+    SqlQuery query(_db);
+    query.prepare("SELECT path, size FROM zsyncmetadata ORDER BY lastUsed DESC, rowid DESC");
+    if (!query.exec()) {
+        return;
+    }
+
+    // Keep the most recently used entries that fit
+    QStringList superfluousPaths;
+    qint64 totalSize = 0;
+    while (query.next().hasData) {
+        totalSize += query.int64Value(1);
+        if (totalSize > _zsyncMetadataCacheLimit) {
+            superfluousPaths.append(query.stringValue(0));
+        }
+    }
+
+    deleteBatch(_deleteZsyncMetadataQuery, superfluousPaths, "zsyncmetadata");
+}
+
 SyncJournalErrorBlacklistRecord SyncJournalDb::errorBlacklistEntry(const QString &file)
 {
     QMutexLocker locker(&_mutex);
@@ -1984,6 +2226,87 @@ void SyncJournalDb::setDataFingerprint(const QByteArray &dataFingerprint)
     _setDataFingerprintQuery2.exec();
 }
 
+void SyncJournalDb::setLocalDiscoveryState(const LocalDiscoveryState &state)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    startTransaction();
+
+    SqlQuery delQuery("DELETE FROM localdiscovery", _db);
+    SqlQuery delPathsQuery("DELETE FROM localdiscoverypaths", _db);
+    if (!delQuery.exec() || !delPathsQuery.exec()) {
+        qCWarning(lcDb) << "SQL error when deleting the local discovery state" << delQuery.error();
+    }
+
+    SqlQuery insQuery("INSERT INTO localdiscovery VALUES (?1, ?2)", _db);
+    insQuery.bindValue(1, state.lastFullDiscovery);
+    insQuery.bindValue(2, state.watchedUntil);
+    if (!insQuery.exec()) {
+        qCWarning(lcDb) << "SQL error when inserting the local discovery state" << insQuery.error();
+    }
+
+    SqlQuery insPathQuery("INSERT OR IGNORE INTO localdiscoverypaths VALUES (?1)", _db);
+    foreach (const auto &path, state.paths) {
+        insPathQuery.reset_and_clear_bindings();
+        insPathQuery.bindValue(1, path);
+        if (!insPathQuery.exec()) {
+            qCWarning(lcDb) << "SQL error when inserting local discovery path" << path << insPathQuery.error();
+        }
+    }
+
+    commitInternal("setLocalDiscoveryState");
+}
+
+SyncJournalDb::LocalDiscoveryState SyncJournalDb::takeLocalDiscoveryState()
+{
+    LocalDiscoveryState state;
+
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return state;
+    }
+
+    if (!_getLocalDiscoveryStateQuery.initOrReset(QByteArrayLiteral("SELECT lastFullDiscovery, watchedUntil FROM localdiscovery"), _db)
+        || !_getLocalDiscoveryPathsQuery.initOrReset(QByteArrayLiteral("SELECT path FROM localdiscoverypaths"), _db)) {
+        return state;
+    }
+
+    if (!_getLocalDiscoveryStateQuery.exec() || !_getLocalDiscoveryStateQuery.next().hasData) {
+        return state;
+    }
+    LocalDiscoveryState stored;
+    stored.lastFullDiscovery = qint64(_getLocalDiscoveryStateQuery.int64Value(0));
+    stored.watchedUntil = qint64(_getLocalDiscoveryStateQuery.int64Value(1));
+    _getLocalDiscoveryStateQuery.reset_and_clear_bindings();
+
+    if (!_getLocalDiscoveryPathsQuery.exec()) {
+        return state;
+    }
+    forever {
+        auto next = _getLocalDiscoveryPathsQuery.next();
+        if (!next.ok)
+            return state;
+        if (!next.hasData)
+            break;
+        stored.paths.append(_getLocalDiscoveryPathsQuery.stringValue(0));
+    }
+
+    // A crash before the next setLocalDiscoveryState() must not find this again
+    startTransaction();
+    SqlQuery delQuery("DELETE FROM localdiscovery", _db);
+    SqlQuery delPathsQuery("DELETE FROM localdiscoverypaths", _db);
+    if (!delQuery.exec() || !delPathsQuery.exec()) {
+        qCWarning(lcDb) << "SQL error when deleting the local discovery state" << delQuery.error();
+        return state;
+    }
+    commitInternal("takeLocalDiscoveryState");
+
+    return stored;
+}
+
 void SyncJournalDb::setConflictRecord(const ConflictRecord &record)
 {
     QMutexLocker locker(&_mutex);
@@ -2267,6 +2590,34 @@ void SyncJournalDb::commitIfNeededAndStartNewTransaction(const QString &context)
     }
 }
 
+void SyncJournalDb::groupCommit(const QString &context)
+{
+    QMutexLocker lock(&_mutex);
+    if (++_groupCommitPending >= _groupCommitMaxCount || _transaction == 0) {
+        // Without an open transaction the changes were committed already
+        commitInternal(context, true);
+        return;
+    }
+    // The timer lives in our thread, other threads rely on the count limit
+    if (_groupCommitPending == 1 && QThread::currentThread() == thread() && thread()->eventDispatcher())
+        _groupCommitTimer->start();
+}
+
+void SyncJournalDb::flushGroupCommit(const QString &context)
+{
+    QMutexLocker lock(&_mutex);
+    if (_groupCommitPending > 0)
+        commitInternal(context, true);
+}
+
+void SyncJournalDb::setGroupCommitLimits(int maxCount, int intervalMsec)
+{
+    QMutexLocker lock(&_mutex);
+    _groupCommitMaxCount = maxCount;
+    _groupCommitInterval = intervalMsec;
+    _groupCommitTimer->setInterval(intervalMsec);
+}
+
 bool SyncJournalDb::open()
 {
     QMutexLocker lock(&_mutex);
@@ -2281,8 +2632,12 @@ bool SyncJournalDb::isOpen()
 
 void SyncJournalDb::commitInternal(const QString &context, bool startTrans)
 {
-    qCDebug(lcDb) << "Transaction commit " << context << (startTrans ? "and starting new transaction" : "");
+    qCDebug(lcDb) << "Transaction commit " << context << (startTrans ? "and starting new transaction" : "")
+                  << "grouped changes:" << _groupCommitPending;
     commitTransaction();
+    _groupCommitPending = 0;
+    if (QThread::currentThread() == thread())
+        _groupCommitTimer->stop();
 
     if (startTrans) {
         startTransaction();
@@ -20,6 +20,7 @@
 #define SYNCJOURNALDB_H
 
 #include <QObject>
+#include <QTimer>
 #include <qmutex.h>
 #include <QDateTime>
 #include <QHash>
@@ -61,6 +62,18 @@ public:
     bool getFileRecord(const QByteArray &filename, SyncJournalFileRecord *rec);
     bool getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec);
     bool getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /// The synced files whose content checksum matches \a checksumHeader
+    bool getFileRecordsByChecksum(const QByteArray &checksumHeader, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /// Like getFileRecord(), with the getPHash() of the path
+    bool getFileRecordByPHash(qint64 phash, SyncJournalFileRecord *rec);
+
+    /**
+     * Calls rowCallback with the phash, inode and file id of every file record.
+     *
+     * Meant for building lookup tables in memory; the records themselves can
+     * then be read with getFileRecordByPHash().
+     */
+    bool listFileIdentities(const std::function<void(qint64 phash, quint64 inode, const QByteArray &fileId)> &rowCallback);
     bool getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     bool listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     bool setFileRecord(const SyncJournalFileRecord &record);
@@ -150,6 +163,21 @@ public:
     // Return the list of transfer ids that were removed.
     QVector<uint> deleteStaleUploadInfos(const QSet<QString> &keep);
 
+    /**
+     * The zsync metadata of the last synced version of a file.
+     *
+     * Lets delta uploads work out the changed ranges without downloading the
+     * metadata from the server. Returns an empty array unless the stored entry
+     * matches \a etag and \a contentChecksum.
+     */
+    QByteArray getZsyncMetadata(const QString &file, const QByteArray &etag, const QByteArray &contentChecksum);
+    /// Stores the metadata, evicting least recently used entries beyond the size limit.
+    void setZsyncMetadata(const QString &file, const QByteArray &etag, const QByteArray &contentChecksum, const QByteArray &metadata);
+    /// Drops entries that no longer describe the synced version of a file.
+    void deleteStaleZsyncMetadata();
+    /// Total size of the stored zsync metadata, 0 disables storing it.
+    void setZsyncMetadataCacheLimit(qint64 bytes);
+
     SyncJournalErrorBlacklistRecord errorBlacklistEntry(const QString &);
     bool deleteStaleErrorBlacklistEntries(const QSet<QString> &keep);
 
@@ -216,6 +244,27 @@ public:
     void commit(const QString &context, bool startTrans = true);
     void commitIfNeededAndStartNewTransaction(const QString &context);
 
+    /**
+     * Like commit(), but several calls are grouped into one transaction.
+     *
+     * The transaction is committed once groupCommitMaxCount() calls are pending
+     * or groupCommitInterval() msec after the first pending call, whichever
+     * comes first. Any commit() also commits the pending changes.
+     *
+     * Use commit() for the records that must be on disk before the next step
+     * is taken, like the upload, download and poll infos that allow resuming
+     * after a crash. Changes that can be recovered by the next discovery, like
+     * the metadata of a propagated item, can use groupCommit().
+     */
+    void groupCommit(const QString &context);
+
+    /// Commits the changes pending from groupCommit() calls, if any
+    void flushGroupCommit(const QString &context);
+
+    int groupCommitMaxCount() const { return _groupCommitMaxCount; }
+    int groupCommitInterval() const { return _groupCommitInterval; }
+    void setGroupCommitLimits(int maxCount, int intervalMsec);
+
     /** Open the db if it isn't already.
      *
      * This usually creates some temporary files next to the db file, like
@@ -242,6 +291,21 @@ public:
     void setDataFingerprint(const QByteArray &dataFingerprint);
     QByteArray dataFingerprint();
 
+    /**
+     * What the folder watcher had recorded when the client stopped,
+     * see LocalDiscoveryTracker::saveState().
+     */
+    struct LocalDiscoveryState
+    {
+        qint64 lastFullDiscovery = 0; // msecs since epoch
+        qint64 watchedUntil = 0; // msecs since epoch
+        QStringList paths;
+
+        bool isValid() const { return watchedUntil > 0; }
+    };
+    void setLocalDiscoveryState(const LocalDiscoveryState &state);
+    /// Returns the stored state and removes it from the db, so it is only trusted once
+    LocalDiscoveryState takeLocalDiscoveryState();
 
     // Conflict record functions
 
@@ -395,16 +459,25 @@ private:
     // Returns 0 on failure and for empty checksum types.
     int mapChecksumType(const QByteArray &checksumType);
 
+    // Evicts the least recently used zsync metadata beyond _zsyncMetadataCacheLimit
+    void applyZsyncMetadataCacheLimit();
+
     SqlDatabase _db;
     QString _dbFile;
     QMutex _mutex; // Public functions are protected with the mutex.
     QMap<QByteArray, int> _checksymTypeCache;
     int _transaction;
     bool _metadataTableIsEmpty;
+    int _groupCommitPending = 0;
+    int _groupCommitMaxCount = 1000;
+    int _groupCommitInterval = 1000; // msec
+    QTimer *_groupCommitTimer;
+    qint64 _zsyncMetadataCacheLimit = 32 * 1024 * 1024;
 
     SqlQuery _getFileRecordQuery;
     SqlQuery _getFileRecordQueryByInode;
     SqlQuery _getFileRecordQueryByFileId;
+    SqlQuery _getFileRecordQueryByChecksum;
     SqlQuery _getFilesBelowPathQuery;
     SqlQuery _getAllFilesQuery;
     SqlQuery _listFilesInPathQuery;
@@ -417,6 +490,9 @@ private:
     SqlQuery _getUploadInfoQuery;
     SqlQuery _setUploadInfoQuery;
     SqlQuery _deleteUploadInfoQuery;
+    SqlQuery _getZsyncMetadataQuery;
+    SqlQuery _setZsyncMetadataQuery;
+    SqlQuery _deleteZsyncMetadataQuery;
     SqlQuery _deleteFileRecordPhash;
     SqlQuery _deleteFileRecordRecursively;
     SqlQuery _getErrorBlacklistQuery;
@@ -428,6 +504,8 @@ private:
     SqlQuery _getDataFingerprintQuery;
     SqlQuery _setDataFingerprintQuery1;
     SqlQuery _setDataFingerprintQuery2;
+    SqlQuery _getLocalDiscoveryStateQuery;
+    SqlQuery _getLocalDiscoveryPathsQuery;
     SqlQuery _getConflictRecordQuery;
     SqlQuery _setConflictRecordQuery;
     SqlQuery _deleteConflictRecordQuery;
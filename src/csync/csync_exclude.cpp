@@ -384,28 +384,37 @@ CSYNC_EXCLUDE_TYPE ExcludedFiles::traversalPatternMatch(const QString &path, Ite
     if (lastSlash >= 0) {
         bnameStr = path.midRef(lastSlash + 1);
     }
+    const bool isDir = filetype == ItemTypeDirectory;
+
+    // The literal, prefix and suffix patterns are looked up first. Their
+    // results are combined with the regex in the same order of precedence
+    // as the alternatives of _bnameTraversalRegex*.
+    if (_bnameKeepFileDir.matches(bnameStr) || (isDir && _bnameKeepDir.matches(bnameStr)))
+        return CSYNC_FILE_EXCLUDE_LIST;
 
     QRegularExpressionMatch m;
-    if (filetype == ItemTypeDirectory) {
+    if (isDir) {
         m = _bnameTraversalRegexDir.match(bnameStr);
     } else {
         m = _bnameTraversalRegexFile.match(bnameStr);
     }
+    if (m.hasMatch() && m.capturedStart(QStringLiteral("exclude")) != -1)
+        return CSYNC_FILE_EXCLUDE_LIST;
+    if (_bnameRemoveFileDir.matches(bnameStr) || (isDir && _bnameRemoveDir.matches(bnameStr)))
+        return CSYNC_FILE_EXCLUDE_AND_REMOVE;
     if (!m.hasMatch())
         return CSYNC_NOT_EXCLUDED;
-    if (m.capturedStart(QStringLiteral("exclude")) != -1) {
-        return CSYNC_FILE_EXCLUDE_LIST;
-    } else if (m.capturedStart(QStringLiteral("excluderemove")) != -1) {
+    if (m.capturedStart(QStringLiteral("excluderemove")) != -1)
         return CSYNC_FILE_EXCLUDE_AND_REMOVE;
-    }
 
     // third capture: full path matching is triggered
-    QString pathStr = path;
+    if (!fullTraversalCandidate(lastSlash >= 0 ? path.left(lastSlash) : QString()))
+        return CSYNC_NOT_EXCLUDED;
 
-    if (filetype == ItemTypeDirectory) {
-        m = _fullTraversalRegexDir.match(pathStr);
+    if (isDir) {
+        m = _fullTraversalRegexDir.match(path);
     } else {
-        m = _fullTraversalRegexFile.match(pathStr);
+        m = _fullTraversalRegexFile.match(path);
     }
     if (m.hasMatch()) {
         if (m.capturedStart(QStringLiteral("exclude")) != -1) {
@@ -417,6 +426,104 @@ CSYNC_EXCLUDE_TYPE ExcludedFiles::traversalPatternMatch(const QString &path, Ite
     return CSYNC_NOT_EXCLUDED;
 }
 
+bool ExcludedFiles::fullTraversalCandidate(const QString &dirPath) const
+{
+    if (!_useFullTraversalParentRegex)
+        return true;
+
+    QMutexLocker locker(&_fullTraversalParentMutex);
+    auto it = _fullTraversalParentCache.constFind(dirPath);
+    if (it != _fullTraversalParentCache.constEnd())
+        return *it;
+
+    // The cache only needs to hold the directories of the current traversal
+    if (_fullTraversalParentCache.size() > 100000)
+        _fullTraversalParentCache.clear();
+    bool candidate = _fullTraversalParentRegex.match(dirPath).hasMatch();
+    _fullTraversalParentCache.insert(dirPath, candidate);
+    return candidate;
+}
+
+bool ExcludedFiles::BnamePatternSet::add(const QString &pattern)
+{
+    auto isLiteral = [](const QStringRef &s) {
+        for (auto c : s) {
+            if (c == QLatin1Char('*') || c == QLatin1Char('?') || c == QLatin1Char('[') || c == QLatin1Char('\\'))
+                return false;
+        }
+        return true;
+    };
+
+    const int size = pattern.size();
+    if (size == 0)
+        return false;
+    if (isLiteral(QStringRef(&pattern))) {
+        _literals.insert(hash(QStringRef(&pattern)), pattern);
+        return true;
+    }
+    if (size > 1 && pattern.startsWith(QLatin1Char('*')) && isLiteral(pattern.midRef(1))) {
+        auto suffix = pattern.mid(1);
+        _suffixes[suffix.size()].insert(hash(QStringRef(&suffix)), suffix);
+        return true;
+    }
+    if (size > 1 && pattern.endsWith(QLatin1Char('*')) && isLiteral(pattern.leftRef(size - 1))) {
+        auto prefix = pattern.left(size - 1);
+        _prefixes[prefix.size()].insert(hash(QStringRef(&prefix)), prefix);
+        return true;
+    }
+    return false;
+}
+
+uint ExcludedFiles::BnamePatternSet::hash(const QStringRef &s) const
+{
+    if (_cs == Qt::CaseSensitive)
+        return qHash(s);
+
+    // Hashes the case folded code points, like the comparison in contains()
+    uint h = 0;
+    for (int i = 0; i < s.size(); ++i) {
+        uint c = s.at(i).unicode();
+        if (QChar::isHighSurrogate(c) && i + 1 < s.size() && s.at(i + 1).isLowSurrogate())
+            c = QChar::surrogateToUcs4(c, s.at(++i).unicode());
+        h = 31 * h + QChar::toCaseFolded(c);
+    }
+    return h;
+}
+
+bool ExcludedFiles::BnamePatternSet::contains(const QMultiHash<uint, QString> &set, const QStringRef &s) const
+{
+    const uint h = hash(s);
+    for (auto it = set.constFind(h); it != set.constEnd() && it.key() == h; ++it) {
+        if (it->compare(s, _cs) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool ExcludedFiles::BnamePatternSet::matches(const QStringRef &bname) const
+{
+    if (!_literals.isEmpty() && contains(_literals, bname))
+        return true;
+    const int size = bname.size();
+    for (auto it = _suffixes.constBegin(); it != _suffixes.constEnd() && it.key() <= size; ++it) {
+        if (contains(*it, bname.right(it.key())))
+            return true;
+    }
+    for (auto it = _prefixes.constBegin(); it != _prefixes.constEnd() && it.key() <= size; ++it) {
+        if (contains(*it, bname.left(it.key())))
+            return true;
+    }
+    return false;
+}
+
+void ExcludedFiles::BnamePatternSet::clear(Qt::CaseSensitivity cs)
+{
+    _cs = cs;
+    _literals.clear();
+    _suffixes.clear();
+    _prefixes.clear();
+}
+
 CSYNC_EXCLUDE_TYPE ExcludedFiles::fullPatternMatch(const QString &p, ItemType filetype) const
 {
     auto match = _csync_excluded_common(p, _excludeConflictFiles);
@@ -608,6 +715,26 @@ void ExcludedFiles::prepare()
     QString bnameTriggerFileDir;
     QString bnameTriggerDir;
 
+    // The bname patterns that can't be looked up in the BnamePatternSets
+    QString bnameRegexFileDirKeep;
+    QString bnameRegexFileDirRemove;
+    QString bnameRegexDirKeep;
+    QString bnameRegexDirRemove;
+
+    // The directory parts of the full patterns, see fullTraversalCandidate()
+    QString fullParents;
+    _useFullTraversalParentRegex = !_wildcardsMatchSlash;
+
+    const auto cs = OCC::Utility::fsCasePreserving() ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    _bnameKeepFileDir.clear(cs);
+    _bnameKeepDir.clear(cs);
+    _bnameRemoveFileDir.clear(cs);
+    _bnameRemoveDir.clear(cs);
+    {
+        QMutexLocker locker(&_fullTraversalParentMutex);
+        _fullTraversalParentCache.clear();
+    }
+
     auto regexAppend = [](QString &fileDirPattern, QString &dirPattern, const QString &appendMe, bool dirOnly) {
         QString &pattern = dirOnly ? dirPattern : fileDirPattern;
         if (!pattern.isEmpty())
@@ -640,9 +767,25 @@ void ExcludedFiles::prepare()
         auto regexExclude = convertToRegexpSyntax(exclude, _wildcardsMatchSlash);
         if (!fullPath) {
             regexAppend(bnameFileDir, bnameDir, regexExclude, matchDirOnly);
+
+            auto &fastFileDir = removeExcluded ? _bnameRemoveFileDir : _bnameKeepFileDir;
+            auto &fastDir = removeExcluded ? _bnameRemoveDir : _bnameKeepDir;
+            if (!(matchDirOnly ? fastDir : fastFileDir).add(exclude)) {
+                regexAppend(removeExcluded ? bnameRegexFileDirRemove : bnameRegexFileDirKeep,
+                    removeExcluded ? bnameRegexDirRemove : bnameRegexDirKeep,
+                    regexExclude, matchDirOnly);
+            }
         } else {
             regexAppend(fullFileDir, fullDir, regexExclude, matchDirOnly);
 
+            // A bracket expression could match the '/' that separates the directory part
+            int lastSlash = exclude.lastIndexOf('/');
+            if (exclude.indexOf('[') != -1 && exclude.indexOf('[') < lastSlash)
+                _useFullTraversalParentRegex = false;
+            if (!fullParents.isEmpty())
+                fullParents.append("|");
+            fullParents.append(convertToRegexpSyntax(exclude.left(lastSlash), _wildcardsMatchSlash));
+
             // For activation, trigger on the 'bname' part of the full pattern.
             QString bnameExclude = extractBnameTrigger(exclude, _wildcardsMatchSlash);
             auto regexBname = convertToRegexpSyntax(bnameExclude, true);
@@ -668,18 +811,26 @@ void ExcludedFiles::prepare()
     emptyMatchNothing(bnameTriggerFileDir);
     emptyMatchNothing(bnameTriggerDir);
 
+    emptyMatchNothing(bnameRegexFileDirKeep);
+    emptyMatchNothing(bnameRegexFileDirRemove);
+    emptyMatchNothing(bnameRegexDirKeep);
+    emptyMatchNothing(bnameRegexDirRemove);
+    emptyMatchNothing(fullParents);
+
     // The bname regex is applied to the bname only, so it must be
     // anchored in the beginning and in the end. It has the structure:
     // (exclude)|(excluderemove)|(bname triggers).
     // If the third group matches, the fullActivatedRegex needs to be applied
     // to the full path.
+    // Literal, "*suffix" and "prefix*" bname patterns are left out, they are
+    // looked up in the BnamePatternSets instead.
     _bnameTraversalRegexFile.setPattern(
-        "^(?P<exclude>" + bnameFileDirKeep + ")$|"
-        + "^(?P<excluderemove>" + bnameFileDirRemove + ")$|"
+        "^(?P<exclude>" + bnameRegexFileDirKeep + ")$|"
+        + "^(?P<excluderemove>" + bnameRegexFileDirRemove + ")$|"
         + "^(?P<trigger>" + bnameTriggerFileDir + ")$");
     _bnameTraversalRegexDir.setPattern(
-        "^(?P<exclude>" + bnameFileDirKeep + "|" + bnameDirKeep + ")$|"
-        + "^(?P<excluderemove>" + bnameFileDirRemove + "|" + bnameDirRemove + ")$|"
+        "^(?P<exclude>" + bnameRegexFileDirKeep + "|" + bnameRegexDirKeep + ")$|"
+        + "^(?P<excluderemove>" + bnameRegexFileDirRemove + "|" + bnameRegexDirRemove + ")$|"
         + "^(?P<trigger>" + bnameTriggerFileDir + "|" + bnameTriggerDir + ")$");
 
     // The full traveral regex is applied to the full path if the trigger capture of
@@ -727,6 +878,11 @@ void ExcludedFiles::prepare()
         + "(?:^|/)(?:" + bnameFileDirRemove + "|" + bnameDirRemove + ")(?:$|/)"
         + ")");
 
+    // A full pattern "dir/name" can only match below a directory that matches
+    // "dir" or has it as a leading part: that is all fullTraversalCandidate()
+    // checks. This only holds if wildcards don't match a slash.
+    _fullTraversalParentRegex.setPattern("^(?:" + fullParents + ")(?:$|/)");
+
     QRegularExpression::PatternOptions patternOptions = QRegularExpression::NoPatternOption;
     if (OCC::Utility::fsCasePreserving())
         patternOptions |= QRegularExpression::CaseInsensitiveOption;
@@ -742,4 +898,6 @@ void ExcludedFiles::prepare()
     _fullRegexFile.optimize();
     _fullRegexDir.setPatternOptions(patternOptions);
     _fullRegexDir.optimize();
+    _fullTraversalParentRegex.setPatternOptions(patternOptions);
+    _fullTraversalParentRegex.optimize();
 }
@@ -27,6 +27,9 @@
 
 #include <QObject>
 #include <QSet>
+#include <QMap>
+#include <QHash>
+#include <QMutex>
 #include <QString>
 #include <QRegularExpression>
 
@@ -207,6 +210,38 @@ private:
     static QString extractBnameTrigger(const QString &exclude, bool wildcardsMatchSlash);
     static QString convertToRegexpSyntax(QString exclude, bool wildcardsMatchSlash);
 
+    /**
+     * Whether a full path pattern may match a child of the directory dirPath.
+     *
+     * Results are cached per directory, so the children of a directory that no
+     * full path pattern can reach skip _fullTraversalRegex*.
+     */
+    bool fullTraversalCandidate(const QString &dirPath) const;
+
+    /**
+     * Bname patterns that don't need a regular expression: literal names,
+     * "*suffix" and "prefix*". Lookups don't allocate, the case insensitive
+     * ones neither.
+     */
+    class BnamePatternSet
+    {
+    public:
+        /// Returns false if the pattern is not of a supported form
+        bool add(const QString &pattern);
+        bool matches(const QStringRef &bname) const;
+        /// Drops all patterns, the next ones are matched with cs
+        void clear(Qt::CaseSensitivity cs);
+
+    private:
+        uint hash(const QStringRef &s) const;
+        bool contains(const QMultiHash<uint, QString> &set, const QStringRef &s) const;
+
+        Qt::CaseSensitivity _cs = Qt::CaseSensitive;
+        QMultiHash<uint, QString> _literals;
+        QMap<int, QMultiHash<uint, QString>> _suffixes; // by length
+        QMap<int, QMultiHash<uint, QString>> _prefixes; // by length
+    };
+
     /// Files to load excludes from
     QSet<QString> _excludeFiles;
 
@@ -217,6 +252,10 @@ private:
     QStringList _allExcludes;
 
     /// see prepare()
+    BnamePatternSet _bnameKeepFileDir;
+    BnamePatternSet _bnameKeepDir;
+    BnamePatternSet _bnameRemoveFileDir;
+    BnamePatternSet _bnameRemoveDir;
     QRegularExpression _bnameTraversalRegexFile;
     QRegularExpression _bnameTraversalRegexDir;
     QRegularExpression _fullTraversalRegexFile;
@@ -224,6 +263,12 @@ private:
     QRegularExpression _fullRegexFile;
     QRegularExpression _fullRegexDir;
 
+    /// The directory parts of the full path patterns, see fullTraversalCandidate()
+    QRegularExpression _fullTraversalParentRegex;
+    bool _useFullTraversalParentRegex = false;
+    mutable QMutex _fullTraversalParentMutex;
+    mutable QHash<QString, bool> _fullTraversalParentCache;
+
     bool _excludeConflictFiles = true;
 
     /**
@@ -25,6 +25,10 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <stdio.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "c_private.h"
 #include "c_lib.h"
@@ -44,22 +48,50 @@ Q_LOGGING_CATEGORY(lcCSyncVIOLocal, "sync.csync.vio_local", QtInfoMsg)
  * directory functions
  */
 
+#ifdef __linux__
+/* The layout the kernel uses for getdents64(), which glibc doesn't export */
+struct csync_linux_dirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+/* Large enough to read most directories with a single getdents64() call */
+static const int DIRENT_BUFFER_SIZE = 128 * 1024;
+#endif
+
 struct csync_vio_handle_t {
-  DIR *dh;
+#ifdef __linux__
+  int fd = -1;
+  QByteArray buffer;
+  int pos = 0;
+  int length = 0;
+#else
+  DIR *dh = nullptr;
+#endif
   QByteArray path;
 };
 
-static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf);
+static void _csync_vio_local_fill_stat(const csync_stat_t &sb, csync_file_stat_t *buf);
 
 csync_vio_handle_t *csync_vio_local_opendir(const QString &name) {
     QScopedPointer<csync_vio_handle_t> handle(new csync_vio_handle_t{});
 
     auto dirname = QFile::encodeName(name);
 
+#ifdef __linux__
+    handle->fd = open(dirname.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (handle->fd < 0) {
+        return nullptr;
+    }
+#else
     handle->dh = _topendir( dirname );
     if (!handle->dh) {
         return nullptr;
     }
+#endif
 
     handle->path = dirname;
     return handle.take();
@@ -67,33 +99,77 @@ csync_vio_handle_t *csync_vio_local_opendir(const QString &name) {
 
 int csync_vio_local_closedir(csync_vio_handle_t *dhandle) {
     Q_ASSERT(dhandle);
+#ifdef __linux__
+    auto rc = close(dhandle->fd);
+#else
     auto rc = _tclosedir(dhandle->dh);
+#endif
     delete dhandle;
     return rc;
 }
 
+/* Returns the next entry of the directory, skipping "." and "..".
+ * The name stays valid until the next call. Returns false at the end or on error (errno is set). */
+static bool _csync_vio_local_next_entry(csync_vio_handle_t *handle, const char **name, unsigned char *type)
+{
+    forever {
+#ifdef __linux__
+        if (handle->pos >= handle->length) {
+            if (handle->buffer.isEmpty())
+                handle->buffer.resize(DIRENT_BUFFER_SIZE);
+            auto n = syscall(SYS_getdents64, handle->fd, handle->buffer.data(), handle->buffer.size());
+            if (n <= 0)
+                return false;
+            handle->pos = 0;
+            handle->length = int(n);
+        }
+        auto dirent = reinterpret_cast<const csync_linux_dirent64 *>(handle->buffer.constData() + handle->pos);
+        handle->pos += dirent->d_reclen;
+#else
+        auto dirent = _treaddir(handle->dh);
+        if (dirent == NULL)
+            return false;
+#endif
+        if (qstrcmp(dirent->d_name, ".") == 0 || qstrcmp(dirent->d_name, "..") == 0)
+            continue;
+        *name = dirent->d_name;
+#if defined(__linux__) || defined(_DIRENT_HAVE_D_TYPE) || defined(__APPLE__)
+        *type = dirent->d_type;
+#else
+        *type = 0;
+#endif
+        return true;
+    }
+}
+
+static int _csync_vio_local_dirfd(csync_vio_handle_t *handle)
+{
+#ifdef __linux__
+    return handle->fd;
+#else
+    return dirfd(handle->dh);
+#endif
+}
+
 std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *handle, OCC::Vfs *vfs) {
 
-  struct _tdirent *dirent = NULL;
+  const char *name = nullptr;
+  unsigned char d_type = 0;
   std::unique_ptr<csync_file_stat_t> file_stat;
 
-  do {
-      dirent = _treaddir(handle->dh);
-      if (dirent == NULL)
-          return {};
-  } while (qstrcmp(dirent->d_name, ".") == 0 || qstrcmp(dirent->d_name, "..") == 0);
+  if (!_csync_vio_local_next_entry(handle, &name, &d_type))
+      return {};
 
   file_stat.reset(new csync_file_stat_t);
-  file_stat->path = c_utf8_from_locale(dirent->d_name);
-  QByteArray fullPath = handle->path % '/' % QByteArray() % const_cast<const char *>(dirent->d_name);
+  file_stat->path = c_utf8_from_locale(name);
   if (file_stat->path.isNull()) {
-      file_stat->original_path = fullPath;
-      qCWarning(lcCSyncVIOLocal) << "Invalid characters in file/directory name, please rename:" << dirent->d_name << handle->path;
+      file_stat->original_path = handle->path % '/' % QByteArray() % name;
+      qCWarning(lcCSyncVIOLocal) << "Invalid characters in file/directory name, please rename:" << name << handle->path;
   }
 
   /* Check for availability of d_type, see manpage. */
-#if defined(_DIRENT_HAVE_D_TYPE) || defined(__APPLE__)
-  switch (dirent->d_type) {
+#if defined(__linux__) || defined(_DIRENT_HAVE_D_TYPE) || defined(__APPLE__)
+  switch (d_type) {
     case DT_FIFO:
     case DT_SOCK:
     case DT_CHR:
@@ -101,7 +177,7 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
       break;
     case DT_DIR:
     case DT_REG:
-      if (dirent->d_type == DT_DIR) {
+      if (d_type == DT_DIR) {
         file_stat->type = ItemTypeDirectory;
       } else {
         file_stat->type = ItemTypeFile;
@@ -115,9 +191,14 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
   if (file_stat->path.isNull())
       return file_stat;
 
-  if (_csync_vio_local_stat_mb(fullPath.constData(), file_stat.get()) < 0) {
+  // Stat relative to the directory: the kernel doesn't have to resolve the
+  // full path again for every entry.
+  csync_stat_t sb;
+  if (fstatat(_csync_vio_local_dirfd(handle), name, &sb, AT_SYMLINK_NOFOLLOW) < 0) {
       // Will get excluded by _csync_detect_update.
       file_stat->type = ItemTypeSkip;
+  } else {
+      _csync_vio_local_fill_stat(sb, file_stat.get());
   }
 
   // Override type for virtual files if desired
@@ -135,19 +216,16 @@ int csync_vio_local_stat(const char *uri, csync_file_stat_t *buf)
 {
     mbchar_t *wuri = c_utf8_path_to_locale(uri);
     *buf = csync_file_stat_t();
-    int rc = _csync_vio_local_stat_mb(wuri, buf);
+    csync_stat_t sb;
+    int rc = _tstat(wuri, &sb);
+    if (rc == 0)
+        _csync_vio_local_fill_stat(sb, buf);
     c_free_locale_string(wuri);
-    return rc;
+    return rc < 0 ? -1 : 0;
 }
 
-static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf)
+static void _csync_vio_local_fill_stat(const csync_stat_t &sb, csync_file_stat_t *buf)
 {
-    csync_stat_t sb;
-
-    if (_tstat(wuri, &sb) < 0) {
-        return -1;
-    }
-
     switch (sb.st_mode & S_IFMT) {
     case S_IFDIR:
       buf->type = ItemTypeDirectory;
@@ -173,5 +251,4 @@ static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf
   buf->inode = sb.st_ino;
   buf->modtime = sb.st_mtime;
   buf->size = sb.st_size;
-  return 0;
 }
@@ -24,6 +24,7 @@
 #include <memory>
 
 class QSettings;
+class TestFolderMan;
 
 namespace OCC {
 
@@ -140,6 +141,8 @@ public slots:
 private:
     void setState(State state);
 
+    friend class ::TestFolderMan;
+
 signals:
     void stateChanged(int state);
     void isConnectedChanged();
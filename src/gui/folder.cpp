@@ -38,6 +38,7 @@
 #include <QTimer>
 #include <QUrl>
 #include <QDir>
+#include <QDateTime>
 #include <QSettings>
 
 #include <QMessageBox>
@@ -46,6 +47,9 @@
 
 static const char versionC[] = "version";
 
+// Batches with more paths aren't checked for spurious notifications
+static const int maxSpuriousCheckedPaths = 100;
+
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcFolder, "gui.folder", QtInfoMsg)
@@ -141,8 +145,10 @@ Folder::Folder(const FolderDefinition &definition,
 Folder::~Folder()
 {
     // If wipeForRemoval() was called the vfs has already shut down.
-    if (_vfs)
+    if (_vfs) {
         _vfs->stop();
+        saveLocalDiscoveryState();
+    }
 
     // Reset then engine first as it will abort and try to access members of the Folder
     _engine.reset();
@@ -524,10 +530,34 @@ int Folder::slotWipeErrorBlacklist()
 }
 
 void Folder::slotWatchedPathChanged(const QString &path)
+{
+    if (handleWatchedPath(path, true)) {
+        // Also schedule this folder for a sync, but only after some delay:
+        // The sync will not upload files that were changed too recently.
+        scheduleThisFolderSoon();
+    }
+}
+
+void Folder::slotWatchedPathsChanged(const QSet<QString> &paths)
+{
+    // A big batch most likely needs a sync anyway, looking up every
+    // path in the journal would only delay it
+    const bool checkSpurious = paths.size() <= maxSpuriousCheckedPaths;
+
+    bool needsSync = false;
+    for (const auto &path : paths) {
+        if (handleWatchedPath(path, checkSpurious))
+            needsSync = true;
+    }
+    if (needsSync)
+        scheduleThisFolderSoon();
+}
+
+bool Folder::handleWatchedPath(const QString &path, bool checkSpurious)
 {
     if (!path.startsWith(this->path())) {
         qCDebug(lcFolder) << "Changed path is not contained in folder, ignoring:" << path;
-        return;
+        return false;
     }
 
     auto relativePath = path.midRef(this->path().size());
@@ -550,10 +580,16 @@ void Folder::slotWatchedPathChanged(const QString &path)
     // Use the path to figure out whether it was our own change
     if (_engine->wasFileTouched(path)) {
         qCDebug(lcFolder) << "Changed path was touched by SyncEngine, ignoring:" << path;
-        return;
+        return false;
     }
 #endif
 
+    if (!checkSpurious) {
+        // Without the record, the excluded item warning can't be given either
+        emit watchedFileChangedExternally(path);
+        return true;
+    }
+
     // Check that the mtime/size actually changed or there was
     // an attribute change (pin state) that caused the notification
     bool spurious = false;
@@ -572,16 +608,13 @@ void Folder::slotWatchedPathChanged(const QString &path)
     }
     if (spurious) {
         qCInfo(lcFolder) << "Ignoring spurious notification for file" << relativePath;
-        return; // probably a spurious notification
+        return false; // probably a spurious notification
     }
 
     warnOnNewExcludedItem(record, relativePath);
 
     emit watchedFileChangedExternally(path);
-
-    // Also schedule this folder for a sync, but only after some delay:
-    // The sync will not upload files that were changed too recently.
-    scheduleThisFolderSoon();
+    return true;
 }
 
 void Folder::implicitlyHydrateFile(const QString &relativepath)
@@ -811,18 +844,11 @@ void Folder::startSync(const QStringList &pathList)
     setDirtyNetworkLimits();
     setSyncOptions();
 
-    static std::chrono::milliseconds fullLocalDiscoveryInterval = []() {
-        auto interval = ConfigFile().fullLocalDiscoveryInterval();
-        QByteArray env = qgetenv("OWNCLOUD_FULL_LOCAL_DISCOVERY_INTERVAL");
-        if (!env.isEmpty()) {
-            interval = std::chrono::milliseconds(env.toLongLong());
-        }
-        return interval;
-    }();
+    const auto interval = fullLocalDiscoveryInterval();
     bool hasDoneFullLocalDiscovery = _timeSinceLastFullLocalDiscovery.isValid();
     bool periodicFullLocalDiscoveryNow =
-        fullLocalDiscoveryInterval.count() >= 0 // negative means we don't require periodic full runs
-        && _timeSinceLastFullLocalDiscovery.hasExpired(fullLocalDiscoveryInterval.count());
+        interval.count() >= 0 // negative means we don't require periodic full runs
+        && _restoredFullLocalDiscoveryAge.count() + _timeSinceLastFullLocalDiscovery.elapsed() > interval.count();
     if (_folderWatcher && _folderWatcher->isReliable()
         && hasDoneFullLocalDiscovery
         && !periodicFullLocalDiscoveryNow) {
@@ -844,6 +870,42 @@ void Folder::startSync(const QStringList &pathList)
     emit syncStarted();
 }
 
+std::chrono::milliseconds Folder::fullLocalDiscoveryInterval()
+{
+    static std::chrono::milliseconds interval = []() {
+        auto interval = ConfigFile().fullLocalDiscoveryInterval();
+        QByteArray env = qgetenv("OWNCLOUD_FULL_LOCAL_DISCOVERY_INTERVAL");
+        if (!env.isEmpty()) {
+            interval = std::chrono::milliseconds(env.toLongLong());
+        }
+        return interval;
+    }();
+    return interval;
+}
+
+void Folder::saveLocalDiscoveryState()
+{
+    // The tracked paths only cover all changes if the watcher didn't miss
+    // anything since the last full local discovery
+    if (!_folderWatcher || !_folderWatcher->isReliable()
+        || !_timeSinceLastFullLocalDiscovery.isValid()) {
+        return;
+    }
+    const auto age = _restoredFullLocalDiscoveryAge.count() + _timeSinceLastFullLocalDiscovery.elapsed();
+    _localDiscoveryTracker->saveState(_journal, QDateTime::currentMSecsSinceEpoch() - age);
+}
+
+void Folder::restoreLocalDiscoveryState()
+{
+    const qint64 lastFullDiscovery = _localDiscoveryTracker->restoreState(_journal, path());
+    if (lastFullDiscovery < 0)
+        return;
+    qCInfo(lcFolder) << "Resuming local change tracking from the previous run";
+    _timeSinceLastFullLocalDiscovery.start();
+    _restoredFullLocalDiscoveryAge = std::chrono::milliseconds(
+        qMax<qint64>(0, QDateTime::currentMSecsSinceEpoch() - lastFullDiscovery));
+}
+
 void Folder::setSyncOptions()
 {
     SyncOptions opt;
@@ -854,12 +916,13 @@ void Folder::setSyncOptions()
     opt._confirmExternalStorage = cfgFile.confirmExternalStorage();
     opt._moveFilesToTrash = cfgFile.moveToTrash();
     opt._vfs = _vfs;
-    opt._parallelNetworkJobs = _accountState->account()->isHttp2Supported() ? 20 : 6;
+    opt._parallelNetworkJobs = parallelNetworkJobs();
 
     opt._initialChunkSize = cfgFile.chunkSize();
     opt._minChunkSize = cfgFile.minChunkSize();
     opt._maxChunkSize = cfgFile.maxChunkSize();
     opt._targetChunkUploadDuration = cfgFile.targetChunkUploadDuration();
+    opt._parallelChunkUploads = cfgFile.parallelChunkUploads();
 
     opt._deltaSyncEnabled = cfgFile.deltaSyncEnabled();
     opt._deltaSyncMinFileSize = cfgFile.deltaSyncMinFileSize();
@@ -870,6 +933,35 @@ void Folder::setSyncOptions()
     _engine->setSyncOptions(opt);
 }
 
+int Folder::parallelNetworkJobs() const
+{
+    int jobs = _accountState->account()->isHttp2Supported() ? 20 : 6;
+    return qMax(1, jobs / _syncShare);
+}
+
+void Folder::setSyncShare(int share)
+{
+    share = qMax(1, share);
+    if (share == _syncShare)
+        return;
+    _syncShare = share;
+    if (isBusy()) {
+        setDirtyNetworkLimits();
+        _engine->setParallelNetworkJobs(parallelNetworkJobs());
+    }
+}
+
+bool Folder::hasSmallPendingChanges() const
+{
+    // Without a previous full local discovery the whole tree gets scanned
+    if (!_timeSinceLastFullLocalDiscovery.isValid()
+        || !_folderWatcher || !_folderWatcher->isReliable()) {
+        return false;
+    }
+    return _localDiscoveryTracker->localDiscoveryPaths().size() <= 100
+        && _lastSyncDuration <= std::chrono::seconds(30);
+}
+
 void Folder::setDirtyNetworkLimits()
 {
     ConfigFile cfg;
@@ -889,6 +981,12 @@ void Folder::setDirtyNetworkLimits()
         uploadLimit = 0;
     }
 
+    // Absolute limits are shared with the folders that sync at the same time
+    if (downloadLimit > 0)
+        downloadLimit = qMax(1, downloadLimit / _syncShare);
+    if (uploadLimit > 0)
+        uploadLimit = qMax(1, uploadLimit / _syncShare);
+
     _engine->setNetworkLimits(uploadLimit, downloadLimit);
 }
 
@@ -953,6 +1051,7 @@ void Folder::slotSyncFinished(bool success)
         && success) {
         if (_engine->lastLocalDiscoveryStyle() == LocalDiscoveryStyle::FilesystemOnly) {
             _timeSinceLastFullLocalDiscovery.start();
+            _restoredFullLocalDiscoveryAge = std::chrono::milliseconds(0);
         }
     }
 
@@ -1183,12 +1282,16 @@ void Folder::registerFolderWatcher()
         return;
 
     _folderWatcher.reset(new FolderWatcher(this));
-    connect(_folderWatcher.data(), &FolderWatcher::pathChanged,
-        this, &Folder::slotWatchedPathChanged);
+    connect(_folderWatcher.data(), &FolderWatcher::pathsChanged,
+        this, &Folder::slotWatchedPathsChanged);
     connect(_folderWatcher.data(), &FolderWatcher::lostChanges,
         this, &Folder::slotNextSyncFullLocalDiscovery);
     connect(_folderWatcher.data(), &FolderWatcher::becameUnreliable,
         this, &Folder::slotWatcherUnreliable);
+    // Once changes are seen by the watcher, pick up what happened since
+    // the last run
+    connect(_folderWatcher.data(), &FolderWatcher::ready,
+        this, &Folder::restoreLocalDiscoveryState);
     _folderWatcher->init(path());
     _folderWatcher->startNotificatonTest(path() + QLatin1String(".owncloudsync.log"));
 }
@@ -25,6 +25,7 @@
 
 #include <QObject>
 #include <QStringList>
+#include <QSet>
 #include <QUuid>
 #include <set>
 #include <chrono>
@@ -210,6 +211,26 @@ public:
 
     void setDirtyNetworkLimits();
 
+    /**
+     * Sets how many folders are syncing at the same time, including this one.
+     *
+     * The network jobs and absolute bandwidth limits are divided between
+     * them. Applies to a running sync as well.
+     */
+    void setSyncShare(int share);
+
+    /// The parallel network jobs of this folder's share
+    int parallelNetworkJobs() const;
+
+    /**
+     * Whether the next sync run is likely to be small.
+     *
+     * That is the case when the local discovery can rely on the file watcher,
+     * few paths were touched and the previous sync run was short. FolderMan
+     * starts these folders before others.
+     */
+    bool hasSmallPendingChanges() const;
+
     /**
       * Ignore syncing of hidden files or not. This is defined in the
       * folder definition
@@ -338,6 +359,9 @@ public slots:
        */
     void slotWatchedPathChanged(const QString &path);
 
+    /// Like slotWatchedPathChanged(), for a batch of paths from the folder watcher
+    void slotWatchedPathsChanged(const QSet<QString> &paths);
+
     /**
      * Mark a virtual file as being requested for download, and start a sync.
      *
@@ -426,6 +450,12 @@ private:
 
     void setSyncOptions();
 
+    /**
+     * Filters one path reported by the folder watcher, returns whether it
+     * needs a sync. Without checkSpurious the journal isn't looked at.
+     */
+    bool handleWatchedPath(const QString &path, bool checkSpurious);
+
     enum LogStatus {
         LogStatusRemove,
         LogStatusRename,
@@ -441,6 +471,13 @@ private:
 
     void startVfs();
 
+    static std::chrono::milliseconds fullLocalDiscoveryInterval();
+
+    /// Persists the local discovery paths, see LocalDiscoveryTracker::saveState()
+    void saveLocalDiscoveryState();
+    /// Resumes the local discovery paths of the previous run, if they can be trusted
+    void restoreLocalDiscoveryState();
+
     AccountStatePtr _accountState;
     FolderDefinition _definition;
     QString _canonicalLocalPath; // As returned with QFileInfo:canonicalFilePath.  Always ends with "/"
@@ -452,8 +489,13 @@ private:
     QElapsedTimer _timeSinceLastSyncDone;
     QElapsedTimer _timeSinceLastSyncStart;
     QElapsedTimer _timeSinceLastFullLocalDiscovery;
+    /// How long ago the last full local discovery was when the timer above was restored
+    std::chrono::milliseconds _restoredFullLocalDiscoveryAge{0};
     std::chrono::milliseconds _lastSyncDuration;
 
+    /// The number of folders sharing the network budget, see setSyncShare()
+    int _syncShare = 1;
+
     /// The number of syncs that failed in a row.
     /// Reset when a sync is successful.
     int _consecutiveFailingSyncs;
@@ -498,7 +540,7 @@ private:
     /**
      * Watches this folder's local directory for changes.
      *
-     * Created by registerFolderWatcher(), triggers slotWatchedPathChanged()
+     * Created by registerFolderWatcher(), triggers slotWatchedPathsChanged()
      */
     QScopedPointer<FolderWatcher> _folderWatcher;
 
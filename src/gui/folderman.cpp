@@ -47,7 +47,7 @@ FolderMan *FolderMan::_instance = 0;
 
 FolderMan::FolderMan(QObject *parent)
     : QObject(parent)
-    , _currentSyncFolder(0)
+    , _maxConcurrentSyncs(1)
     , _syncEnabled(true)
     , _lockWatcher(new LockWatcher)
     , _navigationPaneHelper(this)
@@ -59,6 +59,7 @@ FolderMan::FolderMan(QObject *parent)
     _socketApi.reset(new SocketApi);
 
     ConfigFile cfg;
+    _maxConcurrentSyncs = cfg.maxConcurrentSyncs();
     std::chrono::milliseconds polltime = cfg.remotePollInterval();
     qCInfo(lcFolderMan) << "setting remote poll timer interval to" << polltime.count() << "msec";
     _etagPollTimer.setInterval(polltime.count());
@@ -143,7 +144,7 @@ int FolderMan::unloadAndDeleteAllFolders()
     ASSERT(_folderMap.isEmpty());
 
     _lastSyncFolder = 0;
-    _currentSyncFolder = 0;
+    _currentSyncFolders.clear();
     _scheduledFolders.clear();
     emit folderListChanged(_folderMap);
     emit scheduleQueueChanged();
@@ -606,6 +607,7 @@ void FolderMan::scheduleFolderNext(Folder *f)
     f->prepareToSync();
     emit folderSyncStateChange(f);
     _scheduledFolders.prepend(f);
+    _scheduledNextFolder = f;
     emit scheduleQueueChanged();
 
     startScheduledSyncSoon();
@@ -713,7 +715,8 @@ void FolderMan::startScheduledSyncSoon()
     if (_scheduledFolders.empty()) {
         return;
     }
-    if (isAnySyncRunning()) {
+    const int running = runningSyncCount();
+    if (running >= _maxConcurrentSyncs) {
         return;
     }
 
@@ -721,7 +724,9 @@ void FolderMan::startScheduledSyncSoon()
     qint64 msSinceLastSync = 0;
 
     // Require a pause based on the duration of the last sync run.
-    if (Folder *lastFolder = _lastSyncFolder) {
+    // Not needed when other syncs are still running.
+    Folder *lastFolder = _lastSyncFolder;
+    if (lastFolder && running == 0) {
         msSinceLastSync = lastFolder->msecSinceLastSync().count();
 
         //  1s   -> 1.5s pause
@@ -751,7 +756,8 @@ void FolderMan::startScheduledSyncSoon()
   */
 void FolderMan::slotStartScheduledFolderSync()
 {
-    if (isAnySyncRunning()) {
+    const int running = runningSyncCount();
+    if (running >= _maxConcurrentSyncs) {
         for (auto f : _folderMap) {
             if (f->isSyncRunning())
                 qCInfo(lcFolderMan) << "Currently folder " << f->remoteUrl().toString() << " is running, wait for finish!";
@@ -769,14 +775,35 @@ void FolderMan::slotStartScheduledFolderSync()
         return;
     }
 
-    // Find the first folder in the queue that can be synced.
+    // Drop the folders that can't be synced, then pick one of the others:
+    // the one requested by scheduleFolderNext(), otherwise the first with
+    // small pending changes, otherwise the first. Folders with large changes
+    // leave the last free slot to the small ones.
     Folder *folder = 0;
-    while (!_scheduledFolders.isEmpty()) {
-        Folder *g = _scheduledFolders.dequeue();
-        if (g->canSync()) {
+    Folder *firstLarge = 0;
+    QMutableListIterator<Folder *> it(_scheduledFolders);
+    while (it.hasNext()) {
+        Folder *g = it.next();
+        if (!g->canSync()) {
+            it.remove();
+            continue;
+        }
+        if (g->isSyncRunning()) {
+            continue;
+        }
+        if (g == _scheduledNextFolder || g->hasSmallPendingChanges()) {
             folder = g;
             break;
         }
+        if (!firstLarge)
+            firstLarge = g;
+    }
+    if (!folder && firstLarge && (running == 0 || running + 1 < _maxConcurrentSyncs))
+        folder = firstLarge;
+    if (folder) {
+        _scheduledFolders.removeOne(folder);
+        if (folder == _scheduledNextFolder)
+            _scheduledNextFolder.clear();
     }
 
     emit scheduleQueueChanged();
@@ -788,8 +815,14 @@ void FolderMan::slotStartScheduledFolderSync()
         folder->registerFolderWatcher();
         registerFolderWithSocketApi(folder);
 
-        _currentSyncFolder = folder;
+        _currentSyncFolders.append(folder);
+        updateSyncShares();
+        qCInfo(lcFolderMan) << "Starting sync of" << folder->alias() << "with"
+                            << _currentSyncFolders.size() << "of" << _maxConcurrentSyncs << "scheduled syncs running";
         folder->startSync(QStringList());
+
+        // Fill the remaining slots
+        startScheduledSyncSoon();
     }
 }
 
@@ -912,9 +945,25 @@ void FolderMan::slotScheduleFolderByTime()
     }
 }
 
+int FolderMan::runningSyncCount() const
+{
+    int count = _currentSyncFolders.size();
+    for (auto f : _folderMap) {
+        if (f->isSyncRunning() && !_currentSyncFolders.contains(f))
+            ++count;
+    }
+    return count;
+}
+
+void FolderMan::updateSyncShares()
+{
+    for (auto f : _currentSyncFolders)
+        f->setSyncShare(_currentSyncFolders.size());
+}
+
 bool FolderMan::isAnySyncRunning() const
 {
-    if (_currentSyncFolder)
+    if (!_currentSyncFolders.isEmpty())
         return true;
 
     for (auto f : _folderMap) {
@@ -955,12 +1004,12 @@ void FolderMan::slotFolderSyncFinished(const SyncResult &)
         qPrintable(f->accountState()->account()->displayName()),
         qPrintable(f->remoteUrl().toString()));
 
-    if (f == _currentSyncFolder) {
-        _lastSyncFolder = _currentSyncFolder;
-        _currentSyncFolder = 0;
+    if (_currentSyncFolders.removeAll(f) > 0) {
+        _lastSyncFolder = f;
+        f->setSyncShare(1);
+        updateSyncShares();
     }
-    if (!isAnySyncRunning())
-        startScheduledSyncSoon();
+    startScheduledSyncSoon();
 }
 
 Folder *FolderMan::addFolder(AccountState *accountState, const FolderDefinition &folderDefinition)
@@ -1510,9 +1559,14 @@ QQueue<Folder *> FolderMan::scheduleQueue() const
     return _scheduledFolders;
 }
 
+QList<Folder *> FolderMan::currentSyncFolders() const
+{
+    return _currentSyncFolders;
+}
+
 Folder *FolderMan::currentSyncFolder() const
 {
-    return _currentSyncFolder;
+    return _currentSyncFolders.value(0);
 }
 
 void FolderMan::restartApplication()
@@ -46,7 +46,7 @@ class LockWatcher;
  *   (_timeScheduler and slotScheduleFolderByTime())
  *
  * - A folder watcher receives a notification about a file change
- *   (_folderWatchers and Folder::slotWatchedPathChanged())
+ *   (_folderWatchers and Folder::slotWatchedPathsChanged())
  *
  * - The folder etag on the server has changed
  *   (_etagPollTimer)
@@ -57,6 +57,11 @@ class LockWatcher;
  * - There was a sync error or a follow-up sync is requested
  *   (_timeScheduler and slotScheduleFolderByTime()
  *    and Folder::slotSyncFinished())
+ *
+ * Up to ConfigFile::maxConcurrentSyncs() folders sync at the same time.
+ * They share the network jobs and absolute bandwidth limits, see
+ * Folder::setSyncShare(). Folders with small pending changes are started
+ * before others, and folders with large ones never take the last free slot.
  */
 class FolderMan : public QObject
 {
@@ -182,13 +187,16 @@ public:
     QQueue<Folder *> scheduleQueue() const;
 
     /**
-     * Access to the currently syncing folder.
+     * Access to the currently syncing folders.
      *
-     * Note: This is only the folder that's currently syncing *as-scheduled*. There
+     * Note: These are only the folders that are currently syncing *as-scheduled*. There
      * may be externally-managed syncs such as from placeholder hydrations.
      *
      * See also isAnySyncRunning()
      */
+    QList<Folder *> currentSyncFolders() const;
+
+    /** The first of currentSyncFolders(), or null */
     Folder *currentSyncFolder() const;
 
     /**
@@ -312,6 +320,12 @@ private:
     /** Will start a sync after a bit of delay. */
     void startScheduledSyncSoon();
 
+    /** Scheduled and externally-managed syncs that are running */
+    int runningSyncCount() const;
+
+    /** Divides the network budget between the currently syncing folders */
+    void updateSyncShares();
+
     // finds all folder configuration files
     // and create the folders
     QString getBackupName(QString fullPathName) const;
@@ -327,8 +341,9 @@ private:
     QSet<Folder *> _disabledFolders;
     Folder::Map _folderMap;
     QString _folderConfigPath;
-    Folder *_currentSyncFolder;
+    QList<Folder *> _currentSyncFolders;
     QPointer<Folder> _lastSyncFolder;
+    int _maxConcurrentSyncs;
     bool _syncEnabled;
 
     /// Folder aliases from the settings that weren't read
@@ -348,6 +363,9 @@ private:
     /// Scheduled folders that should be synced as soon as possible
     QQueue<Folder *> _scheduledFolders;
 
+    /// Put in front by scheduleFolderNext(), ahead of folders with small changes
+    QPointer<Folder> _scheduledNextFolder;
+
     /// Picks the next scheduled folder and starts the sync
     QTimer _startScheduledSyncTimer;
 
@@ -922,6 +922,7 @@ void FolderStatusModel::slotSetProgress(const ProgressInfo &progress)
     // item if no items are in progress.
     SyncFileItem curItem = progress._lastCompletedItem;
     qint64 curItemProgress = -1; // -1 means finished
+    qint64 curItemChecksumProgress = 0;
     qint64 biggerItemSize = 0;
     quint64 estimatedUpBw = 0;
     quint64 estimatedDownBw = 0;
@@ -930,6 +931,7 @@ void FolderStatusModel::slotSetProgress(const ProgressInfo &progress)
         if (curItemProgress == -1 || (ProgressInfo::isSizeDependent(citm._item)
                                          && biggerItemSize < citm._item._size)) {
             curItemProgress = citm._progress.completed();
+            curItemChecksumProgress = citm._checksumCompleted;
             curItem = citm._item;
             biggerItemSize = citm._item._size;
         }
@@ -998,6 +1000,13 @@ void FolderStatusModel::slotSetProgress(const ProgressInfo &progress)
         //: Example text: "uploading foobar.png"
         fileProgressString = tr("%1 %2").arg(kindString, itemFileName);
     }
+    if (curItemProgress == 0 && curItemChecksumProgress > 0) {
+        // The upload didn't start yet, the file is still being read
+        //: Example text: "Computing the checksum of foobar.png (1MB of 2MB)"
+        fileProgressString = tr("Calculando a soma de verificação de %1 (%2 de %3)")
+                                 .arg(itemFileName, Utility::octetsToString(curItemChecksumProgress),
+                                     Utility::octetsToString(curItem._size));
+    }
     pi->_progressString = fileProgressString;
 
     // overall progress
@@ -53,6 +53,8 @@ void FolderWatcher::init(const QString &root)
 {
     _d.reset(new FolderWatcherPrivate(this, root));
     _timer.start();
+    if (_d->_ready)
+        QMetaObject::invokeMethod(this, "ready", Qt::QueuedConnection);
 }
 
 bool FolderWatcher::pathIsIgnored(const QString &path)
@@ -152,13 +154,24 @@ void FolderWatcher::changeDetected(const QStringList &paths)
     QSet<QString> changedPaths;
 
     // ------- handle ignores:
-    for (int i = 0; i < paths.size(); ++i) {
-        QString path = paths[i];
+    // Sorted, directories come before their contents. Everything below an
+    // ignored path is ignored too and doesn't need to be matched again.
+    QStringList sortedPaths = pathsSet.toList();
+    sortedPaths.sort();
+    QString ignoredPrefix;
+    for (const auto &path : sortedPaths) {
         if (!_testNotificationPath.isEmpty()
             && Utility::fileNamesEqual(path, _testNotificationPath)) {
             _testNotificationPath.clear();
         }
+        if (path.isEmpty()) {
+            continue;
+        }
+        if (!ignoredPrefix.isEmpty() && path.startsWith(ignoredPrefix)) {
+            continue;
+        }
         if (pathIsIgnored(path)) {
+            ignoredPrefix = path + QLatin1Char('/');
             continue;
         }
 
@@ -169,9 +182,7 @@ void FolderWatcher::changeDetected(const QStringList &paths)
     }
 
     qCInfo(lcFolderWatcher) << "Detected changes in paths:" << changedPaths;
-    foreach (const QString &path, changedPaths) {
-        emit pathChanged(path);
-    }
+    emit pathsChanged(changedPaths);
 }
 
 } // namespace OCC
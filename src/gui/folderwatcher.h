@@ -41,7 +41,7 @@ class Folder;
  *
  * Folder Watcher monitors a directory and its sub directories
  * for changes in the local file system. Changes are signalled
- * through the pathChanged() signal.
+ * through the pathsChanged() signal.
  *
  * @ingroup gui
  */
@@ -83,9 +83,12 @@ public:
     int testLinuxWatchCount() const;
 
 signals:
-    /** Emitted when one of the watched directories or one
-     *  of the contained files is changed. */
-    void pathChanged(const QString &path);
+    /** Emitted when watched directories or contained files are changed,
+     *  once for all paths that were reported together. */
+    void pathsChanged(const QSet<QString> &paths);
+
+    /** Emitted once changes in the whole tree are seen */
+    void ready();
 
     /**
      * Emitted if some notifications were lost.
@@ -15,184 +15,195 @@
 #include "config.h"
 
 #include <sys/inotify.h>
+#include <unistd.h>
 
 #include "folder.h"
 #include "folderwatcher_linux.h"
 
 #include <cerrno>
+#include <cstring>
+#include <QDir>
 #include <QStringList>
 #include <QObject>
-#include <QVarLengthArray>
 
 namespace OCC {
 
-FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path)
+InotifyWorker::InotifyWorker(const QString &root)
     : QObject()
-    , _parent(p)
-    , _folder(path)
+    , _root(root)
+    , _flushTimer(this)
+{
+    _flushTimer.setSingleShot(true);
+    _flushTimer.setInterval(coalesceMsec());
+    connect(&_flushTimer, &QTimer::timeout, this, &InotifyWorker::flush);
+}
+
+InotifyWorker::~InotifyWorker()
 {
-    _fd = inotify_init();
+    _socket.reset();
+    if (_fd != -1)
+        close(_fd);
+}
+
+void InotifyWorker::start()
+{
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     if (_fd != -1) {
         _socket.reset(new QSocketNotifier(_fd, QSocketNotifier::Read));
-        connect(_socket.data(), &QSocketNotifier::activated, this, &FolderWatcherPrivate::slotReceivedNotification);
+        connect(_socket.data(), &QSocketNotifier::activated, this, &InotifyWorker::slotReceivedNotification);
     } else {
         qCWarning(lcFolderWatcher) << "notify_init() failed: " << strerror(errno);
     }
+    // Enough for a few hundred events with long names per read
+    _buffer.resize(64 * 1024);
 
-    QMetaObject::invokeMethod(this, "slotAddFolderRecursive", Q_ARG(QString, path));
+    qCDebug(lcFolderWatcher) << "(+) Watcher:" << _root;
+    watchFolders(QStringList(QDir(_root).absolutePath()));
 }
 
-FolderWatcherPrivate::~FolderWatcherPrivate()
+void InotifyWorker::watchFolders(const QStringList &folders)
 {
-}
+    if (_unansweredFinds > 0)
+        --_unansweredFinds;
 
-// attention: result list passed by reference!
-bool FolderWatcherPrivate::findFoldersBelow(const QDir &dir, QStringList &fullList)
-{
-    bool ok = true;
-    if (!(dir.exists() && dir.isReadable())) {
-        qCDebug(lcFolderWatcher) << "Non existing path coming in: " << dir.absolutePath();
-        ok = false;
-    } else {
-        QStringList nameFilter;
-        nameFilter << QLatin1String("*");
-        QDir::Filters filter = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
-        const QStringList pathes = dir.entryList(nameFilter, filter);
-
-        QStringList::const_iterator constIterator;
-        for (constIterator = pathes.constBegin(); constIterator != pathes.constEnd();
-             ++constIterator) {
-            const QString fullPath(dir.path() + QLatin1String("/") + (*constIterator));
-            fullList.append(fullPath);
-            ok = findFoldersBelow(QDir(fullPath), fullList);
+    QStringList subfolders;
+    for (const auto &folder : folders) {
+        if (_pathToWatch.contains(folder))
+            continue;
+        addWatch(folder);
+
+        const QDir dir(folder);
+        const auto names = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden);
+        for (const auto &name : names)
+            subfolders.append(folder + QLatin1Char('/') + name);
+    }
+    if (!subfolders.isEmpty())
+        requestFolders(subfolders);
+
+    if (_unansweredFinds == 0) {
+        if (!_ready) {
+            _ready = true;
+            qCInfo(lcFolderWatcher) << "Watching" << _pathToWatch.size() << "folders below" << _root;
+            emit ready();
         }
+        if (!_flushTimer.isActive())
+            flush();
     }
+}
 
-    return ok;
+void InotifyWorker::requestFolders(const QStringList &folders)
+{
+    ++_unansweredFinds;
+    emit foldersFound(folders);
 }
 
-void FolderWatcherPrivate::inotifyRegisterPath(const QString &path)
+void InotifyWorker::addWatch(const QString &path)
 {
-    if (path.isEmpty())
+    if (path.isEmpty() || _fd == -1)
         return;
 
     int wd = inotify_add_watch(_fd, path.toUtf8().constData(),
         IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_ONLYDIR);
     if (wd > -1) {
+        // The same inode may already be watched under an old name
+        auto old = _watchToPath.find(wd);
+        if (old != _watchToPath.end() && _pathToWatch.value(old.value()) == wd)
+            _pathToWatch.remove(old.value());
         _watchToPath.insert(wd, path);
         _pathToWatch.insert(path, wd);
-    } else {
+        _watchCount.store(_pathToWatch.size());
+    } else if (errno == ENOMEM || errno == ENOSPC) {
         // If we're running out of memory or inotify watches, become
         // unreliable.
-        if (_parent->_isReliable && (errno == ENOMEM || errno == ENOSPC)) {
-            _parent->_isReliable = false;
-            emit _parent->becameUnreliable(
-                tr("This problem usually happens when the inotify watches are exhausted. "
-                   "Check the FAQ for details."));
-        }
+        emit watchesExhausted();
     }
 }
 
-void FolderWatcherPrivate::slotAddFolderRecursive(const QString &path)
+void InotifyWorker::slotReceivedNotification()
 {
-    if (_pathToWatch.contains(path))
-        return;
+    QStringList newFolders;
 
-    int subdirs = 0;
-    qCDebug(lcFolderWatcher) << "(+) Watcher:" << path;
+    forever {
+        const auto len = read(_fd, _buffer.data(), _buffer.size());
+        if (len <= 0) {
+            if (len < 0 && errno != EAGAIN && errno != EINTR)
+                qCWarning(lcFolderWatcher) << "Reading inotify events failed:" << strerror(errno);
+            break;
+        }
 
-    QDir inPath(path);
-    inotifyRegisterPath(inPath.absolutePath());
+        const inotify_event *event = nullptr;
+        for (ssize_t i = 0; i + ssize_t(sizeof(inotify_event)) <= len; i += sizeof(inotify_event) + event->len) {
+            event = reinterpret_cast<const inotify_event *>(_buffer.constData() + i);
 
-    QStringList allSubfolders;
-    if (!findFoldersBelow(QDir(path), allSubfolders)) {
-        qCWarning(lcFolderWatcher) << "Could not traverse all sub folders";
-    }
-    QStringListIterator subfoldersIt(allSubfolders);
-    while (subfoldersIt.hasNext()) {
-        QString subfolder = subfoldersIt.next();
-        QDir folder(subfolder);
-        if (folder.exists() && !_pathToWatch.contains(folder.absolutePath())) {
-            subdirs++;
-            if (_parent->pathIsIgnored(subfolder)) {
-                qCDebug(lcFolderWatcher) << "* Not adding" << folder.path();
+            if (event->mask & IN_Q_OVERFLOW) {
+                qCWarning(lcFolderWatcher) << "The inotify queue overflowed, changes were lost";
+                if (!_overflowed)
+                    emit lostChanges();
+                _overflowed = true;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // The watch is gone, usually because its folder was deleted
+                const auto path = _watchToPath.take(event->wd);
+                if (_pathToWatch.value(path, -1) == event->wd)
+                    _pathToWatch.remove(path);
+                _watchCount.store(_pathToWatch.size());
                 continue;
             }
-            inotifyRegisterPath(folder.absolutePath());
-        } else {
-            qCDebug(lcFolderWatcher) << "    `-> discarded:" << folder.path();
+
+            // Fire event for the path that was changed.
+            if (event->len == 0 || event->wd <= -1)
+                continue;
+            const QByteArray fileName(event->name);
+            // Filter out journal changes - redundant with filtering in
+            // FolderWatcher::pathIsIgnored.
+            if (fileName.startsWith("._sync_")
+                || fileName.startsWith(".csync_journal.db")
+                || fileName.startsWith(".sync_")) {
+                continue;
+            }
+            const auto dirIt = _watchToPath.constFind(event->wd);
+            if (dirIt == _watchToPath.constEnd())
+                continue;
+            _pendingNames[dirIt.value()].insert(fileName);
+
+            if (event->mask & IN_ISDIR) {
+                const QString path = dirIt.value() + QLatin1Char('/') + QString::fromUtf8(fileName);
+                if (event->mask & (IN_MOVED_FROM | IN_DELETE))
+                    removeFoldersBelow(path);
+                if (event->mask & (IN_MOVED_TO | IN_CREATE))
+                    newFolders.append(path);
+            }
         }
     }
 
-    if (subdirs > 0) {
-        qCDebug(lcFolderWatcher) << "    `-> and" << subdirs << "subdirectories";
-    }
+    if (!newFolders.isEmpty())
+        requestFolders(newFolders);
+    if ((!_pendingNames.isEmpty() || _overflowed) && !_flushTimer.isActive())
+        _flushTimer.start();
 }
 
-void FolderWatcherPrivate::slotReceivedNotification(int fd)
+void InotifyWorker::flush()
 {
-    int len;
-    struct inotify_event *event;
-    int i;
-    int error;
-    QVarLengthArray<char, 2048> buffer(2048);
-
-    do {
-        len = read(fd, buffer.data(), buffer.size());
-        error = errno;
-        /**
-          * From inotify documentation:
-          *
-          * The behavior when the buffer given to read(2) is too
-          * small to return information about the next event
-          * depends on the kernel version: in kernels  before 2.6.21,
-          * read(2) returns 0; since kernel 2.6.21, read(2) fails with
-          * the error EINVAL.
-          */
-        if (len < 0 && error == EINVAL) {
-            // double the buffer size
-            buffer.resize(buffer.size() * 2);
-            /* and try again ... */
-            continue;
-        }
-    } while (false);
-
-    // iterate events in buffer
-    unsigned int ulen = len;
-    for (i = 0; i + sizeof(inotify_event) < ulen; i += sizeof(inotify_event) + (event ? event->len : 0)) {
-        // cast an inotify_event
-        event = (struct inotify_event *)&buffer[i];
-        if (event == NULL) {
-            qCDebug(lcFolderWatcher) << "NULL event";
-            continue;
-        }
-
-        // Fire event for the path that was changed.
-        if (event->len == 0 || event->wd <= -1)
-            continue;
-        QByteArray fileName(event->name);
-        // Filter out journal changes - redundant with filtering in
-        // FolderWatcher::pathIsIgnored.
-        if (fileName.startsWith("._sync_")
-            || fileName.startsWith(".csync_journal.db")
-            || fileName.startsWith(".sync_")) {
-            continue;
-        }
-        const QString p = _watchToPath[event->wd] + '/' + fileName;
-        _parent->changeDetected(p);
+    // Keep collecting until the folders that were reported are watched
+    if (_unansweredFinds > 0)
+        return;
 
-        if ((event->mask & (IN_MOVED_TO | IN_CREATE))
-            && QFileInfo(p).isDir()
-            && !_parent->pathIsIgnored(p)) {
-            slotAddFolderRecursive(p);
-        }
-        if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
-            removeFoldersBelow(p);
-        }
+    QStringList paths;
+    if (_overflowed)
+        paths.append(_root);
+    for (auto it = _pendingNames.cbegin(); it != _pendingNames.cend(); ++it) {
+        for (const auto &name : it.value())
+            paths.append(it.key() + QLatin1Char('/') + QString::fromUtf8(name));
     }
+    _pendingNames.clear();
+    _overflowed = false;
+
+    if (!paths.isEmpty())
+        emit changed(paths);
 }
 
-void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
+void InotifyWorker::removeFoldersBelow(const QString &path)
 {
     auto it = _pathToWatch.find(path);
     if (it == _pathToWatch.end())
@@ -217,6 +228,62 @@ void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
         it = _pathToWatch.erase(it);
         qCDebug(lcFolderWatcher) << "Removed watch for" << itPath;
     }
+    _watchCount.store(_pathToWatch.size());
+}
+
+FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path)
+    : QObject()
+    , _parent(p)
+    , _worker(new InotifyWorker(path))
+{
+    _worker->moveToThread(&_thread);
+    connect(&_thread, &QThread::started, _worker, &InotifyWorker::start);
+    connect(&_thread, &QThread::finished, _worker, &QObject::deleteLater);
+
+    connect(_worker, &InotifyWorker::foldersFound, this, &FolderWatcherPrivate::slotFoldersFound);
+    connect(this, &FolderWatcherPrivate::foldersAccepted, _worker, &InotifyWorker::watchFolders);
+    connect(_worker, &InotifyWorker::changed, _parent,
+        static_cast<void (FolderWatcher::*)(const QStringList &)>(&FolderWatcher::changeDetected));
+    connect(_worker, &InotifyWorker::lostChanges, _parent, &FolderWatcher::lostChanges);
+    connect(_worker, &InotifyWorker::watchesExhausted, this, &FolderWatcherPrivate::slotWatchesExhausted);
+    connect(_worker, &InotifyWorker::ready, this, [this]() {
+        _ready = true;
+        emit _parent->ready();
+    });
+
+    _thread.setObjectName(QStringLiteral("FolderWatcher"));
+    _thread.start();
+}
+
+FolderWatcherPrivate::~FolderWatcherPrivate()
+{
+    // The worker is deleted in its thread once the event loop ends
+    _thread.quit();
+    _thread.wait();
+}
+
+void FolderWatcherPrivate::slotFoldersFound(const QStringList &folders)
+{
+    QStringList accepted;
+    accepted.reserve(folders.size());
+    for (const auto &folder : folders) {
+        if (_parent->pathIsIgnored(folder)) {
+            qCDebug(lcFolderWatcher) << "* Not adding" << folder;
+            continue;
+        }
+        accepted.append(folder);
+    }
+    emit foldersAccepted(accepted);
+}
+
+void FolderWatcherPrivate::slotWatchesExhausted()
+{
+    if (!_parent->_isReliable)
+        return;
+    _parent->_isReliable = false;
+    emit _parent->becameUnreliable(
+        tr("This problem usually happens when the inotify watches are exhausted. "
+           "Check the FAQ for details."));
 }
 
 } // ns mirall
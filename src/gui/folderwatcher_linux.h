@@ -17,50 +17,132 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QSocketNotifier>
 #include <QHash>
-#include <QDir>
+#include <QSet>
+#include <QMap>
+#include <QThread>
+#include <QTimer>
+#include <QAtomicInt>
 
 #include "folderwatcher.h"
 
-class QTimer;
-
 namespace OCC {
 
+/**
+ * @brief Owns the inotify instance, lives in its own thread
+ *
+ * watchFolders() adds watches for folders and lists their subfolders. The
+ * subfolders are reported with foldersFound() so that ignored ones can be
+ * dropped on the GUI thread, where the excludes live; the others come back
+ * through watchFolders(). Folders that appear later take the same way.
+ *
+ * The inotify fd is drained with a large buffer. Changed names are
+ * collected per directory and delivered with changed() at most every
+ * coalesceMsec(), but never while folders are waiting to be watched, so
+ * that a change inside a new folder can't be missed after its creation
+ * was reported.
+ *
+ * @ingroup gui
+ */
+class InotifyWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InotifyWorker(const QString &root);
+    ~InotifyWorker();
+
+    /// Can be read from any thread
+    int watchCount() const { return _watchCount.load(); }
+
+    static int coalesceMsec() { return 100; }
+
+public slots:
+    /// Creates the inotify instance and starts watching the root
+    void start();
+
+    /// Watches the folders and reports their subfolders with foldersFound()
+    void watchFolders(const QStringList &folders);
+
+signals:
+    /** Subfolders that need to be passed to watchFolders(), unless ignored.
+     *
+     * Every emission must be answered with a watchFolders() call, even an
+     * empty one.
+     */
+    void foldersFound(const QStringList &folders);
+
+    void changed(const QStringList &paths);
+
+    /// The kernel queue overflowed, some events are gone
+    void lostChanges();
+
+    /// No more watches can be added, see FolderWatcher::isReliable()
+    void watchesExhausted();
+
+    /// The initial folder tree is watched
+    void ready();
+
+private slots:
+    void slotReceivedNotification();
+    void flush();
+
+private:
+    void addWatch(const QString &path);
+    void removeFoldersBelow(const QString &path);
+    void requestFolders(const QStringList &folders);
+
+    QString _root;
+    int _fd = -1;
+    QScopedPointer<QSocketNotifier> _socket;
+    QByteArray _buffer;
+
+    QHash<int, QString> _watchToPath;
+    QMap<QString, int> _pathToWatch;
+    QAtomicInt _watchCount;
+
+    /// Changed names by the path of their directory, see flush()
+    QHash<QString, QSet<QByteArray>> _pendingNames;
+    bool _overflowed = false;
+    QTimer _flushTimer;
+
+    /// foldersFound() emissions that watchFolders() didn't answer yet
+    int _unansweredFinds = 0;
+    bool _ready = false;
+};
+
 /**
  * @brief Linux (inotify) API implementation of FolderWatcher
+ *
+ * Runs an InotifyWorker in its own thread and filters the folders it
+ * finds against the excludes.
+ *
  * @ingroup gui
  */
 class FolderWatcherPrivate : public QObject
 {
     Q_OBJECT
 public:
-    FolderWatcherPrivate() {}
     FolderWatcherPrivate(FolderWatcher *p, const QString &path);
     ~FolderWatcherPrivate();
 
-    int testWatchCount() const { return _pathToWatch.size(); }
+    int testWatchCount() const { return _worker->watchCount(); }
 
-    /// On linux the watcher is ready when the ctor finished.
-    bool _ready = 1;
+    /// Set once the whole folder tree is watched.
+    bool _ready = false;
 
-protected slots:
-    void slotReceivedNotification(int fd);
-    void slotAddFolderRecursive(const QString &path);
+signals:
+    void foldersAccepted(const QStringList &folders);
 
-protected:
-    bool findFoldersBelow(const QDir &dir, QStringList &fullList);
-    void inotifyRegisterPath(const QString &path);
-    void removeFoldersBelow(const QString &path);
+private slots:
+    void slotFoldersFound(const QStringList &folders);
+    void slotWatchesExhausted();
 
 private:
     FolderWatcher *_parent;
-
-    QString _folder;
-    QHash<int, QString> _watchToPath;
-    QMap<QString, int> _pathToWatch;
-    QScopedPointer<QSocketNotifier> _socket;
-    int _fd;
+    QThread _thread;
+    InotifyWorker *_worker;
 };
 }
 
@@ -208,7 +208,10 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
     connect(_thread, SIGNAL(lostChanges()),
         _parent, SIGNAL(lostChanges()));
     connect(_thread, &WatcherThread::ready,
-        this, [this]() { _ready = 1; });
+        this, [this]() {
+            _ready = 1;
+            emit _parent->ready();
+        });
     _thread->start();
 }
 
@@ -25,8 +25,8 @@
 #include "syncfileitem.h"
 #include "folder.h"
 #include "openfilemanager.h"
+#include "common/utility.h"
 #include "activityitemdelegate.h"
-#include "protocolwidget.h"
 #include "accountstate.h"
 #include "account.h"
 #include "accountmanager.h"
@@ -46,9 +46,9 @@ namespace OCC {
  */
 static const int maxIssueCount = 50000;
 
-static QPair<QString, QString> pathsWithIssuesKey(const ProtocolItem::ExtraData &data)
+static QPair<QString, QString> pathsWithIssuesKey(const ProtocolEntry &entry)
 {
-    return qMakePair(data.folderName, data.path);
+    return qMakePair(entry.folderName, entry.path);
 }
 
 IssuesWidget::IssuesWidget(QWidget *parent)
@@ -57,6 +57,26 @@ IssuesWidget::IssuesWidget(QWidget *parent)
 {
     _ui->setupUi(this);
 
+    // Adjust copyToClipboard() when making changes here!
+    QStringList header;
+    header << tr("Horário");
+    header << tr("Arquivo");
+    header << tr("Pasta");
+    header << tr("Problemas");
+
+    _model = new ProtocolModel(header, maxIssueCount, this);
+    _proxy = new ProtocolSortFilterProxyModel(_model, this);
+    _ui->_treeView->setModel(_proxy);
+    connect(_model, &QAbstractItemModel::rowsInserted, this, [this]() { emit issueCountUpdated(_model->rowCount()); });
+    connect(_model, &QAbstractItemModel::rowsRemoved, this, [this]() { emit issueCountUpdated(_model->rowCount()); });
+    connect(_model, &QAbstractItemModel::modelReset, this, [this]() { emit issueCountUpdated(_model->rowCount()); });
+
+    // The view drops index widgets with their rows, e.g. when they are filtered out
+    connect(_proxy, &QAbstractItemModel::rowsInserted, this,
+        [this](const QModelIndex &, int first, int last) { addErrorWidgets(first, last); });
+    connect(_proxy, &QAbstractItemModel::modelReset, this,
+        [this]() { addErrorWidgets(0, _proxy->rowCount() - 1); });
+
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::progressInfo,
         this, &IssuesWidget::slotProgressInfo);
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemCompleted,
@@ -64,11 +84,11 @@ IssuesWidget::IssuesWidget(QWidget *parent)
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::syncError,
         this, &IssuesWidget::addError);
 
-    connect(_ui->_treeWidget, &QTreeWidget::itemActivated, this, &IssuesWidget::slotOpenFile);
+    connect(_ui->_treeView, &QAbstractItemView::activated, this, &IssuesWidget::slotOpenFile);
     connect(_ui->copyIssuesButton, &QAbstractButton::clicked, this, &IssuesWidget::copyToClipboard);
 
-    _ui->_treeWidget->setContextMenuPolicy(Qt::CustomContextMenu);
-    connect(_ui->_treeWidget, &QTreeWidget::customContextMenuRequested, this, &IssuesWidget::slotItemContextMenu);
+    _ui->_treeView->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(_ui->_treeView, &QWidget::customContextMenuRequested, this, &IssuesWidget::slotItemContextMenu);
 
     connect(_ui->showIgnores, &QAbstractButton::toggled, this, &IssuesWidget::slotRefreshIssues);
     connect(_ui->showWarnings, &QAbstractButton::toggled, this, &IssuesWidget::slotRefreshIssues);
@@ -85,38 +105,26 @@ IssuesWidget::IssuesWidget(QWidget *parent)
     connect(FolderMan::instance(), &FolderMan::folderListChanged,
         this, &IssuesWidget::slotUpdateFolderFilters);
 
-
-    // Adjust copyToClipboard() when making changes here!
-    QStringList header;
-    header << tr("Horário");
-    header << tr("Arquivo");
-    header << tr("Pasta");
-    header << tr("Problemas");
+    slotRefreshIssues();
 
     int timestampColumnExtra = 0;
 #ifdef Q_OS_WIN
     timestampColumnExtra = 20; // font metrics are broken on Windows, see #4721
 #endif
 
-    _ui->_treeWidget->setHeaderLabels(header);
     int timestampColumnWidth =
         ActivityItemDelegate::rowHeight() // icon
-        + _ui->_treeWidget->fontMetrics().width(ProtocolItem::timeString(QDateTime::currentDateTime()))
+        + _ui->_treeView->fontMetrics().width(ProtocolModel::timeString(QDateTime::currentDateTime()))
         + timestampColumnExtra;
-    _ui->_treeWidget->setColumnWidth(0, timestampColumnWidth);
-    _ui->_treeWidget->setColumnWidth(1, 180);
-    _ui->_treeWidget->setColumnCount(4);
-    _ui->_treeWidget->setRootIsDecorated(false);
-    _ui->_treeWidget->setTextElideMode(Qt::ElideMiddle);
-    _ui->_treeWidget->header()->setObjectName("ActivityErrorListHeader");
+    _ui->_treeView->setColumnWidth(0, timestampColumnWidth);
+    _ui->_treeView->setColumnWidth(1, 180);
+    _ui->_treeView->setRootIsDecorated(false);
+    _ui->_treeView->setTextElideMode(Qt::ElideMiddle);
+    _ui->_treeView->header()->setObjectName("ActivityErrorListHeader");
 #if defined(Q_OS_MAC)
-    _ui->_treeWidget->setMinimumWidth(400);
+    _ui->_treeView->setMinimumWidth(400);
 #endif
 
-    _reenableSorting.setInterval(5000);
-    connect(&_reenableSorting, &QTimer::timeout, this,
-        [this]() { _ui->_treeWidget->setSortingEnabled(true); });
-
     _ui->_tooManyIssuesWarning->hide();
     connect(this, &IssuesWidget::issueCountUpdated, this,
         [this](int count) { _ui->_tooManyIssuesWarning->setVisible(count >= maxIssueCount); });
@@ -135,16 +143,16 @@ IssuesWidget::~IssuesWidget()
 void IssuesWidget::showEvent(QShowEvent *ev)
 {
     ConfigFile cfg;
-    cfg.restoreGeometryHeader(_ui->_treeWidget->header());
+    cfg.restoreGeometryHeader(_ui->_treeView->header());
 
     // Sorting by section was newly enabled. But if we restore the header
     // from a state where sorting was disabled, both of these flags will be
     // false and sorting will be impossible!
-    _ui->_treeWidget->header()->setSectionsClickable(true);
-    _ui->_treeWidget->header()->setSortIndicatorShown(true);
+    _ui->_treeView->header()->setSectionsClickable(true);
+    _ui->_treeView->header()->setSortIndicatorShown(true);
 
     // Switch back to "first important, then by time" ordering
-    _ui->_treeWidget->sortByColumn(0, Qt::DescendingOrder);
+    _ui->_treeView->sortByColumn(0, Qt::DescendingOrder);
 
     QWidget::showEvent(ev);
 }
@@ -152,89 +160,48 @@ void IssuesWidget::showEvent(QShowEvent *ev)
 void IssuesWidget::hideEvent(QHideEvent *ev)
 {
     ConfigFile cfg;
-    cfg.saveGeometryHeader(_ui->_treeWidget->header());
+    cfg.saveGeometryHeader(_ui->_treeView->header());
     QWidget::hideEvent(ev);
 }
 
-static bool persistsUntilLocalDiscovery(QTreeWidgetItem *item)
+static bool persistsUntilLocalDiscovery(const ProtocolEntry &entry)
 {
-    const auto data = ProtocolItem::extraData(item);
-    return data.status == SyncFileItem::Conflict
-        || (data.status == SyncFileItem::FileIgnored && data.direction == SyncFileItem::Up);
+    return entry.status == SyncFileItem::Conflict
+        || (entry.status == SyncFileItem::FileIgnored && entry.direction == SyncFileItem::Up);
 }
 
-void IssuesWidget::cleanItems(const std::function<bool(QTreeWidgetItem *)> &shouldDelete)
+void IssuesWidget::cleanItems(const std::function<bool(const ProtocolEntry &)> &shouldDelete)
 {
-    _ui->_treeWidget->setSortingEnabled(false);
-
     // The issue list is a state, clear it and let the next sync fill it
     // with ignored files and propagation errors.
-    int itemCnt = _ui->_treeWidget->topLevelItemCount();
-    for (int cnt = itemCnt - 1; cnt >= 0; cnt--) {
-        QTreeWidgetItem *item = _ui->_treeWidget->topLevelItem(cnt);
-        if (shouldDelete(item)) {
-            _pathsWithIssues.remove(pathsWithIssuesKey(ProtocolItem::extraData(item)));
-            delete item;
-        }
-    }
-
-    _ui->_treeWidget->setSortingEnabled(true);
-
-    // update the tabtext
-    emit(issueCountUpdated(_ui->_treeWidget->topLevelItemCount()));
+    _model->removeEntries([&](const ProtocolEntry &entry) {
+        if (!shouldDelete(entry))
+            return false;
+        _issueIds.remove(pathsWithIssuesKey(entry));
+        return true;
+    });
 }
 
-void IssuesWidget::addItem(QTreeWidgetItem *item)
+bool IssuesWidget::addItem(const ProtocolEntry &entry)
 {
-    if (!item)
-        return;
-
-    int count = _ui->_treeWidget->topLevelItemCount();
-    if (count >= maxIssueCount) {
-        delete item;
-        return;
-    }
-
-    _ui->_treeWidget->setSortingEnabled(false);
-    _reenableSorting.start();
-
-    // Insert item specific errors behind the others
-    int insertLoc = 0;
-    if (!item->text(1).isEmpty()) {
-        for (int i = 0; i < count; ++i) {
-            if (_ui->_treeWidget->topLevelItem(i)->text(1).isEmpty()) {
-                insertLoc = i + 1;
-            } else {
-                break;
-            }
-        }
-    }
+    if (_model->entryCount() >= maxIssueCount)
+        return false;
 
     // Wipe any existing message for the same folder and path
-    auto newData = ProtocolItem::extraData(item);
-    if (_pathsWithIssues.contains(pathsWithIssuesKey(newData))) {
-        for (int i = 0; i < count; ++i) {
-            auto otherItem = _ui->_treeWidget->topLevelItem(i);
-            auto otherData = ProtocolItem::extraData(otherItem);
-            if (otherData.path == newData.path && otherData.folderName == newData.folderName) {
-                delete otherItem;
-                break;
-            }
-        }
-    }
+    quint64 &id = _issueIds[pathsWithIssuesKey(entry)];
+    if (id != 0)
+        _model->removeEntry(id);
 
-    _ui->_treeWidget->insertTopLevelItem(insertLoc, item);
-    _pathsWithIssues.insert(pathsWithIssuesKey(newData));
-    item->setHidden(!shouldBeVisible(item, currentAccountFilter(), currentFolderFilter()));
-    emit issueCountUpdated(_ui->_treeWidget->topLevelItemCount());
+    id = _model->append(entry);
+    return true;
 }
 
-void IssuesWidget::slotOpenFile(QTreeWidgetItem *item, int)
+void IssuesWidget::slotOpenFile(const QModelIndex &index)
 {
-    QString fileName = item->text(1);
-    if (Folder *folder = ProtocolItem::folder(item)) {
+    const auto &entry = _proxy->entry(index);
+    if (Folder *folder = FolderMan::instance()->folder(entry.folderName)) {
         // folder->path() always comes back with trailing path
-        QString fullPath = folder->path() + fileName;
+        QString fullPath = folder->path() + Utility::fileNameForGuiUse(entry.fileName);
         if (QFile(fullPath).exists()) {
             showInFileManager(fullPath);
         }
@@ -251,19 +218,19 @@ void IssuesWidget::slotProgressInfo(const QString &folder, const ProgressInfo &p
             return;
         const auto &engine = f->syncEngine();
         const auto style = engine.lastLocalDiscoveryStyle();
-        cleanItems([&](QTreeWidgetItem *item) {
-            if (ProtocolItem::extraData(item).folderName != folder)
+        cleanItems([&](const ProtocolEntry &entry) {
+            if (entry.folderName != folder)
                 return false;
             if (style == LocalDiscoveryStyle::FilesystemOnly)
                 return true;
-            if (!persistsUntilLocalDiscovery(item))
+            if (!persistsUntilLocalDiscovery(entry))
                 return true;
 
             // Definitely wipe the entry if the file no longer exists
-            if (!QFileInfo(f->path() + ProtocolItem::extraData(item).path).exists())
+            if (!QFileInfo(f->path() + entry.path).exists())
                 return true;
 
-            auto path = QFileInfo(ProtocolItem::extraData(item).path).dir().path();
+            auto path = QFileInfo(entry.path).dir().path();
             if (path == ".")
                 path.clear();
 
@@ -274,13 +241,12 @@ void IssuesWidget::slotProgressInfo(const QString &folder, const ProgressInfo &p
         // We keep track very well of pending conflicts.
         // Inform other components about them.
         QStringList conflicts;
-        auto tree = _ui->_treeWidget;
-        for (int i = 0; i < tree->topLevelItemCount(); ++i) {
-            auto item = tree->topLevelItem(i);
-            auto data = ProtocolItem::extraData(item);
-            if (data.folderName == folder
-                && data.status == SyncFileItem::Conflict) {
-                conflicts.append(data.path);
+        _model->flush();
+        for (int i = 0; i < _model->rowCount(); ++i) {
+            const auto &entry = _model->entry(i);
+            if (entry.folderName == folder
+                && entry.status == SyncFileItem::Conflict) {
+                conflicts.append(entry.path);
             }
         }
         emit ProgressDispatcher::instance()->folderConflicts(folder, conflicts);
@@ -293,24 +259,21 @@ void IssuesWidget::slotItemCompleted(const QString &folder, const SyncFileItemPt
 {
     if (!item->showInIssuesTab())
         return;
-    QTreeWidgetItem *line = ProtocolItem::create(folder, *item);
-    if (!line)
+    if (!FolderMan::instance()->folder(folder))
         return;
-    addItem(line);
+    addItem(ProtocolModel::entryForItem(folder, *item));
 }
 
 void IssuesWidget::slotRefreshIssues()
 {
-    auto tree = _ui->_treeWidget;
     auto filterFolderAlias = currentFolderFilter();
     auto filterAccount = currentAccountFilter();
 
-    for (int i = 0; i < tree->topLevelItemCount(); ++i) {
-        auto item = tree->topLevelItem(i);
-        item->setHidden(!shouldBeVisible(item, filterAccount, filterFolderAlias));
-    }
+    _proxy->setFilter([this, filterAccount, filterFolderAlias](const ProtocolEntry &entry) {
+        return shouldBeVisible(entry, filterAccount, filterFolderAlias);
+    });
 
-    _ui->_treeWidget->setColumnHidden(2, !filterFolderAlias.isEmpty());
+    _ui->_treeView->setColumnHidden(2, !filterFolderAlias.isEmpty());
 }
 
 void IssuesWidget::slotAccountAdded(AccountState *account)
@@ -330,11 +293,11 @@ void IssuesWidget::slotAccountRemoved(AccountState *account)
 
 void IssuesWidget::slotItemContextMenu(const QPoint &pos)
 {
-    auto item = _ui->_treeWidget->itemAt(pos);
-    if (!item)
+    auto index = _ui->_treeView->indexAt(pos);
+    if (!index.isValid())
         return;
-    auto globalPos = _ui->_treeWidget->viewport()->mapToGlobal(pos);
-    ProtocolItem::openContextMenu(globalPos, item, this);
+    auto globalPos = _ui->_treeView->viewport()->mapToGlobal(pos);
+    ProtocolModel::openContextMenu(globalPos, _proxy->entry(index), this);
 }
 
 void IssuesWidget::updateAccountChoiceVisibility()
@@ -355,18 +318,17 @@ QString IssuesWidget::currentFolderFilter() const
     return _ui->filterFolder->currentData().toString();
 }
 
-bool IssuesWidget::shouldBeVisible(QTreeWidgetItem *item, AccountState *filterAccount,
+bool IssuesWidget::shouldBeVisible(const ProtocolEntry &entry, AccountState *filterAccount,
     const QString &filterFolderAlias) const
 {
     bool visible = true;
-    auto data = ProtocolItem::extraData(item);
-    auto status = data.status;
+    auto status = entry.status;
     visible &= (_ui->showIgnores->isChecked() || status != SyncFileItem::FileIgnored);
     visible &= (_ui->showWarnings->isChecked()
         || (status != SyncFileItem::SoftError
                && status != SyncFileItem::Restoration));
 
-    const auto &folderalias = data.folderName;
+    const auto &folderalias = entry.folderName;
     if (filterAccount) {
         auto folder = FolderMan::instance()->folder(folderalias);
         visible &= folder && folder->accountState() == filterAccount;
@@ -422,34 +384,39 @@ void IssuesWidget::slotUpdateFolderFilters()
 
 void IssuesWidget::storeSyncIssues(QTextStream &ts)
 {
-    int topLevelItems = _ui->_treeWidget->topLevelItemCount();
-
-    for (int i = 0; i < topLevelItems; i++) {
-        QTreeWidgetItem *child = _ui->_treeWidget->topLevelItem(i);
-        if (child->isHidden())
-            continue;
+    _model->flush();
+    int rows = _proxy->rowCount();
+
+    for (int i = 0; i < rows; i++) {
+        auto data = [this, i](int column) {
+            auto index = _proxy->index(i, column);
+            // Rows with an error widget don't show their message in the column
+            if (column == 3)
+                return _proxy->entry(index).message;
+            return index.data().toString();
+        };
         ts << right
            // time stamp
            << qSetFieldWidth(20)
-           << child->data(0, Qt::DisplayRole).toString()
+           << data(0)
            // separator
            << qSetFieldWidth(0) << ","
 
            // file name
            << qSetFieldWidth(64)
-           << child->data(1, Qt::DisplayRole).toString()
+           << data(1)
            // separator
            << qSetFieldWidth(0) << ","
 
            // folder
            << qSetFieldWidth(30)
-           << child->data(2, Qt::DisplayRole).toString()
+           << data(2)
            // separator
            << qSetFieldWidth(0) << ","
 
            // action
            << qSetFieldWidth(15)
-           << child->data(3, Qt::DisplayRole).toString()
+           << data(3)
            << qSetFieldWidth(0)
            << endl;
     }
@@ -476,57 +443,42 @@ void IssuesWidget::addError(const QString &folderAlias, const QString &message,
     if (!folder)
         return;
 
-    QStringList columns;
-    QDateTime timestamp = QDateTime::currentDateTime();
-    const QString timeStr = ProtocolItem::timeString(timestamp);
-    const QString longTimeStr = ProtocolItem::timeString(timestamp, QLocale::LongFormat);
-
-    columns << timeStr;
-    columns << ""; // no "File" entry
-    columns << folder->shortGuiLocalPath();
-    columns << message;
-
-    QIcon icon = Theme::instance()->syncStateIcon(SyncResult::Error);
-
-    QTreeWidgetItem *twitem = new ProtocolItem(columns);
-    twitem->setData(0, Qt::SizeHintRole, QSize(0, ActivityItemDelegate::rowHeight()));
-    twitem->setIcon(0, icon);
-    twitem->setToolTip(0, longTimeStr);
-    twitem->setToolTip(3, message);
-    ProtocolItem::ExtraData data;
-    data.timestamp = timestamp;
-    data.folderName = folderAlias;
-    data.status = SyncFileItem::NormalError;
-    ProtocolItem::setExtraData(twitem, data);
-
-    addItem(twitem);
-    addErrorWidget(twitem, message, category);
+    ProtocolEntry entry;
+    entry.timestamp = QDateTime::currentMSecsSinceEpoch();
+    entry.folderName = folderAlias;
+    entry.message = message;
+    entry.status = SyncFileItem::NormalError;
+    entry.errorCategory = category;
+    addItem(entry);
 }
 
-void IssuesWidget::addErrorWidget(QTreeWidgetItem *item, const QString &message, ErrorCategory category)
+void IssuesWidget::addErrorWidgets(int firstRow, int lastRow)
 {
-    QWidget *widget = 0;
-    if (category == ErrorCategory::InsufficientRemoteStorage) {
-        widget = new QWidget;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        auto index = _proxy->index(row, 3);
+        const auto &entry = _proxy->entry(index);
+        if (entry.errorCategory != ErrorCategory::InsufficientRemoteStorage
+            || _ui->_treeView->indexWidget(index)) {
+            continue;
+        }
+
+        auto widget = new QWidget;
         auto layout = new QHBoxLayout;
         widget->setLayout(layout);
 
-        auto label = new ElidedLabel(message, widget);
+        auto label = new ElidedLabel(entry.message, widget);
         label->setElideMode(Qt::ElideMiddle);
         layout->addWidget(label);
 
         auto button = new QPushButton("Tentar enviar todos arquivos", widget);
         button->setSizePolicy(QSizePolicy::Maximum, QSizePolicy::Expanding);
-        auto folderAlias = ProtocolItem::extraData(item).folderName;
+        auto folderAlias = entry.folderName;
         connect(button, &QPushButton::clicked,
             this, [this, folderAlias]() { retryInsufficentRemoteStorageErrors(folderAlias); });
         layout->addWidget(button);
-    }
 
-    if (widget) {
-        item->setText(3, QString());
+        _ui->_treeView->setIndexWidget(index, widget);
     }
-    _ui->_treeWidget->setItemWidget(item, 3, widget);
 }
 
 void IssuesWidget::retryInsufficentRemoteStorageErrors(const QString &folderAlias)
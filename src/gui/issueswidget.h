@@ -16,11 +16,9 @@
 #define ISSUESWIDGET_H
 
 #include <QDialog>
-#include <QDateTime>
-#include <QLocale>
-#include <QTimer>
 
 #include "progressdispatcher.h"
+#include "protocolmodel.h"
 #include "owncloudgui.h"
 
 #include "ui_issueswidget.h"
@@ -54,7 +52,7 @@ public slots:
     void addError(const QString &folderAlias, const QString &message, ErrorCategory category);
     void slotProgressInfo(const QString &folder, const ProgressInfo &progress);
     void slotItemCompleted(const QString &folder, const SyncFileItemPtr &item);
-    void slotOpenFile(QTreeWidgetItem *item, int);
+    void slotOpenFile(const QModelIndex &index);
 
 protected:
     void showEvent(QShowEvent *);
@@ -75,24 +73,24 @@ private:
     void updateAccountChoiceVisibility();
     AccountState *currentAccountFilter() const;
     QString currentFolderFilter() const;
-    bool shouldBeVisible(QTreeWidgetItem *item, AccountState *filterAccount,
+    bool shouldBeVisible(const ProtocolEntry &entry, AccountState *filterAccount,
         const QString &filterFolderAlias) const;
-    void cleanItems(const std::function<bool(QTreeWidgetItem *)> &shouldDelete);
-    void addItem(QTreeWidgetItem *item);
+    void cleanItems(const std::function<bool(const ProtocolEntry &)> &shouldDelete);
+    /// Returns false if the entry was dropped because there are too many
+    bool addItem(const ProtocolEntry &entry);
 
-    /// Add the special error widget for the category, if any
-    void addErrorWidget(QTreeWidgetItem *item, const QString &message, ErrorCategory category);
+    /// Add the special error widgets for the categories of the visible rows, if any
+    void addErrorWidgets(int firstRow, int lastRow);
 
     /// Wipes all insufficient remote storgage blacklist entries
     void retryInsufficentRemoteStorageErrors(const QString &folderAlias);
 
-    /// Each insert disables sorting, this timer reenables it
-    QTimer _reenableSorting;
-
-    /// Optimization: keep track of all folder/paths pairs that have an associated issue
-    QSet<QPair<QString, QString>> _pathsWithIssues;
+    /// The id of the model entry of each folder/path pair that has an issue
+    QHash<QPair<QString, QString>, quint64> _issueIds;
 
     Ui::IssuesWidget *_ui;
+    ProtocolModel *_model;
+    ProtocolSortFilterProxyModel *_proxy;
 };
 }
 
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include <QtWidgets>
+
+#include "protocolmodel.h"
+#include "progressdispatcher.h"
+#include "syncresult.h"
+#include "theme.h"
+#include "folderman.h"
+#include "folder.h"
+#include "activityitemdelegate.h"
+#include "guiutility.h"
+#include "accountstate.h"
+#include "networkjobs.h"
+#include "common/utility.h"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+namespace OCC {
+
+/**
+ * Removing more separate blocks of rows than this at once resets the
+ * model instead, each block moves all rows behind it.
+ */
+static const int maxRemovedBlocks = 64;
+
+ProtocolModel::ProtocolModel(const QStringList &headers, int maxEntries, QObject *parent)
+    : QAbstractTableModel(parent)
+    , _headers(headers)
+    , _maxEntries(maxEntries)
+    , _flushTimer(this)
+    , _errorIcon(Theme::instance()->syncStateIcon(SyncResult::Error))
+    , _warningIcon(Theme::instance()->syncStateIcon(SyncResult::Problem))
+{
+    _flushTimer.setSingleShot(true);
+    _flushTimer.setInterval(flushMsec());
+    connect(&_flushTimer, &QTimer::timeout, this, &ProtocolModel::flush);
+}
+
+int ProtocolModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : _count;
+}
+
+int ProtocolModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : _headers.size();
+}
+
+QVariant ProtocolModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= _count)
+        return QVariant();
+    const auto &e = entry(index.row());
+
+    // Warning: The data and tooltips on the columns define an implicit
+    // interface and can only be changed with care.
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case 0:
+            return timeString(QDateTime::fromMSecsSinceEpoch(e.timestamp));
+        case 1:
+            return Utility::fileNameForGuiUse(e.fileName);
+        case 2:
+            if (auto f = FolderMan::instance()->folder(e.folderName))
+                return f->shortGuiLocalPath();
+            return QVariant();
+        case 3:
+            return e.errorCategory == ErrorCategory::Normal ? e.message : QString();
+        case 4:
+            return e.showSize ? Utility::octetsToString(e.size) : QString();
+        }
+        break;
+    case Qt::DecorationRole:
+        if (index.column() != 0)
+            break;
+        if (e.status == SyncFileItem::NormalError
+            || e.status == SyncFileItem::FatalError
+            || e.status == SyncFileItem::DetailError
+            || e.status == SyncFileItem::BlacklistedError) {
+            return _errorIcon;
+        } else if (Progress::isWarningKind(e.status)) {
+            return _warningIcon;
+        }
+        break;
+    case Qt::ToolTipRole:
+        switch (index.column()) {
+        case 0:
+            return timeString(QDateTime::fromMSecsSinceEpoch(e.timestamp), QLocale::LongFormat);
+        case 1:
+            return e.path;
+        case 3:
+            return e.message;
+        }
+        break;
+    case Qt::SizeHintRole:
+        if (index.column() == 0)
+            return QSize(0, ActivityItemDelegate::rowHeight());
+        break;
+    }
+    return QVariant();
+}
+
+QVariant ProtocolModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
+        return _headers.value(section);
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+quint64 ProtocolModel::append(const ProtocolEntry &entry)
+{
+    _pending.append(entry);
+    _pending.last().id = ++_lastId;
+    if (!_flushTimer.isActive())
+        _flushTimer.start();
+    return _lastId;
+}
+
+void ProtocolModel::flush()
+{
+    _flushTimer.stop();
+    if (_pending.isEmpty())
+        return;
+
+    // Pending entries that would be evicted right away never become rows
+    if (_pending.size() > _maxEntries)
+        _pending.erase(_pending.begin(), _pending.end() - _maxEntries);
+
+    // Make room by dropping the oldest rows, their slots are reused below
+    const int evicted = _count + _pending.size() - _maxEntries;
+    if (evicted > 0) {
+        beginRemoveRows(QModelIndex(), 0, evicted - 1);
+        _first = (_first + evicted) % _entries.size();
+        _count -= evicted;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), _count, _count + _pending.size() - 1);
+    for (const auto &e : _pending)
+        pushEntry(e);
+    endInsertRows();
+    _pending.clear();
+}
+
+void ProtocolModel::pushEntry(const ProtocolEntry &entry)
+{
+    if (_count == _entries.size()) {
+        linearize();
+        _entries.append(entry);
+    } else {
+        _entries[slot(_count)] = entry;
+    }
+    ++_count;
+}
+
+void ProtocolModel::linearize()
+{
+    if (_first != 0) {
+        std::rotate(_entries.begin(), _entries.begin() + _first, _entries.end());
+        _first = 0;
+    }
+    // Drop the slots of evicted entries
+    _entries.resize(_count);
+}
+
+void ProtocolModel::removeEntries(const std::function<bool(const ProtocolEntry &)> &shouldRemove)
+{
+    auto pendingEnd = std::remove_if(_pending.begin(), _pending.end(), shouldRemove);
+    _pending.erase(pendingEnd, _pending.end());
+
+    linearize();
+    std::vector<bool> remove(_count);
+    QVector<QPair<int, int>> blocks; // first and last row
+    for (int row = 0; row < _count; ++row) {
+        remove[row] = shouldRemove(_entries[row]);
+        if (!remove[row])
+            continue;
+        if (row > 0 && remove[row - 1])
+            blocks.last().second = row;
+        else
+            blocks.append(qMakePair(row, row));
+    }
+    if (blocks.isEmpty())
+        return;
+
+    if (blocks.size() > maxRemovedBlocks) {
+        beginResetModel();
+        int kept = 0;
+        for (int row = 0; row < _count; ++row) {
+            if (remove[row])
+                continue;
+            if (kept != row)
+                _entries[kept] = std::move(_entries[row]);
+            ++kept;
+        }
+        _count = kept;
+        _entries.resize(_count);
+        endResetModel();
+        return;
+    }
+
+    // From the end, so that the rows of the other blocks stay the same
+    for (int i = blocks.size() - 1; i >= 0; --i) {
+        const auto &block = blocks[i];
+        beginRemoveRows(QModelIndex(), block.first, block.second);
+        _entries.erase(_entries.begin() + block.first, _entries.begin() + block.second + 1);
+        _count = _entries.size();
+        endRemoveRows();
+    }
+}
+
+bool ProtocolModel::removeEntry(quint64 id)
+{
+    auto idLess = [](const ProtocolEntry &e, quint64 id) { return e.id < id; };
+
+    if (!_pending.isEmpty() && id >= _pending.first().id) {
+        auto it = std::lower_bound(_pending.begin(), _pending.end(), id, idLess);
+        if (it == _pending.end() || it->id != id)
+            return false;
+        _pending.erase(it);
+        return true;
+    }
+
+    linearize();
+    auto it = std::lower_bound(_entries.begin(), _entries.end(), id, idLess);
+    if (it == _entries.end() || it->id != id)
+        return false;
+    const int row = it - _entries.begin();
+    beginRemoveRows(QModelIndex(), row, row);
+    _entries.erase(it);
+    _count = _entries.size();
+    endRemoveRows();
+    return true;
+}
+
+ProtocolEntry ProtocolModel::entryForItem(const QString &folder, const SyncFileItem &item)
+{
+    ProtocolEntry e;
+    e.timestamp = QDateTime::currentMSecsSinceEpoch();
+    e.path = item.destination();
+    e.fileName = item._originalFile;
+    e.folderName = folder;
+    // If the error string is set, it's prefered because it is a useful user message.
+    e.message = item._errorString;
+    if (e.message.isEmpty()) {
+        e.message = Progress::asResultString(item);
+    }
+    e.status = item._status;
+    e.direction = item._direction;
+    e.size = item._size;
+    e.showSize = ProgressInfo::isSizeDependent(item);
+    return e;
+}
+
+QString ProtocolModel::timeString(QDateTime dt, QLocale::FormatType format)
+{
+    // Every visible row asks for this, only build the format once
+    static QString dtFormats[QLocale::NarrowFormat + 1];
+    QString &dtFormat = dtFormats[format];
+    const QLocale loc = QLocale::system();
+    if (dtFormat.isEmpty()) {
+        dtFormat = loc.dateTimeFormat(format);
+        static const QRegExp re("(HH|H|hh|h):mm(?!:s)");
+        dtFormat.replace(re, "\\1:mm:ss");
+    }
+    return loc.toString(dt, dtFormat);
+}
+
+void ProtocolModel::openContextMenu(QPoint globalPos, const ProtocolEntry &entry, QWidget *parent)
+{
+    auto f = FolderMan::instance()->folder(entry.folderName);
+    if (!f)
+        return;
+    AccountPtr account = f->accountState()->account();
+    SyncJournalFileRecord rec;
+    f->journalDb()->getFileRecord(entry.path, &rec);
+    // rec might not be valid
+
+    auto menu = new QMenu(parent);
+
+    if (rec.isValid()) {
+        // "Open in Browser" action, translated in the context of the protocol widget
+        auto openInBrowser = menu->addAction(QCoreApplication::translate("OCC::ProtocolWidget", "Abrir no navegador"));
+        QObject::connect(openInBrowser, &QAction::triggered, parent, [parent, account, rec]() {
+            fetchPrivateLinkUrl(account, rec._path, rec.legacyDeriveNumericFileId(), parent,
+                [parent](const QString &url) {
+                    Utility::openBrowser(url, parent);
+                });
+        });
+    }
+
+    // More actions will be conditionally added to the context menu here later
+
+    if (menu->actions().isEmpty()) {
+        delete menu;
+        return;
+    }
+
+    menu->setAttribute(Qt::WA_DeleteOnClose);
+    menu->popup(globalPos);
+}
+
+ProtocolSortFilterProxyModel::ProtocolSortFilterProxyModel(ProtocolModel *model, QObject *parent)
+    : QSortFilterProxyModel(parent)
+    , _model(model)
+{
+    setSourceModel(model);
+}
+
+const ProtocolEntry &ProtocolSortFilterProxyModel::entry(const QModelIndex &index) const
+{
+    return _model->entry(mapToSource(index).row());
+}
+
+void ProtocolSortFilterProxyModel::setFilter(const std::function<bool(const ProtocolEntry &)> &filter)
+{
+    _filter = filter;
+    invalidateFilter();
+}
+
+bool ProtocolSortFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &) const
+{
+    return !_filter || _filter(_model->entry(sourceRow));
+}
+
+bool ProtocolSortFilterProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
+{
+    const auto &l = _model->entry(left.row());
+    const auto &r = _model->entry(right.row());
+    int column = left.column();
+    if (column == 0) {
+        // Entries with empty "File" column are larger than others,
+        // otherwise sort by time (this uses lexicographic ordering)
+        return std::make_tuple(l.fileName.isEmpty(), l.timestamp)
+            < std::make_tuple(r.fileName.isEmpty(), r.timestamp);
+    } else if (column == 4) {
+        return l.size < r.size;
+    }
+
+    return QSortFilterProxyModel::lessThan(left, right);
+}
+}
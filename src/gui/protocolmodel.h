@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef PROTOCOLMODEL_H
+#define PROTOCOLMODEL_H
+
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QDateTime>
+#include <QIcon>
+#include <QLocale>
+#include <QTimer>
+#include <QVector>
+
+#include <functional>
+
+#include "syncfileitem.h"
+#include "progressdispatcher.h"
+
+class QWidget;
+
+namespace OCC {
+
+/**
+ * One line of the protocol or issue list
+ *
+ * Only the raw values are kept, the strings that are shown are
+ * formatted when the view asks for them.
+ */
+struct ProtocolEntry
+{
+    ProtocolEntry()
+        : status(SyncFileItem::NoStatus)
+        , direction(SyncFileItem::None)
+        , showSize(false)
+    {
+    }
+
+    QString path; // destination, relative to the folder
+    QString fileName; // original file name, empty for folder wide entries
+    QString folderName;
+    QString message;
+    quint64 id = 0; // set by ProtocolModel::append(), increases with every entry
+    qint64 timestamp = 0; // msecs since epoch
+    qint64 size = 0;
+    SyncFileItem::Status status BITFIELD(4);
+    SyncFileItem::Direction direction BITFIELD(3);
+    bool showSize BITFIELD(1);
+    ErrorCategory errorCategory = ErrorCategory::Normal; // other categories show the message in an index widget
+};
+
+/**
+ * @brief Model behind the protocol and issue lists
+ * @ingroup gui
+ *
+ * The entries live in a ring buffer of at most maxEntries, the oldest ones
+ * are dropped when it is full. The row order is the insertion order, the
+ * views sort through a ProtocolSortFilterProxyModel.
+ *
+ * Appended entries are collected and inserted as one block after
+ * flushMsec(), so a sync with many items doesn't cause a model update
+ * per item. Call flush() before looking at the rows.
+ */
+class ProtocolModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    ProtocolModel(const QStringList &headers, int maxEntries, QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex &index, int role) const Q_DECL_OVERRIDE;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const Q_DECL_OVERRIDE;
+
+    const ProtocolEntry &entry(int row) const { return _entries[slot(row)]; }
+
+    /// The rows and the entries that are waiting to be inserted
+    int entryCount() const { return _count + _pending.size(); }
+
+    /// Returns the id the entry got
+    quint64 append(const ProtocolEntry &entry);
+
+    /** Removes the row or pending entry with that id.
+     *
+     * The entries are ordered by id, so it is found without looking
+     * at the others. Returns false if there is no such entry.
+     */
+    bool removeEntry(quint64 id);
+
+    /** Removes the rows and pending entries that match.
+     *
+     * shouldRemove is called exactly once for each of them.
+     */
+    void removeEntries(const std::function<bool(const ProtocolEntry &)> &shouldRemove);
+
+    static int flushMsec() { return 100; }
+
+    // Shared by the protocol and the issue list
+    static ProtocolEntry entryForItem(const QString &folder, const SyncFileItem &item);
+    static QString timeString(QDateTime dt, QLocale::FormatType format = QLocale::NarrowFormat);
+    static void openContextMenu(QPoint globalPos, const ProtocolEntry &entry, QWidget *parent);
+
+public slots:
+    /// Inserts the pending entries
+    void flush();
+
+private:
+    int slot(int row) const { return (_first + row) % _entries.size(); }
+    void pushEntry(const ProtocolEntry &entry);
+    void linearize();
+
+    QStringList _headers;
+    int _maxEntries;
+
+    /// Ring buffer, row 0 is at _first
+    QVector<ProtocolEntry> _entries;
+    int _first = 0;
+    int _count = 0;
+
+    QVector<ProtocolEntry> _pending;
+    QTimer _flushTimer;
+    quint64 _lastId = 0;
+
+    QIcon _errorIcon;
+    QIcon _warningIcon;
+};
+
+/**
+ * @brief Sorting and filtering on top of a ProtocolModel
+ * @ingroup gui
+ *
+ * Special sorting: Entries without a file are moved to the top if the
+ * sorting section is the "Time" column and the order is descending.
+ */
+class ProtocolSortFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    explicit ProtocolSortFilterProxyModel(ProtocolModel *model, QObject *parent = 0);
+
+    const ProtocolEntry &entry(const QModelIndex &index) const;
+
+    /// Only entries for which filter returns true are shown, an empty filter shows all
+    void setFilter(const std::function<bool(const ProtocolEntry &)> &filter);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const Q_DECL_OVERRIDE;
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const Q_DECL_OVERRIDE;
+
+private:
+    ProtocolModel *_model;
+    std::function<bool(const ProtocolEntry &)> _filter;
+};
+}
+
+Q_DECLARE_TYPEINFO(OCC::ProtocolEntry, Q_MOVABLE_TYPE);
+
+#endif // PROTOCOLMODEL_H
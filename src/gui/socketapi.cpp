@@ -37,6 +37,7 @@
 #include "sharemanager.h"
 #endif
 
+#include <algorithm>
 #include <array>
 #include <QBitArray>
 #include <QUrl>
@@ -70,7 +71,7 @@
 // This is the version that is returned when the client asks for the VERSION.
 // The first number should be changed if there is an incompatible change that breaks old clients.
 // The second number should be changed when there are new features.
-#define MIRALL_SOCKET_API_VERSION "1.1"
+#define MIRALL_SOCKET_API_VERSION "1.2"
 
 namespace {
 #if GUI_TESTING
@@ -194,6 +195,23 @@ void SocketListener::sendMessage(const QString &message, bool doWait) const
     }
 }
 
+void SocketListener::sendMessages(const QStringList &messages) const
+{
+    if (!socket) {
+        qCInfo(lcSocketApi) << "Not sending" << messages.size() << "messages to dead socket";
+        return;
+    }
+
+    qCInfo(lcSocketApi) << "Sending" << messages.size() << "SocketAPI messages to" << socket;
+    qCDebug(lcSocketApi) << "-->" << messages;
+    QByteArray bytesToSend = messages.join(QLatin1Char('\n')).toUtf8();
+    bytesToSend.append('\n');
+    qint64 sent = socket->write(bytesToSend);
+    if (sent != bytesToSend.length()) {
+        qCWarning(lcSocketApi) << "Could not send all data on socket for" << messages.size() << "messages";
+    }
+}
+
 struct ListenerHasSocketPred
 {
     QIODevice *socket;
@@ -267,6 +285,11 @@ SocketApi::SocketApi(QObject *parent)
 
     connect(&_localServer, &SocketApiServer::newConnection, this, &SocketApi::slotNewConnection);
 
+    // Listeners that want batches get status pushes at most this often
+    _statusPushTimer.setSingleShot(true);
+    _statusPushTimer.setInterval(200);
+    connect(&_statusPushTimer, &QTimer::timeout, this, &SocketApi::slotFlushStatusPushes);
+
     // folder watcher
     connect(FolderMan::instance(), &FolderMan::folderSyncStateChange, this, &SocketApi::slotUpdateFolderView);
 }
@@ -496,11 +519,66 @@ void SocketApi::processShareRequest(const QString &localFile, SocketListener *li
 
 void SocketApi::broadcastStatusPushMessage(const QString &systemPath, SyncFileStatus fileStatus)
 {
-    QString msg = buildMessage(QLatin1String("STATUS"), systemPath, fileStatus.toSocketAPIString());
     Q_ASSERT(!systemPath.endsWith('/'));
-    uint directoryHash = qHash(systemPath.left(systemPath.lastIndexOf('/')));
+    const QString directory = systemPath.left(systemPath.lastIndexOf('/'));
+    uint directoryHash = qHash(directory);
+    QString msg;
+    bool batched = false;
     foreach (auto &listener, _listeners) {
-        listener.sendMessageIfDirectoryMonitored(msg, directoryHash);
+        if (!listener.isDirectoryMonitored(directoryHash))
+            continue;
+        if (listener.wantsStatusBatches) {
+            batched = true;
+            continue;
+        }
+        if (msg.isNull())
+            msg = buildMessage(QLatin1String("STATUS"), systemPath, fileStatus.toSocketAPIString());
+        listener.sendMessage(msg);
+    }
+
+    if (batched) {
+        _pendingStatusPushes[directory][systemPath] = fileStatus.toSocketAPIString();
+        if (!_statusPushTimer.isActive())
+            _statusPushTimer.start();
+    }
+}
+
+void SocketApi::slotFlushStatusPushes()
+{
+    struct DirectoryBatch
+    {
+        uint hash;
+        int depth;
+        QStringList messages;
+    };
+    std::vector<DirectoryBatch> batches;
+    batches.reserve(_pendingStatusPushes.size());
+    for (auto it = _pendingStatusPushes.cbegin(); it != _pendingStatusPushes.cend(); ++it) {
+        const QString nativeDirectory = QDir::toNativeSeparators(it.key());
+        DirectoryBatch batch{ qHash(it.key()), it.key().count(QLatin1Char('/')), QStringList() };
+        batch.messages.reserve(it.value().size() + 2);
+        batch.messages.append(QLatin1String("STATUS_BATCH:BEGIN:") + nativeDirectory);
+        for (auto status = it.value().cbegin(); status != it.value().cend(); ++status)
+            batch.messages.append(QLatin1String("STATUS:") % status.value() % QLatin1Char(':') % QDir::toNativeSeparators(status.key()));
+        batch.messages.append(QLatin1String("STATUS_BATCH:END:") + nativeDirectory);
+        batches.push_back(std::move(batch));
+    }
+    _pendingStatusPushes.clear();
+
+    // Deeper directories first, so that children are updated before their parents
+    std::sort(batches.begin(), batches.end(),
+        [](const DirectoryBatch &a, const DirectoryBatch &b) { return a.depth > b.depth; });
+
+    foreach (auto &listener, _listeners) {
+        if (!listener.wantsStatusBatches)
+            continue;
+        QStringList messages;
+        for (const auto &batch : batches) {
+            if (listener.isDirectoryMonitored(batch.hash))
+                messages.append(batch.messages);
+        }
+        if (!messages.isEmpty())
+            listener.sendMessages(messages);
     }
 }
 
@@ -532,6 +610,33 @@ void SocketApi::command_RETRIEVE_FILE_STATUS(const QString &argument, SocketList
     listener->sendMessage(message);
 }
 
+void SocketApi::command_RETRIEVE_DIRECTORY_STATUS(const QString &argument, SocketListener *listener)
+{
+    auto fileData = FileData::get(argument);
+    const QString nativeDirectory = QDir::toNativeSeparators(fileData.localPath);
+
+    QStringList messages;
+    messages.append(QLatin1String("STATUS_BATCH:BEGIN:") + nativeDirectory);
+    if (fileData.folder) {
+        // Pushes for the entries of this directory are wanted from now on
+        listener->registerMonitoredDirectory(qHash(fileData.localPath));
+
+        auto &tracker = fileData.folder->syncEngine().syncFileStatusTracker();
+        const QString relativePrefix = fileData.folderRelativePath.isEmpty()
+            ? QString()
+            : fileData.folderRelativePath + QLatin1Char('/');
+        const auto entries = QDir(fileData.localPath).entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+        messages.reserve(entries.size() + 2);
+        for (const auto &entry : entries) {
+            messages.append(QLatin1String("STATUS:")
+                % tracker.fileStatus(relativePrefix + entry).toSocketAPIString()
+                % QLatin1Char(':') % nativeDirectory % QDir::separator() % entry);
+        }
+    }
+    messages.append(QLatin1String("STATUS_BATCH:END:") + nativeDirectory);
+    listener->sendMessages(messages);
+}
+
 void SocketApi::command_SHARE(const QString &localFile, SocketListener *listener)
 {
     processShareRequest(localFile, listener, ShareDialogStartPage::UsersAndGroups);
@@ -542,8 +647,14 @@ void SocketApi::command_MANAGE_PUBLIC_LINKS(const QString &localFile, SocketList
     processShareRequest(localFile, listener, ShareDialogStartPage::PublicLinks);
 }
 
-void SocketApi::command_VERSION(const QString &, SocketListener *listener)
+void SocketApi::command_VERSION(const QString &argument, SocketListener *listener)
 {
+    // Listeners may announce the version they speak, older ones send nothing
+    const auto version = argument.split(QLatin1Char('.'));
+    const int major = version.value(0).toInt();
+    const int minor = version.value(1).toInt();
+    listener->wantsStatusBatches = major > 1 || (major == 1 && minor >= 2);
+
     listener->sendMessage(QLatin1String("VERSION:" MIRALL_VERSION_STRING ":" MIRALL_SOCKET_API_VERSION));
 }
 
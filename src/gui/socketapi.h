@@ -22,6 +22,9 @@
 
 #include "config.h"
 
+#include <QHash>
+#include <QTimer>
+
 #if defined(Q_OS_MAC)
 #include "socketapisocket_mac.h"
 #else
@@ -68,6 +71,7 @@ private slots:
     void onLostConnection();
     void slotSocketDestroyed(QObject *obj);
     void slotReadSocket();
+    void slotFlushStatusPushes();
 
     static void copyUrlToClipboard(const QString &link);
     static void emailPrivateLink(const QString &link);
@@ -104,6 +108,13 @@ private:
     Q_INVOKABLE void command_RETRIEVE_FOLDER_STATUS(const QString &argument, SocketListener *listener);
     Q_INVOKABLE void command_RETRIEVE_FILE_STATUS(const QString &argument, SocketListener *listener);
 
+    /** Replies with the status of every entry of a directory (added in version 1.2)
+     * Reply with STATUS_BATCH:BEGIN:[directory]
+     * followed by a STATUS:[status]:[path] for each entry
+     * and ends with STATUS_BATCH:END:[directory]
+     */
+    Q_INVOKABLE void command_RETRIEVE_DIRECTORY_STATUS(const QString &argument, SocketListener *listener);
+
     Q_INVOKABLE void command_VERSION(const QString &argument, SocketListener *listener);
 
     Q_INVOKABLE void command_SHARE_MENU_TITLE(const QString &argument, SocketListener *listener);
@@ -154,6 +165,11 @@ private:
     QSet<QString> _registeredAliases;
     QList<SocketListener> _listeners;
     SocketApiServer _localServer;
+
+    // Status pushes waiting for slotFlushStatusPushes(): the latest status string
+    // of each path, by the directory of the path
+    QHash<QString, QHash<QString, QString>> _pendingStatusPushes;
+    QTimer _statusPushTimer;
 };
 }
 
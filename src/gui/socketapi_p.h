@@ -67,11 +67,25 @@ public:
     {
     }
 
+    /** Set when the listener announced socket API 1.2 or later with VERSION.
+     *
+     * It then gets its status pushes in batches, see SocketApi::slotFlushStatusPushes().
+     */
+    bool wantsStatusBatches = false;
+
     void sendMessage(const QString &message, bool doWait = false) const;
 
+    /// Sends all messages with a single write
+    void sendMessages(const QStringList &messages) const;
+
+    bool isDirectoryMonitored(uint systemDirectoryHash) const
+    {
+        return _monitoredDirectoriesBloomFilter.isHashMaybeStored(systemDirectoryHash);
+    }
+
     void sendMessageIfDirectoryMonitored(const QString &message, uint systemDirectoryHash) const
     {
-        if (_monitoredDirectoriesBloomFilter.isHashMaybeStored(systemDirectoryHash))
+        if (isDirectoryMonitored(systemDirectoryHash))
             sendMessage(message, false);
     }
 
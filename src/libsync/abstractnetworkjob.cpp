@@ -128,7 +128,7 @@ QNetworkReply *AbstractNetworkJob::addTimer(QNetworkReply *reply)
 QNetworkReply *AbstractNetworkJob::sendRequest(const QByteArray &verb, const QUrl &url,
     QNetworkRequest req, QIODevice *requestBody)
 {
-    auto reply = _account->sendRawRequest(verb, url, req, requestBody);
+    auto reply = _account->sendRawRequest(verb, url, req, requestBody, _jobClass);
     _requestBody = requestBody;
     if (_requestBody) {
         _requestBody->setParent(reply);
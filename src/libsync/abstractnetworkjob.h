@@ -69,6 +69,10 @@ public:
     void setFollowRedirects(bool follow);
     bool followRedirects() const { return _followRedirects; }
 
+    /** Which of the account's network access managers sends the requests */
+    void setNetworkJobClass(NetworkJobClass jobClass) { _jobClass = jobClass; }
+    NetworkJobClass networkJobClass() const { return _jobClass; }
+
     QByteArray responseTimestamp();
     /* Content of the X-Request-ID header. (Only set after the request is sent) */
     QByteArray requestId();
@@ -196,6 +200,7 @@ private:
     QTimer _timer;
     int _redirectCount = 0;
     int _http2ResendCount = 0;
+    NetworkJobClass _jobClass = NetworkJobClass::Default;
 
     // Set by the xyzRequest() functions and needed to be able to redirect
     // requests, should it be required.
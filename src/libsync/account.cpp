@@ -150,6 +150,7 @@ void Account::setCredentials(AbstractCredentials *cred)
 
         _am = QSharedPointer<QNetworkAccessManager>();
     }
+    _jobClassAms.clear();
 
     // The order for these two is important! Reading the credential's
     // settings accesses the account as well as account->_credentials,
@@ -220,6 +221,7 @@ void Account::resetNetworkAccessManager()
 
     qCDebug(lcAccount) << "Resetting QNAM";
     QNetworkCookieJar *jar = _am->cookieJar();
+    _jobClassAms.clear();
 
     // Use a QSharedPointer to allow locking the life of the QNAM on the stack.
     // Make it call deleteLater to make sure that we can return to any QNAM stack frames safely.
@@ -242,22 +244,53 @@ QSharedPointer<QNetworkAccessManager> Account::sharedNetworkAccessManager()
     return _am;
 }
 
-QNetworkReply *Account::sendRawRequest(const QByteArray &verb, const QUrl &url, QNetworkRequest req, QIODevice *data)
+QNetworkAccessManager *Account::networkAccessManagerFor(NetworkJobClass jobClass)
+{
+    static const bool shardingEnabled = qEnvironmentVariableIsEmpty("OWNCLOUD_QNAM_SHARDING")
+        || qEnvironmentVariableIntValue("OWNCLOUD_QNAM_SHARDING") != 0;
+    // HTTP/2 multiplexes all requests over one connection anyway
+    if (jobClass == NetworkJobClass::Default || !shardingEnabled || _http2Supported || !_credentials)
+        return _am.data();
+
+    auto &am = _jobClassAms[jobClass];
+    if (!am) {
+        QNetworkAccessManager *qnam = _credentials->createQNAM();
+        if (qnam == _am.data()) {
+            // These credentials hand out a single QNAM
+            _jobClassAms.remove(jobClass);
+            return _am.data();
+        }
+        am = QSharedPointer<QNetworkAccessManager>(qnam, &QObject::deleteLater);
+        lendCookieJarTo(am.data());
+        connect(am.data(), SIGNAL(sslErrors(QNetworkReply *, QList<QSslError>)),
+            SLOT(slotHandleSslErrors(QNetworkReply *, QList<QSslError>)));
+        connect(am.data(), &QNetworkAccessManager::proxyAuthenticationRequired,
+            this, &Account::proxyAuthenticationRequired);
+    }
+    // The proxy is changed on the main QNAM only
+    if (am->proxy() != _am->proxy())
+        am->setProxy(_am->proxy());
+    return am.data();
+}
+
+QNetworkReply *Account::sendRawRequest(const QByteArray &verb, const QUrl &url, QNetworkRequest req, QIODevice *data,
+    NetworkJobClass jobClass)
 {
     req.setUrl(url);
     req.setSslConfiguration(this->getOrCreateSslConfig());
+    QNetworkAccessManager *am = networkAccessManagerFor(jobClass);
     if (verb == "HEAD" && !data) {
-        return _am->head(req);
+        return am->head(req);
     } else if (verb == "GET" && !data) {
-        return _am->get(req);
+        return am->get(req);
     } else if (verb == "POST") {
-        return _am->post(req, data);
+        return am->post(req, data);
     } else if (verb == "PUT") {
-        return _am->put(req, data);
+        return am->put(req, data);
     } else if (verb == "DELETE" && !data) {
-        return _am->deleteResource(req);
+        return am->deleteResource(req);
     }
-    return _am->sendCustomRequest(req, verb, data);
+    return am->sendCustomRequest(req, verb, data);
 }
 
 SimpleNetworkJob *Account::sendRequest(const QByteArray &verb, const QUrl &url, QNetworkRequest req, QIODevice *data)
@@ -429,6 +462,8 @@ void Account::handleInvalidCredentials()
 void Account::clearQNAMCache()
 {
     _am->clearAccessCache();
+    for (const auto &am : _jobClassAms)
+        am->clearAccessCache();
 }
 
 const Capabilities &Account::capabilities() const
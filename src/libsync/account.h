@@ -26,6 +26,7 @@
 #include <QSslCipher>
 #include <QSslError>
 #include <QSharedPointer>
+#include <QMap>
 
 #ifndef TOKEN_AUTH_ONLY
 #include <QPixmap>
@@ -140,11 +141,19 @@ public:
      * Network requests in AbstractNetworkJobs are created through
      * this function. Other places should prefer to use jobs or
      * sendRequest().
+     *
+     * Without HTTP/2, each \a jobClass other than NetworkJobClass::Default
+     * uses a separate QNAM that shares the cookies, credentials, proxy and
+     * ssl configuration of the main one. Each has its own connection limit
+     * per host, so discovery requests don't queue behind transfers and
+     * more than 6 requests can run at once. Set OWNCLOUD_QNAM_SHARDING=0
+     * to use a single QNAM.
      */
     QNetworkReply *sendRawRequest(const QByteArray &verb,
         const QUrl &url,
         QNetworkRequest req = QNetworkRequest(),
-        QIODevice *data = 0);
+        QIODevice *data = 0,
+        NetworkJobClass jobClass = NetworkJobClass::Default);
 
     /** Create and start network job for a simple one-off request.
      *
@@ -267,6 +276,7 @@ protected Q_SLOTS:
 private:
     Account(QObject *parent = 0);
     void setSharedThis(AccountPtr sharedThis);
+    QNetworkAccessManager *networkAccessManagerFor(NetworkJobClass jobClass);
 
     QWeakPointer<Account> _sharedThis;
     QString _id;
@@ -293,6 +303,7 @@ private:
     QScopedPointer<AbstractSslErrorHandler> _sslErrorHandler;
     QuotaInfo *_quotaInfo;
     QSharedPointer<QNetworkAccessManager> _am;
+    QMap<NetworkJobClass, QSharedPointer<QNetworkAccessManager>> _jobClassAms;
     QScopedPointer<AbstractCredentials> _credentials;
     bool _http2Supported = false;
 
@@ -24,6 +24,14 @@ typedef QSharedPointer<Account> AccountPtr;
 class AccountState;
 typedef QExplicitlySharedDataPointer<AccountState> AccountStatePtr;
 
+/** Kinds of requests that get their own network access manager, see Account::sendRawRequest() */
+enum class NetworkJobClass {
+    Default,
+    Discovery,
+    SmallTransfer,
+    LargeTransfer
+};
+
 } // namespace OCC
 
 #endif //SERVERFWD
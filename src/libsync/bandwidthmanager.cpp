@@ -31,365 +31,303 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcBandwidthManager, "sync.bandwidthmanager", QtInfoMsg)
 
+// Relative limits outside of this range would either leave nothing for the
+// other applications or let the measurement dominate the whole period.
+static const qint64 minRelativePercent = 10;
+static const qint64 maxRelativePercent = 90;
+
+// Waiting consumers get at least this much per round, to avoid tiny reads.
+// It is also the lowest rate a relative limit goes down to.
+static const qint64 minShare = 1024;
+
 // Because of the many layers of buffering inside Qt (and probably the OS and the network)
-// we cannot lower this value much more. If we do, the estimated bw will be very high
-// because the buffers fill fast while the actual network algorithms are not relevant yet.
-static qint64 relativeLimitMeasuringTimerIntervalMsec = 1000 * 2;
+// the probe of relative limits cannot be much shorter than BandwidthLimiter::probeMsec().
+// If it is, the estimated bw will be very high because the buffers fill fast while the
+// actual network algorithms are not relevant yet.
 // See also WritingState in http://code.woboq.org/qt5/qtbase/src/network/access/qhttpprotocolhandler.cpp.html#_ZN20QHttpProtocolHandler11sendRequestEv
 
-// FIXME At some point:
-//  * Register device only after the QNR received its metaDataChanged() signal
-//  * Incorporate Qt buffer fill state (it's a negative absolute delta).
-//  * Incorporate SSL overhead (percentage)
-//  * For relative limiting, do less measuring and more delaying+giving quota
-//  * For relative limiting, smoothen measurements
-
-BandwidthManager::BandwidthManager(OwncloudPropagator *p)
-    : QObject()
-    , _propagator(p)
-    , _relativeLimitCurrentMeasuredDevice(0)
-    , _relativeUploadLimitProgressAtMeasuringRestart(0)
-    , _currentUploadLimit(0)
-    , _relativeLimitCurrentMeasuredJob(0)
-    , _currentDownloadLimit(0)
+void BandwidthLimiter::setLimit(qint64 limit, qint64 burstMsec, qint64 nowMsec)
 {
-    _currentUploadLimit = _propagator->_uploadLimit.fetchAndAddAcquire(0);
-    _currentDownloadLimit = _propagator->_downloadLimit.fetchAndAddAcquire(0);
-
-    QObject::connect(&_switchingTimer, &QTimer::timeout, this, &BandwidthManager::switchingTimerExpired);
-    _switchingTimer.setInterval(10 * 1000);
-    _switchingTimer.start();
-    QMetaObject::invokeMethod(this, "switchingTimerExpired", Qt::QueuedConnection);
-
-    // absolute uploads/downloads
-    QObject::connect(&_absoluteLimitTimer, &QTimer::timeout, this, &BandwidthManager::absoluteLimitTimerExpired);
-    _absoluteLimitTimer.setInterval(1000);
-    _absoluteLimitTimer.start();
-
-    // Relative uploads
-    QObject::connect(&_relativeUploadMeasuringTimer, &QTimer::timeout,
-        this, &BandwidthManager::relativeUploadMeasuringTimerExpired);
-    _relativeUploadMeasuringTimer.setInterval(relativeLimitMeasuringTimerIntervalMsec);
-    _relativeUploadMeasuringTimer.start();
-    _relativeUploadMeasuringTimer.setSingleShot(true); // will be restarted from the delay timer
-    QObject::connect(&_relativeUploadDelayTimer, &QTimer::timeout,
-        this, &BandwidthManager::relativeUploadDelayTimerExpired);
-    _relativeUploadDelayTimer.setSingleShot(true); // will be restarted from the measuring timer
-
-    // Relative downloads
-    QObject::connect(&_relativeDownloadMeasuringTimer, &QTimer::timeout,
-        this, &BandwidthManager::relativeDownloadMeasuringTimerExpired);
-    _relativeDownloadMeasuringTimer.setInterval(relativeLimitMeasuringTimerIntervalMsec);
-    _relativeDownloadMeasuringTimer.start();
-    _relativeDownloadMeasuringTimer.setSingleShot(true); // will be restarted from the delay timer
-    QObject::connect(&_relativeDownloadDelayTimer, &QTimer::timeout,
-        this, &BandwidthManager::relativeDownloadDelayTimerExpired);
-    _relativeDownloadDelayTimer.setSingleShot(true); // will be restarted from the measuring timer
+    if (limit == _limit && burstMsec == _burstMsec)
+        return;
+    _limit = limit;
+    _burstMsec = burstMsec;
+    _lastRefillMsec = nowMsec;
+    _probing = false;
+    if (_limit > 0) {
+        setRate(_limit);
+        _milliTokens = _burst * 1000;
+    } else if (_limit < 0) {
+        startProbe(nowMsec);
+    } else {
+        setRate(0);
+    }
 }
 
-BandwidthManager::~BandwidthManager()
+void BandwidthLimiter::setRate(qint64 rate)
 {
+    _rate = rate;
+    // The bucket must at least hold what accumulates between two rounds,
+    // otherwise tokens are lost whenever the timer is a bit late
+    _burst = _rate * qMax(_burstMsec, 2 * roundMsec()) / 1000;
+    _milliTokens = qMin(_milliTokens, _burst * 1000);
+    _roundShare = qMax(minShare, _rate * roundMsec() / 1000 / qMax(1, _consumers.size()));
 }
 
-void BandwidthManager::registerUploadDevice(UploadDevice *p)
+void BandwidthLimiter::startProbe(qint64 nowMsec)
 {
-    _absoluteUploadDeviceList.append(p);
-    _relativeUploadDeviceList.append(p);
-    QObject::connect(p, &QObject::destroyed, this, &BandwidthManager::unregisterUploadDevice);
-
-    if (usingAbsoluteUploadLimit()) {
-        p->setBandwidthLimited(true);
-        p->setChoked(false);
-    } else if (usingRelativeUploadLimit()) {
-        p->setBandwidthLimited(true);
-        p->setChoked(true);
-    } else {
-        p->setBandwidthLimited(false);
-        p->setChoked(false);
-    }
+    _probing = true;
+    _phaseStartMsec = nowMsec;
+    _phaseStartTransferred = _transferred;
+    setRate(0);
 }
 
-void BandwidthManager::unregisterUploadDevice(QObject *o)
+void BandwidthLimiter::addConsumer(QObject *consumer)
 {
-    auto p = reinterpret_cast<UploadDevice *>(o); // note, we might already be in the ~QObject
-    _absoluteUploadDeviceList.removeAll(p);
-    _relativeUploadDeviceList.removeAll(p);
-    if (p == _relativeLimitCurrentMeasuredDevice) {
-        _relativeLimitCurrentMeasuredDevice = 0;
-        _relativeUploadLimitProgressAtMeasuringRestart = 0;
-    }
+    if (!_consumers.contains(consumer))
+        _consumers.insert(consumer, Consumer());
 }
 
-void BandwidthManager::registerDownloadJob(GETJob *j)
+void BandwidthLimiter::removeConsumer(QObject *consumer)
 {
-    _downloadJobList.append(j);
-    QObject::connect(j, &QObject::destroyed, this, &BandwidthManager::unregisterDownloadJob);
-
-    if (usingAbsoluteDownloadLimit()) {
-        j->setBandwidthLimited(true);
-        j->setChoked(false);
-    } else if (usingRelativeDownloadLimit()) {
-        j->setBandwidthLimited(true);
-        j->setChoked(true);
-    } else {
-        j->setBandwidthLimited(false);
-        j->setChoked(false);
-    }
+    _consumers.remove(consumer);
+    _waiting.removeAll(consumer);
 }
 
-void BandwidthManager::unregisterDownloadJob(QObject *o)
+void BandwidthLimiter::advance(qint64 nowMsec)
 {
-    GETJob *j = reinterpret_cast<GETJob *>(o); // note, we might already be in the ~QObject
-    _downloadJobList.removeAll(j);
-    if (_relativeLimitCurrentMeasuredJob == j) {
-        _relativeLimitCurrentMeasuredJob = 0;
-        _relativeDownloadLimitProgressAtMeasuringRestart = 0;
-    }
+    if (_lastRefillMsec < 0)
+        _lastRefillMsec = nowMsec;
+    if (_limit < 0)
+        advanceRelative(nowMsec);
+    if (_rate > 0 && nowMsec > _lastRefillMsec)
+        _milliTokens = qMin(_burst * 1000, _milliTokens + _rate * (nowMsec - _lastRefillMsec));
+    _lastRefillMsec = nowMsec;
 }
 
-void BandwidthManager::relativeUploadMeasuringTimerExpired()
+void BandwidthLimiter::advanceRelative(qint64 nowMsec)
 {
-    if (!usingRelativeUploadLimit() || _relativeUploadDeviceList.count() == 0) {
-        // Not in this limiting mode, just wait 1 sec to continue the cycle
-        _relativeUploadDelayTimer.setInterval(1000);
-        _relativeUploadDelayTimer.start();
+    if (!_probing) {
+        if (nowMsec >= _phaseEndMsec)
+            startProbe(nowMsec);
         return;
     }
-    if (_relativeLimitCurrentMeasuredDevice == 0) {
-        qCDebug(lcBandwidthManager) << "No device set, just waiting 1 sec";
-        _relativeUploadDelayTimer.setInterval(1000);
-        _relativeUploadDelayTimer.start();
+
+    const qint64 elapsed = nowMsec - _phaseStartMsec;
+    if (elapsed < probeMsec())
         return;
-    }
 
-    qCDebug(lcBandwidthManager) << _relativeUploadDeviceList.count() << "Starting Delay";
-
-    qint64 relativeLimitProgressMeasured = (_relativeLimitCurrentMeasuredDevice->_readWithProgress
-                                               + _relativeLimitCurrentMeasuredDevice->_read)
-        / 2;
-    qint64 relativeLimitProgressDifference = relativeLimitProgressMeasured - _relativeUploadLimitProgressAtMeasuringRestart;
-    qCDebug(lcBandwidthManager) << _relativeUploadLimitProgressAtMeasuringRestart
-                                << relativeLimitProgressMeasured << relativeLimitProgressDifference;
-
-    qint64 speedkBPerSec = (relativeLimitProgressDifference / relativeLimitMeasuringTimerIntervalMsec * 1000.0) / 1024.0;
-    qCDebug(lcBandwidthManager) << relativeLimitProgressDifference / 1024 << "kB =>" << speedkBPerSec << "kB/sec on full speed ("
-                                << _relativeLimitCurrentMeasuredDevice->_readWithProgress << _relativeLimitCurrentMeasuredDevice->_read
-                                << qAbs(_relativeLimitCurrentMeasuredDevice->_readWithProgress
-                                       - _relativeLimitCurrentMeasuredDevice->_read)
-                                << ")";
-
-    qint64 uploadLimitPercent = -_currentUploadLimit;
-    // don't use too extreme values
-    uploadLimitPercent = qMin(uploadLimitPercent, qint64(90));
-    uploadLimitPercent = qMax(qint64(10), uploadLimitPercent);
-    qint64 wholeTimeMsec = (100.0 / uploadLimitPercent) * relativeLimitMeasuringTimerIntervalMsec;
-    qint64 waitTimeMsec = wholeTimeMsec - relativeLimitMeasuringTimerIntervalMsec;
-    qint64 realWaitTimeMsec = waitTimeMsec + wholeTimeMsec;
-    qCDebug(lcBandwidthManager) << waitTimeMsec << " - " << realWaitTimeMsec << " msec for " << uploadLimitPercent << "%";
-
-    // We want to wait twice as long since we want to give all
-    // devices the same quota we used now since we don't want
-    // any upload to timeout
-    _relativeUploadDelayTimer.setInterval(realWaitTimeMsec);
-    _relativeUploadDelayTimer.start();
-
-    int deviceCount = _relativeUploadDeviceList.count();
-    qint64 quotaPerDevice = relativeLimitProgressDifference * (uploadLimitPercent / 100.0) / deviceCount + 1.0;
-    Q_FOREACH (UploadDevice *ud, _relativeUploadDeviceList) {
-        ud->setBandwidthLimited(true);
-        ud->setChoked(false);
-        ud->giveBandwidthQuota(quotaPerDevice);
-        qCDebug(lcBandwidthManager) << "Gave" << quotaPerDevice / 1024.0 << "kB to" << ud;
+    // A probe with little to transfer says little about the link, so the
+    // estimate may at most halve per period
+    const qint64 probeBytes = _transferred - _phaseStartTransferred;
+    _capacity = qMax(probeBytes * 1000 / elapsed, _capacity / 2);
+    if (_capacity <= 0) {
+        startProbe(nowMsec);
+        return;
     }
-    _relativeLimitCurrentMeasuredDevice = 0;
+
+    // Choose the rate so that the whole period, including the unthrottled
+    // probe, averages to the percentage of the capacity
+    const qint64 percent = qBound(minRelativePercent, -_limit, maxRelativePercent);
+    const qint64 limitedMsec = qMax(roundMsec(), relativePeriodMsec() - elapsed);
+    const qint64 periodBytes = _capacity * percent * (elapsed + limitedMsec) / 100 / 1000;
+    const qint64 rate = qMax(minShare, (periodBytes - probeBytes) * 1000 / limitedMsec);
+
+    qCDebug(lcBandwidthManager) << "Measured" << _capacity / 1024 << "KiB/s, limiting to"
+                                << rate / 1024 << "KiB/s for" << limitedMsec << "msec to reach" << percent << "%";
+
+    _probing = false;
+    _phaseEndMsec = nowMsec + limitedMsec;
+    _milliTokens = 0;
+    setRate(rate);
 }
 
-void BandwidthManager::relativeUploadDelayTimerExpired()
+void BandwidthLimiter::wait(QObject *consumer, Consumer &c)
 {
-    // Switch to measuring state
-    _relativeUploadMeasuringTimer.start(); // always start to continue the cycle
-
-    if (!usingRelativeUploadLimit()) {
-        return; // oh, not actually needed
+    if (!c.waiting) {
+        c.waiting = true;
+        _waiting.append(consumer);
     }
+}
 
-    if (_relativeUploadDeviceList.isEmpty()) {
-        return;
+qint64 BandwidthLimiter::take(QObject *consumer, qint64 wanted, qint64 nowMsec)
+{
+    advance(nowMsec);
+    if (wanted <= 0)
+        return 0;
+
+    auto it = _consumers.find(consumer);
+    if (it == _consumers.end()) {
+        // not (or no longer) registered, e.g. reading the rest of a finished reply
+        return wanted;
     }
-
-    qCDebug(lcBandwidthManager) << _relativeUploadDeviceList.count() << "Starting measuring";
-
-    // Take first device and then append it again (= we round robin all devices)
-    _relativeLimitCurrentMeasuredDevice = _relativeUploadDeviceList.takeFirst();
-    _relativeUploadDeviceList.append(_relativeLimitCurrentMeasuredDevice);
-
-    _relativeUploadLimitProgressAtMeasuringRestart = (_relativeLimitCurrentMeasuredDevice->_readWithProgress
-                                                         + _relativeLimitCurrentMeasuredDevice->_read)
-        / 2;
-    _relativeLimitCurrentMeasuredDevice->setBandwidthLimited(false);
-    _relativeLimitCurrentMeasuredDevice->setChoked(false);
-
-    // choke all other UploadDevices
-    Q_FOREACH (UploadDevice *ud, _relativeUploadDeviceList) {
-        if (ud != _relativeLimitCurrentMeasuredDevice) {
-            ud->setBandwidthLimited(true);
-            ud->setChoked(true);
+    Consumer &c = it.value();
+    c.woken = false;
+
+    qint64 grant = wanted;
+    if (_rate > 0) {
+        grant = qMin(grant, _milliTokens / 1000);
+        const int othersCompeting = _waiting.size() - (c.waiting ? 1 : 0)
+            + _activeThisRound - (c.takenThisRound > 0 ? 1 : 0);
+        if (othersCompeting > 0)
+            grant = qMin(grant, _roundShare - c.takenThisRound);
+        if (grant <= 0) {
+            wait(consumer, c);
+            return 0;
         }
+        if (c.takenThisRound == 0)
+            ++_activeThisRound;
+        _milliTokens -= grant * 1000;
+        c.takenThisRound += grant;
     }
 
-    // now we're in measuring state
+    if (c.waiting) {
+        c.waiting = false;
+        _waiting.removeOne(consumer);
+    }
+    _transferred += grant;
+    return grant;
 }
 
-// for downloads:
-void BandwidthManager::relativeDownloadMeasuringTimerExpired()
+QList<QObject *> BandwidthLimiter::nextRound(qint64 nowMsec)
 {
-    if (!usingRelativeDownloadLimit() || _downloadJobList.count() == 0) {
-        // Not in this limiting mode, just wait 1 sec to continue the cycle
-        _relativeDownloadDelayTimer.setInterval(1000);
-        _relativeDownloadDelayTimer.start();
-        return;
+    advance(nowMsec);
+
+    // Consumers that were woken up by the last round but did not ask
+    // again have nothing to transfer right now
+    for (auto it = _waiting.begin(); it != _waiting.end();) {
+        Consumer &c = _consumers[*it];
+        if (c.woken) {
+            c.waiting = false;
+            c.woken = false;
+            it = _waiting.erase(it);
+        } else {
+            ++it;
+        }
     }
-    if (_relativeLimitCurrentMeasuredJob == 0) {
-        qCDebug(lcBandwidthManager) << "No job set, just waiting 1 sec";
-        _relativeDownloadDelayTimer.setInterval(1000);
-        _relativeDownloadDelayTimer.start();
-        return;
+    for (auto &c : _consumers)
+        c.takenThisRound = 0;
+    _activeThisRound = 0;
+
+    const QList<QObject *> woken = _waiting;
+    if (_rate <= 0) {
+        for (auto *consumer : woken)
+            _consumers[consumer].waiting = false;
+        _waiting.clear();
+        return woken;
     }
 
-    qCDebug(lcBandwidthManager) << _downloadJobList.count() << "Starting Delay";
-
-    qint64 relativeLimitProgressMeasured = _relativeLimitCurrentMeasuredJob->currentDownloadPosition();
-    qint64 relativeLimitProgressDifference = relativeLimitProgressMeasured - _relativeDownloadLimitProgressAtMeasuringRestart;
-    qCDebug(lcBandwidthManager) << _relativeDownloadLimitProgressAtMeasuringRestart
-                                << relativeLimitProgressMeasured << relativeLimitProgressDifference;
-
-    qint64 speedkBPerSec = (relativeLimitProgressDifference / relativeLimitMeasuringTimerIntervalMsec * 1000.0) / 1024.0;
-    qCDebug(lcBandwidthManager) << relativeLimitProgressDifference / 1024 << "kB =>" << speedkBPerSec << "kB/sec on full speed ("
-                                << _relativeLimitCurrentMeasuredJob->currentDownloadPosition();
-
-    qint64 downloadLimitPercent = -_currentDownloadLimit;
-    // don't use too extreme values
-    downloadLimitPercent = qMin(downloadLimitPercent, qint64(90));
-    downloadLimitPercent = qMax(qint64(10), downloadLimitPercent);
-    qint64 wholeTimeMsec = (100.0 / downloadLimitPercent) * relativeLimitMeasuringTimerIntervalMsec;
-    qint64 waitTimeMsec = wholeTimeMsec - relativeLimitMeasuringTimerIntervalMsec;
-    qint64 realWaitTimeMsec = waitTimeMsec + wholeTimeMsec;
-    qCDebug(lcBandwidthManager) << waitTimeMsec << " - " << realWaitTimeMsec << " msec for " << downloadLimitPercent << "%";
-
-    // We want to wait twice as long since we want to give all
-    // devices the same quota we used now since we don't want
-    // any download to timeout
-    _relativeDownloadDelayTimer.setInterval(realWaitTimeMsec);
-    _relativeDownloadDelayTimer.start();
-
-    int jobCount = _downloadJobList.count();
-    qint64 quota = relativeLimitProgressDifference * (downloadLimitPercent / 100.0);
-    if (quota > 20 * 1024) {
-        qCInfo(lcBandwidthManager) << "ADJUSTING QUOTA FROM " << quota << " TO " << quota - 20 * 1024;
-        quota -= 20 * 1024;
-    }
-    qint64 quotaPerJob = quota / jobCount + 1.0;
-    Q_FOREACH (GETJob *gfj, _downloadJobList) {
-        gfj->setBandwidthLimited(true);
-        gfj->setChoked(false);
-        gfj->giveBandwidthQuota(quotaPerJob);
-        qCDebug(lcBandwidthManager) << "Gave" << quotaPerJob / 1024.0 << "kB to" << gfj;
-    }
-    _relativeLimitCurrentMeasuredDevice = 0;
+    _roundShare = qMax(minShare, _milliTokens / 1000 / qMax(1, _waiting.size()));
+    for (auto *consumer : woken)
+        _consumers[consumer].woken = true;
+    return woken;
 }
 
-void BandwidthManager::relativeDownloadDelayTimerExpired()
+BandwidthManager::BandwidthManager(OwncloudPropagator *p)
+    : QObject()
+    , _propagator(p)
+{
+    _clock.start();
+    QObject::connect(&_roundTimer, &QTimer::timeout, this, &BandwidthManager::roundTimerExpired);
+    _roundTimer.setInterval(BandwidthLimiter::roundMsec());
+}
+
+BandwidthManager::~BandwidthManager()
 {
-    // Switch to measuring state
-    _relativeDownloadMeasuringTimer.start(); // always start to continue the cycle
+}
 
-    if (!usingRelativeDownloadLimit()) {
-        return; // oh, not actually needed
+void BandwidthManager::updateLimits()
+{
+    const qint64 burstMsec = _propagator->syncOptions()._bandwidthBurst.count();
+    const qint64 now = _clock.elapsed();
+
+    const qint64 newUploadLimit = _propagator->_uploadLimit.fetchAndAddAcquire(0);
+    const bool uploadLimitChanged = newUploadLimit != _upload.limit();
+    if (uploadLimitChanged)
+        qCInfo(lcBandwidthManager) << "Upload Bandwidth limit changed" << _upload.limit() << newUploadLimit;
+    _upload.setLimit(newUploadLimit, burstMsec, now);
+    if (uploadLimitChanged) {
+        Q_FOREACH (UploadDevice *ud, _uploadDeviceList) {
+            ud->setBandwidthLimited(_upload.isLimited());
+        }
     }
 
-    if (_downloadJobList.isEmpty()) {
-        qCDebug(lcBandwidthManager) << _downloadJobList.count() << "No jobs?";
-        return;
+    const qint64 newDownloadLimit = _propagator->_downloadLimit.fetchAndAddAcquire(0);
+    const bool downloadLimitChanged = newDownloadLimit != _download.limit();
+    if (downloadLimitChanged)
+        qCInfo(lcBandwidthManager) << "Download Bandwidth limit changed" << _download.limit() << newDownloadLimit;
+    _download.setLimit(newDownloadLimit, burstMsec, now);
+    if (downloadLimitChanged) {
+        Q_FOREACH (GETJob *j, _downloadJobList) {
+            j->setBandwidthLimited(_download.isLimited());
+        }
     }
+}
 
-    qCDebug(lcBandwidthManager) << _downloadJobList.count() << "Starting measuring";
+void BandwidthManager::registerUploadDevice(UploadDevice *p)
+{
+    _uploadDeviceList.append(p);
+    _upload.addConsumer(p);
+    QObject::connect(p, &QObject::destroyed, this, &BandwidthManager::unregisterUploadDevice);
 
-    // Take first device and then append it again (= we round robin all devices)
-    _relativeLimitCurrentMeasuredJob = _downloadJobList.takeFirst();
-    _downloadJobList.append(_relativeLimitCurrentMeasuredJob);
+    p->setBandwidthLimited(_upload.isLimited());
+}
 
-    _relativeDownloadLimitProgressAtMeasuringRestart = _relativeLimitCurrentMeasuredJob->currentDownloadPosition();
-    _relativeLimitCurrentMeasuredJob->setBandwidthLimited(false);
-    _relativeLimitCurrentMeasuredJob->setChoked(false);
+void BandwidthManager::unregisterUploadDevice(QObject *o)
+{
+    auto p = reinterpret_cast<UploadDevice *>(o); // note, we might already be in the ~QObject
+    _uploadDeviceList.removeAll(p);
+    _upload.removeConsumer(o);
+}
 
-    // choke all other download jobs
-    Q_FOREACH (GETJob *gfj, _downloadJobList) {
-        if (gfj != _relativeLimitCurrentMeasuredJob) {
-            gfj->setBandwidthLimited(true);
-            gfj->setChoked(true);
-        }
-    }
+void BandwidthManager::registerDownloadJob(GETJob *j)
+{
+    _downloadJobList.append(j);
+    _download.addConsumer(j);
+    QObject::connect(j, &QObject::destroyed, this, &BandwidthManager::unregisterDownloadJob);
 
-    // now we're in measuring state
+    j->setBandwidthLimited(_download.isLimited());
 }
 
-// end downloads
+void BandwidthManager::unregisterDownloadJob(QObject *o)
+{
+    GETJob *j = reinterpret_cast<GETJob *>(o); // note, we might already be in the ~QObject
+    _downloadJobList.removeAll(j);
+    _download.removeConsumer(o);
+}
 
-void BandwidthManager::switchingTimerExpired()
+qint64 BandwidthManager::takeUploadQuota(UploadDevice *device, qint64 wanted)
 {
-    qint64 newUploadLimit = _propagator->_uploadLimit.fetchAndAddAcquire(0);
-    if (newUploadLimit != _currentUploadLimit) {
-        qCInfo(lcBandwidthManager) << "Upload Bandwidth limit changed" << _currentUploadLimit << newUploadLimit;
-        _currentUploadLimit = newUploadLimit;
-        Q_FOREACH (UploadDevice *ud, _relativeUploadDeviceList) {
-            if (newUploadLimit == 0) {
-                ud->setBandwidthLimited(false);
-                ud->setChoked(false);
-            } else if (newUploadLimit > 0) {
-                ud->setBandwidthLimited(true);
-                ud->setChoked(false);
-            } else if (newUploadLimit < 0) {
-                ud->setBandwidthLimited(true);
-                ud->setChoked(true);
-            }
-        }
-    }
-    qint64 newDownloadLimit = _propagator->_downloadLimit.fetchAndAddAcquire(0);
-    if (newDownloadLimit != _currentDownloadLimit) {
-        qCInfo(lcBandwidthManager) << "Download Bandwidth limit changed" << _currentDownloadLimit << newDownloadLimit;
-        _currentDownloadLimit = newDownloadLimit;
-        Q_FOREACH (GETJob *j, _downloadJobList) {
-            if (usingAbsoluteDownloadLimit()) {
-                j->setBandwidthLimited(true);
-                j->setChoked(false);
-            } else if (usingRelativeDownloadLimit()) {
-                j->setBandwidthLimited(true);
-                j->setChoked(true);
-            } else {
-                j->setBandwidthLimited(false);
-                j->setChoked(false);
-            }
-        }
-    }
+    qint64 quota = _upload.take(device, wanted, _clock.elapsed());
+    if (quota == 0)
+        startRoundTimer();
+    return quota;
 }
 
-void BandwidthManager::absoluteLimitTimerExpired()
+qint64 BandwidthManager::takeDownloadQuota(GETJob *job, qint64 wanted)
 {
-    if (usingAbsoluteUploadLimit() && _absoluteUploadDeviceList.count() > 0) {
-        qint64 quotaPerDevice = _currentUploadLimit / qMax(1, _absoluteUploadDeviceList.count());
-        qCDebug(lcBandwidthManager) << quotaPerDevice << _absoluteUploadDeviceList.count() << _currentUploadLimit;
-        Q_FOREACH (UploadDevice *device, _absoluteUploadDeviceList) {
-            device->giveBandwidthQuota(quotaPerDevice);
-            qCDebug(lcBandwidthManager) << "Gave " << quotaPerDevice / 1024.0 << " kB to" << device;
-        }
+    qint64 quota = _download.take(job, wanted, _clock.elapsed());
+    if (quota == 0)
+        startRoundTimer();
+    return quota;
+}
+
+void BandwidthManager::startRoundTimer()
+{
+    if (!_roundTimer.isActive())
+        _roundTimer.start();
+}
+
+void BandwidthManager::roundTimerExpired()
+{
+    const qint64 now = _clock.elapsed();
+    Q_FOREACH (QObject *device, _upload.nextRound(now)) {
+        QMetaObject::invokeMethod(device, "readyRead", Qt::QueuedConnection); // tell QNAM that we have quota
     }
-    if (usingAbsoluteDownloadLimit() && _downloadJobList.count() > 0) {
-        qint64 quotaPerJob = _currentDownloadLimit / qMax(1, _downloadJobList.count());
-        qCDebug(lcBandwidthManager) << quotaPerJob << _downloadJobList.count() << _currentDownloadLimit;
-        Q_FOREACH (GETJob *j, _downloadJobList) {
-            j->giveBandwidthQuota(quotaPerJob);
-            qCDebug(lcBandwidthManager) << "Gave " << quotaPerJob / 1024.0 << " kB to" << j;
-        }
+    Q_FOREACH (QObject *job, _download.nextRound(now)) {
+        QMetaObject::invokeMethod(job, "slotReadyRead", Qt::QueuedConnection);
     }
+    if (!_upload.hasWaiting() && !_download.hasWaiting())
+        _roundTimer.stop();
 }
 }
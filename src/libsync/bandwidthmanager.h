@@ -15,9 +15,14 @@
 #ifndef BANDWIDTHMANAGER_H
 #define BANDWIDTHMANAGER_H
 
+#include "owncloudlib.h"
+
 #include <QObject>
 #include <QLinkedList>
+#include <QHash>
+#include <QList>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QIODevice>
 
 namespace OCC {
@@ -26,8 +31,109 @@ class UploadDevice;
 class GETJob;
 class OwncloudPropagator;
 
+/**
+ * @brief Token bucket limiting the transfers of one direction
+ *
+ * Tokens (bytes) accumulate at rate() per second, up to burst(). Every
+ * consumer takes tokens from the same bucket right before it moves data,
+ * so any number of transfers can run at the same time.
+ *
+ * When a consumer gets nothing, it is put on a wait list. nextRound() is
+ * called every roundMsec() while someone waits: it divides the available
+ * tokens by the number of waiting consumers, and during that round a consumer
+ * may take no more than this share while others wait or take tokens too.
+ * A consumer without competition may take all tokens.
+ *
+ * A negative limit is a percentage of the measured link capacity: the bucket
+ * is opened for probeMsec() to measure what the transfers achieve, and the
+ * rate for the rest of relativePeriodMsec() is chosen so that the whole
+ * period averages to the percentage.
+ *
+ * Time is passed in by the caller.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT BandwidthLimiter
+{
+public:
+    /** limit > 0 is in bytes per second, < 0 a percentage, 0 means unlimited
+     *
+     * burstMsec is how many msec worth of the rate may accumulate while
+     * the consumers are idle.
+     */
+    void setLimit(qint64 limit, qint64 burstMsec, qint64 nowMsec);
+    qint64 limit() const { return _limit; }
+
+    /// Whether the consumers have to take() tokens
+    bool isLimited() const { return _limit != 0; }
+
+    /// The current rate in bytes per second, 0 while not throttled
+    qint64 rate() const { return _rate; }
+    qint64 burst() const { return _burst; }
+
+    void addConsumer(QObject *consumer);
+    void removeConsumer(QObject *consumer);
+    int consumerCount() const { return _consumers.size(); }
+
+    /** Takes up to wanted bytes for the consumer
+     *
+     * Returns 0 if the consumer has to wait until nextRound() wakes it up.
+     */
+    qint64 take(QObject *consumer, qint64 wanted, qint64 nowMsec);
+
+    /// Starts a new round and returns the waiting consumers in the order they should retry
+    QList<QObject *> nextRound(qint64 nowMsec);
+    bool hasWaiting() const { return !_waiting.isEmpty(); }
+
+    /// Total bytes taken so far
+    qint64 transferred() const { return _transferred; }
+
+    static qint64 roundMsec() { return 100; }
+    static qint64 probeMsec() { return 2000; }
+    static qint64 relativePeriodMsec() { return 40000; }
+
+private:
+    struct Consumer
+    {
+        qint64 takenThisRound = 0;
+        bool waiting = false;
+        bool woken = false; // woken by the last round and didn't ask since
+    };
+
+    void advance(qint64 nowMsec);
+    void advanceRelative(qint64 nowMsec);
+    void setRate(qint64 rate);
+    void startProbe(qint64 nowMsec);
+    void wait(QObject *consumer, Consumer &c);
+
+    qint64 _limit = 0;
+    qint64 _burstMsec = 0;
+    qint64 _rate = 0;
+    qint64 _burst = 0;
+    qint64 _milliTokens = 0; // tokens * 1000, keeps the fractions of a byte between refills
+    qint64 _lastRefillMsec = -1;
+
+    QHash<QObject *, Consumer> _consumers;
+    QList<QObject *> _waiting;
+    qint64 _roundShare = 0;
+    int _activeThisRound = 0; // consumers that took something since the last round
+
+    qint64 _transferred = 0;
+
+    // for relative limits
+    bool _probing = false;
+    qint64 _phaseStartMsec = 0;
+    qint64 _phaseStartTransferred = 0;
+    qint64 _phaseEndMsec = 0;
+    qint64 _capacity = 0;
+};
+
 /**
  * @brief The BandwidthManager class
+ *
+ * Throttles the uploads and downloads of one propagator with a
+ * BandwidthLimiter per direction.
+ *
  * @ingroup libsync
  */
 class BandwidthManager : public QObject
@@ -37,11 +143,16 @@ public:
     BandwidthManager(OwncloudPropagator *p);
     ~BandwidthManager();
 
-    bool usingAbsoluteUploadLimit() { return _currentUploadLimit > 0; }
-    bool usingRelativeUploadLimit() { return _currentUploadLimit < 0; }
-    bool usingAbsoluteDownloadLimit() { return _currentDownloadLimit > 0; }
-    bool usingRelativeDownloadLimit() { return _currentDownloadLimit < 0; }
+    bool usingUploadLimit() const { return _upload.isLimited(); }
+    bool usingDownloadLimit() const { return _download.isLimited(); }
+
+    /// Applies the limits and the burst currently set on the propagator
+    void updateLimits();
 
+    /// Returns how many of the wanted bytes may be sent now, 0 means wait for readyRead()
+    qint64 takeUploadQuota(UploadDevice *device, qint64 wanted);
+    /// Returns how many of the wanted bytes may be read now, 0 means wait for slotReadyRead()
+    qint64 takeDownloadQuota(GETJob *job, qint64 wanted);
 
 public slots:
     void registerUploadDevice(UploadDevice *);
@@ -50,55 +161,24 @@ public slots:
     void registerDownloadJob(GETJob *);
     void unregisterDownloadJob(QObject *);
 
-    void absoluteLimitTimerExpired();
-    void switchingTimerExpired();
-
-    void relativeUploadMeasuringTimerExpired();
-    void relativeUploadDelayTimerExpired();
-
-    void relativeDownloadMeasuringTimerExpired();
-    void relativeDownloadDelayTimerExpired();
+private slots:
+    void roundTimerExpired();
 
 private:
-    // for switching between absolute and relative bw limiting
-    QTimer _switchingTimer;
+    void startRoundTimer();
 
-    // FIXME this timer and this variable should be replaced
-    // by the propagator emitting the changed limit values to us as signal
     OwncloudPropagator *_propagator;
 
-    // for absolute up/down bw limiting
-    QTimer _absoluteLimitTimer;
-
-    // FIXME merge these two lists
-    QLinkedList<UploadDevice *> _absoluteUploadDeviceList;
-    QLinkedList<UploadDevice *> _relativeUploadDeviceList;
+    QElapsedTimer _clock;
 
-    QTimer _relativeUploadMeasuringTimer;
+    // only runs while some transfer waits for tokens
+    QTimer _roundTimer;
 
-    // for relative bw limiting, we need to wait this amount before measuring again
-    QTimer _relativeUploadDelayTimer;
-
-    // the device measured
-    UploadDevice *_relativeLimitCurrentMeasuredDevice;
-
-    // for measuring how much progress we made at start
-    qint64 _relativeUploadLimitProgressAtMeasuringRestart;
-    qint64 _currentUploadLimit;
+    BandwidthLimiter _upload;
+    QLinkedList<UploadDevice *> _uploadDeviceList;
 
+    BandwidthLimiter _download;
     QLinkedList<GETJob *> _downloadJobList;
-    QTimer _relativeDownloadMeasuringTimer;
-
-    // for relative bw limiting, we need to wait this amount before measuring again
-    QTimer _relativeDownloadDelayTimer;
-
-    // the device measured
-    GETJob *_relativeLimitCurrentMeasuredJob;
-
-    // for measuring how much progress we made at start
-    qint64 _relativeDownloadLimitProgressAtMeasuringRestart;
-
-    qint64 _currentDownloadLimit;
 };
 }
 
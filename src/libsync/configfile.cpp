@@ -67,6 +67,8 @@ static const char chunkSizeC[] = "chunkSize";
 static const char minChunkSizeC[] = "minChunkSize";
 static const char maxChunkSizeC[] = "maxChunkSize";
 static const char targetChunkUploadDurationC[] = "targetChunkUploadDuration";
+static const char parallelChunkUploadsC[] = "parallelChunkUploads";
+static const char maxConcurrentSyncsC[] = "maxConcurrentSyncs";
 static const char automaticLogDirC[] = "logToTemporaryLogDir";
 static const char deleteOldLogsAfterHoursC[] = "temporaryLogDirDeleteOldLogsAfterHours";
 static const char showExperimentalOptionsC[] = "showExperimentalOptions";
@@ -193,6 +195,18 @@ chrono::milliseconds ConfigFile::targetChunkUploadDuration() const
     return millisecondsValue(settings, targetChunkUploadDurationC, chrono::minutes(1));
 }
 
+int ConfigFile::parallelChunkUploads() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(parallelChunkUploadsC), 1).toInt(); // default to one chunk at a time
+}
+
+int ConfigFile::maxConcurrentSyncs() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return qMax(1, settings.value(QLatin1String(maxConcurrentSyncsC), 3).toInt());
+}
+
 void ConfigFile::setOptionalDesktopNotifications(bool show)
 {
     QSettings settings(configFile(), QSettings::IniFormat);
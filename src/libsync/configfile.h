@@ -160,6 +160,10 @@ public:
     qint64 maxChunkSize() const;
     qint64 minChunkSize() const;
     std::chrono::milliseconds targetChunkUploadDuration() const;
+    int parallelChunkUploads() const;
+
+    /** How many folders may sync at the same time */
+    int maxConcurrentSyncs() const;
 
     void saveGeometry(QWidget *w);
     void restoreGeometry(QWidget *w);
@@ -68,77 +68,134 @@ void ProcessDirectoryJob::process()
 {
     ASSERT(_localQueryDone && _serverQueryDone);
 
-    QString localDir;
-
     //
-    // Build lookup tables for local, remote and db entries.
+    // Merge the server, db and local entries by name.
+    // Each list is sorted on its own and then walked in a single pass, which is
+    // a lot cheaper than collecting them in a map for large directories.
     // For suffix-virtual files, the key will always be the base file name
     // without the suffix.
     //
-    struct Entries {
-        SyncJournalFileRecord dbEntry;
-        RemoteInfo serverEntry;
-        LocalInfo localEntry;
-    };
-    std::map<QString, Entries> entries;
-    for (auto &e : _serverNormalQueryEntries) {
-        entries[e.name].serverEntry = std::move(e);
-    }
+    auto serverEntries = std::move(_serverNormalQueryEntries);
     _serverNormalQueryEntries.clear();
+    std::stable_sort(serverEntries.begin(), serverEntries.end(),
+        [](const RemoteInfo &a, const RemoteInfo &b) { return a.name < b.name; });
 
     // fetch all the name from the DB
+    struct DbEntry
+    {
+        QString name;
+        SyncJournalFileRecord record;
+    };
+    std::vector<DbEntry> dbEntries;
     auto pathU8 = _currentFolder._original.toUtf8();
     if (!_discoveryData->_statedb->listFilesInPath(pathU8, [&](const SyncJournalFileRecord &rec) {
             auto name = pathU8.isEmpty() ? rec._path : QString::fromUtf8(rec._path.constData() + (pathU8.size() + 1));
             if (rec.isVirtualFile() && isVfsWithSuffix())
                 chopVirtualFileSuffix(name);
-            auto &dbEntry = entries[name].dbEntry;
-            dbEntry = rec;
-            setupDbPinStateActions(dbEntry);
+            dbEntries.push_back({ name, rec });
+            setupDbPinStateActions(dbEntries.back().record);
         })) {
         dbError();
         return;
     }
+    std::stable_sort(dbEntries.begin(), dbEntries.end(),
+        [](const DbEntry &a, const DbEntry &b) { return a.name < b.name; });
+
+    auto hasServerOrDbEntry = [&](const QString &name) {
+        auto s = std::lower_bound(serverEntries.cbegin(), serverEntries.cend(), name,
+            [](const RemoteInfo &e, const QString &n) { return e.name < n; });
+        if (s != serverEntries.cend() && s->name == name)
+            return true;
+        auto d = std::lower_bound(dbEntries.cbegin(), dbEntries.cend(), name,
+            [](const DbEntry &e, const QString &n) { return e.name < n; });
+        return d != dbEntries.cend() && d->name == name;
+    };
 
-    for (auto &e : _localNormalQueryEntries) {
+    auto localQueryEntries = std::move(_localNormalQueryEntries);
+    _localNormalQueryEntries.clear();
+    struct LocalEntry
+    {
+        QString name;
+        const LocalInfo *info;
+    };
+    std::vector<LocalEntry> localEntries;
+    localEntries.reserve(localQueryEntries.size());
+    for (const auto &e : localQueryEntries) {
         // Normally for vfs-suffix files the local entries need the suffix removed.
         // However, don't do it if "foo.owncloud" exists on the server or in the db
         // (as a non-virtual file): we don't want to create two entries.
         auto name = e.name;
-        if (e.isVirtualFile && isVfsWithSuffix() && entries.find(name) == entries.end()) {
+        if (e.isVirtualFile && isVfsWithSuffix() && !hasServerOrDbEntry(name))
             chopVirtualFileSuffix(name);
-            // If there is both a virtual file and a real file, we must keep the real file
-            if (entries[name].localEntry.isValid())
-                continue;
-        }
-        entries[name].localEntry = std::move(e);
+        localEntries.push_back({ name, &e });
     }
-    _localNormalQueryEntries.clear();
+    // If there is both a virtual file and a real file, we must keep the real
+    // file: sort it first and skip the other one below.
+    std::sort(localEntries.begin(), localEntries.end(), [](const LocalEntry &a, const LocalEntry &b) {
+        if (a.name != b.name)
+            return a.name < b.name;
+        return !a.info->isVirtualFile && b.info->isVirtualFile;
+    });
 
     //
     // Iterate over entries and process them
     //
-    for (const auto &f : entries) {
-        const auto &e = f.second;
+    const RemoteInfo noServerEntry;
+    const SyncJournalFileRecord noDbEntry;
+    const LocalInfo noLocalEntry;
+    size_t serverIndex = 0, dbIndex = 0, localIndex = 0;
+    while (serverIndex < size_t(serverEntries.size()) || dbIndex < dbEntries.size() || localIndex < localEntries.size()) {
+        // The smallest name of the three lists is the next entry
+        QString name;
+        bool haveName = false;
+        auto consider = [&](const QString &candidate) {
+            if (!haveName || candidate < name) {
+                name = candidate;
+                haveName = true;
+            }
+        };
+        if (serverIndex < size_t(serverEntries.size()))
+            consider(serverEntries[serverIndex].name);
+        if (dbIndex < dbEntries.size())
+            consider(dbEntries[dbIndex].name);
+        if (localIndex < localEntries.size())
+            consider(localEntries[localIndex].name);
+
+        // When a name appears several times in the server or db list, the last one wins
+        const RemoteInfo *serverMatch = &noServerEntry;
+        while (serverIndex < size_t(serverEntries.size()) && serverEntries[serverIndex].name == name)
+            serverMatch = &serverEntries[serverIndex++];
+        const SyncJournalFileRecord *dbMatch = &noDbEntry;
+        while (dbIndex < dbEntries.size() && dbEntries[dbIndex].name == name)
+            dbMatch = &dbEntries[dbIndex++].record;
+        const LocalInfo *localMatch = &noLocalEntry;
+        if (localIndex < localEntries.size() && localEntries[localIndex].name == name) {
+            localMatch = localEntries[localIndex].info;
+            while (localIndex < localEntries.size() && localEntries[localIndex].name == name)
+                localIndex++;
+        }
+        const auto &serverEntry = *serverMatch;
+        const auto &dbEntry = *dbMatch;
+        const auto &localEntry = *localMatch;
 
         PathTuple path;
-        path = _currentFolder.addName(f.first);
+        path = _currentFolder.addName(name);
 
         if (isVfsWithSuffix()) {
             // If the file is virtual in the db, adjust path._original
-            if (e.dbEntry.isVirtualFile()) {
-                ASSERT(hasVirtualFileSuffix(e.dbEntry._path));
+            if (dbEntry.isVirtualFile()) {
+                ASSERT(hasVirtualFileSuffix(dbEntry._path));
                 addVirtualFileSuffix(path._original);
-            } else if (e.localEntry.isVirtualFile && !e.dbEntry.isValid()) {
+            } else if (localEntry.isVirtualFile && !dbEntry.isValid()) {
                 // We don't have a db entry - but it should be at this path
                 addVirtualFileSuffix(path._original);
             }
 
             // If the file is virtual locally, adjust path._local
-            if (e.localEntry.isVirtualFile) {
-                ASSERT(hasVirtualFileSuffix(e.localEntry.name));
+            if (localEntry.isVirtualFile) {
+                ASSERT(hasVirtualFileSuffix(localEntry.name));
                 addVirtualFileSuffix(path._local);
-            } else if (e.dbEntry.isVirtualFile() && _queryLocal == ParentNotChanged) {
+            } else if (dbEntry.isVirtualFile() && _queryLocal == ParentNotChanged) {
                 addVirtualFileSuffix(path._local);
             }
         }
@@ -147,17 +204,17 @@ void ProcessDirectoryJob::process()
         // For windows, the hidden state is also discovered within the vio
         // local stat function.
         // Recall file shall not be ignored (#4420)
-        bool isHidden = e.localEntry.isHidden || (f.first[0] == '.' && f.first != QLatin1String(".sys.admin#recall#"));
-        if (handleExcluded(path._target, e.localEntry.name,
-                e.localEntry.isDirectory || e.serverEntry.isDirectory, isHidden,
-                e.localEntry.isSymLink))
+        bool isHidden = localEntry.isHidden || (name[0] == '.' && name != QLatin1String(".sys.admin#recall#"));
+        if (handleExcluded(path._target, localEntry.name,
+                localEntry.isDirectory || serverEntry.isDirectory, isHidden,
+                localEntry.isSymLink))
             continue;
 
         if (_queryServer == InBlackList || _discoveryData->isInSelectiveSyncBlackList(path._original)) {
-            processBlacklisted(path, e.localEntry, e.dbEntry);
+            processBlacklisted(path, localEntry, dbEntry);
             continue;
         }
-        processFile(std::move(path), e.localEntry, e.serverEntry, e.dbEntry);
+        processFile(std::move(path), localEntry, serverEntry, dbEntry);
     }
     QTimer::singleShot(0, _discoveryData, &DiscoveryPhase::scheduleMoreJobs);
 }
@@ -602,7 +659,7 @@ void ProcessDirectoryJob::processFileAnalyzeRemoteInfo(
             async = true;
         }
     };
-    if (!_discoveryData->_statedb->getFileRecordsByFileId(serverEntry.fileId, renameCandidateProcessing)) {
+    if (!_discoveryData->renameCandidates().getFileRecordsByFileId(serverEntry.fileId, renameCandidateProcessing)) {
         dbError();
         return;
     }
@@ -839,7 +896,7 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
 
     // Check if it is a move
     OCC::SyncJournalFileRecord base;
-    if (!_discoveryData->_statedb->getFileRecordByInode(localEntry.inode, &base)) {
+    if (!_discoveryData->renameCandidates().getFileRecordByInode(localEntry.inode, &base)) {
         dbError();
         return;
     }
@@ -1298,7 +1355,7 @@ void ProcessDirectoryJob::subJobFinished()
     QTimer::singleShot(0, _discoveryData, &DiscoveryPhase::scheduleMoreJobs);
 }
 
-int ProcessDirectoryJob::processSubJobs(int nbJobs)
+void ProcessDirectoryJob::processSubJobs(int &networkJobs, int &localJobs)
 {
     if (_queuedJobs.empty() && _runningJobs.empty() && _pendingAsyncJobs == 0) {
         _pendingAsyncJobs = -1; // We're finished, we don't want to emit finished again
@@ -1324,21 +1381,27 @@ int ProcessDirectoryJob::processSubJobs(int nbJobs)
         emit finished();
     }
 
-    int started = 0;
     foreach (auto *rj, _runningJobs) {
-        started += rj->processSubJobs(nbJobs - started);
-        if (started >= nbJobs)
-            return started;
+        rj->processSubJobs(networkJobs, localJobs);
+        if (networkJobs <= 0 && localJobs <= 0)
+            return;
     }
 
-    while (started < nbJobs && !_queuedJobs.empty()) {
-        auto f = _queuedJobs.front();
-        _queuedJobs.pop_front();
+    // Directories that only need a local scan aren't held back by the
+    // network job limit, so skip over queued jobs we have no budget for.
+    auto it = _queuedJobs.begin();
+    while (it != _queuedJobs.end() && (networkJobs > 0 || localJobs > 0)) {
+        auto f = *it;
+        int &budget = f->_queryServer == NormalQuery ? networkJobs : localJobs;
+        if (budget <= 0) {
+            ++it;
+            continue;
+        }
+        --budget;
+        it = _queuedJobs.erase(it);
         _runningJobs.push_back(f);
         f->start();
-        started++;
     }
-    return started;
 }
 
 void ProcessDirectoryJob::dbError()
@@ -1430,7 +1493,7 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
     QString localPath = _discoveryData->_localDir + _currentFolder._local;
     auto localJob = new DiscoverySingleLocalDirectoryJob(_discoveryData->_account, localPath, _discoveryData->_syncOptions._vfs.data());
 
-    _discoveryData->_currentlyActiveJobs++;
+    _discoveryData->_currentlyActiveLocalJobs++;
     _pendingAsyncJobs++;
 
     connect(localJob, &DiscoverySingleLocalDirectoryJob::itemDiscovered, _discoveryData, &DiscoveryPhase::itemDiscovered);
@@ -1440,14 +1503,14 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
     });
 
     connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedFatalError, this, [this](const QString &msg) {
-        _discoveryData->_currentlyActiveJobs--;
+        _discoveryData->_currentlyActiveLocalJobs--;
         _pendingAsyncJobs--;
 
         emit _discoveryData->fatalError(msg);
     });
 
     connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedNonFatalError, this, [this](const QString &msg) {
-        _discoveryData->_currentlyActiveJobs--;
+        _discoveryData->_currentlyActiveLocalJobs--;
         _pendingAsyncJobs--;
 
         if (_dirItem) {
@@ -1461,7 +1524,7 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
     });
 
     connect(localJob, &DiscoverySingleLocalDirectoryJob::finished, this, [this](const auto &results) {
-        _discoveryData->_currentlyActiveJobs--;
+        _discoveryData->_currentlyActiveLocalJobs--;
         _pendingAsyncJobs--;
 
         _localNormalQueryEntries = results;
@@ -1471,8 +1534,7 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
             this->process();
     });
 
-    QThreadPool *pool = QThreadPool::globalInstance();
-    pool->start(localJob); // QThreadPool takes ownership
+    DiscoveryPhase::localScanPool()->start(localJob); // QThreadPool takes ownership
 }
 
 
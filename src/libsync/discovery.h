@@ -85,8 +85,13 @@ public:
     }
 
     void start();
-    /** Start up to nbJobs, return the number of job started; emit finished() when done */
-    int processSubJobs(int nbJobs);
+    /** Start queued sub-jobs within the given budgets; emit finished() when done
+     *
+     * Jobs that query the server take from networkJobs, jobs that only read the
+     * local directory take from localJobs. Both budgets are decremented for the
+     * started jobs.
+     */
+    void processSubJobs(int &networkJobs, int &localJobs);
 
     SyncFileItemPtr _dirItem;
 
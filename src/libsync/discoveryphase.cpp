@@ -18,6 +18,7 @@
 #include "account.h"
 #include "common/asserts.h"
 #include "common/checksums.h"
+#include "common/syncjournaldb.h"
 
 #include <csync_exclude.h>
 #include "vio/csync_vio_local.h"
@@ -27,6 +28,7 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QTextCodec>
+#include <QThread>
 #include <cstring>
 
 
@@ -110,6 +112,7 @@ void DiscoveryPhase::checkSelectiveSyncNewFolder(const QString &path, RemotePerm
 
     // do a PROPFIND to know the size of this folder
     auto propfindJob = new PropfindJob(_account, _remoteFolder + path, this);
+    propfindJob->setNetworkJobClass(NetworkJobClass::Discovery);
     propfindJob->setProperties(QList<QByteArray>() << "resourcetype"
                                                    << "http://owncloud.org/ns:size");
     QObject::connect(propfindJob, &PropfindJob::finishedWithError,
@@ -174,6 +177,13 @@ QPair<bool, QByteArray> DiscoveryPhase::findAndCancelDeletedJob(const QString &o
     return { result, oldEtag };
 }
 
+RenameCandidateIndex &DiscoveryPhase::renameCandidates()
+{
+    if (!_renameCandidates)
+        _renameCandidates.reset(new RenameCandidateIndex(_statedb));
+    return *_renameCandidates;
+}
+
 void DiscoveryPhase::startJob(ProcessDirectoryJob *job)
 {
     ENFORCE(!_currentRootJob);
@@ -209,11 +219,28 @@ void DiscoveryPhase::setSelectiveSyncWhiteList(const QStringList &list)
     std::sort(_selectiveSyncWhiteList.begin(), _selectiveSyncWhiteList.end());
 }
 
+Q_GLOBAL_STATIC(QThreadPool, discoveryLocalScanPool)
+
+QThreadPool *DiscoveryPhase::localScanPool()
+{
+    auto pool = discoveryLocalScanPool();
+    static bool initialized = [pool] {
+        pool->setMaxThreadCount(qBound(2, QThread::idealThreadCount(), 8));
+        return true;
+    }();
+    Q_UNUSED(initialized);
+    return pool;
+}
+
 void DiscoveryPhase::scheduleMoreJobs()
 {
     auto limit = qMax(1, _syncOptions._parallelNetworkJobs);
-    if (_currentRootJob && _currentlyActiveJobs < limit) {
-        _currentRootJob->processSubJobs(limit - _currentlyActiveJobs);
+    // Keep a few scans queued so the threads don't wait for the main thread
+    auto localLimit = 2 * localScanPool()->maxThreadCount();
+    int networkJobs = limit - _currentlyActiveJobs;
+    int localJobs = localLimit - _currentlyActiveLocalJobs;
+    if (_currentRootJob && (networkJobs > 0 || localJobs > 0)) {
+        _currentRootJob->processSubJobs(networkJobs, localJobs);
     }
 }
 
@@ -303,6 +330,7 @@ void DiscoverySingleDirectoryJob::start()
 {
     // Start the actual HTTP job
     LsColJob *lsColJob = new LsColJob(_account, _subPath, this);
+    lsColJob->setNetworkJobClass(NetworkJobClass::Discovery);
 
     QList<QByteArray> props;
     props << "resourcetype"
@@ -478,4 +506,74 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot(QNetworkReply *r)
     emit finished(HttpError{ httpCode, msg });
     deleteLater();
 }
+
+RenameCandidateIndex::RenameCandidateIndex(SyncJournalDb *journal)
+    : _journal(journal)
+{
+}
+
+bool RenameCandidateIndex::ensureBuilt()
+{
+    if (_built)
+        return true;
+    if (_buildFailed || ++_lookups <= _directLookupLimit)
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = _journal->listFileIdentities([this](qint64 phash, quint64 inode, const QByteArray &fileId) {
+        // Like the query in getFileRecordByInode(), the first record wins
+        if (inode && !_phashByInode.contains(inode))
+            _phashByInode.insert(inode, phash);
+        if (!fileId.isEmpty())
+            _phashByFileIdHash.insert(qHash(fileId), phash);
+    });
+    if (!ok) {
+        qCWarning(lcDiscovery) << "Could not read the file identities, using the journal for rename candidates";
+        _phashByInode.clear();
+        _phashByFileIdHash.clear();
+        _buildFailed = true;
+        return false;
+    }
+    _built = true;
+    qCInfo(lcDiscovery) << "Indexed" << _phashByInode.size() << "inodes and" << _phashByFileIdHash.size()
+                        << "file ids for rename detection in" << timer.elapsed() << "ms";
+    return true;
+}
+
+bool RenameCandidateIndex::getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec)
+{
+    if (!ensureBuilt())
+        return _journal->getFileRecordByInode(inode, rec);
+
+    Q_ASSERT(rec);
+    *rec = SyncJournalFileRecord();
+    auto it = _phashByInode.constFind(inode);
+    if (!inode || it == _phashByInode.constEnd())
+        return true;
+    if (!_journal->getFileRecordByPHash(*it, rec))
+        return false;
+    if (rec->_inode != inode)
+        *rec = SyncJournalFileRecord(); // the record changed since the index was built
+    return true;
+}
+
+bool RenameCandidateIndex::getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    if (!ensureBuilt())
+        return _journal->getFileRecordsByFileId(fileId, rowCallback);
+
+    if (fileId.isEmpty())
+        return true;
+    // values() returns the most recently inserted first, report them in journal order
+    const auto phashes = _phashByFileIdHash.values(qHash(fileId));
+    for (auto it = phashes.crbegin(); it != phashes.crend(); ++it) {
+        SyncJournalFileRecord rec;
+        if (!_journal->getFileRecordByPHash(*it, &rec))
+            return false;
+        if (rec.isValid() && rec._fileId == fileId)
+            rowCallback(rec);
+    }
+    return true;
+}
 }
@@ -20,12 +20,15 @@
 #include <csync.h>
 #include <QMap>
 #include <QSet>
+#include <QHash>
 #include "networkjobs.h"
 #include <QMutex>
 #include <QWaitCondition>
 #include <QLinkedList>
 #include <QRunnable>
+#include <QThreadPool>
 #include <deque>
+#include <memory>
 #include "syncoptions.h"
 #include "syncfileitem.h"
 
@@ -41,6 +44,7 @@ enum class LocalDiscoveryStyle {
 
 class Account;
 class SyncJournalDb;
+class SyncJournalFileRecord;
 class ProcessDirectoryJob;
 
 /**
@@ -152,6 +156,51 @@ public:
     QByteArray _dataFingerprint;
 };
 
+/**
+ * @brief Answers the rename candidate lookups of the discovery
+ *
+ * The discovery looks up journal entries by inode (local moves) and by file id
+ * (remote moves) for every new file. On large trees with many new files this is
+ * one indexed query per file. Once more than directLookupLimit() lookups were
+ * made, the (phash, inode, fileid) triplets of the whole journal are read once
+ * and later lookups only fetch the matching record by its primary key.
+ *
+ * The index only holds phashes: records are always re-read from the journal and
+ * checked against the looked up inode or file id.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT RenameCandidateIndex
+{
+public:
+    explicit RenameCandidateIndex(SyncJournalDb *journal);
+
+    /// Same as SyncJournalDb::getFileRecordByInode()
+    bool getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec);
+
+    /// Same as SyncJournalDb::getFileRecordsByFileId()
+    bool getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+
+    /// Number of lookups that are forwarded to the journal before the index is built
+    int directLookupLimit() const { return _directLookupLimit; }
+    void setDirectLookupLimit(int limit) { _directLookupLimit = limit; }
+
+    bool isBuilt() const { return _built; }
+
+private:
+    /// Returns false if the index isn't (and can't be) used for the next lookup
+    bool ensureBuilt();
+
+    SyncJournalDb *_journal;
+    int _directLookupLimit = 64;
+    int _lookups = 0;
+    bool _built = false;
+    bool _buildFailed = false;
+
+    QHash<quint64, qint64> _phashByInode;
+    QMultiHash<uint, qint64> _phashByFileIdHash;
+};
+
 class DiscoveryPhase : public QObject
 {
     Q_OBJECT
@@ -201,7 +250,8 @@ class DiscoveryPhase : public QObject
      */
     bool isRenamed(const QString &p) const { return _renamedItemsLocal.contains(p) || _renamedItemsRemote.contains(p); }
 
-    int _currentlyActiveJobs = 0;
+    int _currentlyActiveJobs = 0; // server queries, limited by _parallelNetworkJobs
+    int _currentlyActiveLocalJobs = 0; // local directory scans, see localScanPool()
 
     // both must contain a sorted list
     QStringList _selectiveSyncBlackList;
@@ -236,6 +286,10 @@ class DiscoveryPhase : public QObject
      */
     QPair<bool, QByteArray> findAndCancelDeletedJob(const QString &originalPath);
 
+    /// Rename candidate lookups in _statedb, created on first use
+    RenameCandidateIndex &renameCandidates();
+    std::unique_ptr<RenameCandidateIndex> _renameCandidates;
+
 public:
     // input
     QString _localDir; // absolute path to the local directory. ends with '/'
@@ -251,6 +305,13 @@ public:
 
     void startJob(ProcessDirectoryJob *);
 
+    /** The threads scanning local directories, shared by all discoveries
+     *
+     * Local scans don't count against _parallelNetworkJobs: a sync where
+     * most directories are unchanged on the server is limited by the disk.
+     */
+    static QThreadPool *localScanPool();
+
     void setSelectiveSyncBlackList(const QStringList &list);
     void setSelectiveSyncWhiteList(const QStringList &list);
 
@@ -21,6 +21,14 @@
 #include <QDirIterator>
 #include <QCoreApplication>
 
+#ifdef Q_OS_LINUX
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
 // We use some internals of csync:
 extern "C" int c_utimes(const char *, const struct timeval *);
 
@@ -189,6 +197,60 @@ bool FileSystem::removeRecursively(const QString &path, const std::function<void
     return allRemoved;
 }
 
+bool FileSystem::cloneFile(const QString &source, const QString &destination, QString *errorString)
+{
+    QFile src(source);
+    if (!openAndSeekFileSharedRead(&src, errorString, 0))
+        return false;
+    QFile dst(destination);
+    if (!dst.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        *errorString = dst.errorString();
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    const int in = src.handle();
+    const int out = dst.handle();
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0)
+        return true;
+#endif
+// copy_file_range() is in glibc since 2.27
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    qint64 left = src.size();
+    while (left > 0) {
+        const ssize_t copied = copy_file_range(in, nullptr, out, nullptr, left, 0);
+        if (copied <= 0)
+            break;
+        left -= copied;
+    }
+    if (left == 0)
+        return true;
+    qCDebug(lcFileSystem) << "copy_file_range failed for" << source << strerror(errno);
+    // Start over with the plain copy below
+    if (!src.seek(0) || !dst.resize(0) || !dst.seek(0)) {
+        *errorString = dst.errorString();
+        return false;
+    }
+#endif
+#endif
+
+    QByteArray buffer(64 * 1024, Qt::Uninitialized);
+    forever {
+        const qint64 read = src.read(buffer.data(), buffer.size());
+        if (read < 0) {
+            *errorString = src.errorString();
+            return false;
+        }
+        if (read == 0)
+            return true;
+        if (dst.write(buffer.constData(), read) != read) {
+            *errorString = dst.errorString();
+            return false;
+        }
+    }
+}
+
 bool FileSystem::getInode(const QString &filename, quint64 *inode)
 {
     csync_file_stat_t fs;
@@ -86,6 +86,15 @@ namespace FileSystem {
         qint64 previousSize,
         time_t previousMtime);
 
+    /**
+     * @brief Copies \a source to \a destination, replacing its content
+     *
+     * On Linux the data blocks are shared (FICLONE) where the file system
+     * supports it, and otherwise copied by the kernel (copy_file_range).
+     * Everywhere else, and if both fail, the file is copied through a buffer.
+     */
+    bool OWNCLOUDSYNC_EXPORT cloneFile(const QString &source, const QString &destination, QString *errorString);
+
     /**
      * Removes a directory and its contents recursively
      *
@@ -15,8 +15,13 @@
 #include "localdiscoverytracker.h"
 
 #include "syncfileitem.h"
+#include "filesystem.h"
+#include "common/syncjournaldb.h"
 
+#include <QDateTime>
+#include <QDir>
 #include <QLoggingCategory>
+#include <QSet>
 
 using namespace OCC;
 
@@ -36,6 +41,7 @@ void LocalDiscoveryTracker::startSyncFullDiscovery()
 {
     _localDiscoveryPaths.clear();
     _previousLocalDiscoveryPaths.clear();
+    _fullDiscoveryRunning = true;
     qCDebug(lcLocalDiscoveryTracker) << "full discovery";
 }
 
@@ -50,6 +56,7 @@ void LocalDiscoveryTracker::startSyncPartialDiscovery()
 
     _previousLocalDiscoveryPaths = std::move(_localDiscoveryPaths);
     _localDiscoveryPaths.clear();
+    _fullDiscoveryRunning = false;
 }
 
 const std::set<QString> &LocalDiscoveryTracker::localDiscoveryPaths() const
@@ -94,4 +101,86 @@ void LocalDiscoveryTracker::slotSyncFinished(bool success)
         qCDebug(lcLocalDiscoveryTracker) << "sync failed, keeping last sync's local discovery path list";
     }
     _previousLocalDiscoveryPaths.clear();
+    _fullDiscoveryRunning = false;
+}
+
+bool LocalDiscoveryTracker::saveState(SyncJournalDb &journal, qint64 lastFullDiscovery) const
+{
+    if (_fullDiscoveryRunning) {
+        qCInfo(lcLocalDiscoveryTracker) << "not saving the local discovery state during a full discovery";
+        return false;
+    }
+
+    SyncJournalDb::LocalDiscoveryState state;
+    state.lastFullDiscovery = lastFullDiscovery;
+    state.watchedUntil = QDateTime::currentMSecsSinceEpoch();
+    // The paths of a running sync are only forgotten once it succeeds
+    for (auto &path : _localDiscoveryPaths)
+        state.paths.append(path);
+    for (auto &path : _previousLocalDiscoveryPaths)
+        state.paths.append(path);
+    journal.setLocalDiscoveryState(state);
+    qCInfo(lcLocalDiscoveryTracker) << "saved" << state.paths.size() << "local discovery paths";
+    return true;
+}
+
+qint64 LocalDiscoveryTracker::restoreState(SyncJournalDb &journal, const QString &localPath)
+{
+    const auto state = journal.takeLocalDiscoveryState();
+    if (!state.isValid()) {
+        qCInfo(lcLocalDiscoveryTracker) << "no local discovery state to restore";
+        return -1;
+    }
+
+    QSet<QString> directories;
+    directories.insert(QString());
+    bool ok = journal.getFilesBelowPath(QByteArray(), [&](const SyncJournalFileRecord &rec) {
+        if (rec.isDirectory())
+            directories.insert(QString::fromUtf8(rec._path));
+    });
+    if (!ok || !QFileInfo(localPath).isDir())
+        return -1;
+
+    // Leave some room for filesystems with a coarse mtime resolution
+    const time_t watchedUntil = state.watchedUntil / 1000 - 2;
+
+    std::set<QString> paths(state.paths.begin(), state.paths.end());
+    int modifiedDirectories = 0;
+    for (const auto &dir : directories) {
+        const QString dirPath = localPath + dir;
+        if (!QFileInfo(dirPath).isDir()) {
+            paths.insert(dir);
+            ++modifiedDirectories;
+            continue;
+        }
+        if (FileSystem::getModTime(dirPath) < watchedUntil)
+            continue;
+        ++modifiedDirectories;
+
+        // Listing one entry gets the whole directory listed. Only new
+        // subdirectories need to be named, the known ones are checked here.
+        bool listed = false;
+        const auto entries = QDir(dirPath).entryInfoList(
+            QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+        for (const auto &entry : entries) {
+            const QString path = dir.isEmpty() ? entry.fileName() : dir + QLatin1Char('/') + entry.fileName();
+            if (entry.isDir() && directories.contains(path))
+                continue;
+            paths.insert(path);
+            listed = true;
+        }
+        if (!listed)
+            paths.insert(dir);
+    }
+
+    // The root folder would mean a full discovery, which is what the caller
+    // does for an invalid state anyway
+    if (paths.count(QString()))
+        return -1;
+
+    _localDiscoveryPaths.insert(paths.begin(), paths.end());
+    qCInfo(lcLocalDiscoveryTracker) << "restored" << state.paths.size() << "local discovery paths,"
+                                    << modifiedDirectories << "of" << directories.size()
+                                    << "directories were modified since" << QDateTime::fromMSecsSinceEpoch(state.watchedUntil);
+    return state.lastFullDiscovery;
 }
@@ -24,6 +24,7 @@
 namespace OCC {
 
 class SyncFileItem;
+class SyncJournalDb;
 typedef QSharedPointer<SyncFileItem> SyncFileItemPtr;
 
 /**
@@ -44,6 +45,12 @@ typedef QSharedPointer<SyncFileItem> SyncFileItemPtr;
  * All paths used in this class are expected to be utf8 encoded byte arrays,
  * relative to the folder that is being synced, without a starting slash.
  *
+ * The paths survive a restart of the client with saveState() and
+ * restoreState(). Changes made while the client wasn't running are found
+ * by comparing the mtimes of the directories in the journal against the
+ * time the tracking stopped. Files that are written in place, without
+ * touching their directory, are only caught by the next full discovery.
+ *
  * @ingroup libsync
  */
 class OWNCLOUDSYNC_EXPORT LocalDiscoveryTracker : public QObject
@@ -68,6 +75,26 @@ public:
     /** Access list of files that shall be locally rediscovered. */
     const std::set<QString> &localDiscoveryPaths() const;
 
+    /**
+     * Stores the tracked paths in the journal, claiming that every local
+     * change up to now is among them.
+     *
+     * lastFullDiscovery is the time of the last full local discovery, in
+     * msecs since epoch. Returns false and stores nothing while a full
+     * discovery is running, since the paths are incomplete then.
+     */
+    bool saveState(SyncJournalDb &journal, qint64 lastFullDiscovery) const;
+
+    /**
+     * Takes the state stored by saveState() out of the journal and adds its
+     * paths, plus the contents of all directories modified since then.
+     *
+     * localPath is the synced folder, ending with a slash. Returns the
+     * lastFullDiscovery that was stored, or -1 if there was no usable state
+     * and a full local discovery is needed.
+     */
+    qint64 restoreState(SyncJournalDb &journal, const QString &localPath);
+
 public slots:
     /**
      * Success and failure of sync items adjust what the next sync is
@@ -96,6 +123,9 @@ private:
      * again when the sync is done to make sure everything is retried.
      */
     std::set<QString> _previousLocalDiscoveryPaths;
+
+    /// Whether the current sync run was started with startSyncFullDiscovery()
+    bool _fullDiscoveryRunning = false;
 };
 
 } // namespace OCC
@@ -176,132 +176,196 @@ bool MkColJob::finished()
 }
 
 /*********************************************************************************************/
-// supposed to read <D:collection> when pointing to <D:resourcetype><D:collection></D:resourcetype>..
-static QString readContentsAsString(QXmlStreamReader &reader)
+
+LsColXMLParser::LsColXMLParser()
 {
-    QString result;
-    int level = 0;
-    do {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        if (type == QXmlStreamReader::StartElement) {
-            level++;
-            result += "<" + reader.name().toString() + ">";
-        } else if (type == QXmlStreamReader::Characters) {
-            result += reader.text();
-        } else if (type == QXmlStreamReader::EndElement) {
-            level--;
-            if (level < 0) {
-                break;
-            }
-            result += "</" + reader.name().toString() + ">";
-        }
+    begin(nullptr, QString());
+}
 
-    } while (!reader.atEnd());
-    return result;
+bool LsColXMLParser::parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath)
+{
+    begin(sizes, expectedPath);
+    return addData(xml) && finish();
 }
 
+void LsColXMLParser::begin(QHash<QString, qint64> *sizes, const QString &expectedPath)
+{
+    _reader.clear();
+    _reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration("d", "DAV:"));
+    _sizes = sizes;
+    _expectedPath = expectedPath;
+    _failed = false;
+
+    _folders.clear();
+    _currentHref.clear();
+    _currentTmpProperties.clear();
+    _currentHttp200Properties.clear();
+    _currentPropsHaveHttp200 = false;
+    _insidePropstat = false;
+    _insideProp = false;
+    _insideMultiStatus = false;
+
+    _capture = NoCapture;
+    _captureName.clear();
+    _captureText.clear();
+    _captureLevel = 0;
+}
 
-LsColXMLParser::LsColXMLParser()
+bool LsColXMLParser::addData(const QByteArray &data)
 {
+    if (_failed)
+        return false;
+
+    _reader.addData(data);
+    // Running out of data ends the loop with PrematureEndOfDocumentError;
+    // parsing resumes where it stopped once more data is added.
+    while (!_reader.atEnd()) {
+        _reader.readNext();
+        if (!processToken()) {
+            _failed = true;
+            return false;
+        }
+    }
+
+    if (_reader.hasError() && _reader.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+        // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
+        qCWarning(lcLsColJob) << "ERROR" << _reader.errorString()
+                              << "at line" << _reader.lineNumber() << "column" << _reader.columnNumber();
+        _failed = true;
+        return false;
+    }
+    return true;
 }
 
-bool LsColXMLParser::parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath)
+bool LsColXMLParser::finish()
 {
-    // Parse DAV response
-    QXmlStreamReader reader(xml);
-    reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration("d", "DAV:"));
+    if (_failed)
+        return false;
 
-    QStringList folders;
-    QString currentHref;
-    QMap<QString, QString> currentTmpProperties;
-    QMap<QString, QString> currentHttp200Properties;
-    bool currentPropsHaveHttp200 = false;
-    bool insidePropstat = false;
-    bool insideProp = false;
-    bool insideMultiStatus = false;
+    if (_reader.hasError()) {
+        qCWarning(lcLsColJob) << "ERROR" << _reader.errorString()
+                              << "at line" << _reader.lineNumber() << "column" << _reader.columnNumber();
+        return false;
+    } else if (!_insideMultiStatus) {
+        qCWarning(lcLsColJob) << "ERROR no WebDAV response?";
+        return false;
+    }
+    emit directoryListingSubfolders(_folders);
+    emit finishedWithoutError();
+    return true;
+}
 
-    while (!reader.atEnd()) {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        QString name = reader.name().toString();
-        // Start elements with DAV:
-        if (type == QXmlStreamReader::StartElement && reader.namespaceUri() == QLatin1String("DAV:")) {
-            if (name == QLatin1String("href")) {
+bool LsColXMLParser::processToken()
+{
+    const QXmlStreamReader::TokenType type = _reader.tokenType();
+
+    // Collect the contents of the element started earlier. For properties, the
+    // contents are kept as a string such as "<collection></collection>" when
+    // pointing to <d:resourcetype><d:collection/></d:resourcetype>.
+    if (_capture != NoCapture) {
+        if (type == QXmlStreamReader::StartElement) {
+            _captureLevel++;
+            if (_capture == CaptureProperty) {
+                _captureText += QLatin1Char('<');
+                _captureText += _reader.name();
+                _captureText += QLatin1Char('>');
+            }
+        } else if (type == QXmlStreamReader::Characters) {
+            _captureText += _reader.text();
+        } else if (type == QXmlStreamReader::EndElement) {
+            if (_captureLevel > 0) {
+                _captureLevel--;
+                if (_capture == CaptureProperty) {
+                    _captureText += QLatin1String("</");
+                    _captureText += _reader.name();
+                    _captureText += QLatin1Char('>');
+                }
+                return true;
+            }
+
+            const Capture capture = _capture;
+            _capture = NoCapture;
+            if (capture == CaptureHref) {
                 // We don't use URL encoding in our request URL (which is the expected path) (QNAM will do it for us)
                 // but the result will have URL encoding..
-                QString hrefString = QString::fromUtf8(QByteArray::fromPercentEncoding(reader.readElementText().toUtf8()));
-                if (!hrefString.startsWith(expectedPath)) {
-                    qCWarning(lcLsColJob) << "Invalid href" << hrefString << "expected starting with" << expectedPath;
+                QString hrefString = QString::fromUtf8(QByteArray::fromPercentEncoding(_captureText.toUtf8()));
+                if (!hrefString.startsWith(_expectedPath)) {
+                    qCWarning(lcLsColJob) << "Invalid href" << hrefString << "expected starting with" << _expectedPath;
                     return false;
                 }
-                currentHref = hrefString;
-            } else if (name == QLatin1String("response")) {
-            } else if (name == QLatin1String("propstat")) {
-                insidePropstat = true;
-            } else if (name == QLatin1String("status") && insidePropstat) {
-                QString httpStatus = reader.readElementText();
-                if (httpStatus.startsWith("HTTP/1.1 200")) {
-                    currentPropsHaveHttp200 = true;
-                } else {
-                    currentPropsHaveHttp200 = false;
+                _currentHref = hrefString;
+            } else if (capture == CaptureStatus) {
+                _currentPropsHaveHttp200 = _captureText.startsWith("HTTP/1.1 200");
+            } else {
+                if (_captureName == QLatin1String("resourcetype") && _captureText.contains("collection")) {
+                    _folders.append(_currentHref);
+                } else if (_captureName == QLatin1String("size")) {
+                    bool ok = false;
+                    auto s = _captureText.toLongLong(&ok);
+                    if (ok && _sizes) {
+                        _sizes->insert(_currentHref, s);
+                    }
                 }
-            } else if (name == QLatin1String("prop")) {
-                insideProp = true;
-                continue;
-            } else if (name == QLatin1String("multistatus")) {
-                insideMultiStatus = true;
-                continue;
+                _currentTmpProperties.insert(_captureName, _captureText);
             }
+            _captureText.clear();
         }
+        return true;
+    }
 
-        if (type == QXmlStreamReader::StartElement && insidePropstat && insideProp) {
-            // All those elements are properties
-            QString propertyContent = readContentsAsString(reader);
-            if (name == QLatin1String("resourcetype") && propertyContent.contains("collection")) {
-                folders.append(currentHref);
-            } else if (name == QLatin1String("size")) {
-                bool ok = false;
-                auto s = propertyContent.toLongLong(&ok);
-                if (ok && sizes) {
-                    sizes->insert(currentHref, s);
-                }
-            }
-            currentTmpProperties.insert(reader.name().toString(), propertyContent);
+    auto startCapture = [this](Capture capture) {
+        _capture = capture;
+        _captureName = _reader.name().toString();
+        _captureText.clear();
+        _captureLevel = 0;
+    };
+
+    // Start elements with DAV:
+    if (type == QXmlStreamReader::StartElement && _reader.namespaceUri() == QLatin1String("DAV:")) {
+        const QStringRef name = _reader.name();
+        if (name == QLatin1String("href")) {
+            startCapture(CaptureHref);
+            return true;
+        } else if (name == QLatin1String("response")) {
+        } else if (name == QLatin1String("propstat")) {
+            _insidePropstat = true;
+        } else if (name == QLatin1String("status") && _insidePropstat) {
+            startCapture(CaptureStatus);
+            return true;
+        } else if (name == QLatin1String("prop")) {
+            _insideProp = true;
+            return true;
+        } else if (name == QLatin1String("multistatus")) {
+            _insideMultiStatus = true;
+            return true;
         }
+    }
 
-        // End elements with DAV:
-        if (type == QXmlStreamReader::EndElement) {
-            if (reader.namespaceUri() == QLatin1String("DAV:")) {
-                if (reader.name() == "response") {
-                    if (currentHref.endsWith('/')) {
-                        currentHref.chop(1);
-                    }
-                    emit directoryListingIterated(currentHref, currentHttp200Properties);
-                    currentHref.clear();
-                    currentHttp200Properties.clear();
-                } else if (reader.name() == "propstat") {
-                    insidePropstat = false;
-                    if (currentPropsHaveHttp200) {
-                        currentHttp200Properties = QMap<QString, QString>(currentTmpProperties);
-                    }
-                    currentTmpProperties.clear();
-                    currentPropsHaveHttp200 = false;
-                } else if (reader.name() == "prop") {
-                    insideProp = false;
-                }
-            }
-        }
+    if (type == QXmlStreamReader::StartElement && _insidePropstat && _insideProp) {
+        // All those elements are properties
+        startCapture(CaptureProperty);
+        return true;
     }
 
-    if (reader.hasError()) {
-        // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
-        qCWarning(lcLsColJob) << "ERROR" << reader.errorString() << xml;
-        return false;
-    } else if (!insideMultiStatus) {
-        qCWarning(lcLsColJob) << "ERROR no WebDAV response?" << xml;
-        return false;
-    } else {
-        emit directoryListingSubfolders(folders);
-        emit finishedWithoutError();
+    // End elements with DAV:
+    if (type == QXmlStreamReader::EndElement && _reader.namespaceUri() == QLatin1String("DAV:")) {
+        if (_reader.name() == QLatin1String("response")) {
+            if (_currentHref.endsWith('/')) {
+                _currentHref.chop(1);
+            }
+            emit directoryListingIterated(_currentHref, _currentHttp200Properties);
+            _currentHref.clear();
+            _currentHttp200Properties.clear();
+        } else if (_reader.name() == QLatin1String("propstat")) {
+            _insidePropstat = false;
+            if (_currentPropsHaveHttp200) {
+                _currentHttp200Properties = QMap<QString, QString>(_currentTmpProperties);
+            }
+            _currentTmpProperties.clear();
+            _currentPropsHaveHttp200 = false;
+        } else if (_reader.name() == QLatin1String("prop")) {
+            _insideProp = false;
+        }
     }
     return true;
 }
@@ -361,6 +425,16 @@ void LsColJob::start()
     QBuffer *buf = new QBuffer(this);
     buf->setData(xml);
     buf->open(QIODevice::ReadOnly);
+
+    connect(&_parser, &LsColXMLParser::directoryListingSubfolders,
+        this, &LsColJob::directoryListingSubfolders);
+    connect(&_parser, &LsColXMLParser::directoryListingIterated,
+        this, &LsColJob::directoryListingIterated);
+    connect(&_parser, &LsColXMLParser::finishedWithError,
+        this, &LsColJob::finishedWithError);
+    connect(&_parser, &LsColXMLParser::finishedWithoutError,
+        this, &LsColJob::finishedWithoutError);
+
     if (_url.isValid()) {
         sendRequest("PROPFIND", _url, req, buf);
     } else {
@@ -369,29 +443,52 @@ void LsColJob::start()
     AbstractNetworkJob::start();
 }
 
-// TODO: Instead of doing all in this slot, we should iteratively parse in readyRead(). This
-// would allow us to be more asynchronous in processing while data is coming from the network,
-// not all in one big blob at the end.
+void LsColJob::newReplyHook(QNetworkReply *reply)
+{
+    connect(reply, &QNetworkReply::readyRead, this, &LsColJob::slotReadyRead);
+}
+
+bool LsColJob::isMultiStatusReply() const
+{
+    QString contentType = reply()->header(QNetworkRequest::ContentTypeHeader).toString();
+    int httpCode = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return httpCode == 207 && contentType.contains("application/xml; charset=utf-8");
+}
+
+void LsColJob::slotReadyRead()
+{
+    // Replies that were redirected or resent are not parsed, nor is anything
+    // but a multistatus response: finished() deals with those.
+    if (sender() != reply() || !isMultiStatusReply())
+        return;
+
+    // Parse what we have so directoryListingIterated comes while the rest of a
+    // large listing is still being received, and the reply doesn't buffer it all.
+    const QByteArray data = reply()->readAll();
+    if (_parseFailed)
+        return;
+    if (!_parsing) {
+        _parser.begin(&_sizes, reply()->request().url().path()); // something like "/owncloud/remote.php/webdav/folder"
+        _parsing = true;
+    }
+    if (!_parser.addData(data))
+        _parseFailed = true;
+}
+
 bool LsColJob::finished()
 {
     qCInfo(lcLsColJob) << "LSCOL of" << reply()->request().url() << "FINISHED WITH STATUS"
                        << replyStatusString();
 
-    QString contentType = reply()->header(QNetworkRequest::ContentTypeHeader).toString();
     int httpCode = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    if (httpCode == 207 && contentType.contains("application/xml; charset=utf-8")) {
-        LsColXMLParser parser;
-        connect(&parser, &LsColXMLParser::directoryListingSubfolders,
-            this, &LsColJob::directoryListingSubfolders);
-        connect(&parser, &LsColXMLParser::directoryListingIterated,
-            this, &LsColJob::directoryListingIterated);
-        connect(&parser, &LsColXMLParser::finishedWithError,
-            this, &LsColJob::finishedWithError);
-        connect(&parser, &LsColXMLParser::finishedWithoutError,
-            this, &LsColJob::finishedWithoutError);
-
-        QString expectedPath = reply()->request().url().path(); // something like "/owncloud/remote.php/webdav/folder"
-        if (!parser.parse(reply()->readAll(), &_sizes, expectedPath)) {
+    if (isMultiStatusReply()) {
+        if (!_parsing) {
+            _parser.begin(&_sizes, reply()->request().url().path());
+            _parsing = true;
+        }
+        if (!_parseFailed && !_parser.addData(reply()->readAll()))
+            _parseFailed = true;
+        if (_parseFailed || !_parser.finish()) {
             // XML parse error
             emit finishedWithError(reply());
         }
@@ -597,6 +694,33 @@ QList<QByteArray> PropfindJob::properties() const
     return _properties;
 }
 
+/*
+ * Reads the text of the property the reader is at, up to its end element.
+ * The texts of nested elements, like the <oc:checksum> elements inside
+ * <oc:checksums>, are joined with spaces.
+ */
+static QString readPropertyText(QXmlStreamReader &reader)
+{
+    QStringList parts;
+    QString text;
+    int depth = 0;
+    while (!reader.atEnd()) {
+        const auto type = reader.readNext();
+        if (type == QXmlStreamReader::StartElement) {
+            ++depth;
+        } else if (type == QXmlStreamReader::Characters) {
+            text += reader.text();
+        } else if (type == QXmlStreamReader::EndElement) {
+            if (!text.trimmed().isEmpty())
+                parts.append(depth == 0 ? text : text.trimmed());
+            text.clear();
+            if (depth-- == 0)
+                break;
+        }
+    }
+    return parts.join(QLatin1Char(' '));
+}
+
 bool PropfindJob::finished()
 {
     qCInfo(lcPropfindJob) << "PROPFIND of" << reply()->request().url() << "FINISHED WITH STATUS"
@@ -617,7 +741,8 @@ bool PropfindJob::finished()
             QXmlStreamReader::TokenType type = reader.readNext();
             if (type == QXmlStreamReader::StartElement) {
                 if (!curElement.isEmpty() && curElement.top() == QLatin1String("prop")) {
-                    items.insert(reader.name().toString(), reader.readElementText(QXmlStreamReader::SkipChildElements));
+                    const QString name = reader.name().toString();
+                    items.insert(name, readPropertyText(reader));
                 } else {
                     curElement.push(reader.name().toString());
                 }
@@ -19,6 +19,7 @@
 #include "abstractnetworkjob.h"
 #include "common/result.h"
 #include <QUrlQuery>
+#include <QXmlStreamReader>
 #include <functional>
 
 class QUrl;
@@ -57,7 +58,12 @@ private slots:
 };
 
 /**
- * @brief The LsColJob class
+ * @brief Parser for the multistatus response of a PROPFIND
+ *
+ * The response can be fed all at once with parse() or incrementally with
+ * begin(), addData() and finish(); directoryListingIterated is emitted for
+ * every response element as soon as it has been read completely.
+ *
  * @ingroup libsync
  */
 class OWNCLOUDSYNC_EXPORT LsColXMLParser : public QObject
@@ -68,13 +74,59 @@ public:
 
     bool parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath);
 
+    /** Resets the parser for a new response. */
+    void begin(QHash<QString, qint64> *sizes, const QString &expectedPath);
+
+    /** Parses the next piece of the response. Returns false on error,
+     * after which further data is ignored. */
+    bool addData(const QByteArray &data);
+
+    /** To be called once the whole response was added. Returns false if it
+     * was not a valid, complete WebDAV response; otherwise emits
+     * directoryListingSubfolders and finishedWithoutError. */
+    bool finish();
+
 signals:
     void directoryListingSubfolders(const QStringList &items);
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
     void finishedWithError(QNetworkReply *reply);
     void finishedWithoutError();
+
+private:
+    bool processToken();
+
+    enum Capture {
+        NoCapture,
+        CaptureHref,
+        CaptureStatus,
+        CaptureProperty
+    };
+
+    QXmlStreamReader _reader;
+    QHash<QString, qint64> *_sizes = nullptr;
+    QString _expectedPath;
+    bool _failed = false;
+
+    QStringList _folders;
+    QString _currentHref;
+    QMap<QString, QString> _currentTmpProperties;
+    QMap<QString, QString> _currentHttp200Properties;
+    bool _currentPropsHaveHttp200 = false;
+    bool _insidePropstat = false;
+    bool _insideProp = false;
+    bool _insideMultiStatus = false;
+
+    // Text of the element being read; elements may span several addData() calls
+    Capture _capture = NoCapture;
+    QString _captureName;
+    QString _captureText;
+    int _captureLevel = 0;
 };
 
+/**
+ * @brief The LsColJob class
+ * @ingroup libsync
+ */
 class OWNCLOUDSYNC_EXPORT LsColJob : public AbstractNetworkJob
 {
     Q_OBJECT
@@ -101,12 +153,23 @@ signals:
     void finishedWithError(QNetworkReply *reply);
     void finishedWithoutError();
 
+protected:
+    void newReplyHook(QNetworkReply *reply) Q_DECL_OVERRIDE;
+
 private slots:
     virtual bool finished() Q_DECL_OVERRIDE;
+    void slotReadyRead();
 
 private:
+    bool isMultiStatusReply() const;
+
     QList<QByteArray> _properties;
     QUrl _url; // Used instead of path() if the url is specified in the constructor
+
+    // The response is parsed as it arrives
+    LsColXMLParser _parser;
+    bool _parsing = false;
+    bool _parseFailed = false;
 };
 
 /**
@@ -42,6 +42,8 @@
 #include <QTimerEvent>
 #include <qmath.h>
 
+#include <numeric>
+
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcPropagator, "sync.propagator", QtInfoMsg)
@@ -81,13 +83,83 @@ OwncloudPropagator::~OwncloudPropagator()
 
 int OwncloudPropagator::maximumActiveTransferJob()
 {
-    if (_downloadLimit.fetchAndAddAcquire(0) != 0
-        || _uploadLimit.fetchAndAddAcquire(0) != 0
-        || !_syncOptions._parallelNetworkJobs) {
-        // disable parallelism when there is a network limit.
+    // Bandwidth limits don't need to disable parallelism: all running
+    // transfers take their share from the BandwidthManager's token buckets.
+    if (!_syncOptions._parallelNetworkJobs)
         return 1;
+    return _transferConcurrency.limit();
+}
+
+/* Uploads and downloads of file contents, as opposed to metadata operations */
+static bool isTransfer(const SyncFileItem &item)
+{
+    if (item.isDirectory())
+        return false;
+    switch (item._instruction) {
+    case CSYNC_INSTRUCTION_NEW:
+    case CSYNC_INSTRUCTION_SYNC:
+    case CSYNC_INSTRUCTION_CONFLICT:
+    case CSYNC_INSTRUCTION_TYPE_CHANGE:
+        return true;
+    default:
+        return false;
     }
-    return qMin(3, qCeil(_syncOptions._parallelNetworkJobs / 2.));
+}
+
+/* Errors that hint at an overloaded link or server rather than a problem with the file */
+static bool isCongestionError(const SyncFileItem &item)
+{
+    switch (item._status) {
+    case SyncFileItem::NormalError:
+    case SyncFileItem::SoftError:
+    case SyncFileItem::FatalError:
+        break;
+    default:
+        return false;
+    }
+    // Local errors, like a full disk or a file that changed, don't count
+    return item._isCongestionError || item._httpErrorCode == 429 || item._httpErrorCode >= 500;
+}
+
+qint64 OwncloudPropagator::transferCost(const SyncFileItem &item) const
+{
+    if (!isTransfer(item))
+        return 0;
+    qint64 cost = qMax<qint64>(item._size, 1);
+    // Uplinks are usually slower than downlinks
+    if (item._direction == SyncFileItem::Up)
+        cost *= 2;
+    // Modified files may only need a delta transferred
+    if (item._instruction == CSYNC_INSTRUCTION_SYNC
+        && _syncOptions._deltaSyncEnabled
+        && item._size >= _syncOptions._deltaSyncMinFileSize
+        && _account->capabilities().zsyncSupportedVersion() == "1.0") {
+        cost /= 4;
+    }
+    return cost;
+}
+
+bool OwncloudPropagator::isLargeTransfer(const SyncFileItem &item) const
+{
+    // Files that need to be chunked when uploaded
+    return transferCost(item) > _syncOptions._initialChunkSize;
+}
+
+int OwncloudPropagator::maximumActiveLargeTransferJob()
+{
+    const int transfers = maximumActiveTransferJob();
+    if (transfers <= 1)
+        return transfers;
+    return transfers - qMax(1, transfers / 3);
+}
+
+/* Upper bound for the TransferConcurrencyController */
+int OwncloudPropagator::maximumParallelTransfers()
+{
+    const int hardMaximum = hardMaximumActiveJob();
+    if (_syncOptions._maxParallelTransfers > 0)
+        return qMin(_syncOptions._maxParallelTransfers, hardMaximum);
+    return hardMaximum;
 }
 
 /* The maximum number of active jobs in parallel  */
@@ -101,6 +173,7 @@ int OwncloudPropagator::hardMaximumActiveJob()
 PropagateItemJob::~PropagateItemJob()
 {
     if (auto p = propagator()) {
+        p->_largeTransferJobs.remove(this);
         // Normally, every job should clean itself from the _activeJobList. So this should not be
         // needed. But if a job has a bug or is deleted before the network jobs signal get received,
         // we might risk end up with dangling pointer in the list which may cause crashes.
@@ -374,6 +447,12 @@ void OwncloudPropagator::start(const SyncFileItemVector &items)
      * In order to do that we loop over the items. (which are sorted by destination)
      * When we enter a directory, we can create the directory job and push it on the stack. */
 
+    _transferConcurrency.reset(_syncOptions._minParallelTransfers, maximumParallelTransfers(),
+        qMin(3, qCeil(_syncOptions._parallelNetworkJobs / 2.)));
+    _transferClock.start();
+    connect(this, &OwncloudPropagator::itemCompleted,
+        this, &OwncloudPropagator::slotTransferCompleted, Qt::UniqueConnection);
+
     _rootJob.reset(new PropagateRootDirectory(this));
     QStack<QPair<QString /* directory name */, PropagateDirectory * /* job */>> directories;
     directories.push(qMakePair(QString(), _rootJob.data()));
@@ -506,6 +585,17 @@ void OwncloudPropagator::setSyncOptions(const SyncOptions &syncOptions)
     _chunkSize = syncOptions._initialChunkSize;
 }
 
+void OwncloudPropagator::setParallelNetworkJobs(int jobs)
+{
+    if (jobs == _syncOptions._parallelNetworkJobs)
+        return;
+    qCInfo(lcPropagator) << "Parallel network jobs" << _syncOptions._parallelNetworkJobs << "->" << jobs;
+    _syncOptions._parallelNetworkJobs = jobs;
+    _transferConcurrency.setBounds(_syncOptions._minParallelTransfers, maximumParallelTransfers());
+    if (_rootJob)
+        scheduleNextJob();
+}
+
 bool OwncloudPropagator::localFileNameClash(const QString &relFile)
 {
     bool re = false;
@@ -637,9 +727,24 @@ void OwncloudPropagator::reportFileTotal(const SyncFileItem &item, qint64 newSiz
 
 void OwncloudPropagator::reportProgress(const SyncFileItem &item, qint64 bytes)
 {
+    if (isTransfer(item))
+        _transferConcurrency.transferProgress(item._file, bytes, _transferClock.elapsed());
     emit progress(item, bytes);
 }
 
+void OwncloudPropagator::reportChecksumProgress(const SyncFileItem &item, qint64 bytes)
+{
+    emit checksumProgress(item, bytes);
+}
+
+void OwncloudPropagator::slotTransferCompleted(const SyncFileItemPtr &item)
+{
+    if (!isTransfer(*item) || item->_status == SyncFileItem::Restoration
+        || _abortRequested.fetchAndAddRelaxed(0))
+        return;
+    _transferConcurrency.transferFinished(item->_file, item->_size, isCongestionError(*item), _transferClock.elapsed());
+}
+
 AccountPtr OwncloudPropagator::account() const
 {
     return _account;
@@ -803,6 +908,7 @@ bool PropagatorCompositeJob::scheduleSelfOrChild()
     // Start the composite job
     if (_state == NotYetStarted) {
         _state = Running;
+        sortTransfersByCost();
     }
 
     // Ask all the running composite jobs if they have something new to schedule.
@@ -824,13 +930,28 @@ bool PropagatorCompositeJob::scheduleSelfOrChild()
     // Now it's our turn, check if we have something left to do.
     // First, convert a task to a job if necessary
     while (_jobsToDo.isEmpty() && !_tasksToDo.isEmpty()) {
-        SyncFileItemPtr nextTask = _tasksToDo.first();
-        _tasksToDo.remove(0);
+        // Large transfers wait for a free large transfer slot. The transfers
+        // behind them are large too (they are sorted by cost), but the other
+        // tasks in between, like removals and moves, can still run.
+        int index = 0;
+        if (!propagator()->canStartLargeTransfer()) {
+            while (index < _tasksToDo.size() && propagator()->isLargeTransfer(*_tasksToDo.at(index)))
+                ++index;
+            if (index == _tasksToDo.size()) {
+                // Leave the slot to small items in other directories.
+                return false;
+            }
+        }
+        SyncFileItemPtr nextTask = _tasksToDo.at(index);
+        const bool large = propagator()->isLargeTransfer(*nextTask);
+        _tasksToDo.remove(index);
         PropagatorJob *job = propagator()->createJob(nextTask);
         if (!job) {
             qCWarning(lcDirectory) << "Useless task found for file" << nextTask->destination() << "instruction" << nextTask->_instruction;
             continue;
         }
+        if (large)
+            propagator()->_largeTransferJobs.insert(job);
         appendJob(job);
         break;
     }
@@ -859,6 +980,7 @@ void PropagatorCompositeJob::slotSubJobFinished(SyncFileItem::Status status)
 
     // Delete the job and remove it from our list of jobs.
     subJob->deleteLater();
+    propagator()->_largeTransferJobs.remove(subJob);
     int i = _runningJobs.indexOf(subJob);
     ENFORCE(i >= 0); // should only happen if this function is called more than once
     _runningJobs.remove(i);
@@ -880,6 +1002,29 @@ void PropagatorCompositeJob::slotSubJobFinished(SyncFileItem::Status status)
     }
 }
 
+void PropagatorCompositeJob::sortTransfersByCost()
+{
+    QVector<int> positions;
+    SyncFileItemVector transfers;
+    QVector<qint64> costs;
+    for (int i = 0; i < _tasksToDo.size(); ++i) {
+        const qint64 cost = propagator()->transferCost(*_tasksToDo.at(i));
+        if (cost > 0) {
+            positions.append(i);
+            transfers.append(_tasksToDo.at(i));
+            costs.append(cost);
+        }
+    }
+    if (transfers.size() < 2)
+        return;
+
+    QVector<int> order(transfers.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return costs[a] < costs[b]; });
+    for (int i = 0; i < order.size(); ++i)
+        _tasksToDo[positions[i]] = transfers[order[i]];
+}
+
 void PropagatorCompositeJob::finalize()
 {
     // The propagator will do parallel scheduling and this could be posted
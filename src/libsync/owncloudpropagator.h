@@ -18,6 +18,7 @@
 #include <QHash>
 #include <QObject>
 #include <QMap>
+#include <QSet>
 #include <QLinkedList>
 #include <QElapsedTimer>
 #include <QTimer>
@@ -31,6 +32,7 @@
 #include "bandwidthmanager.h"
 #include "accountfwd.h"
 #include "syncoptions.h"
+#include "transferconcurrency.h"
 
 namespace OCC {
 
@@ -241,6 +243,12 @@ public:
     virtual bool scheduleSelfOrChild() Q_DECL_OVERRIDE;
     virtual JobParallelism parallelism() Q_DECL_OVERRIDE;
 
+    /** Orders the transfers among _tasksToDo by OwncloudPropagator::transferCost()
+     *
+     * The other tasks keep their positions. Done once when the job starts.
+     */
+    void sortTransfersByCost();
+
     /*
      * Abort synchronously or asynchronously - some jobs
      * require to be finished without immediete abort (abort on job might
@@ -422,6 +430,12 @@ public:
     const SyncOptions &syncOptions() const;
     void setSyncOptions(const SyncOptions &syncOptions);
 
+    /** Changes SyncOptions::_parallelNetworkJobs of a running propagation
+     *
+     * Used when several folders share a global budget of network jobs.
+     */
+    void setParallelNetworkJobs(int jobs);
+
     QAtomicInt _downloadLimit;
     QAtomicInt _uploadLimit;
     BandwidthManager _bandwidthManager;
@@ -455,6 +469,30 @@ public:
     /* the maximum number of jobs using bandwidth (uploads or downloads, in parallel) */
     int maximumActiveTransferJob();
 
+    /** Estimated cost of a transfer, 0 for items that aren't uploads or downloads.
+     *
+     * Based on the size, weighted by direction and by whether only a delta
+     * may need to be transferred.
+     */
+    qint64 transferCost(const SyncFileItem &item) const;
+
+    /** Large transfers run in the background: they may only take some of the
+     * maximumActiveTransferJob() slots, the others are kept for small items.
+     */
+    bool isLargeTransfer(const SyncFileItem &item) const;
+    NetworkJobClass networkJobClass(const SyncFileItem &item) const
+    {
+        return isLargeTransfer(item) ? NetworkJobClass::LargeTransfer : NetworkJobClass::SmallTransfer;
+    }
+    int maximumActiveLargeTransferJob();
+    bool canStartLargeTransfer() { return _largeTransferJobs.size() < maximumActiveLargeTransferJob(); }
+
+    /** The running jobs for which isLargeTransfer() was true when they started */
+    QSet<PropagatorJob *> _largeTransferJobs;
+
+    /** Adapts maximumActiveTransferJob() to the measured throughput, see start() */
+    const TransferConcurrencyController &transferConcurrency() const { return _transferConcurrency; }
+
     /** The size to use for upload chunks.
      *
      * Will be dynamically adjusted after each chunk upload finishes
@@ -492,6 +530,8 @@ public:
     void scheduleNextJob();
     void reportProgress(const SyncFileItem &, qint64 bytes);
     void reportFileTotal(const SyncFileItem &item, qint64 newSize);
+    /// Bytes read to compute the checksums of an upload, not transferred ones
+    void reportChecksumProgress(const SyncFileItem &item, qint64 bytes);
 
     void abort()
     {
@@ -572,11 +612,14 @@ private slots:
 
     void scheduleNextJobImpl();
 
+    void slotTransferCompleted(const SyncFileItemPtr &item);
+
 signals:
     void newItem(const SyncFileItemPtr &);
     void itemCompleted(const SyncFileItemPtr &);
     void progress(const SyncFileItem &, qint64 bytes);
     void updateFileTotal(const SyncFileItem &, qint64 newSize);
+    void checksumProgress(const SyncFileItem &, qint64 bytes);
     void finished(bool success);
 
     /** Emitted when propagation has problems with a locked file. */
@@ -597,6 +640,10 @@ private:
     QScopedPointer<PropagateRootDirectory> _rootJob;
     SyncOptions _syncOptions;
     bool _jobScheduled = false;
+    TransferConcurrencyController _transferConcurrency;
+    QElapsedTimer _transferClock;
+
+    int maximumParallelTransfers();
 };
 
 
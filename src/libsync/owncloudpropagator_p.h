@@ -37,6 +37,26 @@ inline QByteArray getEtagFromReply(QNetworkReply *reply)
     return ret;
 }
 
+/**
+ * Whether a network error hints at an overloaded link or server rather
+ * than a problem with the request. Our own timeouts abort the reply, see
+ * AbstractNetworkJob::timedOut().
+ */
+inline bool isCongestionNetworkError(QNetworkReply::NetworkError nerror, bool timedOut)
+{
+    switch (nerror) {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+        return true;
+    case QNetworkReply::OperationCanceledError:
+        return timedOut;
+    default:
+        return false;
+    }
+}
+
 /**
  * Given an error from the network, map to a SyncFileItem::Status error
  */
@@ -275,6 +275,19 @@ void ProgressInfo::setProgressItem(const SyncFileItem &item, qint64 completed)
     _lastCompletedItem = SyncFileItem();
 }
 
+void ProgressInfo::setChecksumProgress(const SyncFileItem &item, qint64 completed)
+{
+    if (!shouldCountProgress(item)) {
+        return;
+    }
+
+    if (!_currentItems.contains(item._file)) {
+        _currentItems[item._file]._item = item;
+        _currentItems[item._file]._progress._total = item._size;
+    }
+    _currentItems[item._file]._checksumCompleted = completed;
+}
+
 ProgressInfo::Estimates ProgressInfo::totalProgress() const
 {
     Estimates file = _fileProgress.estimates();
@@ -196,6 +196,8 @@ public:
     {
         SyncFileItem _item;
         Progress _progress;
+        /// Bytes read to compute the checksums, before an upload starts
+        qint64 _checksumCompleted = 0;
     };
     QHash<QString, ProgressItem> _currentItems;
 
@@ -209,6 +211,9 @@ public:
 
     void setProgressItem(const SyncFileItem &item, qint64 completed);
 
+    /// Doesn't change the completed size, the bytes were only read locally
+    void setChecksumProgress(const SyncFileItem &item, qint64 completed);
+
     /**
      * Get the total completion estimate
      */
@@ -41,6 +41,8 @@ extern "C" {
 #include <QDir>
 #include <QTemporaryDir>
 
+#include <cstring>
+
 #if defined(Q_CC_MSVC)
 #include <io.h>  // for dup
 #endif
@@ -82,6 +84,78 @@ QUrl zsyncMetadataUrl(OwncloudPropagator *propagator, const QString &path)
     return Utility::concatUrlPath(propagator->account()->davUrl(), propagator->_remoteFolder + path, urlQuery);
 }
 
+namespace {
+struct ZsyncBlockSums
+{
+    qint64 blockSize = 0;
+    qint64 length = 0;
+    QByteArray hashLengths;
+    int recordSize = 0;
+    QByteArray sums;
+
+    qint64 blockCount() const { return (length + blockSize - 1) / blockSize; }
+};
+
+bool parseZsyncBlockSums(const QByteArray &metadata, ZsyncBlockSums *result)
+{
+    // The header lines are followed by an empty line and the raw block sums
+    const int headerEnd = metadata.indexOf("\n\n");
+    if (headerEnd < 0)
+        return false;
+
+    for (const auto &line : metadata.left(headerEnd).split('\n')) {
+        const int sep = line.indexOf(": ");
+        if (sep < 0)
+            continue;
+        const QByteArray key = line.left(sep);
+        const QByteArray value = line.mid(sep + 2);
+        if (key == "Blocksize") {
+            result->blockSize = value.toLongLong();
+        } else if (key == "Length") {
+            result->length = value.toLongLong();
+        } else if (key == "Hash-Lengths") {
+            // seq_matches,rsum_len,checksum_len
+            const auto lengths = value.split(',');
+            if (lengths.size() != 3)
+                return false;
+            result->hashLengths = value;
+            result->recordSize = lengths[1].toInt() + lengths[2].toInt();
+        }
+    }
+    if (result->blockSize <= 0 || result->length < 0 || result->recordSize <= 0)
+        return false;
+
+    result->sums = metadata.mid(headerEnd + 2);
+    return result->sums.size() == result->blockCount() * result->recordSize;
+}
+}
+
+bool zsyncChangedBlocks(const QByteArray &oldMetadata, const QByteArray &newMetadata,
+    QVector<QPair<qint64, qint64>> *changedRanges, qint64 *oldLength)
+{
+    ZsyncBlockSums oldSums, newSums;
+    if (!parseZsyncBlockSums(oldMetadata, &oldSums) || !parseZsyncBlockSums(newMetadata, &newSums))
+        return false;
+    if (oldSums.blockSize != newSums.blockSize || oldSums.hashLengths != newSums.hashLengths)
+        return false;
+
+    changedRanges->clear();
+    const qint64 blockSize = newSums.blockSize;
+    const int recordSize = newSums.recordSize;
+    const qint64 commonBlocks = qMin(oldSums.blockCount(), newSums.blockCount());
+    for (qint64 i = 0; i < commonBlocks; ++i) {
+        if (memcmp(oldSums.sums.constData() + i * recordSize, newSums.sums.constData() + i * recordSize, recordSize) == 0)
+            continue;
+        if (!changedRanges->isEmpty() && changedRanges->last().first + changedRanges->last().second == i * blockSize) {
+            changedRanges->last().second += blockSize;
+        } else {
+            changedRanges->append(qMakePair(i * blockSize, blockSize));
+        }
+    }
+    *oldLength = oldSums.length;
+    return true;
+}
+
 void ZsyncSeedRunnable::run()
 {
     // Create a temporary file to use with zsync_begin()
@@ -154,86 +228,136 @@ static void log_zsync_errors(const char *func, FILE *stream, void */*error_conte
     qCWarning(lcZsyncGenerate) << "Zsync error: " << func << ": " << strerror(ferror(stream));
 }
 
-void ZsyncGenerateRunnable::run()
+ZsyncMetadataWriter::ZsyncMetadataWriter()
 {
-    // Create a temporary file to use with zsync_begin()
-    QTemporaryFile zsynctf, zsyncmeta;
-    zsyncmeta.open();
-    zsynctf.open();
+    // Create the temporary files to use with zsyncfile_write()
+    if (!_metadataFile.open() || !_blockSumsFile.open())
+        return;
 
-    int metaHandle = zsyncmeta.handle();
-    zsync_unique_ptr<FILE> meta(fdopen(dup(metaHandle), "w"), [](FILE *f) {
+    _metadata = zsync_unique_ptr<FILE>(fdopen(dup(_metadataFile.handle()), "w"), [](FILE *f) {
         fclose(f);
     });
-    zsyncmeta.close();
+    _metadataFile.close();
 
-    int tfHandle = zsynctf.handle();
-    zsync_unique_ptr<FILE> tf(fdopen(dup(tfHandle), "w+"), [](FILE *f) {
+    _blockSums = zsync_unique_ptr<FILE>(fdopen(dup(_blockSumsFile.handle()), "w+"), [](FILE *f) {
         fclose(f);
     });
-    zsynctf.close();
+    _blockSumsFile.close();
+
+    if (!_metadata || !_blockSums)
+        return;
 
     /* Ensure that metadata file is not buffered, since we are using handles directly */
-    setvbuf(meta.get(), NULL, _IONBF, 0);
+    setvbuf(_metadata.get(), NULL, _IONBF, 0);
+
+    _state = zsync_unique_ptr<zsyncfile_state>(zsyncfile_init(ZSYNC_BLOCKSIZE), [](zsyncfile_state *state) {
+        zsyncfile_finish(&state);
+    });
+    if (_state)
+        _state->stream_error = &log_zsync_errors;
+}
+
+ZsyncMetadataWriter::~ZsyncMetadataWriter()
+{
+}
+
+bool ZsyncMetadataWriter::isValid() const
+{
+    return _metadata && _blockSums && _state;
+}
+
+bool ZsyncMetadataWriter::addBlock(char *data, qint64 size)
+{
+    ASSERT(isValid() && size <= ZSYNC_BLOCKSIZE);
+    return zsyncfile_write_blocksums(reinterpret_cast<unsigned char *>(data), size, _blockSums.get(), _state.get()) == 0;
+}
+
+bool ZsyncMetadataWriter::finish(QString *metadataFileName)
+{
+    ASSERT(isValid());
+
+    // We don't care for the optimal checksum lengths computed by
+    // compute_rsum_checksum_len() since we use blocks much larger
+    // than the default (1 MB instead of 8 kB) and can just store the full
+    // 24 bytes per block.
+    int rsum_len = 8;
+    int checksum_len = 16;
 
+    if (zsyncfile_write(
+            _metadata.get(), _blockSums.get(),
+            rsum_len, checksum_len,
+            0, 0, 0, // recompress
+            0, 0, // fname, mtime
+            0, 0, // urls
+            0, 0, // Uurls
+            _state.get())
+        != 0) {
+        return false;
+    }
+
+    _metadataFile.setAutoRemove(false);
+    *metadataFileName = _metadataFile.fileName();
+    return true;
+}
+
+qint64 readZsyncBlock(QIODevice *device, char *data, qint64 size)
+{
+    qint64 got = 0;
+    while (got < size) {
+        const qint64 r = device->read(data + got, size - got);
+        if (r < 0)
+            return -1;
+        if (r == 0)
+            break;
+        got += r;
+    }
+    return got;
+}
+
+void ZsyncGenerateRunnable::run()
+{
     qCDebug(lcZsyncGenerate) << "Starting generation of:" << _file;
 
-    // See ZsyncSeedRunnable for details on FILE creation
     QFile inFile(_file);
     QString error;
     if (!FileSystem::openAndSeekFileSharedRead(&inFile, &error, 0)) {
-        FileSystem::remove(zsyncmeta.fileName());
         QString error = tr("Falha ao abrir o arquivo de entrada %1: %2").arg(_file, error);
         emit failedSignal(error);
         return;
     }
-    zsync_unique_ptr<FILE> in(fdopen(dup(inFile.handle()), "r"), [](FILE *f) {
-        fclose(f);
-    });
-    if (!in) {
-        FileSystem::remove(zsyncmeta.fileName());
-        QString error = tr("Falha ao abrir o arquivo de entrada: %1").arg(_file);
+
+    ZsyncMetadataWriter writer;
+    if (!writer.isValid()) {
+        QString error = QString(tr("Falha ao gravar o arquivo de metadados zsync:")) + _file;
         emit failedSignal(error);
         return;
     }
 
-    zsync_unique_ptr<zsyncfile_state> state(zsyncfile_init(ZSYNC_BLOCKSIZE), [](zsyncfile_state *state) {
-        zsyncfile_finish(&state);
-    });
-    state->stream_error = &log_zsync_errors;
-
     /* Read the input file and construct the checksum of the whole file, and
      * the per-block checksums */
-    if (zsyncfile_read_stream_write_blocksums(in.get(), tf.get(), /*no_look_inside=*/1, state.get()) != 0) {
+    QByteArray buf(ZSYNC_BLOCKSIZE, Qt::Uninitialized);
+    qint64 got = 0;
+    while ((got = readZsyncBlock(&inFile, buf.data(), buf.size())) > 0) {
+        if (!writer.addBlock(buf.data(), got)) {
+            got = -1;
+            break;
+        }
+    }
+    if (got < 0) {
         QString error = QString(tr("Falha ao gravar somas de bloco:")) + _file;
         emit failedSignal(error);
         return;
     }
 
-    // We don't care for the optimal checksum lengths computed by
-    // compute_rsum_checksum_len() since we use blocks much larger
-    // than the default (1 MB instead of 8 kB) and can just store the full
-    // 24 bytes per block.
-    int rsum_len = 8;
-    int checksum_len = 16;
-
-    if (zsyncfile_write(
-            meta.get(), tf.get(),
-            rsum_len, checksum_len,
-            0, 0, 0, // recompress
-            0, 0, // fname, mtime
-            0, 0, // urls
-            0, 0, // Uurls
-            state.get())
-        != 0) {
+    QString metadataFileName;
+    if (!writer.finish(&metadataFileName)) {
         QString error = QString(tr("Falha ao gravar o arquivo de metadados zsync:")) + _file;
         emit failedSignal(error);
         return;
     }
 
-    qCDebug(lcZsyncGenerate) << "Done generation of:" << zsyncmeta.fileName();
+    qCDebug(lcZsyncGenerate) << "Done generation of:" << metadataFileName;
 
-    zsyncmeta.setAutoRemove(false);
-    emit finishedSignal(zsyncmeta.fileName());
+    emit finishedSignal(metadataFileName);
 }
 }
@@ -22,9 +22,16 @@
 #include <QTemporaryFile>
 #include <QRunnable>
 #include <QThreadPool>
+#include <QIODevice>
+#include <QVector>
+#include <QPair>
+
+#include <cstdio>
 
 #define ZSYNC_BLOCKSIZE (1 * 1024 * 1024) // must be power of 2
 
+struct zsyncfile_state_s;
+
 namespace OCC {
 Q_DECLARE_LOGGING_CATEGORY(lcZsyncPut)
 Q_DECLARE_LOGGING_CATEGORY(lcZsyncGet)
@@ -51,6 +58,23 @@ bool isZsyncPropagationEnabled(OwncloudPropagator *propagator, const SyncFileIte
  */
 QUrl zsyncMetadataUrl(OwncloudPropagator *propagator, const QString &path);
 
+/**
+ * @ingroup libsync
+ *
+ * Compares the block sums of two zsync metadata files block by block, without
+ * looking at the file contents.
+ *
+ * \a changedRanges receives the (start, size) byte ranges of the blocks the
+ * files have in common whose sums differ, \a oldLength the file length stored
+ * in \a oldMetadata. Blocks past the end of the shorter file are not reported.
+ * Unlike seeding, content that moved to a different offset is not found.
+ *
+ * Returns false if the metadata is malformed or the block sums can't be compared.
+ *
+ */
+bool zsyncChangedBlocks(const QByteArray &oldMetadata, const QByteArray &newMetadata,
+    QVector<QPair<qint64, qint64>> *changedRanges, qint64 *oldLength);
+
 /**
  * @ingroup libsync
  *
@@ -81,6 +105,55 @@ signals:
     void failedSignal(const QString &errorString);
 };
 
+/**
+ * @ingroup libsync
+ *
+ * Builds a zsync metadata file from file contents that are fed to it block by
+ * block. Lets callers that read the file anyway avoid a second pass over it.
+ *
+ */
+class ZsyncMetadataWriter
+{
+public:
+    ZsyncMetadataWriter();
+    ~ZsyncMetadataWriter();
+
+    /** False if the temporary files could not be set up. */
+    bool isValid() const;
+
+    /**
+     * Adds the block sums for the next \a size bytes of the file.
+     *
+     * \a data must have room for ZSYNC_BLOCKSIZE bytes and only the last call
+     * may pass less than that: short blocks are zero padded in place.
+     */
+    bool addBlock(char *data, qint64 size);
+
+    /**
+     * Writes the metadata file. On success it is not removed automatically,
+     * its path is returned in \a metadataFileName.
+     */
+    bool finish(QString *metadataFileName);
+
+private:
+    Q_DISABLE_COPY(ZsyncMetadataWriter)
+
+    QTemporaryFile _blockSumsFile;
+    QTemporaryFile _metadataFile;
+    zsync_unique_ptr<FILE> _blockSums;
+    zsync_unique_ptr<FILE> _metadata;
+    zsync_unique_ptr<zsyncfile_state_s> _state;
+};
+
+/**
+ * @ingroup libsync
+ *
+ * Fills \a data with up to \a size bytes from \a device, retrying short reads.
+ * Returns the number of bytes read or -1 on error.
+ *
+ */
+qint64 readZsyncBlock(QIODevice *device, char *data, qint64 size);
+
 /**
  * @ingroup libsync
  *
@@ -88,7 +161,7 @@ signals:
  * Takes an input file path and returns a zsync metadata file path finsihed.
  *
  */
-class ZsyncGenerateRunnable : public QObject, public QRunnable
+class OWNCLOUDSYNC_EXPORT ZsyncGenerateRunnable : public QObject, public QRunnable
 {
     Q_OBJECT
     const QString _file;
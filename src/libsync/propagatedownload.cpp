@@ -30,6 +30,8 @@
 #include <QNetworkAccessManager>
 #include <QFileInfo>
 #include <QDir>
+#include <QFutureWatcher>
+#include <qtconcurrentrun.h>
 #include <cmath>
 
 #ifdef Q_OS_UNIX
@@ -41,6 +43,16 @@ namespace OCC {
 Q_LOGGING_CATEGORY(lcGetJob, "sync.networkjob.get", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateDownload, "sync.propagator.download", QtInfoMsg)
 
+// The checksum header of a GET reply, Content-MD5 is used if there is no OC-Checksum
+static QByteArray transmissionChecksumHeader(const QNetworkReply *reply)
+{
+    auto checksumHeader = findBestChecksum(reply->rawHeader(checkSumHeaderC));
+    auto contentMd5Header = reply->rawHeader(contentMd5HeaderC);
+    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
+        checksumHeader = "MD5:" + contentMd5Header;
+    return checksumHeader;
+}
+
 // Always coming in with forward slashes.
 // In csync_excluded_no_ctx we ignore all files with longer than 254 chars
 // This function also adds a dot at the beginning of the filename to hide the file on OS X and Linux
@@ -118,7 +130,7 @@ void GETFileJob::start()
         sendRequest("GET", _directDownloadUrl, req);
     }
 
-    qCDebug(lcGetJob) << _bandwidthManager << _bandwidthChoked << _bandwidthLimited;
+    qCDebug(lcGetJob) << _bandwidthManager << _bandwidthLimited;
     if (_bandwidthManager) {
         _bandwidthManager->registerDownloadJob(this);
     }
@@ -130,7 +142,7 @@ void GETFileJob::start()
 
 void GETFileJob::newReplyHook(QNetworkReply *reply)
 {
-    reply->setReadBufferSize(16 * 1024); // keep low so we can easier limit the bandwidth
+    reply->setReadBufferSize(readBufferSize());
 
     connect(reply, &QNetworkReply::metaDataChanged, this, &GETFileJob::slotMetaDataChanged);
     connect(reply, &QIODevice::readyRead, this, &GETFileJob::slotReadyRead);
@@ -142,7 +154,7 @@ void GETFileJob::slotMetaDataChanged()
 {
     // For some reason setting the read buffer in GETFileJob::start doesn't seem to go
     // through the HTTP layer thread(?)
-    reply()->setReadBufferSize(16 * 1024);
+    reply()->setReadBufferSize(readBufferSize());
 
     int httpStatus = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
@@ -220,6 +232,9 @@ void GETFileJob::slotMetaDataChanged()
                 return;
             }
             _resumeStart = 0;
+            // The hashes of the old part don't apply anymore
+            for (auto &calculator : _streamingChecksums)
+                calculator.reset(new ChecksumCalculator(calculator->checksumType()));
         } else {
             _errorString = tr("O servidor retornou erro numa série-de-conteúdo");
             _errorStatus = SyncFileItem::NormalError;
@@ -233,31 +248,58 @@ void GETFileJob::slotMetaDataChanged()
         _lastModified = Utility::qDateTimeToTime_t(lastModified.toDateTime());
     }
 
+    if (_resumeStart == 0) {
+        const QByteArray checksumType = parseChecksumHeaderType(transmissionChecksumHeader(reply()));
+        if (!checksumType.isEmpty() && !hasStreamingChecksum(checksumType))
+            addStreamingChecksum(QSharedPointer<ChecksumCalculator>::create(checksumType));
+    }
+
     _saveBodyToFile = true;
 }
 
-void GETJob::setBandwidthManager(BandwidthManager *bwm)
+void GETFileJob::addStreamingChecksum(const QSharedPointer<ChecksumCalculator> &calculator)
 {
-    _bandwidthManager = bwm;
+    if (calculator->isValid())
+        _streamingChecksums.append(calculator);
 }
 
-void GETJob::setChoked(bool c)
+bool GETFileJob::hasStreamingChecksum(const QByteArray &checksumType) const
 {
-    _bandwidthChoked = c;
-    QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
+    for (const auto &calculator : _streamingChecksums) {
+        if (calculator->checksumType() == checksumType)
+            return true;
+    }
+    return false;
+}
+
+QMap<QByteArray, QByteArray> GETFileJob::streamedChecksums()
+{
+    QMap<QByteArray, QByteArray> checksums;
+    for (const auto &calculator : _streamingChecksums)
+        checksums.insert(calculator->checksumType(), calculator->result());
+    _streamingChecksums.clear();
+    return checksums;
+}
+
+void GETJob::setBandwidthManager(BandwidthManager *bwm)
+{
+    _bandwidthManager = bwm;
 }
 
 void GETJob::setBandwidthLimited(bool b)
 {
     _bandwidthLimited = b;
+    // A buffer size of 0 is only used for error replies, which are read at once
+    if (reply() && reply()->readBufferSize() != 0)
+        reply()->setReadBufferSize(readBufferSize());
     QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
 }
 
-void GETJob::giveBandwidthQuota(qint64 q)
+qint64 GETJob::bandwidthQuota(qint64 wanted)
 {
-    _bandwidthQuota = q;
-    qCDebug(lcGetJob) << "Got" << q << "bytes";
-    QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
+    if (!_bandwidthLimited || !_bandwidthManager)
+        return wanted;
+    return _bandwidthManager->takeDownloadQuota(this, wanted);
 }
 
 qint64 GETFileJob::currentDownloadPosition()
@@ -272,23 +314,15 @@ void GETFileJob::slotReadyRead()
 {
     if (!reply())
         return;
-    int bufferSize = qMin(1024 * 8ll, reply()->bytesAvailable());
+    int bufferSize = qMin(1024 * 64ll, reply()->bytesAvailable());
     QByteArray buffer(bufferSize, Qt::Uninitialized);
 
     while (reply()->bytesAvailable() > 0 && _saveBodyToFile) {
-        if (_bandwidthChoked) {
-            qCWarning(lcGetJob) << "Download choked";
+        qint64 toRead = bandwidthQuota(qMin(qint64(bufferSize), reply()->bytesAvailable()));
+        if (toRead == 0) {
+            qCDebug(lcGetJob) << "Out of quota";
             break;
         }
-        qint64 toRead = bufferSize;
-        if (_bandwidthLimited) {
-            toRead = qMin(qint64(bufferSize), _bandwidthQuota);
-            if (toRead == 0) {
-                qCWarning(lcGetJob) << "Out of quota";
-                break;
-            }
-            _bandwidthQuota -= toRead;
-        }
 
         qint64 r = reply()->read(buffer.data(), toRead);
         if (r < 0) {
@@ -307,6 +341,8 @@ void GETFileJob::slotReadyRead()
             reply()->abort();
             return;
         }
+        for (const auto &calculator : _streamingChecksums)
+            calculator->addData(buffer.constData(), r);
     }
 
     if (reply()->isFinished() && (reply()->bytesAvailable() == 0 || !_saveBodyToFile)) {
@@ -516,6 +552,77 @@ void PropagateDownloadFile::startDownload()
         propagator()->_journal->commit("download file start");
     }
 
+    if (_resumeStart == 0 && startLocalCopy())
+        return;
+
+    startNetworkDownload();
+}
+
+bool PropagateDownloadFile::startLocalCopy()
+{
+    // Weak checksums could match a different file of the same size
+    if (_item->_checksumHeader.isEmpty() || !csync_is_collision_safe_hash(_item->_checksumHeader))
+        return false;
+
+    // Only files that weren't changed since they were synced are known to have this content
+    QString source;
+    propagator()->_journal->getFileRecordsByChecksum(_item->_checksumHeader, [&](const SyncJournalFileRecord &record) {
+        if (!source.isEmpty() || record._fileSize != _item->_size || record._path == _item->_file.toUtf8())
+            return;
+        const QString path = propagator()->getFilePath(QString::fromUtf8(record._path));
+        if (!FileSystem::fileChanged(path, record._fileSize, record._modtime))
+            source = path;
+    });
+    if (source.isEmpty())
+        return false;
+
+    qCInfo(lcPropagateDownload) << "Copying" << source << "instead of downloading" << _item->_file;
+
+    _tmpFile.close();
+    const QString tmpFileName = _tmpFile.fileName();
+    const QByteArray checksumType = parseChecksumHeaderType(_item->_checksumHeader);
+    auto watcher = new QFutureWatcher<QByteArray>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, checksumType]() {
+        watcher->deleteLater();
+        localCopyFinished(checksumType, watcher->result());
+    });
+    propagator()->_activeJobList.append(this);
+    watcher->setFuture(QtConcurrent::run([source, tmpFileName, checksumType]() {
+        QString error;
+        if (!FileSystem::cloneFile(source, tmpFileName, &error)) {
+            qCWarning(lcPropagateDownload) << "Could not copy" << source << error;
+            return QByteArray();
+        }
+        // The source may have been changed since it was checked
+        return ComputeChecksum::computeNowOnFile(tmpFileName, checksumType);
+    }));
+    return true;
+}
+
+void PropagateDownloadFile::localCopyFinished(const QByteArray &checksumType, const QByteArray &checksum)
+{
+    propagator()->_activeJobList.removeOne(this);
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0))
+        return;
+
+    if (!checksum.isEmpty() && makeChecksumHeader(checksumType, checksum) == _item->_checksumHeader) {
+        propagator()->reportProgress(*_item, _item->_size);
+        _streamedChecksums.insert(checksumType, checksum);
+        transmissionChecksumValidated(checksumType, checksum);
+        return;
+    }
+
+    qCInfo(lcPropagateDownload) << "The local copy of" << _item->_file << "has a different checksum, downloading it";
+    if (!_tmpFile.open(QIODevice::Append | QIODevice::Unbuffered) || !_tmpFile.resize(0)) {
+        qCWarning(lcPropagateDownload) << "could not open temporary file" << _tmpFile.fileName();
+        done(SyncFileItem::NormalError, _tmpFile.errorString());
+        return;
+    }
+    startNetworkDownload();
+}
+
+void PropagateDownloadFile::startNetworkDownload()
+{
     if (_item->_remotePerm.hasPermission(RemotePermissions::HasZSyncMetadata) && isZsyncPropagationEnabled(propagator(), _item)) {
         if (_item->_previousSize) {
             // Retrieve zsync metadata file from the server
@@ -546,12 +653,14 @@ void PropagateDownloadFile::slotZsyncGetMetaFinished(QNetworkReply *reply)
 
     QByteArray zsyncData = reply->readAll();
     _expectedEtagForResume = getEtagFromReply(reply);
+    _zsyncMetadata = zsyncData;
     qCInfo(lcZsyncGet) << "Retrieved zsync metadata for:" << _item->_file << "size:" << zsyncData.size()
                        << "etag:" << _expectedEtagForResume;
 
     QMap<QByteArray, QByteArray> headers;
     _job = new GETFileZsyncJob(propagator(), _item, propagator()->_remoteFolder + _item->_file,
         &_tmpFile, headers, _expectedEtagForResume, zsyncData, this);
+    _job->setNetworkJobClass(propagator()->networkJobClass(*_item));
     connect(_job.data(), &GETJob::finishedSignal, this, &PropagateDownloadFile::slotGetFinished);
     connect(qobject_cast<GETFileZsyncJob *>(_job.data()), &GETFileZsyncJob::overallDownloadProgress,
         this, &PropagateDownloadFile::slotDownloadProgress);
@@ -563,6 +672,14 @@ void PropagateDownloadFile::slotZsyncGetMetaFinished(QNetworkReply *reply)
 
 void PropagateDownloadFile::startFullDownload()
 {
+    // The part a resumed download already has is hashed once here,
+    // everything else is hashed by the job while it arrives
+    const QByteArray checksumType = contentChecksumType();
+    if (_resumeStart > 0 && !checksumType.isEmpty() && !_resumedPartHashed) {
+        hashResumedPart(checksumType);
+        return;
+    }
+
     QMap<QByteArray, QByteArray> headers;
 
     if (_item->_directDownloadUrl.isEmpty()) {
@@ -584,13 +701,62 @@ void PropagateDownloadFile::startFullDownload()
             &_tmpFile, headers, _expectedEtagForResume, _resumeStart, this);
     }
     _job->setBandwidthManager(&propagator()->_bandwidthManager);
+    _job->setNetworkJobClass(propagator()->networkJobClass(*_item));
+    auto fileJob = qobject_cast<GETFileJob *>(_job.data());
+    if (_resumedPartChecksum) {
+        fileJob->addStreamingChecksum(_resumedPartChecksum);
+        _resumedPartChecksum.clear();
+    } else if (_resumeStart == 0 && !checksumType.isEmpty()) {
+        fileJob->addStreamingChecksum(QSharedPointer<ChecksumCalculator>::create(checksumType));
+    }
     connect(_job.data(), &GETJob::finishedSignal, this, &PropagateDownloadFile::slotGetFinished);
-    connect(qobject_cast<GETFileJob *>(_job.data()), &GETFileJob::downloadProgress,
+    connect(fileJob, &GETFileJob::downloadProgress,
         this, &PropagateDownloadFile::slotDownloadProgress);
     propagator()->_activeJobList.append(this);
     _job->start();
 }
 
+void PropagateDownloadFile::hashResumedPart(const QByteArray &checksumType)
+{
+    _resumedPartHashed = true;
+    auto calculator = QSharedPointer<ChecksumCalculator>::create(checksumType);
+    if (!calculator->isValid()) {
+        startFullDownload();
+        return;
+    }
+
+    qCInfo(lcPropagateDownload) << "Computing" << checksumType << "checksum of the" << _resumeStart
+                                << "bytes already downloaded of" << _item->_file << "in a thread";
+
+    const QString fileName = _tmpFile.fileName();
+    const qint64 size = _resumeStart;
+    auto watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, calculator]() {
+        watcher->deleteLater();
+        // Without it, the whole file is hashed after the download
+        if (watcher->result())
+            _resumedPartChecksum = calculator;
+        if (propagator()->_abortRequested.fetchAndAddRelaxed(0))
+            return;
+        startFullDownload();
+    });
+    watcher->setFuture(QtConcurrent::run([calculator, fileName, size]() {
+        QFile file(fileName);
+        QString openError;
+        if (!FileSystem::openAndSeekFileSharedRead(&file, &openError, 0))
+            return false;
+        QByteArray buf(64 * 1024, Qt::Uninitialized);
+        for (qint64 left = size; left > 0;) {
+            const qint64 got = file.read(buf.data(), qMin(left, qint64(buf.size())));
+            if (got <= 0)
+                return false;
+            calculator->addData(buf.constData(), got);
+            left -= got;
+        }
+        return true;
+    }));
+}
+
 qint64 PropagateDownloadFile::committedDiskSpace() const
 {
     if (_state == Running) {
@@ -640,6 +806,7 @@ void PropagateDownloadFile::slotGetFinished()
 
     QNetworkReply::NetworkError err = job->reply()->error();
     if (err != QNetworkReply::NoError) {
+        _item->_isCongestionError = isCongestionNetworkError(err, job->timedOut());
 
         // If we sent a 'Range' header and get 416 back, we want to retry
         // without the header.
@@ -787,19 +954,25 @@ void PropagateDownloadFile::slotGetFinished()
         // job will be deleted later.
     }
 
+    if (auto fileJob = qobject_cast<GETFileJob *>(job))
+        _streamedChecksums = fileJob->streamedChecksums();
+
     // Do checksum validation for the download. If there is no checksum header, the validator
     // will also emit the validated() signal to continue the flow in slot transmissionChecksumValidated()
     // as this is (still) also correct.
+    // The file only has to be read again if its checksum type wasn't hashed while receiving it.
     ValidateChecksumHeader *validator = new ValidateChecksumHeader(this);
     connect(validator, &ValidateChecksumHeader::validated,
         this, &PropagateDownloadFile::transmissionChecksumValidated);
     connect(validator, &ValidateChecksumHeader::validationFailed,
         this, &PropagateDownloadFile::slotChecksumFail);
-    auto checksumHeader = findBestChecksum(job->reply()->rawHeader(checkSumHeaderC));
-    auto contentMd5Header = job->reply()->rawHeader(contentMd5HeaderC);
-    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
-        checksumHeader = "MD5:" + contentMd5Header;
-    validator->start(_tmpFile.fileName(), checksumHeader);
+    const auto checksumHeader = transmissionChecksumHeader(job->reply());
+    const auto checksumType = parseChecksumHeaderType(checksumHeader);
+    if (_streamedChecksums.contains(checksumType)) {
+        validator->validate(checksumHeader, checksumType, _streamedChecksums.value(checksumType));
+    } else {
+        validator->start(_tmpFile.fileName(), checksumHeader);
+    }
 }
 
 void PropagateDownloadFile::slotChecksumFail(const QString &errMsg)
@@ -917,6 +1090,12 @@ void PropagateDownloadFile::transmissionChecksumValidated(const QByteArray &chec
         return contentChecksumComputed(checksumType, checksum);
     }
 
+    // Maybe it was hashed while downloading
+    const auto streamedChecksum = _streamedChecksums.value(theContentChecksumType);
+    if (!streamedChecksum.isEmpty()) {
+        return contentChecksumComputed(theContentChecksumType, streamedChecksum);
+    }
+
     // Compute the content checksum.
     auto computeChecksum = new ComputeChecksum(this);
     computeChecksum->setChecksumType(theContentChecksumType);
@@ -1055,8 +1234,12 @@ void PropagateDownloadFile::updateMetadata(bool isConflict)
         done(SyncFileItem::FatalError, tr("Ocorreu um erro ao escrever metadados ao banco de dados"));
         return;
     }
+    if (!_zsyncMetadata.isEmpty() && !isConflict && _expectedEtagForResume == _item->_etag) {
+        // Lets the next delta upload of this file skip fetching the metadata
+        propagator()->_journal->setZsyncMetadata(_item->_file, _item->_etag, _item->_checksumHeader, _zsyncMetadata);
+    }
     propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
-    propagator()->_journal->commit("download file start2");
+    propagator()->_journal->groupCommit("download file finished");
 
     done(isConflict ? SyncFileItem::Conflict : SyncFileItem::Success);
 
@@ -16,9 +16,11 @@
 #include "owncloudpropagator.h"
 #include "networkjobs.h"
 #include "propagatecommonzsync.h"
+#include "common/checksums.h"
 
 #include <QBuffer>
 #include <QFile>
+#include <QVector>
 
 namespace OCC {
 
@@ -30,11 +32,15 @@ protected:
     time_t _lastModified = 0;
     QString _errorString;
     SyncFileItem::Status _errorStatus = SyncFileItem::NoStatus;
-    bool _bandwidthLimited = false; // if _bandwidthQuota will be used
-    bool _bandwidthChoked = false; // if download is paused (won't read on readyRead())
-    qint64 _bandwidthQuota = 0;
+    bool _bandwidthLimited = false; // if quota must be taken from the _bandwidthManager
     QPointer<BandwidthManager> _bandwidthManager = nullptr;
 
+    /// How many of the wanted bytes may be read now, 0 means wait for the next slotReadyRead()
+    qint64 bandwidthQuota(qint64 wanted);
+
+    /// Small read buffers let a bandwidth limit take effect quickly, larger ones save wake-ups
+    qint64 readBufferSize() const { return _bandwidthLimited ? 16 * 1024 : 1024 * 1024; }
+
 public:
     GETJob(AccountPtr account, const QString &path, QObject *parent = 0)
         : AbstractNetworkJob(account, path, parent)
@@ -59,9 +65,7 @@ public:
     SyncFileItem::Status errorStatus() { return _errorStatus; }
     void setErrorStatus(const SyncFileItem::Status &s) { _errorStatus = s; }
     void setBandwidthManager(BandwidthManager *bwm);
-    void setChoked(bool c);
     void setBandwidthLimited(bool b);
-    void giveBandwidthQuota(qint64 q);
     void onTimedOut();
 
 signals:
@@ -82,8 +86,8 @@ class GETFileZsyncJob : public GETJob
     QByteArray _expectedEtagForResume;
     bool _hasEmittedFinishedSignal;
     QByteArray _zsyncData;
-    int _nrange = 0;
     int _current = 0;
+    int _nextToSend = 0;
     off_t _pos = 0;
     off_t _received = 0;
     /* these must be in this order so the destructors are done in the right order */
@@ -92,13 +96,28 @@ class GETFileZsyncJob : public GETJob
 
     /** Byte ranges that need to be received.
      *
-     * As returned by zsync_needed_byte_ranges()
+     * Built from zsync_needed_byte_ranges(), with neighbouring ranges
+     * merged according to SyncOptions::_deltaSyncRangeMergeGap.
      *
-     * That means: [begin0, end0, begin1, end1, ...]
-     * where begin and end are *inclusive* and the last
+     * Each entry is [begin, end] where end is *inclusive* and the last
      * end may very well exceed the total file size.
      */
-    zsync_unique_ptr<off_t> _zbyterange = nullptr;
+    QVector<QPair<off_t, off_t>> _ranges;
+
+    /** A range request sent ahead of the one currently fed to zsync.
+     *
+     * zsync_receive_data() must see each range from start to end before
+     * the next one begins, so the data of these requests is buffered
+     * until it is their turn. The buffers are bounded by the number of
+     * requests in flight and the range sizes.
+     */
+    struct PrefetchedRange
+    {
+        QPointer<QNetworkReply> reply;
+        QByteArray data;
+        bool failed = false;
+    };
+    QMap<int, PrefetchedRange> _prefetched;
 
 public:
     // DOES NOT take ownership of the device.
@@ -115,11 +134,19 @@ private:
     void seedFinished(void *zs);
     void seedFailed(const QString &errorString);
 
-    void startCurrentRange(qint64 start = 0, qint64 end = 0);
+    QNetworkRequest rangeRequest(int index);
+    void startCurrentRange();
+    void sendPrefetchRequests();
+    bool readPrefetchedData(PrefetchedRange &prefetched);
+
+    bool receiveRangeData(const char *data, qint64 len);
+    bool completeCurrentRange();
+    void emitFinishedSignal();
 
 private slots:
     void slotReadyRead();
     void slotMetaDataChanged();
+    void slotPrefetchMetaDataChanged();
 
 public slots:
     void slotOverallDownloadProgress(qint64, qint64);
@@ -148,6 +175,9 @@ class OWNCLOUDSYNC_EXPORT GETFileJob : public GETJob
     /// Will be set to true once we've seen a 2xx response header
     bool _saveBodyToFile = false;
 
+    /// Hashes of the data before _resumeStart and of everything written since
+    QVector<QSharedPointer<ChecksumCalculator>> _streamingChecksums;
+
 public:
     // DOES NOT take ownership of the device.
     explicit GETFileJob(AccountPtr account, const QString &path, QIODevice *device,
@@ -185,10 +215,24 @@ public:
     qint64 expectedContentLength() const { return _expectedContentLength; }
     void setExpectedContentLength(qint64 size) { _expectedContentLength = size; }
 
+    /** Hashes the body while it is written to the device.
+     *
+     * The calculator must already contain the data before resumeStart().
+     * When the download starts at the beginning of the file, a hash for the
+     * type of the reply's checksum header is added automatically.
+     */
+    void addStreamingChecksum(const QSharedPointer<ChecksumCalculator> &calculator);
+
+    /// The checksums of the downloaded file by type. Only call once, after finishedSignal().
+    QMap<QByteArray, QByteArray> streamedChecksums();
+
 private slots:
     void slotReadyRead();
     void slotMetaDataChanged();
 
+private:
+    bool hasStreamingChecksum(const QByteArray &checksumType) const;
+
 signals:
     void downloadProgress(qint64, qint64);
 };
@@ -211,6 +255,12 @@ signals:
     |                         checksum differs?                      |
     +-> startDownload() <--------------------------------------------+
         +                                                            |
+        +-> same content already synced to another local file?       |
+        |   then copy it and compute the copy's checksum             |
+        |   done?+> localCopyFinished()                              |
+        |             +                                              |
+        |             +-> identical? transmissionChecksumValidated() |
+        |                                                            |
         +-> isZsyncPropagationEnabled()?                             |
             +                                                        |
             +-+ yes +> local file exists?                            |
@@ -227,7 +277,8 @@ signals:
                                                      |               |
                   done?+> slotGetFinished() <--------+               |
                             +                                        |
-                            +-> validate checksum header             |
+                            +-> validate checksum header (hashed     |
+                                while receiving if possible)         |
                                                                      |
                   done?+> transmissionChecksumValidated()            |
                             +                                        |
@@ -248,6 +299,7 @@ class PropagateDownloadFile : public PropagateItemJob
     Q_OBJECT
     QByteArray _expectedEtagForResume;
     bool _isDeltaSyncDownload = false;
+    QByteArray _zsyncMetadata; /// the server's zsync metadata of the downloaded version
 
 public:
     PropagateDownloadFile(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
@@ -280,6 +332,10 @@ private slots:
     void conflictChecksumComputed(const QByteArray &checksumType, const QByteArray &checksum);
     /// Called to start downloading the remote file
     void startDownload();
+    /// Called when the copy of an identical local file and its checksum are done
+    void localCopyFinished(const QByteArray &checksumType, const QByteArray &checksum);
+    /// Gets the file from the server, with zsync if possible
+    void startNetworkDownload();
     void startFullDownload();
     /// Called when the GETJob finishes
     void slotGetFinished();
@@ -299,6 +355,10 @@ private slots:
 
 private:
     void deleteExistingFolder();
+    /// Hashes the part of the file that a resumed download already has, then continues with startFullDownload()
+    void hashResumedPart(const QByteArray &checksumType);
+    /// Copies a synced local file with the expected checksum into the temporary file, false if there is none
+    bool startLocalCopy();
 
     qint64 _resumeStart;
     qint64 _downloadProgress;
@@ -307,6 +367,13 @@ private:
     bool _deleteExisting;
     ConflictRecord _conflictRecord;
 
+    /// Hash of the data before _resumeStart, once hashResumedPart() is done
+    QSharedPointer<ChecksumCalculator> _resumedPartChecksum;
+    bool _resumedPartHashed = false;
+
+    /// Checksums computed while the data was received, by type
+    QMap<QByteArray, QByteArray> _streamedChecksums;
+
     QElapsedTimer _stopwatch;
 };
 }
@@ -62,29 +62,30 @@ GETFileZsyncJob::GETFileZsyncJob(OwncloudPropagator *propagator, SyncFileItemPtr
 {
 }
 
-void GETFileZsyncJob::startCurrentRange(qint64 start, qint64 end)
+QNetworkRequest GETFileZsyncJob::rangeRequest(int index)
 {
     // The end of the range might exceed the file size.
     // It's size-1 because the Range header is end-inclusive.
-    end = qMin(end, _item->_size - 1);
-
-    _headers["Range"] = "bytes=" + QByteArray::number(start) + '-' + QByteArray::number(end);
-
-    qCDebug(lcZsyncGet) << path() << "HTTP GET with range" << _headers["Range"];
+    qint64 start = _ranges[index].first;
+    qint64 end = qMin(qint64(_ranges[index].second), _item->_size - 1);
 
     QNetworkRequest req;
     for (QMap<QByteArray, QByteArray>::const_iterator it = _headers.begin(); it != _headers.end(); ++it) {
         req.setRawHeader(it.key(), it.value());
     }
+    req.setRawHeader("Range", "bytes=" + QByteArray::number(start) + '-' + QByteArray::number(end));
     req.setPriority(QNetworkRequest::LowPriority); // Long downloads must not block non-propagation jobs.
+    return req;
+}
+
+void GETFileZsyncJob::startCurrentRange()
+{
+    QNetworkRequest req = rangeRequest(_current);
+    qCDebug(lcZsyncGet) << path() << "HTTP GET with range" << req.rawHeader("Range");
 
     sendRequest("GET", makeDavUrl(path()), req);
 
-    reply()->setReadBufferSize(16 * 1024); // keep low so we can easier limit the bandwidth
-    qCDebug(lcZsyncGet) << _bandwidthManager << _bandwidthChoked << _bandwidthLimited;
-    if (_bandwidthManager) {
-        _bandwidthManager->registerDownloadJob(this);
-    }
+    reply()->setReadBufferSize(readBufferSize());
 
     if (reply()->error() != QNetworkReply::NoError) {
         qCWarning(lcZsyncGet) << " Network error: " << errorString();
@@ -95,47 +96,133 @@ void GETFileZsyncJob::startCurrentRange(qint64 start, qint64 end)
     connect(reply(), &QNetworkReply::downloadProgress, this, &GETFileZsyncJob::slotOverallDownloadProgress);
     connect(reply(), &QIODevice::readyRead, this, &GETFileZsyncJob::slotReadyRead);
     connect(reply(), &QNetworkReply::metaDataChanged, this, &GETFileZsyncJob::slotMetaDataChanged);
-    connect(this, &AbstractNetworkJob::networkActivity, account().data(), &Account::propagatorNetworkActivity);
 
     AbstractNetworkJob::start();
 }
 
-bool GETFileZsyncJob::finished()
+void GETFileZsyncJob::sendPrefetchRequests()
 {
-    if (reply()->bytesAvailable()) {
+    const int maxInFlight = qMax(1, _propagator->syncOptions()._deltaSyncMaxRangeRequests);
+    _nextToSend = qMax(_nextToSend, _current + 1);
+    while (_nextToSend < _ranges.size() && _nextToSend - _current < maxInFlight) {
+        QNetworkRequest req = rangeRequest(_nextToSend);
+        qCDebug(lcZsyncGet) << path() << "HTTP GET ahead with range" << req.rawHeader("Range");
+
+        // These replies are owned by the job; they are only adopted as reply()
+        // once it is their turn to be fed to zsync.
+        QNetworkReply *prefetchReply = account()->sendRawRequest("GET", makeDavUrl(path()), req, nullptr, networkJobClass());
+        prefetchReply->setParent(this);
+        prefetchReply->setProperty("doNotHandleAuth", true);
+        prefetchReply->setReadBufferSize(readBufferSize()); // shares the bandwidth quota with the current range
+
+        connect(prefetchReply, &QNetworkReply::metaDataChanged, this, &GETFileZsyncJob::slotPrefetchMetaDataChanged);
+        connect(prefetchReply, &QIODevice::readyRead, this, &GETFileZsyncJob::slotReadyRead);
+        connect(prefetchReply, &QNetworkReply::downloadProgress, this, &AbstractNetworkJob::networkActivity);
+
+        _prefetched[_nextToSend].reply = prefetchReply;
+        _nextToSend++;
+    }
+}
+
+bool GETFileZsyncJob::receiveRangeData(const char *data, qint64 len)
+{
+    qCDebug(lcZsyncGet) << "About to zsync" << len << "bytes @" << _ranges[_current].first << "pos:" << _pos << "of" << path();
+
+    if (zsync_receive_data(_zr.get(), (const unsigned char *)data, _ranges[_current].first + _pos, len) != 0) {
+        _errorString = "Failed to receive data for: " + _propagator->getFilePath(_item->_file);
+        _errorStatus = SyncFileItem::NormalError;
+        qCWarning(lcZsyncGet) << "Error while writing to file:" << _errorString;
         return false;
     }
+    _pos += len;
+    return true;
+}
 
+bool GETFileZsyncJob::completeCurrentRange()
+{
     // zsync_receive_data will only complete once we have sent block aligned data
-    off_t range_size = _zbyterange.get()[(2 * _current) + 1] - _zbyterange.get()[(2 * _current)] + 1;
+    off_t range_size = _ranges[_current].second - _ranges[_current].first + 1;
     if (_pos < range_size) {
         QByteArray fill(range_size - _pos, 0);
-        qCDebug(lcZsyncGet) << "About to zsync" << range_size - _pos << "filler bytes @" << _zbyterange.get()[2 * _current] << "pos:" << _pos << "of" << path();
-        if (zsync_receive_data(_zr.get(), (const unsigned char *)fill.constData(), _zbyterange.get()[2 * _current] + _pos, range_size - _pos) != 0) {
-            _errorString = "Failed to receive data for: " + _propagator->getFilePath(_item->_file);
-            _errorStatus = SyncFileItem::NormalError;
-            qCWarning(lcZsyncGet) << "Error while writing to file:" << _errorString;
-            reply()->abort();
-            emit finishedSignal();
-            return true;
-        }
-    }
-
-    // chain the next range if we still have some
-    if (_current < _nrange - 1) {
-        _current++;
-        startCurrentRange(_zbyterange.get()[2 * _current], _zbyterange.get()[(2 * _current) + 1]);
-        return false;
+        qCDebug(lcZsyncGet) << "About to zsync" << range_size - _pos << "filler bytes";
+        return receiveRangeData(fill.constData(), fill.size());
     }
+    return true;
+}
 
+void GETFileZsyncJob::emitFinishedSignal()
+{
     if (!_hasEmittedFinishedSignal) {
         _zr.reset();
         _zs.reset(); // ensure the file is closed.
         emit finishedSignal();
     }
-
     _hasEmittedFinishedSignal = true;
+}
+
+bool GETFileZsyncJob::finished()
+{
+    if (reply()->bytesAvailable()) {
+        return false;
+    }
 
+    // Errors on the current range are handled by PropagateDownloadFile via reply()
+    int httpStatus = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply()->error() != QNetworkReply::NoError || httpStatus / 100 != 2 || _errorStatus != SyncFileItem::NoStatus) {
+        emitFinishedSignal();
+        return true;
+    }
+
+    if (!completeCurrentRange()) {
+        emitFinishedSignal();
+        return true;
+    }
+
+    // Continue with the next range: it is either already in flight, done, or not sent yet
+    while (++_current < _ranges.size()) {
+        _pos = 0;
+        PrefetchedRange prefetched = _prefetched.take(_current);
+        QNetworkReply *prefetchReply = prefetched.reply;
+
+        if (prefetchReply && !prefetched.failed && !prefetchReply->isFinished()) {
+            if (!receiveRangeData(prefetched.data.constData(), prefetched.data.size())) {
+                emitFinishedSignal();
+                return true;
+            }
+            // Drive the running request like the ones we start ourselves
+            disconnect(prefetchReply, &QNetworkReply::metaDataChanged, this, &GETFileZsyncJob::slotPrefetchMetaDataChanged);
+            connect(prefetchReply, &QNetworkReply::downloadProgress, this, &GETFileZsyncJob::slotOverallDownloadProgress);
+            connect(prefetchReply, &QNetworkReply::metaDataChanged, this, &GETFileZsyncJob::slotMetaDataChanged);
+            adoptRequest(prefetchReply);
+            sendPrefetchRequests();
+            QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
+            return false;
+        }
+
+        if (prefetchReply && !prefetched.failed && prefetchReply->error() == QNetworkReply::NoError) {
+            // Already complete, only the tail that did not fit the read buffer is left
+            QByteArray tail = prefetchReply->readAll();
+            _received += tail.size();
+            prefetched.data += tail;
+            delete prefetchReply;
+            if (!receiveRangeData(prefetched.data.constData(), prefetched.data.size()) || !completeCurrentRange()) {
+                emitFinishedSignal();
+                return true;
+            }
+            continue;
+        }
+
+        // Never sent, or failed: (re)request it so errors get reported the usual way
+        if (prefetchReply) {
+            qCInfo(lcZsyncGet) << "Retrying range" << _current << "of" << path();
+            delete prefetchReply;
+        }
+        startCurrentRange();
+        sendPrefetchRequests();
+        return false;
+    }
+
+    emitFinishedSignal();
     return true; // discard
 }
 
@@ -164,10 +251,11 @@ void GETFileZsyncJob::seedFinished(void *zs)
     }
 
     /* Get a set of byte ranges that we need to complete the target */
-    _zbyterange = zsync_unique_ptr<off_t>(zsync_needed_byte_ranges(_zs.get(), &_nrange, 0), [](off_t *zbr) {
+    int nrange = 0;
+    zsync_unique_ptr<off_t> zbyterange(zsync_needed_byte_ranges(_zs.get(), &nrange, 0), [](off_t *zbr) {
         free(zbr);
     });
-    if (!_zbyterange) {
+    if (!zbyterange) {
         _errorString = tr("Falha ao obter os intervalos de bytes do zsync.");
         _errorStatus = SyncFileItem::NormalError;
         qCDebug(lcZsyncGet) << _errorString;
@@ -175,10 +263,21 @@ void GETFileZsyncJob::seedFinished(void *zs)
         return;
     }
 
-    qCDebug(lcZsyncGet) << "Number of ranges:" << _nrange;
+    const qint64 mergeGap = _propagator->syncOptions()._deltaSyncRangeMergeGap;
+    for (int i = 0; i < nrange; i++) {
+        off_t begin = zbyterange.get()[2 * i];
+        off_t end = zbyterange.get()[(2 * i) + 1];
+        if (!_ranges.isEmpty() && begin - _ranges.last().second - 1 <= mergeGap) {
+            _ranges.last().second = qMax(_ranges.last().second, end);
+        } else {
+            _ranges.append(qMakePair(begin, end));
+        }
+    }
+
+    qCDebug(lcZsyncGet) << "Number of ranges:" << nrange << "requests:" << _ranges.size();
 
     /* If we have no ranges then we have equal files and we are done */
-    if (_nrange == 0 && _item->_size == qint64(zsync_file_length(_zs.get()))) {
+    if (_ranges.isEmpty() && _item->_size == qint64(zsync_file_length(_zs.get()))) {
         _propagator->reportFileTotal(*_item, 0);
         _errorStatus = SyncFileItem::Success;
         _zr.reset();
@@ -187,6 +286,14 @@ void GETFileZsyncJob::seedFinished(void *zs)
         return;
     }
 
+    if (_ranges.isEmpty()) {
+        _errorString = tr("Os metadados do zsync não correspondem ao tamanho do arquivo.");
+        _errorStatus = SyncFileItem::NormalError;
+        qCDebug(lcZsyncGet) << _errorString << _item->_size << zsync_file_length(_zs.get());
+        emit finishedSignal();
+        return;
+    }
+
     _zr = zsync_unique_ptr<struct zsync_receiver>(zsync_begin_receive(_zs.get(), 0), [](struct zsync_receiver *zr) {
         zsync_end_receive(zr);
     });
@@ -199,15 +306,23 @@ void GETFileZsyncJob::seedFinished(void *zs)
     }
 
     quint64 totalBytes = 0;
-    for (int i = 0; i < _nrange; i++) {
-        totalBytes += _zbyterange.get()[(2 * i) + 1] - _zbyterange.get()[(2 * i)] + 1;
+    for (const auto &range : _ranges) {
+        totalBytes += range.second - range.first + 1;
     }
 
     qCDebug(lcZsyncGet) << "Total bytes:" << totalBytes;
     _propagator->reportFileTotal(*_item, totalBytes);
 
-    /* start getting bytes for first zsync byte range */
-    startCurrentRange(_zbyterange.get()[0], _zbyterange.get()[1]);
+    qCDebug(lcZsyncGet) << _bandwidthManager << _bandwidthLimited;
+    if (_bandwidthManager) {
+        _bandwidthManager->registerDownloadJob(this);
+    }
+    connect(this, &AbstractNetworkJob::networkActivity, account().data(), &Account::propagatorNetworkActivity);
+
+    /* start getting bytes for the first zsync byte range, and the next ones ahead of time */
+    _current = 0;
+    startCurrentRange();
+    sendPrefetchRequests();
 }
 
 void GETFileZsyncJob::seedFailed(const QString &errorString)
@@ -245,23 +360,15 @@ void GETFileZsyncJob::slotReadyRead()
     if (!reply())
         return;
 
-    int bufferSize = qMin(1024 * 8ll, reply()->bytesAvailable());
+    int bufferSize = qMin(1024 * 64ll, reply()->bytesAvailable());
     QByteArray buffer(bufferSize, Qt::Uninitialized);
 
     while (reply()->bytesAvailable() > 0) {
-        if (_bandwidthChoked) {
-            qCWarning(lcZsyncGet) << "Download choked";
+        qint64 toRead = bandwidthQuota(qMin(qint64(bufferSize), reply()->bytesAvailable()));
+        if (toRead == 0) {
+            qCDebug(lcZsyncGet) << "Out of quota";
             return;
         }
-        qint64 toRead = bufferSize;
-        if (_bandwidthLimited) {
-            toRead = qMin(qint64(bufferSize), _bandwidthQuota);
-            if (toRead == 0) {
-                qCWarning(lcZsyncGet) << "Out of quota";
-                return;
-            }
-            _bandwidthQuota -= toRead;
-        }
 
         qint64 r = reply()->read(buffer.data(), toRead);
         if (r < 0) {
@@ -272,25 +379,72 @@ void GETFileZsyncJob::slotReadyRead()
             return;
         }
 
-        if (!_nrange) {
+        if (_ranges.isEmpty()) {
             qCWarning(lcZsyncGet) << "No ranges to fetch.";
             _received += r;
             _pos += r;
             return;
         }
 
-        qCDebug(lcZsyncGet) << "About to zsync" << r << "bytes @" << _zbyterange.get()[2 * _current] << "pos:" << _pos << "of" << path();
-
-        if (zsync_receive_data(_zr.get(), (const unsigned char *)buffer.constData(), _zbyterange.get()[2 * _current] + _pos, r) != 0) {
-            _errorString = "Failed to receive data for: " + _propagator->getFilePath(_item->_file);
-            _errorStatus = SyncFileItem::NormalError;
-            qCWarning(lcZsyncGet) << "Error while writing to file:" << _errorString;
+        _received += r;
+        if (!receiveRangeData(buffer.constData(), r)) {
             reply()->abort();
             return;
         }
+    }
 
-        _received += r;
-        _pos += r;
+    // Whatever quota is left goes to the requests sent ahead
+    for (auto it = _prefetched.begin(); it != _prefetched.end(); ++it) {
+        if (!readPrefetchedData(it.value())) {
+            return;
+        }
+    }
+}
+
+bool GETFileZsyncJob::readPrefetchedData(PrefetchedRange &prefetched)
+{
+    QNetworkReply *prefetchReply = prefetched.reply;
+    if (!prefetchReply || prefetched.failed) {
+        return true;
+    }
+
+    while (prefetchReply->bytesAvailable() > 0) {
+        qint64 toRead = bandwidthQuota(prefetchReply->bytesAvailable());
+        if (toRead == 0) {
+            return false;
+        }
+
+        QByteArray data = prefetchReply->read(toRead);
+        _received += data.size();
+        prefetched.data += data;
+    }
+    return true;
+}
+
+void GETFileZsyncJob::slotPrefetchMetaDataChanged()
+{
+    auto prefetchReply = qobject_cast<QNetworkReply *>(sender());
+    if (!prefetchReply) {
+        return;
+    }
+    for (auto it = _prefetched.begin(); it != _prefetched.end(); ++it) {
+        if (it.value().reply != prefetchReply) {
+            continue;
+        }
+
+        // Anything unusual (redirects, auth, errors, changed etag) is left to the
+        // normal request path: the range is requested again once it is its turn.
+        int httpStatus = prefetchReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        QByteArray etag = getEtagFromReply(prefetchReply);
+        if (httpStatus / 100 != 2 || prefetchReply->error() != QNetworkReply::NoError
+            || (!_expectedEtagForResume.isEmpty() && _expectedEtagForResume != etag)) {
+            qCInfo(lcZsyncGet) << "Dropping range requested ahead" << it.key() << "of" << path()
+                               << httpStatus << etag;
+            it.value().failed = true;
+            it.value().data.clear();
+            prefetchReply->abort();
+        }
+        return;
     }
 }
 
@@ -298,7 +452,7 @@ void GETFileZsyncJob::slotMetaDataChanged()
 {
     // For some reason setting the read buffer in GETFileJob::start doesn't seem to go
     // through the HTTP layer thread(?)
-    reply()->setReadBufferSize(16 * 1024);
+    reply()->setReadBufferSize(readBufferSize());
 
     int httpStatus = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
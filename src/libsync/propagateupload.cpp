@@ -32,6 +32,7 @@
 #include <QDir>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <qtconcurrentrun.h>
 #include <cmath>
 #include <cstring>
 
@@ -179,6 +180,13 @@ bool PollJob::finished()
     return true;
 }
 
+PropagateUploadFileCommon::~PropagateUploadFileCommon()
+{
+    if (!_zsyncMetadataFile.isEmpty()) {
+        FileSystem::remove(_zsyncMetadataFile);
+    }
+}
+
 void PropagateUploadFileCommon::setDeleteExisting(bool enabled)
 {
     _deleteExisting = enabled;
@@ -237,51 +245,84 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
 
     QByteArray checksumType = contentChecksumType();
 
+    // Reuse the content checksum as the transmission checksum if possible
+    QByteArray transmissionChecksumType;
+    if (propagator()->account()->capabilities().supportedChecksumTypes().contains(checksumType)) {
+        transmissionChecksumType = checksumType;
+    } else if (uploadChecksumEnabled()) {
+        transmissionChecksumType = propagator()->account()->capabilities().uploadChecksumType();
+    }
+
+    const bool generateZsyncMetadata = uploadsZsyncMetadata();
+
     // Maybe the discovery already computed the checksum?
     QByteArray existingChecksumType, existingChecksum;
     parseChecksumHeader(_item->_checksumHeader, &existingChecksumType, &existingChecksum);
     if (existingChecksumType == checksumType) {
-        slotComputeTransmissionChecksum(checksumType, existingChecksum);
-        return;
+        _item->_checksumHeader = makeChecksumHeader(existingChecksumType, existingChecksum);
+        if (transmissionChecksumType == checksumType) {
+            if (!generateZsyncMetadata) {
+                slotStartUpload(checksumType, existingChecksum);
+                return;
+            }
+            transmissionChecksumType.clear();
+        }
+        checksumType.clear();
     }
 
-    // Compute the content checksum.
-    auto computeChecksum = new ComputeChecksum(this);
-    computeChecksum->setChecksumType(checksumType);
+    // Read the file once for everything that still needs to be computed
+    auto computeChecksums = new ComputeUploadChecksums(this);
+    computeChecksums->setContentChecksumType(checksumType);
+    computeChecksums->setTransmissionChecksumType(transmissionChecksumType);
+    computeChecksums->setGenerateZsyncMetadata(generateZsyncMetadata);
 
-    connect(computeChecksum, &ComputeChecksum::done,
-        this, &PropagateUploadFileCommon::slotComputeTransmissionChecksum);
-    connect(computeChecksum, &ComputeChecksum::done,
-        computeChecksum, &QObject::deleteLater);
-    computeChecksum->start(filePath);
+    connect(computeChecksums, &ComputeUploadChecksums::progress,
+        this, &PropagateUploadFileCommon::slotChecksumProgress);
+    connect(computeChecksums, &ComputeUploadChecksums::done,
+        this, &PropagateUploadFileCommon::slotChecksumsComputed);
+    connect(computeChecksums, &ComputeUploadChecksums::done,
+        computeChecksums, &QObject::deleteLater);
+    computeChecksums->start(filePath);
 }
 
-void PropagateUploadFileCommon::slotComputeTransmissionChecksum(const QByteArray &contentChecksumType, const QByteArray &contentChecksum)
+void PropagateUploadFileCommon::slotChecksumProgress(qint64 done, qint64 total)
 {
-    _item->_checksumHeader = makeChecksumHeader(contentChecksumType, contentChecksum);
+    qCDebug(lcPropagateUpload) << "Computing checksums of" << _item->_file << ":" << done << "of" << total << "bytes read";
+    propagator()->reportChecksumProgress(*_item, done);
+}
 
-    // Reuse the content checksum as the transmission checksum if possible
+void PropagateUploadFileCommon::slotChecksumsComputed()
+{
+    auto computeChecksums = qobject_cast<ComputeUploadChecksums *>(sender());
+    ASSERT(computeChecksums);
+    const auto &result = computeChecksums->result();
+
+    if (!result.errorString.isEmpty()) {
+        // slotStartUpload() and the zsync metadata generation deal with files
+        // that went away or can't be read.
+        qCWarning(lcPropagateUpload) << "Could not compute checksums of" << _item->_file << result.errorString;
+    }
+
+    if (!computeChecksums->contentChecksumType().isEmpty()) {
+        _item->_checksumHeader = makeChecksumHeader(result.contentChecksumType, result.contentChecksum);
+    }
+    _zsyncMetadataFile = result.zsyncMetadataFile;
+
+    if (!computeChecksums->transmissionChecksumType().isEmpty()) {
+        slotStartUpload(result.transmissionChecksumType, result.transmissionChecksum);
+        return;
+    }
+
+    // No separate transmission checksum was computed: reuse the content checksum if possible
+    QByteArray contentChecksumType, contentChecksum;
+    parseChecksumHeader(_item->_checksumHeader, &contentChecksumType, &contentChecksum);
     const auto supportedTransmissionChecksums =
         propagator()->account()->capabilities().supportedChecksumTypes();
     if (supportedTransmissionChecksums.contains(contentChecksumType)) {
         slotStartUpload(contentChecksumType, contentChecksum);
-        return;
-    }
-
-    // Compute the transmission checksum.
-    auto computeChecksum = new ComputeChecksum(this);
-    if (uploadChecksumEnabled()) {
-        computeChecksum->setChecksumType(propagator()->account()->capabilities().uploadChecksumType());
     } else {
-        computeChecksum->setChecksumType(QByteArray());
+        slotStartUpload(QByteArray(), QByteArray());
     }
-
-    connect(computeChecksum, &ComputeChecksum::done,
-        this, &PropagateUploadFileCommon::slotStartUpload);
-    connect(computeChecksum, &ComputeChecksum::done,
-        computeChecksum, &QObject::deleteLater);
-    const QString filePath = propagator()->getFilePath(_item->_file);
-    computeChecksum->start(filePath);
 }
 
 void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum)
@@ -326,19 +367,262 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
         return;
     }
 
+    if (startRemoteCopy())
+        return;
+
+    doStartUpload();
+}
+
+bool PropagateUploadFileCommon::startRemoteCopy()
+{
+    // Only new files: a copy must not replace changes made on the server.
+    // Small files are uploaded faster than the extra requests take, and
+    // zsync metadata can only be uploaded along with the file.
+    if (_item->_instruction != CSYNC_INSTRUCTION_NEW || _deleteExisting
+        || _item->_size < propagator()->smallFileSize()
+        || !_zsyncMetadataFile.isEmpty()
+        || !csync_is_collision_safe_hash(_item->_checksumHeader)) {
+        return false;
+    }
+
+    SyncJournalFileRecord source;
+    propagator()->_journal->getFileRecordsByChecksum(_item->_checksumHeader, [&](const SyncJournalFileRecord &record) {
+        if (!source.isValid() && record._fileSize == _item->_size && !record._etag.isEmpty()
+            && record._path != _item->_file.toUtf8()) {
+            source = record;
+        }
+    });
+    if (!source.isValid())
+        return false;
+
+    qCInfo(lcPropagateUpload) << "Copying" << source._path << "on the server instead of uploading" << _item->_file;
+
+    QNetworkRequest req;
+    const QString destination = QDir::cleanPath(propagator()->account()->davUrl().path()
+        + propagator()->_remoteFolder + _item->_file);
+    req.setRawHeader("Destination", QUrl::toPercentEncoding(destination, "/"));
+    req.setRawHeader("Overwrite", "F");
+    // Fails if the server's file isn't the version the checksum was recorded for
+    req.setRawHeader("If-Match", '"' + source._etag + '"');
+    const QUrl url = Utility::concatUrlPath(propagator()->account()->davUrl(),
+        propagator()->_remoteFolder + QString::fromUtf8(source._path));
+
+    propagator()->_activeJobList.append(this);
+    auto job = propagator()->account()->sendRequest("COPY", url, req);
+    _jobs.append(job);
+    connect(job, &SimpleNetworkJob::finishedSignal, this, &PropagateUploadFileCommon::slotRemoteCopyFinished);
+    connect(job, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
+    return true;
+}
+
+void PropagateUploadFileCommon::slotRemoteCopyFinished(QNetworkReply *reply)
+{
+    const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply->error() != QNetworkReply::NoError || httpStatus / 100 != 2) {
+        qCInfo(lcPropagateUpload) << "COPY to" << _item->_file << "failed with status" << httpStatus << reply->errorString();
+        return slotRemoteCopyFailed();
+    }
+
+    // The copy has the modification time of its source
+    auto job = new ProppatchJob(propagator()->account(), propagator()->_remoteFolder + _item->_file, this);
+    _jobs.append(job);
+    QMap<QByteArray, QByteArray> properties;
+    properties["DAV::lastmodified"] = QByteArray::number(qint64(_item->_modtime));
+    job->setProperties(properties);
+    connect(job, &ProppatchJob::success, this, &PropagateUploadFileCommon::slotRemoteCopyMtimeSet);
+    // Without the right modification time the copy is replaced by an upload
+    connect(job, &ProppatchJob::finishedWithError, this, &PropagateUploadFileCommon::slotRemoteCopyFailed);
+    connect(job, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
+    job->start();
+}
+
+void PropagateUploadFileCommon::slotRemoteCopyMtimeSet()
+{
+    if (_aborting)
+        return;
+
+    auto job = new PropfindJob(propagator()->account(), propagator()->_remoteFolder + _item->_file, this);
+    _jobs.append(job);
+    job->setProperties({ "getetag", "http://owncloud.org/ns:id", "http://owncloud.org/ns:checksums" });
+    connect(job, &PropfindJob::result, this, &PropagateUploadFileCommon::slotRemoteCopyInfo);
+    connect(job, &PropfindJob::finishedWithError, this, &PropagateUploadFileCommon::slotRemoteCopyFailed);
+    connect(job, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
+    job->start();
+}
+
+void PropagateUploadFileCommon::slotRemoteCopyInfo(const QVariantMap &values)
+{
+    const QByteArray etag = parseEtag(values.value("getetag").toByteArray());
+    if (etag.isEmpty())
+        return slotRemoteCopyFailed();
+
+    // If the server knows a checksum of the copy, it has to be ours
+    QByteArray expectedType, expectedChecksum;
+    parseChecksumHeader(_item->_checksumHeader, &expectedType, &expectedChecksum);
+    for (const auto &header : values.value("checksums").toByteArray().split(' ')) {
+        QByteArray type, checksum;
+        if (parseChecksumHeader(header, &type, &checksum)
+            && type.toUpper() == expectedType.toUpper() && checksum != expectedChecksum) {
+            qCWarning(lcPropagateUpload) << "The server's copy of" << _item->_file << "has the checksum" << header;
+            return slotRemoteCopyFailed();
+        }
+    }
+
+    propagator()->_activeJobList.removeOne(this);
+    _item->_etag = etag;
+    _item->_fileId = values.value("id").toByteArray();
+    propagator()->reportProgress(*_item, _item->_size);
+    finalize();
+}
+
+void PropagateUploadFileCommon::slotRemoteCopyFailed()
+{
+    if (_aborting)
+        return;
+    propagator()->_activeJobList.removeOne(this);
+    qCInfo(lcPropagateUpload) << "Uploading" << _item->_file;
     doStartUpload();
 }
 
+ComputeUploadChecksums::ComputeUploadChecksums(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ComputeUploadChecksums::~ComputeUploadChecksums()
+{
+    // Let a still running calculation stop at the next block
+    if (_state) {
+        _state->aborted.storeRelease(1);
+    }
+}
+
+void ComputeUploadChecksums::start(const QString &filePath)
+{
+    qCInfo(lcPropagateUpload) << "Computing" << _contentChecksumType << _transmissionChecksumType << "checksums"
+                              << (_generateZsyncMetadata ? "and zsync metadata" : "") << "of" << filePath << "in a thread";
+
+    connect(&_watcher, &QFutureWatcherBase::finished,
+        this, &ComputeUploadChecksums::slotCalculationDone,
+        Qt::UniqueConnection);
+    connect(&_progressTimer, &QTimer::timeout,
+        this, &ComputeUploadChecksums::slotReportProgress,
+        Qt::UniqueConnection);
+
+    _fileSize = FileSystem::getSize(filePath);
+    _reportedBytes = 0;
+    _state = QSharedPointer<SharedState>::create();
+    _progressTimer.start(500);
+
+    auto state = _state;
+    auto contentChecksumType = _contentChecksumType;
+    auto transmissionChecksumType = _transmissionChecksumType;
+    auto generateZsyncMetadata = _generateZsyncMetadata;
+    _watcher.setFuture(QtConcurrent::run([=]() {
+        return compute(filePath, contentChecksumType, transmissionChecksumType, generateZsyncMetadata, state.data());
+    }));
+}
+
+ComputeUploadChecksums::Result ComputeUploadChecksums::computeNow(const QString &filePath) const
+{
+    return compute(filePath, _contentChecksumType, _transmissionChecksumType, _generateZsyncMetadata, nullptr);
+}
+
+ComputeUploadChecksums::Result ComputeUploadChecksums::compute(const QString &filePath,
+    const QByteArray &contentChecksumType, const QByteArray &transmissionChecksumType,
+    bool generateZsyncMetadata, SharedState *state)
+{
+    Result result;
+
+    QFile file(filePath);
+    QString openError;
+    if (!FileSystem::openAndSeekFileSharedRead(&file, &openError, 0)) {
+        result.errorString = openError;
+        return result;
+    }
+
+    ChecksumCalculator content(contentChecksumType);
+    std::unique_ptr<ChecksumCalculator> transmission;
+    if (transmissionChecksumType != contentChecksumType) {
+        transmission.reset(new ChecksumCalculator(transmissionChecksumType));
+    }
+    std::unique_ptr<ZsyncMetadataWriter> zsync;
+    if (generateZsyncMetadata) {
+        zsync.reset(new ZsyncMetadataWriter);
+        if (!zsync->isValid()) {
+            // The checksums are still useful without it
+            result.errorString = tr("Falha ao gravar o arquivo de metadados zsync:") + filePath;
+            zsync.reset();
+        }
+    }
+
+    // The zsync block sums need whole blocks, the hashes don't care
+    QByteArray buf(ZSYNC_BLOCKSIZE, Qt::Uninitialized);
+    qint64 got = 0;
+    while ((got = readZsyncBlock(&file, buf.data(), buf.size())) > 0) {
+        if (state && state->aborted.loadAcquire()) {
+            return Result();
+        }
+
+        content.addData(buf.constData(), got);
+        if (transmission) {
+            transmission->addData(buf.constData(), got);
+        }
+        // Goes last: short blocks are zero padded in place
+        if (zsync && !zsync->addBlock(buf.data(), got)) {
+            result.errorString = tr("Falha ao gravar somas de bloco:") + filePath;
+            zsync.reset();
+        }
+
+        if (state) {
+            state->bytesRead.fetchAndAddRelaxed(got);
+        }
+    }
+    if (got < 0) {
+        result.errorString = file.errorString();
+        return result;
+    }
+
+    result.contentChecksum = content.result();
+    if (!result.contentChecksum.isNull()) {
+        result.contentChecksumType = contentChecksumType;
+    }
+    result.transmissionChecksum = transmission ? transmission->result() : result.contentChecksum;
+    if (!result.transmissionChecksum.isNull()) {
+        result.transmissionChecksumType = transmissionChecksumType;
+    }
+
+    if (zsync && !zsync->finish(&result.zsyncMetadataFile)) {
+        result.errorString = tr("Falha ao gravar o arquivo de metadados zsync:") + filePath;
+    }
+    return result;
+}
+
+void ComputeUploadChecksums::slotCalculationDone()
+{
+    _progressTimer.stop();
+    slotReportProgress();
+
+    _result = _watcher.future().result();
+    emit done();
+}
+
+void ComputeUploadChecksums::slotReportProgress()
+{
+    const qint64 bytesRead = _state->bytesRead.load();
+    if (bytesRead != _reportedBytes) {
+        _reportedBytes = bytesRead;
+        emit progress(bytesRead, _fileSize);
+    }
+}
+
 UploadDevice::UploadDevice(const QString &fileName, qint64 start, qint64 size, BandwidthManager *bwm)
     : _file(fileName)
     , _start(start)
     , _size(size)
     , _read(0)
     , _bandwidthManager(bwm)
-    , _bandwidthQuota(0)
-    , _readWithProgress(0)
     , _bandwidthLimited(false)
-    , _choked(false)
 {
     _bandwidthManager->registerUploadDevice(this);
 }
@@ -397,15 +681,11 @@ qint64 UploadDevice::readData(char *data, qint64 maxlen)
     if (maxlen <= 0) {
         return 0;
     }
-    if (isChoked()) {
-        return 0;
-    }
-    if (isBandwidthLimited()) {
-        maxlen = qMin(maxlen, _bandwidthQuota);
-        if (maxlen <= 0) { // no quota
+    if (isBandwidthLimited() && _bandwidthManager) {
+        maxlen = _bandwidthManager->takeUploadQuota(this, maxlen);
+        if (maxlen <= 0) { // no quota, readyRead() is emitted when there is
             return 0;
         }
-        _bandwidthQuota -= maxlen;
     }
 
     auto c = _file.read(data, maxlen);
@@ -417,14 +697,6 @@ qint64 UploadDevice::readData(char *data, qint64 maxlen)
     return c;
 }
 
-void UploadDevice::slotJobUploadProgress(qint64 sent, qint64 t)
-{
-    if (sent == 0 || t == 0) {
-        return;
-    }
-    _readWithProgress = sent;
-}
-
 bool UploadDevice::atEnd() const
 {
     return _read >= _size;
@@ -459,28 +731,12 @@ bool UploadDevice::seek(qint64 pos)
     return true;
 }
 
-void UploadDevice::giveBandwidthQuota(qint64 bwq)
-{
-    if (!atEnd()) {
-        _bandwidthQuota = bwq;
-        QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection); // tell QNAM that we have quota
-    }
-}
-
 void UploadDevice::setBandwidthLimited(bool b)
 {
     _bandwidthLimited = b;
     QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
 }
 
-void UploadDevice::setChoked(bool b)
-{
-    _choked = b;
-    if (!_choked) {
-        QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
-    }
-}
-
 void PropagateUploadFileCommon::startPollJob(const QString &path)
 {
     PollJob *job = new PollJob(propagator()->account(), path, _item,
@@ -534,7 +790,7 @@ void PropagateUploadFileCommon::checkResettingErrors()
                                       << "is" << uploadInfo._errorCount;
         }
         propagator()->_journal->setUploadInfo(_item->_file, uploadInfo);
-        propagator()->_journal->commit("Upload info");
+        propagator()->_journal->groupCommit("Upload info");
     }
 }
 
@@ -543,6 +799,7 @@ void PropagateUploadFileCommon::commonErrorHandling(AbstractNetworkJob *job)
     QByteArray replyContent;
     QString errorString = job->errorStringParsingBody(&replyContent);
     qCDebug(lcPropagateUpload) << replyContent; // display the XML error in the debug
+    _item->_isCongestionError = isCongestionNetworkError(job->reply()->error(), job->timedOut());
 
     if (_item->_httpErrorCode == 412) {
         // Precondition Failed: Either an etag or a checksum mismatch.
@@ -674,7 +931,7 @@ void PropagateUploadFileCommon::finalize()
 
     // Remove from the progress database:
     propagator()->_journal->setUploadInfo(_item->_file, SyncJournalDb::UploadInfo());
-    propagator()->_journal->commit("upload file start");
+    propagator()->_journal->groupCommit("upload file finished");
 
     done(SyncFileItem::Success);
 }
@@ -20,6 +20,9 @@
 #include <QBuffer>
 #include <QFile>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QTimer>
 
 namespace OCC {
 
@@ -52,9 +55,6 @@ public:
 
     void setBandwidthLimited(bool);
     bool isBandwidthLimited() { return _bandwidthLimited; }
-    void setChoked(bool);
-    bool isChoked() { return _choked; }
-    void giveBandwidthQuota(qint64 bwq);
 
 signals:
 
@@ -71,13 +71,84 @@ private:
 
     // Bandwidth manager related
     QPointer<BandwidthManager> _bandwidthManager;
-    qint64 _bandwidthQuota;
-    qint64 _readWithProgress;
-    bool _bandwidthLimited; // if _bandwidthQuota will be used
-    bool _choked; // if upload is paused (readData() will return 0)
-    friend class BandwidthManager;
-public slots:
-    void slotJobUploadProgress(qint64 sent, qint64 t);
+    bool _bandwidthLimited; // if quota must be taken from the _bandwidthManager
+};
+
+/**
+ * @brief Computes everything an upload needs from the file contents in one read
+ * @ingroup libsync
+ *
+ * The content checksum, the transmission checksum and optionally the zsync
+ * metadata are all fed from the same buffers on a worker thread, instead of
+ * reading the file once per consumer.
+ */
+class OWNCLOUDSYNC_EXPORT ComputeUploadChecksums : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result
+    {
+        QByteArray contentChecksumType;
+        QByteArray contentChecksum;
+        QByteArray transmissionChecksumType;
+        QByteArray transmissionChecksum;
+        /// Path of the generated zsync metadata file, owned by the receiver
+        QString zsyncMetadataFile;
+        /// Set if the file could not be read or the zsync metadata not be written
+        QString errorString;
+    };
+
+    explicit ComputeUploadChecksums(QObject *parent = 0);
+    ~ComputeUploadChecksums();
+
+    /// An empty type skips that checksum. Equal types are only computed once.
+    void setContentChecksumType(const QByteArray &type) { _contentChecksumType = type; }
+    QByteArray contentChecksumType() const { return _contentChecksumType; }
+    void setTransmissionChecksumType(const QByteArray &type) { _transmissionChecksumType = type; }
+    QByteArray transmissionChecksumType() const { return _transmissionChecksumType; }
+    void setGenerateZsyncMetadata(bool enabled) { _generateZsyncMetadata = enabled; }
+
+    /**
+     * Reads \a filePath in a thread. progress() is emitted while reading
+     * and done() once the result() is available.
+     *
+     * Deleting this object stops the calculation early.
+     */
+    void start(const QString &filePath);
+
+    /// Computes synchronously.
+    Result computeNow(const QString &filePath) const;
+
+    const Result &result() const { return _result; }
+
+signals:
+    void progress(qint64 done, qint64 total);
+    void done();
+
+private slots:
+    void slotCalculationDone();
+    void slotReportProgress();
+
+private:
+    struct SharedState
+    {
+        QAtomicInteger<qint64> bytesRead;
+        QAtomicInt aborted;
+    };
+
+    static Result compute(const QString &filePath, const QByteArray &contentChecksumType,
+        const QByteArray &transmissionChecksumType, bool generateZsyncMetadata, SharedState *state);
+
+    QByteArray _contentChecksumType;
+    QByteArray _transmissionChecksumType;
+    bool _generateZsyncMetadata = false;
+
+    QSharedPointer<SharedState> _state;
+    qint64 _fileSize = 0;
+    qint64 _reportedBytes = 0;
+    QTimer _progressTimer;
+    QFutureWatcher<Result> _watcher;
+    Result _result;
 };
 
 /**
@@ -191,9 +262,12 @@ signals:
  *         |
  *         v
  *    slotStartUpload()  -> doStartUpload()
- *                                  .
- *                                  .
- *                                  v
+ *         |                   ^        .
+ *         v          failed?  |        .
+ *    startRemoteCopy() -------+        .
+ *     (COPY, PROPPATCH, PROPFIND)      .
+ *         |                            .
+ *         v                            v
  *        finalize() or abortWithError()  or startPollJob()
  */
 class PropagateUploadFileCommon : public PropagateItemJob
@@ -214,6 +288,9 @@ protected:
 
     QByteArray _transmissionChecksumHeader;
 
+    /// zsync metadata generated along with the checksums, removed on destruction
+    QString _zsyncMetadataFile;
+
 public:
     PropagateUploadFileCommon(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
         : PropagateItemJob(propagator, item)
@@ -222,6 +299,7 @@ public:
         , _aborting(false)
     {
     }
+    ~PropagateUploadFileCommon();
 
     /**
      * Whether an existing entity with the same name may be deleted before
@@ -237,14 +315,25 @@ public:
 
 private slots:
     void slotComputeContentChecksum();
-    // Content checksum computed, compute the transmission checksum
-    void slotComputeTransmissionChecksum(const QByteArray &contentChecksumType, const QByteArray &contentChecksum);
+    void slotChecksumProgress(qint64 done, qint64 total);
+    // Content and transmission checksums computed in a single read of the file
+    void slotChecksumsComputed();
     // transmission checksum computed, prepare the upload
     void slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum);
+    void slotRemoteCopyFinished(QNetworkReply *reply);
+    void slotRemoteCopyMtimeSet();
+    void slotRemoteCopyInfo(const QVariantMap &values);
+    void slotRemoteCopyFailed();
 
 public:
     virtual void doStartUpload() = 0;
 
+    /**
+     * Whether zsync metadata will be uploaded for this file. If so, it is
+     * generated while reading the file for the checksums.
+     */
+    virtual bool uploadsZsyncMetadata() { return false; }
+
     void startPollJob(const QString &path);
     void finalize();
     void abortWithError(SyncFileItem::Status status, const QString &error);
@@ -291,6 +380,13 @@ protected:
 
     /** Bases headers that need to be sent on the PUT, or in the MOVE for chunking-ng */
     QMap<QByteArray, QByteArray> headers();
+
+private:
+    /**
+     * Copies a synced file with the same content checksum on the server
+     * instead of uploading. Returns false if there is none.
+     */
+    bool startRemoteCopy();
 };
 
 /**
@@ -369,11 +465,11 @@ private:
     qint64 _bytesToUpload;
 
     uint _transferId = 0; /// transfer id (part of the url)
-    int _currentChunkOffset = 0; /// byte offset of the next chunk data that will be sent
-    qint64 _currentChunkSize = 0; /// current chunk size
     bool _removeJobError = false; /// if not null, there was an error removing the job
     bool _zsyncSupported = false; /// if zsync is supported this will be set to true
     bool _isZsyncMetadataUploadRunning = false; // flag to ensure that zsync metadata upload is complete before job is
+    QByteArray _uploadedZsyncMetadata; /// kept in the journal once the upload succeeded
+    bool _zsyncSeedFromCache = false; /// seeding with the journal's zsync metadata instead of the server's
 
     // Map chunk number with its size  from the PROPFIND on resume.
     // (Only used from slotPropfindIterate/slotPropfindFinished because the LsColJob use signals to report data.)
@@ -393,6 +489,15 @@ private:
     };
     QVector<UploadRangeInfo> _rangesToUpload;
 
+    // The chunk PUTs that are currently running, with their range and upload progress.
+    // Their data has already been removed from _rangesToUpload.
+    struct ChunkInFlight
+    {
+        UploadRangeInfo range;
+        qint64 progress;
+    };
+    QHash<PUTFileJob *, ChunkInFlight> _chunksInFlight;
+
     /**
      * Return the URL of a chunk.
      * If chunkOffset == -1, returns the URL of the parent folder containing the chunks
@@ -415,12 +520,22 @@ public:
     }
 
     void doStartUpload() Q_DECL_OVERRIDE;
+    bool uploadsZsyncMetadata() Q_DECL_OVERRIDE;
 
 private:
     void doStartUploadNext();
     void startNewUpload();
     void startNextChunk();
+    bool startChunk();
     void doFinalMove();
+
+    /// zsync metadata of the last synced version, if the server still has that version
+    QByteArray cachedZsyncMetadata();
+    /// Finds the changed ranges by comparing block sums with \a previousMetadata, false if not suitable
+    bool startUploadOfChangedBlocks(const QByteArray &previousMetadata);
+    void seedZsyncMetadata(QByteArray zsyncData);
+    /// Sets up _rangesToUpload from the ranges zsync found to be missing on the server
+    void startZsyncUpload(const QVector<UploadRangeInfo> &neededRanges, qint64 remoteSize);
 public slots:
     void abort(AbortType abortType) Q_DECL_OVERRIDE;
 private slots:
@@ -79,18 +79,27 @@ void PropagateUploadFileNG::slotZsyncSeedFinished(void *_zs)
 
     qCDebug(lcZsyncPut) << "Number of ranges:" << _nrange;
 
+    QVector<UploadRangeInfo> neededRanges;
+    for (int i = 0; i < _nrange; i++) {
+        UploadRangeInfo rangeinfo = { qint64(zbyterange.get()[(2 * i)]), qint64(zbyterange.get()[(2 * i) + 1]) - qint64(zbyterange.get()[(2 * i)]) + 1 };
+        neededRanges.append(rangeinfo);
+    }
+
     // The remote file size according to zsync metadata
-    auto remoteSize = static_cast<qint64>(zsync_file_length(zs.get()));
+    startZsyncUpload(neededRanges, static_cast<qint64>(zsync_file_length(zs.get())));
+}
 
+void PropagateUploadFileNG::startZsyncUpload(const QVector<UploadRangeInfo> &neededRanges, qint64 remoteSize)
+{
     /* If we have no ranges then we have equal files and we are done */
-    if (_nrange == 0 && _item->_size == remoteSize) {
+    if (neededRanges.isEmpty() && _item->_size == remoteSize) {
         propagator()->reportFileTotal(*_item, 0);
         finalize();
         return;
     }
 
     // Size of combined uploads
-    int totalBytes = 0;
+    qint64 totalBytes = 0;
 
     /* The rightmost range returned by zsync can be larger than the local or remote
      * file size. That happens because zsync only considers whole blocks.
@@ -114,8 +123,7 @@ void PropagateUploadFileNG::slotZsyncSeedFinished(void *_zs)
      * and can easily handle the case of a locally grown file below (remote smaller).
      */
     qint64 minSize = qMin(_item->_size, remoteSize);
-    for (int i = 0; i < _nrange; i++) {
-        UploadRangeInfo rangeinfo = { qint64(zbyterange.get()[(2 * i)]), qint64(zbyterange.get()[(2 * i) + 1]) - qint64(zbyterange.get()[(2 * i)]) + 1 };
+    for (auto rangeinfo : neededRanges) {
         if (rangeinfo.start < minSize) {
             if (rangeinfo.end() > minSize)
                 rangeinfo.size = minSize - rangeinfo.start;
@@ -151,9 +159,14 @@ void PropagateUploadFileNG::slotZsyncSeedFailed(const QString &errorString)
 {
     qCCritical(lcZsyncPut) << errorString;
 
-    /* delete remote zsync file */
-    QUrl zsyncUrl = zsyncMetadataUrl(propagator(), _item->_file);
-    (new DeleteJob(propagator()->account(), zsyncUrl, this))->start();
+    if (_zsyncSeedFromCache) {
+        /* forget the cached metadata, the next attempt fetches it from the server */
+        propagator()->_journal->setZsyncMetadata(_item->_file, QByteArray(), QByteArray(), QByteArray());
+    } else {
+        /* delete remote zsync file */
+        QUrl zsyncUrl = zsyncMetadataUrl(propagator(), _item->_file);
+        (new DeleteJob(propagator()->account(), zsyncUrl, this))->start();
+    }
 
     abortWithError(SyncFileItem::NormalError, errorString);
 }
@@ -208,6 +221,17 @@ void PropagateUploadFileNG::doStartUpload()
 
     _zsyncSupported = isZsyncPropagationEnabled(propagator(), _item);
     if (_zsyncSupported && _item->_remotePerm.hasPermission(RemotePermissions::HasZSyncMetadata)) {
+        // The metadata of the last synced version saves the round trip
+        const QByteArray cachedMetadata = cachedZsyncMetadata();
+        if (!cachedMetadata.isEmpty()) {
+            qCInfo(lcZsyncPut) << "Using cached zsync metadata for:" << _item->_file;
+            if (!startUploadOfChangedBlocks(cachedMetadata)) {
+                _zsyncSeedFromCache = true;
+                seedZsyncMetadata(cachedMetadata);
+            }
+            return;
+        }
+
         // Retrieve zsync metadata file from the server
         qCInfo(lcZsyncPut) << "Retrieving zsync metadata for:" << _item->_file;
         QNetworkRequest req;
@@ -242,6 +266,56 @@ void PropagateUploadFileNG::slotZsyncGetMetaFinished(QNetworkReply *reply)
 
     qCInfo(lcZsyncPut) << "Retrieved zsync metadata for:" << _item->_file << "size:" << zsyncData.size();
 
+    seedZsyncMetadata(zsyncData);
+}
+
+QByteArray PropagateUploadFileNG::cachedZsyncMetadata()
+{
+    SyncJournalFileRecord record;
+    if (!propagator()->_journal->getFileRecord(_item->_file, &record) || !record.isValid())
+        return QByteArray();
+
+    // The changed ranges are relative to the version the server has
+    if (!_item->_etag.isEmpty() && _item->_etag != record._etag)
+        return QByteArray();
+
+    return propagator()->_journal->getZsyncMetadata(_item->_file, record._etag, record._checksumHeader);
+}
+
+bool PropagateUploadFileNG::startUploadOfChangedBlocks(const QByteArray &previousMetadata)
+{
+    // Needs the new metadata that was generated along with the checksums
+    if (_zsyncMetadataFile.isEmpty())
+        return false;
+    QFile metadataFile(_zsyncMetadataFile);
+    if (!metadataFile.open(QIODevice::ReadOnly))
+        return false;
+
+    QVector<QPair<qint64, qint64>> changedBlocks;
+    qint64 previousSize = 0;
+    if (!zsyncChangedBlocks(previousMetadata, metadataFile.readAll(), &changedBlocks, &previousSize))
+        return false;
+
+    qint64 changedBytes = qMax<qint64>(0, _item->_size - previousSize);
+    QVector<UploadRangeInfo> neededRanges;
+    for (const auto &block : changedBlocks) {
+        neededRanges.append({ block.first, block.second });
+        changedBytes += block.second;
+    }
+
+    // Content may have moved, seeding finds it at its new offset
+    if (changedBytes > _item->_size / 2) {
+        qCInfo(lcZsyncPut) << "Too many changed blocks, seeding instead:" << changedBytes << "of" << _item->_size;
+        return false;
+    }
+
+    qCInfo(lcZsyncPut) << "Changed blocks from cached zsync metadata:" << changedBlocks.size();
+    startZsyncUpload(neededRanges, previousSize);
+    return true;
+}
+
+void PropagateUploadFileNG::seedZsyncMetadata(QByteArray zsyncData)
+{
     ZsyncSeedRunnable *run = new ZsyncSeedRunnable(zsyncData, propagator()->getFilePath(_item->_file), ZsyncMode::upload);
     connect(run, &ZsyncSeedRunnable::finishedSignal, this, &PropagateUploadFileNG::slotZsyncSeedFinished);
     connect(run, &ZsyncSeedRunnable::failedSignal, this, &PropagateUploadFileNG::slotZsyncSeedFailed);
@@ -250,9 +324,20 @@ void PropagateUploadFileNG::slotZsyncGetMetaFinished(QNetworkReply *reply)
     QThreadPool::globalInstance()->start(run);
 }
 
+bool PropagateUploadFileNG::uploadsZsyncMetadata()
+{
+    return isZsyncPropagationEnabled(propagator(), _item);
+}
+
 void PropagateUploadFileNG::doStartUploadNext()
 {
-    if (_zsyncSupported) {
+    if (_zsyncSupported && !_zsyncMetadataFile.isEmpty()) {
+        _isZsyncMetadataUploadRunning = true;
+
+        // Generated while computing the checksums, upload it once the chunk upload is set up
+        QMetaObject::invokeMethod(this, "slotZsyncGenerationFinished", Qt::QueuedConnection,
+            Q_ARG(QString, _zsyncMetadataFile));
+    } else if (_zsyncSupported) {
         _isZsyncMetadataUploadRunning = true;
 
         ZsyncGenerateRunnable *run = new ZsyncGenerateRunnable(propagator()->getFilePath(_item->_file));
@@ -331,7 +416,6 @@ void PropagateUploadFileNG::slotPropfindFinished()
     slotJobDestroyed(job); // remove it from the _jobs list
     propagator()->_activeJobList.removeOne(this);
 
-    _currentChunkOffset = 0;
     _sent = 0;
 
     for (auto chunkOffset : _serverChunks.keys()) {
@@ -491,7 +575,7 @@ void PropagateUploadFileNG::doFinalMove()
         return;
 
     // Still not finished all ranges.
-    if (!_rangesToUpload.isEmpty())
+    if (!_rangesToUpload.isEmpty() || !_chunksInFlight.isEmpty())
         return;
 
     ENFORCE(_jobs.isEmpty(), "MOVE for upload even though jobs are still running");
@@ -535,17 +619,32 @@ void PropagateUploadFileNG::startNextChunk()
 
     // All ranges complete!
     if (_rangesToUpload.isEmpty()) {
-        doFinalMove();
+        if (_chunksInFlight.isEmpty())
+            doFinalMove();
         return;
     }
 
-    _currentChunkOffset = _rangesToUpload.first().start;
-    _currentChunkSize = qMin(propagator()->_chunkSize, _rangesToUpload.first().size);
+    // The first chunk runs in the slot of this job, further ones are only
+    // started if the propagator has transfer slots to spare.
+    const int maxParallelChunks = qMax(1, propagator()->syncOptions()._parallelChunkUploads);
+    while (!_rangesToUpload.isEmpty() && _chunksInFlight.size() < maxParallelChunks) {
+        if (!_chunksInFlight.isEmpty()
+            && propagator()->_activeJobList.count() >= propagator()->maximumActiveTransferJob()) {
+            break;
+        }
+        if (!startChunk())
+            return;
+    }
+}
+
+bool PropagateUploadFileNG::startChunk()
+{
+    UploadRangeInfo chunk = { _rangesToUpload.first().start, qMin(propagator()->_chunkSize, _rangesToUpload.first().size) };
 
     const QString fileName = propagator()->getFilePath(_item->_file);
 
     auto device = std::unique_ptr<UploadDevice>(new UploadDevice(
-            fileName, _currentChunkOffset, _currentChunkSize, &propagator()->_bandwidthManager));
+            fileName, chunk.start, chunk.size, &propagator()->_bandwidthManager));
     if (!device->open(QIODevice::ReadOnly)) {
         qCWarning(lcPropagateUpload) << "Could not prepare upload device: " << device->errorString();
 
@@ -556,26 +655,28 @@ void PropagateUploadFileNG::startNextChunk()
         }
         // Soft error because this is likely caused by the user modifying his files while syncing
         abortWithError(SyncFileItem::SoftError, device->errorString());
-        return;
+        return false;
     }
 
+    markRangeAsDone(chunk.start, chunk.size);
+
     QMap<QByteArray, QByteArray> headers;
-    headers["OC-Chunk-Offset"] = QByteArray::number(_currentChunkOffset);
+    headers["OC-Chunk-Offset"] = QByteArray::number(chunk.start);
 
-    QUrl url = chunkUrl(_currentChunkOffset);
+    QUrl url = chunkUrl(chunk.start);
 
     // job takes ownership of device via a QScopedPointer. Job deletes itself when finishing
-    auto devicePtr = device.get(); // for connections later
     PUTFileJob *job = new PUTFileJob(propagator()->account(), url, std::move(device), headers, 0, this);
+    job->setNetworkJobClass(propagator()->networkJobClass(*_item));
     _jobs.append(job);
+    _chunksInFlight.insert(job, { chunk, 0 });
     connect(job, &PUTFileJob::finishedSignal, this, &PropagateUploadFileNG::slotPutFinished);
     connect(job, &PUTFileJob::uploadProgress,
         this, &PropagateUploadFileNG::slotUploadProgress);
-    connect(job, &PUTFileJob::uploadProgress,
-        devicePtr, &UploadDevice::slotJobUploadProgress);
     connect(job, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
     job->start();
     propagator()->_activeJobList.append(this);
+    return true;
 }
 
 void PropagateUploadFileNG::slotZsyncGenerationFinished(const QString &generatedFileName)
@@ -584,6 +685,11 @@ void PropagateUploadFileNG::slotZsyncGenerationFinished(const QString &generated
         << "Finished generation of:" << generatedFileName
         << "size:" << FileSystem::getSize(generatedFileName);
 
+    QFile metadataFile(generatedFileName);
+    if (metadataFile.open(QIODevice::ReadOnly)) {
+        _uploadedZsyncMetadata = metadataFile.readAll();
+    }
+
     auto device = std::unique_ptr<UploadDevice>(new UploadDevice(
             generatedFileName, 0, FileSystem::getSize(generatedFileName), &propagator()->_bandwidthManager));
     if (!device->open(QIODevice::ReadOnly)) {
@@ -601,14 +707,12 @@ void PropagateUploadFileNG::slotZsyncGenerationFinished(const QString &generated
     qCDebug(lcPropagateUpload) << "Starting upload of .zsync";
 
     // job takes ownership of device via a QScopedPointer. Job deletes itself when finishing
-    auto devicePtr = device.get(); // for connections later
     PUTFileJob *job = new PUTFileJob(propagator()->account(), url, std::move(device), headers, 0, this);
+    job->setNetworkJobClass(propagator()->networkJobClass(*_item));
     _jobs.append(job);
     connect(job, &PUTFileJob::finishedSignal, this, &PropagateUploadFileNG::slotZsyncMetadataUploadFinished);
     connect(job, &PUTFileJob::uploadProgress,
         this, &PropagateUploadFileNG::slotUploadProgress);
-    connect(job, &PUTFileJob::uploadProgress,
-        devicePtr, &UploadDevice::slotJobUploadProgress);
     job->start();
     propagator()->_activeJobList.append(this);
 
@@ -643,6 +747,8 @@ void PropagateUploadFileNG::slotPutFinished()
 
     propagator()->_activeJobList.removeOne(this);
 
+    const ChunkInFlight chunk = _chunksInFlight.take(job);
+
     if (_finished) {
         // We have sent the finished signal already. We don't need to handle any remaining jobs
         return;
@@ -657,9 +763,8 @@ void PropagateUploadFileNG::slotPutFinished()
         return;
     }
 
-    // Mark the range as uploaded
-    markRangeAsDone(_currentChunkOffset, _currentChunkSize);
-    _sent += _currentChunkSize;
+    // The range was already taken out of _rangesToUpload when the chunk was started
+    _sent += chunk.range.size;
 
     ENFORCE(_sent <= _bytesToUpload, "can't send more than size");
 
@@ -670,11 +775,12 @@ void PropagateUploadFileNG::slotPutFinished()
     auto targetDuration = propagator()->syncOptions()._targetChunkUploadDuration;
     if (targetDuration.count() > 0) {
         auto uploadTime = ++job->msSinceStart(); // add one to avoid div-by-zero
-        qint64 predictedGoodSize = (_currentChunkSize * targetDuration) / uploadTime;
+        qint64 predictedGoodSize = (chunk.range.size * targetDuration) / uploadTime;
 
         // The whole targeting is heuristic. The predictedGoodSize will fluctuate
         // quite a bit because of external factors (like available bandwidth)
-        // and internal factors (like number of parallel uploads).
+        // and internal factors (like number of parallel uploads, including the
+        // other chunks of this file).
         //
         // We use an exponential moving average here as a cheap way of smoothing
         // the chunk sizes a bit.
@@ -686,7 +792,7 @@ void PropagateUploadFileNG::slotPutFinished()
             targetSize,
             propagator()->syncOptions()._maxChunkSize);
 
-        qCInfo(lcPropagateUpload) << "Chunked upload of" << _currentChunkSize << "bytes took" << uploadTime.count()
+        qCInfo(lcPropagateUpload) << "Chunked upload of" << chunk.range.size << "bytes took" << uploadTime.count()
                                   << "ms, desired is" << targetDuration.count() << "ms, expected good chunk size is"
                                   << predictedGoodSize << "bytes and nudged next chunk size to "
                                   << propagator()->_chunkSize << "bytes";
@@ -725,7 +831,7 @@ void PropagateUploadFileNG::slotPutFinished()
         auto uploadInfo = propagator()->_journal->getUploadInfo(_item->_file);
         uploadInfo._errorCount = 0;
         propagator()->_journal->setUploadInfo(_item->_file, uploadInfo);
-        propagator()->_journal->commit("Upload info");
+        propagator()->_journal->groupCommit("Upload info");
     }
     startNextChunk();
 }
@@ -781,6 +887,11 @@ void PropagateUploadFileNG::slotMoveJobFinished()
         abortWithError(SyncFileItem::NormalError, tr("Falta ETag do servidor"));
         return;
     }
+
+    if (!_uploadedZsyncMetadata.isEmpty()) {
+        // Describes the new version on the server, see cachedZsyncMetadata()
+        propagator()->_journal->setZsyncMetadata(_item->_file, _item->_etag, _item->_checksumHeader, _uploadedZsyncMetadata);
+    }
     finalize();
 }
 
@@ -793,7 +904,18 @@ void PropagateUploadFileNG::slotUploadProgress(qint64 sent, qint64 total)
     if (sent == 0 && total == 0) {
         return;
     }
-    propagator()->reportProgress(*_item, _sent + sent);
+
+    // Progress of the zsync metadata upload is not tracked per chunk
+    auto it = _chunksInFlight.find(qobject_cast<PUTFileJob *>(sender()));
+    qint64 progress = 0;
+    if (it != _chunksInFlight.end()) {
+        it->progress = sent;
+    } else {
+        progress = sent;
+    }
+    for (const auto &chunk : _chunksInFlight)
+        progress += chunk.progress;
+    propagator()->reportProgress(*_item, _sent + progress);
 }
 
 void PropagateUploadFileNG::abort(PropagatorJob::AbortType abortType)
@@ -124,7 +124,7 @@ void PropagateLocalRemove::start()
     }
     propagator()->reportProgress(*_item, 0);
     propagator()->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
-    propagator()->_journal->commit("Local remove");
+    propagator()->_journal->groupCommit("Local remove");
     done(SyncFileItem::Success);
 }
 
@@ -180,7 +180,7 @@ void PropagateLocalMkdir::start()
         done(SyncFileItem::FatalError, tr("Ocorreu um erro ao escrever metadados ao banco de dados"));
         return;
     }
-    propagator()->_journal->commit("localMkdir");
+    propagator()->_journal->groupCommit("localMkdir");
 
     auto resultStatus = _item->_instruction == CSYNC_INSTRUCTION_CONFLICT
         ? SyncFileItem::Conflict
@@ -262,7 +262,7 @@ void PropagateLocalRename::start()
         return;
     }
 
-    propagator()->_journal->commit("localRename");
+    propagator()->_journal->groupCommit("localRename");
 
     done(SyncFileItem::Success);
 }
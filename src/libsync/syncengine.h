@@ -64,6 +64,9 @@ public:
     Q_INVOKABLE void startSync();
     void setNetworkLimits(int upload, int download);
 
+    /** Changes the number of parallel network jobs, also of a running sync */
+    void setParallelNetworkJobs(int jobs);
+
     /* Abort the sync.  Called from the main thread */
     void abort();
 
@@ -189,6 +192,7 @@ private slots:
     void slotDiscoveryFinished();
     void slotPropagationFinished(bool success);
     void slotProgress(const SyncFileItem &item, qint64 curent);
+    void slotChecksumProgress(const SyncFileItem &item, qint64 current);
     void updateFileTotal(const SyncFileItem &item, qint64 newSize);
     void slotCleanPollsJobAborted(const QString &error);
 
@@ -223,8 +227,6 @@ private:
     // cleanup and emit the finished signal
     void finalize(bool success);
 
-    static bool s_anySyncRunning; //true when one sync is running somewhere (for debugging)
-
     // Must only be acessed during update and reconcile
     QVector<SyncFileItemPtr> _syncItems;
 
@@ -21,12 +21,15 @@
 #include "csync_exclude.h"
 
 #include <QLoggingCategory>
+#include <QTimer>
+
+#include <algorithm>
 
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcStatusTracker, "sync.statustracker", QtInfoMsg)
 
-static int pathCompare( const QString& lhs, const QString& rhs )
+static int pathCompare(const QStringRef &lhs, const QString &rhs)
 {
     // Should match Utility::fsCasePreserving, we want don't want to pay for the runtime check on every comparison.
     return lhs.compare(rhs,
@@ -38,46 +41,113 @@ static int pathCompare( const QString& lhs, const QString& rhs )
         );
 }
 
-static bool pathStartsWith( const QString& lhs, const QString& rhs )
+// Once fileStatus() cached this many states, they are all dropped
+static const int maxCachedStates = 100000;
+
+// Calls func for node and its subtree, parents before their children
+template <typename NodeT, typename Func>
+static void forEachNode(NodeT *node, const Func &func)
 {
-    return lhs.startsWith(rhs,
-#if defined(Q_OS_WIN) || defined(Q_OS_MAC)
-        Qt::CaseInsensitive
-#else
-        Qt::CaseSensitive
-#endif
-        );
+    func(node);
+    for (const auto &child : node->children)
+        forEachNode(child.get(), func);
 }
 
-bool SyncFileStatusTracker::PathComparator::operator()( const QString& lhs, const QString& rhs ) const
+int SyncFileStatusTracker::Node::depth() const
 {
-    // This will make sure that the std::map is ordered and queried case-insensitively on macOS and Windows.
-    return pathCompare(lhs, rhs) < 0;
+    int depth = 0;
+    for (auto node = parent; node; node = node->parent)
+        ++depth;
+    return depth;
 }
 
-SyncFileStatus::SyncFileStatusTag SyncFileStatusTracker::lookupProblem(const QString &pathToMatch, const SyncFileStatusTracker::ProblemsMap &problemMap)
+bool SyncFileStatusTracker::Node::isEmpty() const
 {
-    auto lower = problemMap.lower_bound(pathToMatch);
-    for (auto it = lower; it != problemMap.cend(); ++it) {
-        const QString &problemPath = it->first;
-        SyncFileStatus::SyncFileStatusTag severity = it->second;
-
-        if (pathCompare(problemPath, pathToMatch) == 0) {
-            return severity;
-        } else if (severity == SyncFileStatus::StatusError
-            && pathStartsWith(problemPath, pathToMatch)
-            && (pathToMatch.isEmpty() || problemPath.at(pathToMatch.size()) == '/')) {
-            return SyncFileStatus::StatusWarning;
-        } else if (!pathStartsWith(problemPath, pathToMatch)) {
-            // Starting at lower_bound we get the first path that is not smaller,
-            // since: "a/" < "a/aa" < "a/aa/aaa" < "a/ab/aba"
-            // If problemMap keys are ["a/aa/aaa", "a/ab/aba"] and pathToMatch == "a/aa",
-            // lower_bound(pathToMatch) will point to "a/aa/aaa", and the moment that
-            // problemPath.startsWith(pathToMatch) == false, we know that we've looked
-            // at everything that interest us.
-            break;
-        }
+    return children.empty()
+        && syncCount == 0
+        && problem == SyncFileStatus::StatusNone
+        && !dirty
+        && cached == NotCached;
+}
+
+SyncFileStatusTracker::Node *SyncFileStatusTracker::child(Node *node, const QStringRef &name, bool create)
+{
+    // This will make sure that the children are ordered and queried case-insensitively on macOS and Windows.
+    auto &children = node->children;
+    auto it = std::lower_bound(children.begin(), children.end(), name,
+        [](const std::unique_ptr<Node> &child, const QStringRef &name) { return pathCompare(name, child->name) > 0; });
+    if (it != children.end() && pathCompare(name, (*it)->name) == 0)
+        return it->get();
+    if (!create)
+        return nullptr;
+
+    std::unique_ptr<Node> newChild(new Node);
+    newChild->parent = node;
+    newChild->name = name.toString();
+    return children.insert(it, std::move(newChild))->get();
+}
+
+SyncFileStatusTracker::Node *SyncFileStatusTracker::findNode(const QString &relativePath, bool create)
+{
+    Node *node = &_root;
+    int start = 0;
+    while (node && start < relativePath.size()) {
+        int end = relativePath.indexOf(QLatin1Char('/'), start);
+        if (end == -1)
+            end = relativePath.size();
+        if (end > start)
+            node = child(node, relativePath.midRef(start, end - start), create);
+        start = end + 1;
     }
+    return node;
+}
+
+QString SyncFileStatusTracker::nodePath(const Node *node)
+{
+    int size = -1;
+    for (auto n = node; n->parent; n = n->parent)
+        size += n->name.size() + 1;
+    if (size <= 0)
+        return QString();
+
+    QString path(size, Qt::Uninitialized);
+    QChar *out = path.data() + size;
+    for (auto n = node; n->parent; n = n->parent) {
+        out -= n->name.size();
+        std::copy(n->name.constBegin(), n->name.constEnd(), out);
+        if (out != path.data())
+            *--out = QLatin1Char('/');
+    }
+    return path;
+}
+
+void SyncFileStatusTracker::pruneEmptyChildren(Node *node)
+{
+    auto &children = node->children;
+    for (const auto &child : children)
+        pruneEmptyChildren(child.get());
+    children.erase(std::remove_if(children.begin(), children.end(),
+                       [](const std::unique_ptr<Node> &child) { return child->isEmpty(); }),
+        children.end());
+}
+
+void SyncFileStatusTracker::setProblem(Node *node, SyncFileStatus::SyncFileStatusTag problem)
+{
+    const bool wasError = node->problem == SyncFileStatus::StatusError;
+    const bool isError = problem == SyncFileStatus::StatusError;
+    node->problem = problem;
+    if (wasError != isError) {
+        for (auto parent = node->parent; parent; parent = parent->parent)
+            parent->errorsBelow += isError ? 1 : -1;
+    }
+}
+
+SyncFileStatus::SyncFileStatusTag SyncFileStatusTracker::lookupProblem(const Node *node) const
+{
+    if (node->problem != SyncFileStatus::StatusNone)
+        return node->problem;
+    if (node->errorsBelow > 0)
+        return SyncFileStatus::StatusWarning;
     return SyncFileStatus::StatusNone;
 }
 
@@ -125,11 +195,51 @@ SyncFileStatus SyncFileStatusTracker::fileStatus(const QString &relativePath)
 {
     ASSERT(!relativePath.endsWith(QLatin1Char('/')));
 
-    if (relativePath.isEmpty()) {
+    SyncFileStatus status = nodeStatus(findNode(relativePath, true), relativePath);
+
+    if (_cachedStateCount > maxCachedStates && !_cacheCleanupScheduled) {
+        // Not right away, the caller might be one of our own slots holding nodes
+        _cacheCleanupScheduled = true;
+        QTimer::singleShot(0, this, [this] {
+            _cacheCleanupScheduled = false;
+            clearCachedStates(&_root);
+            pruneEmptyChildren(&_root);
+        });
+    }
+    return status;
+}
+
+SyncFileStatus SyncFileStatusTracker::nodeStatus(Node *node, const QString &relativePath)
+{
+    if (node == &_root) {
         // This is the root sync folder, it doesn't have an entry in the database and won't be walked by csync, so resolve manually.
-        return resolveSyncAndErrorStatus(QString(), NotShared);
+        return resolveSyncAndErrorStatus(&_root, NotShared);
+    }
+
+    if (node->cached == Node::NotCached) {
+        node->cached = lookupCachedState(relativePath);
+        ++_cachedStateCount;
+    }
+
+    if (node->cached == Node::CachedExcluded)
+        return SyncFileStatus(SyncFileStatus::StatusExcluded);
+
+    if (node->dirty)
+        return SyncFileStatus::StatusSync;
+
+    switch (node->cached) {
+    case Node::CachedShared:
+        return resolveSyncAndErrorStatus(node, Shared);
+    case Node::CachedNotShared:
+        return resolveSyncAndErrorStatus(node, NotShared);
+    default:
+        // Must be a new file not yet in the database, check if it's syncing or has an error.
+        return resolveSyncAndErrorStatus(node, NotShared, PathUnknown);
     }
+}
 
+SyncFileStatusTracker::Node::CachedState SyncFileStatusTracker::lookupCachedState(const QString &relativePath)
+{
     // The SyncEngine won't notify us at all for CSYNC_FILE_SILENTLY_EXCLUDED
     // and CSYNC_FILE_EXCLUDE_AND_REMOVE excludes. Even though it's possible
     // that the status of CSYNC_FILE_EXCLUDE_LIST excludes will change if the user
@@ -141,20 +251,27 @@ SyncFileStatus SyncFileStatusTracker::fileStatus(const QString &relativePath)
     if (_syncEngine->excludedFiles().isExcluded(_syncEngine->localPath() + relativePath,
             _syncEngine->localPath(),
             _syncEngine->ignoreHiddenFiles())) {
-        return SyncFileStatus(SyncFileStatus::StatusExcluded);
+        return Node::CachedExcluded;
     }
 
-    if (_dirtyPaths.contains(relativePath))
-        return SyncFileStatus::StatusSync;
-
-    // First look it up in the database to know if it's shared
+    // Look it up in the database to know if it's shared
     SyncJournalFileRecord rec;
     if (_syncEngine->journal()->getFileRecord(relativePath, &rec) && rec.isValid()) {
-        return resolveSyncAndErrorStatus(relativePath, rec._remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared);
+        return rec._remotePerm.hasPermission(RemotePermissions::IsShared) ? Node::CachedShared : Node::CachedNotShared;
     }
+    return Node::CachedNotInDb;
+}
 
-    // Must be a new file not yet in the database, check if it's syncing or has an error.
-    return resolveSyncAndErrorStatus(relativePath, NotShared, PathUnknown);
+void SyncFileStatusTracker::clearCachedStates(Node *node)
+{
+    if (!node || _cachedStateCount == 0)
+        return;
+    forEachNode(node, [this](Node *n) {
+        if (n->cached != Node::NotCached) {
+            n->cached = Node::NotCached;
+            --_cachedStateCount;
+        }
+    });
 }
 
 void SyncFileStatusTracker::slotPathTouched(const QString &fileName)
@@ -162,77 +279,73 @@ void SyncFileStatusTracker::slotPathTouched(const QString &fileName)
     QString folderPath = _syncEngine->localPath();
 
     ASSERT(fileName.startsWith(folderPath));
-    QString localPath = fileName.mid(folderPath.size());
-    _dirtyPaths.insert(localPath);
+    Node *node = findNode(fileName.mid(folderPath.size()), true);
+    node->dirty = true;
+    _dirtyNodes.insert(node);
 
     emit fileStatusChanged(fileName, SyncFileStatus::StatusSync);
 }
 
 void SyncFileStatusTracker::slotAddSilentlyExcluded(const QString &folderPath)
 {
-    _syncProblems[folderPath] = SyncFileStatus::StatusExcluded;
-    emit fileStatusChanged(getSystemDestination(folderPath), resolveSyncAndErrorStatus(folderPath, NotShared));
+    Node *node = findNode(folderPath, true);
+    setProblem(node, SyncFileStatus::StatusExcluded);
+    emit fileStatusChanged(getSystemDestination(folderPath), resolveSyncAndErrorStatus(node, NotShared));
+}
+
+void SyncFileStatusTracker::emitStatus(Node *node, SharedFlag sharedFlag)
+{
+    const QString relativePath = nodePath(node);
+    SyncFileStatus status = sharedFlag == UnknownShared
+        ? nodeStatus(node, relativePath)
+        : resolveSyncAndErrorStatus(node, sharedFlag);
+    emit fileStatusChanged(getSystemDestination(relativePath), status);
 }
 
-void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
+void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(Node *node, SharedFlag sharedFlag)
 {
-    // Will return 0 (and increase to 1) if the path wasn't in the map yet
-    int count = _syncCount[relativePath]++;
-    if (!count) {
-        SyncFileStatus status = sharedFlag == UnknownShared
-            ? fileStatus(relativePath)
-            : resolveSyncAndErrorStatus(relativePath, sharedFlag);
-        emit fileStatusChanged(getSystemDestination(relativePath), status);
-
-        // We passed from OK to SYNC, increment the parent to keep it marked as
-        // SYNC while we propagate ourselves and our own children.
-        ASSERT(!relativePath.endsWith('/'));
-        int lastSlashIndex = relativePath.lastIndexOf('/');
-        if (lastSlashIndex != -1)
-            incSyncCountAndEmitStatusChanged(relativePath.left(lastSlashIndex), UnknownShared);
-        else if (!relativePath.isEmpty())
-            incSyncCountAndEmitStatusChanged(QString(), UnknownShared);
+    // Once we passed from OK to SYNC, increment the parent to keep it marked as
+    // SYNC while we propagate ourselves and our own children.
+    for (; node && node->syncCount++ == 0; node = node->parent) {
+        emitStatus(node, sharedFlag);
+        sharedFlag = UnknownShared;
     }
 }
 
-void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
+void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(Node *node, SharedFlag sharedFlag)
 {
-    int count = --_syncCount[relativePath];
-    if (!count) {
-        // Remove from the map, same as 0
-        _syncCount.remove(relativePath);
-
-        SyncFileStatus status = sharedFlag == UnknownShared
-            ? fileStatus(relativePath)
-            : resolveSyncAndErrorStatus(relativePath, sharedFlag);
-        emit fileStatusChanged(getSystemDestination(relativePath), status);
-
-        // We passed from SYNC to OK, decrement our parent.
-        ASSERT(!relativePath.endsWith('/'));
-        int lastSlashIndex = relativePath.lastIndexOf('/');
-        if (lastSlashIndex != -1)
-            decSyncCountAndEmitStatusChanged(relativePath.left(lastSlashIndex), UnknownShared);
-        else if (!relativePath.isEmpty())
-            decSyncCountAndEmitStatusChanged(QString(), UnknownShared);
+    // Once we passed from SYNC to OK, decrement our parent.
+    for (; node && node->syncCount > 0 && --node->syncCount == 0; node = node->parent) {
+        emitStatus(node, sharedFlag);
+        sharedFlag = UnknownShared;
     }
 }
 
 void SyncFileStatusTracker::slotAboutToPropagate(SyncFileItemVector &items)
 {
-    ASSERT(_syncCount.isEmpty());
+    ASSERT(_root.syncCount == 0);
 
-    ProblemsMap oldProblems;
-    std::swap(_syncProblems, oldProblems);
+    std::vector<std::pair<Node *, SyncFileStatus::SyncFileStatusTag>> oldProblems;
+    forEachNode(&_root, [&oldProblems](Node *node) {
+        if (node->problem != SyncFileStatus::StatusNone)
+            oldProblems.emplace_back(node, node->problem);
+    });
+    for (const auto &oldProblem : oldProblems)
+        setProblem(oldProblem.first, SyncFileStatus::StatusNone);
 
     foreach (const SyncFileItemPtr &item, items) {
         qCDebug(lcStatusTracker) << "Investigating" << item->destination() << item->_status << item->_instruction;
-        _dirtyPaths.remove(item->destination());
+        Node *node = findNode(item->destination(), true);
+        if (node->dirty) {
+            node->dirty = false;
+            _dirtyNodes.remove(node);
+        }
 
         if (hasErrorStatus(*item)) {
-            _syncProblems[item->_file] = SyncFileStatus::StatusError;
-            invalidateParentPaths(item->destination());
+            setProblem(findNode(item->_file, true), SyncFileStatus::StatusError);
+            invalidateParentPaths(node);
         } else if (hasExcludedStatus(*item)) {
-            _syncProblems[item->_file] = SyncFileStatus::StatusExcluded;
+            setProblem(findNode(item->_file, true), SyncFileStatus::StatusExcluded);
         }
 
         SharedFlag sharedFlag = item->_remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared;
@@ -241,44 +354,54 @@ void SyncFileStatusTracker::slotAboutToPropagate(SyncFileItemVector &items)
             && item->_instruction != CSYNC_INSTRUCTION_IGNORE
             && item->_instruction != CSYNC_INSTRUCTION_ERROR) {
             // Mark this path as syncing for instructions that will result in propagation.
-            incSyncCountAndEmitStatusChanged(item->destination(), sharedFlag);
+            incSyncCountAndEmitStatusChanged(node, sharedFlag);
         } else {
-            emit fileStatusChanged(getSystemDestination(item->destination()), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
+            emitStatus(node, sharedFlag);
         }
     }
 
     // Some metadata status won't trigger files to be synced, make sure that we
     // push the OK status for dirty files that don't need to be propagated.
-    // Swap into a copy since fileStatus() reads _dirtyPaths to determine the status
-    QSet<QString> oldDirtyPaths;
-    std::swap(_dirtyPaths, oldDirtyPaths);
-    for (auto it = oldDirtyPaths.constBegin(); it != oldDirtyPaths.constEnd(); ++it)
-        emit fileStatusChanged(getSystemDestination(*it), fileStatus(*it));
+    // Clear the flags first since nodeStatus() reads them to determine the status
+    QSet<Node *> oldDirtyNodes;
+    std::swap(_dirtyNodes, oldDirtyNodes);
+    for (auto node : oldDirtyNodes)
+        node->dirty = false;
+    for (auto node : oldDirtyNodes)
+        emitStatus(node, UnknownShared);
 
     // Make sure to push any status that might have been resolved indirectly since the last sync
     // (like an error file being deleted from disk)
-    for (auto it = _syncProblems.begin(); it != _syncProblems.end(); ++it)
-        oldProblems.erase(it->first);
-    for (auto it = oldProblems.begin(); it != oldProblems.end(); ++it) {
-        const QString &path = it->first;
-        SyncFileStatus::SyncFileStatusTag severity = it->second;
-        if (severity == SyncFileStatus::StatusError)
-            invalidateParentPaths(path);
-        emit fileStatusChanged(getSystemDestination(path), fileStatus(path));
+    for (const auto &oldProblem : oldProblems) {
+        Node *node = oldProblem.first;
+        if (node->problem != SyncFileStatus::StatusNone)
+            continue;
+        if (oldProblem.second == SyncFileStatus::StatusError)
+            invalidateParentPaths(node);
+        emitStatus(node, UnknownShared);
     }
+
+    emitInvalidatedParents();
+    pruneEmptyChildren(&_root);
 }
 
 void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
 {
     qCDebug(lcStatusTracker) << "Item completed" << item->destination() << item->_status << item->_instruction;
 
+    Node *node = findNode(item->destination(), true);
+    // The journal entries of the item and everything below it may have changed
+    clearCachedStates(node);
+    if (item->_file != item->destination())
+        clearCachedStates(findNode(item->_file, false));
+
     if (hasErrorStatus(*item)) {
-        _syncProblems[item->_file] = SyncFileStatus::StatusError;
-        invalidateParentPaths(item->destination());
+        setProblem(findNode(item->_file, true), SyncFileStatus::StatusError);
+        invalidateParentPaths(node);
     } else if (hasExcludedStatus(*item)) {
-        _syncProblems[item->_file] = SyncFileStatus::StatusExcluded;
-    } else {
-        _syncProblems.erase(item->_file);
+        setProblem(findNode(item->_file, true), SyncFileStatus::StatusExcluded);
+    } else if (Node *fileNode = findNode(item->_file, false)) {
+        setProblem(fileNode, SyncFileStatus::StatusNone);
     }
 
     SharedFlag sharedFlag = item->_remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared;
@@ -287,37 +410,49 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
         && item->_instruction != CSYNC_INSTRUCTION_IGNORE
         && item->_instruction != CSYNC_INSTRUCTION_ERROR) {
         // decSyncCount calls *must* be symetric with incSyncCount calls in slotAboutToPropagate
-        decSyncCountAndEmitStatusChanged(item->destination(), sharedFlag);
+        decSyncCountAndEmitStatusChanged(node, sharedFlag);
     } else {
-        emit fileStatusChanged(getSystemDestination(item->destination()), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
+        emitStatus(node, sharedFlag);
     }
+
+    emitInvalidatedParents();
 }
 
 void SyncFileStatusTracker::slotSyncFinished()
 {
     // Clear the sync counts to reduce the impact of unsymetrical inc/dec calls (e.g. when directory job abort)
-    QHash<QString, int> oldSyncCount;
-    std::swap(_syncCount, oldSyncCount);
-    for (auto it = oldSyncCount.begin(); it != oldSyncCount.end(); ++it)
-        emit fileStatusChanged(getSystemDestination(it.key()), fileStatus(it.key()));
+    std::vector<Node *> syncingNodes;
+    forEachNode(&_root, [&syncingNodes](Node *node) {
+        if (node->syncCount) {
+            node->syncCount = 0;
+            syncingNodes.push_back(node);
+        }
+    });
+    // Children before their parents
+    for (auto it = syncingNodes.rbegin(); it != syncingNodes.rend(); ++it)
+        emitStatus(*it, UnknownShared);
 }
 
 void SyncFileStatusTracker::slotSyncEngineRunningChanged()
 {
-    emit fileStatusChanged(getSystemDestination(QString()), resolveSyncAndErrorStatus(QString(), NotShared));
+    // The excludes and the journal may have changed while we weren't looking
+    clearCachedStates(&_root);
+    pruneEmptyChildren(&_root);
+
+    emitStatus(&_root, NotShared);
 }
 
-SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &relativePath, SharedFlag sharedFlag, PathKnownFlag isPathKnown)
+SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const Node *node, SharedFlag sharedFlag, PathKnownFlag isPathKnown)
 {
     // If it's a new file and that we're not syncing it yet,
     // don't show any icon and wait for the filesystem watcher to trigger a sync.
     SyncFileStatus status(isPathKnown ? SyncFileStatus::StatusUpToDate : SyncFileStatus::StatusNone);
-    if (_syncCount.value(relativePath)) {
+    if (node->syncCount) {
         status.set(SyncFileStatus::StatusSync);
     } else {
         // After a sync finished, we need to show the users issues from that last sync like the activity list does.
         // Also used for parent directories showing a warning for an error child.
-        SyncFileStatus::SyncFileStatusTag problemStatus = lookupProblem(relativePath, _syncProblems);
+        SyncFileStatus::SyncFileStatusTag problemStatus = lookupProblem(node);
         if (problemStatus != SyncFileStatus::StatusNone)
             status.set(problemStatus);
     }
@@ -330,13 +465,29 @@ SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &r
     return status;
 }
 
-void SyncFileStatusTracker::invalidateParentPaths(const QString &path)
+void SyncFileStatusTracker::invalidateParentPaths(Node *node)
 {
-    QStringList splitPath = path.split('/', QString::SkipEmptyParts);
-    for (int i = 0; i < splitPath.size(); ++i) {
-        QString parentPath = QStringList(splitPath.mid(0, i)).join(QLatin1String("/"));
-        emit fileStatusChanged(getSystemDestination(parentPath), fileStatus(parentPath));
-    }
+    // A parent that is already in the set brought its own parents along
+    for (auto parent = node->parent; parent && !_invalidatedParents.contains(parent); parent = parent->parent)
+        _invalidatedParents.insert(parent);
+}
+
+void SyncFileStatusTracker::emitInvalidatedParents()
+{
+    if (_invalidatedParents.isEmpty())
+        return;
+
+    // Each directory once, children before their parents
+    std::vector<std::pair<int, Node *>> parents;
+    parents.reserve(_invalidatedParents.size());
+    for (auto node : _invalidatedParents)
+        parents.emplace_back(node->depth(), node);
+    std::sort(parents.begin(), parents.end(),
+        [](const std::pair<int, Node *> &a, const std::pair<int, Node *> &b) { return a.first > b.first; });
+    _invalidatedParents.clear();
+
+    for (const auto &parent : parents)
+        emitStatus(parent.second, UnknownShared);
 }
 
 QString SyncFileStatusTracker::getSystemDestination(const QString &relativePath)
@@ -19,9 +19,11 @@
 // #include "ownsql.h"
 #include "syncfileitem.h"
 #include "common/syncfilestatus.h"
-#include <map>
 #include <QSet>
 
+#include <memory>
+#include <vector>
+
 namespace OCC {
 
 class SyncEngine;
@@ -53,32 +55,80 @@ private slots:
     void slotSyncEngineRunningChanged();
 
 private:
-    struct PathComparator {
-        bool operator()( const QString& lhs, const QString& rhs ) const;
-    };
-    typedef std::map<QString, SyncFileStatus::SyncFileStatusTag, PathComparator> ProblemsMap;
-    SyncFileStatus::SyncFileStatusTag lookupProblem(const QString &pathToMatch, const ProblemsMap &problemMap);
-
     enum SharedFlag { UnknownShared,
         NotShared,
         Shared };
     enum PathKnownFlag { PathUnknown = 0,
         PathKnown };
-    SyncFileStatus resolveSyncAndErrorStatus(const QString &relativePath, SharedFlag sharedState, PathKnownFlag isPathKnown = PathKnown);
 
-    void invalidateParentPaths(const QString &path);
+    /**
+     * One path component of the status tree.
+     *
+     * The tree only holds the paths the tracker knows something about: the
+     * ones being synced, with problems, touched since the last sync or with
+     * a cached database lookup. Nodes that know nothing are pruned.
+     */
+    struct Node
+    {
+        // What fileStatus() found out from the excludes and the database,
+        // only valid until the path gets synced.
+        enum CachedState : quint8 {
+            NotCached,
+            CachedExcluded,
+            CachedNotInDb,
+            CachedNotShared,
+            CachedShared
+        };
+
+        Node *parent = nullptr;
+        QString name;
+        // Sorted with pathCompare(), see child()
+        std::vector<std::unique_ptr<Node>> children;
+
+        // Counts the number direct children currently being synced (has unfinished propagation jobs).
+        // We'll show a file/directory as SYNC as long as its sync count is > 0.
+        // A directory that starts/ends propagation will in turn increase/decrease its own parent by 1.
+        int syncCount = 0;
+        // Number of StatusError problems in the subtree, excluding this node
+        int errorsBelow = 0;
+        SyncFileStatus::SyncFileStatusTag problem = SyncFileStatus::StatusNone;
+        bool dirty = false;
+        CachedState cached = NotCached;
+
+        int depth() const;
+        bool isEmpty() const;
+    };
+
+    Node *findNode(const QString &relativePath, bool create);
+    Node *child(Node *node, const QStringRef &name, bool create);
+    static QString nodePath(const Node *node);
+    void pruneEmptyChildren(Node *node);
+
+    SyncFileStatus nodeStatus(Node *node, const QString &relativePath);
+    Node::CachedState lookupCachedState(const QString &relativePath);
+    void clearCachedStates(Node *node);
+
+    void setProblem(Node *node, SyncFileStatus::SyncFileStatusTag problem);
+    SyncFileStatus::SyncFileStatusTag lookupProblem(const Node *node) const;
+    SyncFileStatus resolveSyncAndErrorStatus(const Node *node, SharedFlag sharedState, PathKnownFlag isPathKnown = PathKnown);
+
+    void emitStatus(Node *node, SharedFlag sharedState);
+    void invalidateParentPaths(Node *node);
+    void emitInvalidatedParents();
     QString getSystemDestination(const QString &relativePath);
-    void incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
-    void decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
+    void incSyncCountAndEmitStatusChanged(Node *node, SharedFlag sharedState);
+    void decSyncCountAndEmitStatusChanged(Node *node, SharedFlag sharedState);
 
     SyncEngine *_syncEngine;
 
-    ProblemsMap _syncProblems;
-    QSet<QString> _dirtyPaths;
-    // Counts the number direct children currently being synced (has unfinished propagation jobs).
-    // We'll show a file/directory as SYNC as long as its sync count is > 0.
-    // A directory that starts/ends propagation will in turn increase/decrease its own parent by 1.
-    QHash<QString, int> _syncCount;
+    // The sync folder itself
+    Node _root;
+    QSet<Node *> _dirtyNodes;
+    // Ancestors of changed errors, their status is pushed once at the end
+    // of the slot that changed them, see emitInvalidatedParents()
+    QSet<Node *> _invalidatedParents;
+    int _cachedStateCount = 0;
+    bool _cacheCleanupScheduled = false;
 };
 }
 
@@ -46,6 +46,22 @@ void SyncOptions::fillFromEnvironmentVariables()
     int maxParallel = qgetenv("OWNCLOUD_MAX_PARALLEL").toInt();
     if (maxParallel > 0)
         _parallelNetworkJobs = maxParallel;
+
+    int parallelChunks = qgetenv("OWNCLOUD_PARALLEL_CHUNK_UPLOADS").toInt();
+    if (parallelChunks > 0)
+        _parallelChunkUploads = parallelChunks;
+
+    int minTransfers = qgetenv("OWNCLOUD_MIN_PARALLEL_TRANSFERS").toInt();
+    if (minTransfers > 0)
+        _minParallelTransfers = minTransfers;
+
+    int maxTransfers = qgetenv("OWNCLOUD_MAX_PARALLEL_TRANSFERS").toInt();
+    if (maxTransfers > 0)
+        _maxParallelTransfers = maxTransfers;
+
+    QByteArray bandwidthBurstEnv = qgetenv("OWNCLOUD_BANDWIDTH_BURST");
+    if (!bandwidthBurstEnv.isEmpty())
+        _bandwidthBurst = std::chrono::milliseconds(bandwidthBurstEnv.toUInt());
 }
 
 void SyncOptions::verifyChunkSizes()
@@ -67,16 +67,59 @@ struct OWNCLOUDSYNC_EXPORT SyncOptions
     /** The maximum number of active jobs in parallel  */
     int _parallelNetworkJobs = 6;
 
+    /** How many chunks of a single chunkingNG upload may be sent in parallel.
+     *
+     * Additional chunks are only started while the propagator has free
+     * transfer slots, see OwncloudPropagator::maximumActiveTransferJob().
+     */
+    int _parallelChunkUploads = 1;
+
+    /** Bounds for the number of parallel uploads and downloads.
+     *
+     * The propagator adapts the number of transfers between these, see
+     * TransferConcurrencyController. A maximum of 0 means _parallelNetworkJobs.
+     */
+    int _minParallelTransfers = 1;
+    int _maxParallelTransfers = 0;
+
+    /** How much of a bandwidth limit may be saved up while transfers are idle.
+     *
+     * After such a pause the transfers may briefly exceed the limit until the
+     * saved up amount is used. See BandwidthLimiter.
+     */
+    std::chrono::milliseconds _bandwidthBurst = std::chrono::milliseconds(250);
+
     /** Whether delta-synchronization is enabled */
     bool _deltaSyncEnabled = false;
 
     /** What the minimum file size (in Bytes) is for delta-synchronization */
     qint64 _deltaSyncMinFileSize = 0;
 
+    /** How many range requests a single delta-sync download keeps in flight.
+     *
+     * Set to 1 to fetch the ranges strictly one after another.
+     */
+    int _deltaSyncMaxRangeRequests = 4;
+
+    /** Needed byte ranges closer than this (in Bytes) are fetched with one request.
+     *
+     * The bytes in between are downloaded again, trading some bandwidth for
+     * fewer round trips. 0 only merges ranges that touch.
+     */
+    qint64 _deltaSyncRangeMergeGap = 0;
+
+    /** Total size (in Bytes) of the zsync metadata kept in the journal.
+     *
+     * It describes the last synced version of files and lets delta-sync
+     * uploads skip fetching the metadata from the server. 0 disables it.
+     */
+    qint64 _deltaSyncMetadataCacheSize = 32 * 1024 * 1024;
+
     /** Reads settings from env vars where available.
      *
      * Currently reads _initialChunkSize, _minChunkSize, _maxChunkSize,
-     * _targetChunkUploadDuration, _parallelNetworkJobs.
+     * _targetChunkUploadDuration, _parallelNetworkJobs, _parallelChunkUploads,
+     * _minParallelTransfers, _maxParallelTransfers, _bandwidthBurst.
      */
     void fillFromEnvironmentVariables();
 
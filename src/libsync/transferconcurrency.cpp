@@ -0,0 +1,152 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "transferconcurrency.h"
+
+#include <QLoggingCategory>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcTransferConcurrency, "sync.propagator.concurrency", QtInfoMsg)
+
+// After stepping back, wait this many windows before trying a higher limit again
+static const int holdWindowsAfterStepBack = 5;
+
+TransferConcurrencyController::TransferConcurrencyController()
+{
+}
+
+void TransferConcurrencyController::reset(int minimum, int maximum, int initial)
+{
+    _minimum = qMax(1, minimum);
+    _maximum = qMax(_minimum, maximum);
+    _limit = qBound(_minimum, initial, _maximum);
+    _transfers.clear();
+    _windowStartMsec = -1;
+    _window = Window();
+    _lastWindow = Window();
+    _lastWasIncrease = false;
+    _throughputBeforeIncrease = 0;
+    _bestLatency = -1;
+    _holdWindows = 0;
+    qCInfo(lcTransferConcurrency) << "Parallel transfers between" << _minimum << "and" << _maximum << "starting at" << _limit;
+}
+
+void TransferConcurrencyController::setBounds(int minimum, int maximum)
+{
+    _minimum = qMax(1, minimum);
+    _maximum = qMax(_minimum, maximum);
+    setLimit(_limit, "bounds changed");
+}
+
+void TransferConcurrencyController::transferProgress(const QString &file, qint64 bytes, qint64 nowMsec)
+{
+    advance(nowMsec);
+    auto it = _transfers.find(file);
+    if (it == _transfers.end()) {
+        _transfers.insert(file, Transfer{ nowMsec, bytes });
+        _window.maxRunning = qMax(_window.maxRunning, _transfers.size());
+        return;
+    }
+    // Restarted transfers report less than before
+    if (bytes > it->bytes)
+        _window.bytes += bytes - it->bytes;
+    it->bytes = bytes;
+}
+
+void TransferConcurrencyController::transferFinished(const QString &file, qint64 size, bool congested, qint64 nowMsec)
+{
+    advance(nowMsec);
+    auto it = _transfers.find(file);
+    if (it != _transfers.end()) {
+        if (!congested && size <= smallTransferSize()) {
+            _window.latencySumMsec += nowMsec - it->startMsec;
+            _window.latencyCount++;
+        }
+        _transfers.erase(it);
+    }
+    _window.finished++;
+    if (congested)
+        _window.errors++;
+}
+
+void TransferConcurrencyController::advance(qint64 nowMsec)
+{
+    if (_windowStartMsec < 0) {
+        _windowStartMsec = nowMsec;
+        _window.maxRunning = _transfers.size();
+        return;
+    }
+    if (nowMsec - _windowStartMsec < windowDuration())
+        return;
+    _window.durationMsec = nowMsec - _windowStartMsec;
+    evaluate();
+    _lastWindow = _window;
+    _window = Window();
+    _window.maxRunning = _transfers.size();
+    _windowStartMsec = nowMsec;
+}
+
+void TransferConcurrencyController::evaluate()
+{
+    const auto &w = _window;
+    const bool wasIncrease = _lastWasIncrease;
+    _lastWasIncrease = false;
+
+    qCInfo(lcTransferConcurrency) << "Window of" << w.durationMsec << "ms:"
+                                  << w.throughput() / 1024 << "KiB/s,"
+                                  << "latency" << w.latency() << "ms,"
+                                  << "errors" << w.errors << "of" << w.finished << "finished,"
+                                  << "running up to" << w.maxRunning << "of" << _limit;
+
+    if (w.errors > 0 && w.errors * 10 >= w.finished) {
+        _holdWindows = holdWindowsAfterStepBack;
+        setLimit(_limit / 2, "errors");
+        return;
+    }
+
+    const bool latencyInflated = _bestLatency > 0 && w.latency() > 2 * _bestLatency;
+    if (w.latency() > 0 && (_bestLatency < 0 || w.latency() < _bestLatency))
+        _bestLatency = w.latency();
+
+    if (wasIncrease && (w.throughput() * 100 < _throughputBeforeIncrease * 105 || latencyInflated)) {
+        _holdWindows = holdWindowsAfterStepBack;
+        setLimit(_limit - 1, latencyInflated ? "latency grew" : "no throughput gain");
+        return;
+    }
+
+    if (w.maxRunning < _limit) {
+        qCDebug(lcTransferConcurrency) << "Keeping" << _limit << "parallel transfers, not saturated";
+        return;
+    }
+
+    if (_holdWindows > 0) {
+        --_holdWindows;
+        return;
+    }
+
+    if (_limit < _maximum) {
+        _throughputBeforeIncrease = w.throughput();
+        _lastWasIncrease = true;
+        setLimit(_limit + 1, "probing");
+    }
+}
+
+void TransferConcurrencyController::setLimit(int limit, const char *reason)
+{
+    limit = qBound(_minimum, limit, _maximum);
+    if (limit == _limit)
+        return;
+    qCInfo(lcTransferConcurrency) << "Parallel transfers" << _limit << "->" << limit << "(" << reason << ")";
+    _limit = limit;
+}
+}
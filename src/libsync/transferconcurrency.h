@@ -0,0 +1,111 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QString>
+
+namespace OCC {
+
+/**
+ * @brief Adapts the number of parallel transfers to what the link delivers
+ *
+ * The propagator reports the progress and the end of every upload and
+ * download. The reports are summed up in windows of windowDuration() msec,
+ * and at the end of each window the limit is adjusted:
+ *
+ * - If more than a tenth of the finished transfers failed with a network
+ *   error, a timeout or a server overload reply, the limit is halved.
+ * - If the limit wasn't reached during the window, it is kept.
+ * - If the previous window raised the limit and that did not raise the
+ *   throughput by 5%, or it made small transfers take twice as long as the
+ *   best window so far, the limit goes back down by one. It is then kept
+ *   for a few windows before probing again.
+ * - Otherwise the limit grows by one.
+ *
+ * The limit always stays within the configured bounds. Every decision is
+ * logged under sync.propagator.concurrency, and the last window can be read
+ * with lastWindow().
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT TransferConcurrencyController
+{
+public:
+    struct Window
+    {
+        qint64 bytes = 0;
+        qint64 durationMsec = 0;
+        int finished = 0;
+        int errors = 0;
+        qint64 latencySumMsec = 0; // of the transfers up to smallTransferSize()
+        int latencyCount = 0;
+        int maxRunning = 0;
+
+        qint64 throughput() const { return durationMsec > 0 ? bytes * 1000 / durationMsec : 0; }
+        qint64 latency() const { return latencyCount > 0 ? latencySumMsec / latencyCount : -1; }
+    };
+
+    TransferConcurrencyController();
+
+    /** Sets the bounds and the starting limit, and forgets all measurements */
+    void reset(int minimum, int maximum, int initial);
+
+    /** Changes the bounds of a running controller, keeping its measurements */
+    void setBounds(int minimum, int maximum);
+
+    int limit() const { return _limit; }
+    int minimum() const { return _minimum; }
+    int maximum() const { return _maximum; }
+    int running() const { return _transfers.size(); }
+
+    /// Called with the cumulative number of bytes transferred for a file
+    void transferProgress(const QString &file, qint64 bytes, qint64 nowMsec);
+
+    /// Called when a transfer ends; congested is true for errors that hint at an overloaded link or server
+    void transferFinished(const QString &file, qint64 size, bool congested, qint64 nowMsec);
+
+    Window lastWindow() const { return _lastWindow; }
+
+    static qint64 windowDuration() { return 2000; }
+    static qint64 smallTransferSize() { return 1024 * 1024; }
+
+private:
+    struct Transfer
+    {
+        qint64 startMsec;
+        qint64 bytes;
+    };
+
+    void advance(qint64 nowMsec);
+    void evaluate();
+    void setLimit(int limit, const char *reason);
+
+    int _minimum = 1;
+    int _maximum = 1;
+    int _limit = 1;
+
+    QHash<QString, Transfer> _transfers;
+
+    qint64 _windowStartMsec = -1;
+    Window _window;
+    Window _lastWindow;
+
+    bool _lastWasIncrease = false;
+    qint64 _throughputBeforeIncrease = 0;
+    qint64 _bestLatency = -1;
+    int _holdWindows = 0;
+};
+}
@@ -8,6 +8,9 @@
 #include "syncenginetestutils.h"
 #include <syncengine.h>
 
+#include <algorithm>
+#include <random>
+
 using namespace OCC;
 
 int numDirs = 0;
@@ -31,6 +34,37 @@ void addBunchOfFiles(int depth, const QString &path, FileModifier &fi) {
     }
 }
 
+// Compares ordering the discovered items the way SyncEngine used to, inserting
+// each one at its sorted position, with appending them all and sorting once.
+static bool benchItemOrdering(QStringList paths)
+{
+    // Discovery reports the directories in whatever order their listings
+    // arrive; shuffle the paths (reproducibly) to get a similar order.
+    std::mt19937 generator(42);
+    std::shuffle(paths.begin(), paths.end(), generator);
+
+    SyncFileItemVector discovered;
+    for (const auto &path : paths) {
+        SyncFileItemPtr item(new SyncFileItem);
+        item->_file = path;
+        discovered.append(item);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    SyncFileItemVector inserted;
+    for (const auto &item : discovered)
+        inserted.insert(std::lower_bound(inserted.begin(), inserted.end(), item), item);
+    qDebug() << "SORTED INSERT OF" << discovered.size() << "ITEMS:" << timer.restart();
+
+    SyncFileItemVector appended = discovered;
+    std::reverse(appended.begin(), appended.end());
+    std::stable_sort(appended.begin(), appended.end());
+    qDebug() << "APPEND AND SORT OF" << discovered.size() << "ITEMS:" << timer.restart();
+
+    return inserted == appended;
+}
+
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
@@ -39,11 +73,19 @@ int main(int argc, char *argv[])
 
     qDebug() << "NUMFILES" << numFiles;
     qDebug() << "NUMDIRS" << numDirs;
+
+    QStringList paths;
+    QObject::connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted,
+        [&](const SyncFileItemPtr &item) { paths.append(item->_file); });
+
     QElapsedTimer timer;
     timer.start();
     bool result1 = fakeFolder.syncOnce();
     qDebug() << "FIRST SYNC: " << result1 << timer.restart();
     bool result2 = fakeFolder.syncOnce();
     qDebug() << "SECOND SYNC: " << result2 << timer.restart();
-    return (result1 && result2) ? 0 : -1;
+
+    bool result3 = benchItemOrdering(paths);
+    qDebug() << "SAME ORDER: " << result3;
+    return (result1 && result2 && result3) ? 0 : -1;
 }
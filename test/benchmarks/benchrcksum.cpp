@@ -0,0 +1,101 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+// Measures how fast librcksum finds the blocks of a target in a local seed file,
+// comparing the sequential stream scan with the threaded file scan.
+//
+// Usage: RcksumBench [size in MiB] [threads, 0 = one per CPU]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryFile>
+#include <QDebug>
+
+#include <propagatecommonzsync.h>
+
+extern "C" {
+#include "librcksum/rcksum.h"
+}
+
+#include <cstdio>
+
+using namespace OCC;
+
+static QByteArray randomData(qint64 size, quint64 seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (qint64 i = 0; i < size; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        data[i] = char(seed);
+    }
+    return data;
+}
+
+// Returns the number of blocks found, or -1 on error
+static int scan(const QByteArray &target, const QString &seedFile, bool threaded, int threads, qint64 *elapsed)
+{
+    const int blocks = int((target.size() + ZSYNC_BLOCKSIZE - 1) / ZSYNC_BLOCKSIZE);
+    struct rcksum_state *rs = rcksum_init(blocks, ZSYNC_BLOCKSIZE, 8, 16, nullptr);
+    if (!rs)
+        return -1;
+    for (int b = 0; b < blocks; ++b) {
+        auto block = reinterpret_cast<const unsigned char *>(target.constData()) + qint64(b) * ZSYNC_BLOCKSIZE;
+        unsigned char checksum[CHECKSUM_SIZE];
+        rcksum_calc_checksum(checksum, block, ZSYNC_BLOCKSIZE);
+        rcksum_add_target_block(rs, b, rcksum_calc_rsum_block(block, ZSYNC_BLOCKSIZE), checksum);
+    }
+    rcksum_set_scan_threads(rs, threads);
+
+    FILE *f = fopen(seedFile.toLocal8Bit().constData(), "rb");
+    if (!f) {
+        rcksum_end(rs);
+        return -1;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    int got = threaded ? rcksum_submit_source_file(rs, f, false, false)
+                       : rcksum_submit_source_stream(rs, f, false, false);
+    *elapsed = timer.nsecsElapsed();
+    fclose(f);
+    rcksum_end(rs);
+    return got;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const qint64 size = (argc > 1 ? QByteArray(argv[1]).toLongLong() : 256) * 1024 * 1024;
+    const int threads = argc > 2 ? QByteArray(argv[2]).toInt() : 0;
+
+    // The target is all blocks of the seed but shifted by a few bytes, with one
+    // block in eight changed: the scan has to roll over every byte of the
+    // changed blocks and checksum each of the others.
+    QByteArray target = randomData(size, 0x9E3779B97F4A7C15ull);
+    QByteArray seed = randomData(3, 42) + target;
+    for (qint64 offset = 5 * ZSYNC_BLOCKSIZE + 17; offset < target.size(); offset += 8 * ZSYNC_BLOCKSIZE)
+        target[offset] = ~target[offset];
+
+    QTemporaryFile seedFile;
+    if (!seedFile.open() || seedFile.write(seed) != seed.size()) {
+        qWarning() << "Could not write the seed file";
+        return -1;
+    }
+    seedFile.close();
+
+    qint64 streamTime = 0;
+    qint64 threadedTime = 0;
+    int streamBlocks = scan(target, seedFile.fileName(), false, threads, &streamTime);
+    int threadedBlocks = scan(target, seedFile.fileName(), true, threads, &threadedTime);
+
+    auto rate = [&](qint64 nsecs) { return nsecs ? double(seed.size()) / nsecs : 0; };
+    qDebug() << "SEED MiB" << seed.size() / (1024 * 1024) << "THREADS" << threads;
+    qDebug() << "STREAM SCAN:  " << streamBlocks << "blocks" << rate(streamTime) << "GB/s";
+    qDebug() << "THREADED SCAN:" << threadedBlocks << "blocks" << rate(threadedTime) << "GB/s";
+    return (streamBlocks >= 0 && streamBlocks == threadedBlocks) ? 0 : -1;
+}
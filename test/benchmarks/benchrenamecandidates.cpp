@@ -0,0 +1,102 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+// Measures the rename candidate lookups of the discovery on a large journal,
+// comparing one journal query per lookup with the RenameCandidateIndex.
+//
+// Usage: RenameCandidatesBench [records, default 1000000] [lookups, default 100000]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QDebug>
+
+#include "common/syncjournaldb.h"
+#include "common/syncjournalfilerecord.h"
+#include "discoveryphase.h"
+
+#include <random>
+
+using namespace OCC;
+
+static QByteArray fileIdFor(int i)
+{
+    return QByteArray::number(i).rightJustified(8, '0') + "ocbenchid";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int records = argc > 1 ? QByteArray(argv[1]).toInt() : 1000000;
+    const int lookups = argc > 2 ? QByteArray(argv[2]).toInt() : 100000;
+
+    QTemporaryDir dir;
+    SyncJournalDb db(dir.path() + "/.sync_bench.db");
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < records; ++i) {
+        SyncJournalFileRecord record;
+        record._path = "dir" + QByteArray::number(i / 1000) + "/file" + QByteArray::number(i);
+        record._inode = 1000 + quint64(i);
+        record._fileId = fileIdFor(i);
+        record._etag = "etag";
+        record._type = ItemTypeFile;
+        record._remotePerm = RemotePermissions::fromDbValue("RW");
+        record._modtime = 1500000000;
+        record._fileSize = i;
+        if (!db.setFileRecord(record)) {
+            qWarning() << "Could not write the journal";
+            return -1;
+        }
+    }
+    db.commit("bench");
+    qDebug() << "JOURNAL" << records << "records written in" << timer.elapsed() << "ms";
+
+    // Half of the lookups hit an existing record, like moved files do; the
+    // other half are new files that have no rename source.
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 2 * records - 1);
+    QVector<int> keys(lookups);
+    for (auto &key : keys)
+        key = dist(gen);
+
+    auto run = [&](const char *name, auto &&byInode, auto &&byFileId, QVector<QByteArray> *paths) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int key : keys) {
+            SyncJournalFileRecord rec;
+            if (!byInode(1000 + quint64(key), &rec))
+                return false;
+            paths->append(rec._path);
+            if (!byFileId(fileIdFor(key), [&](const SyncJournalFileRecord &r) { paths->append(r._path); }))
+                return false;
+        }
+        qDebug() << name << 2 * lookups << "lookups in" << timer.elapsed() << "ms";
+        return true;
+    };
+
+    QVector<QByteArray> directPaths;
+    bool ok = run("JOURNAL QUERIES:",
+        [&](quint64 inode, SyncJournalFileRecord *rec) { return db.getFileRecordByInode(inode, rec); },
+        [&](const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &cb) { return db.getFileRecordsByFileId(fileId, cb); },
+        &directPaths);
+
+    RenameCandidateIndex index(&db);
+    index.setDirectLookupLimit(0);
+    QVector<QByteArray> indexPaths;
+    ok = ok && run("INDEX (including build):",
+        [&](quint64 inode, SyncJournalFileRecord *rec) { return index.getFileRecordByInode(inode, rec); },
+        [&](const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &cb) { return index.getFileRecordsByFileId(fileId, cb); },
+        &indexPaths);
+
+    if (!ok || !index.isBuilt() || directPaths != indexPaths) {
+        qWarning() << "The index lookups differ from the journal queries";
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+// Downloads a few large files that come first in discovery order together
+// with many small documents, and measures how long it takes until the first
+// documents are available and until the whole sync is done.
+//
+// Every GET reply is delayed by a fixed latency plus its size divided by a
+// per-connection transfer rate.
+
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+static const int largeFiles = 4;
+static const int largeFileSize = 16 * 1000 * 1000;
+static const int smallDirs = 10;
+static const int smallFilesPerDir = 50;
+static const int smallFileSize = 2000;
+static const int firstN = 100;
+static const qint64 latencyMs = 20;
+static const qint64 bytesPerMs = 5000; // 5 MB/s per connection
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    FakeFolder fakeFolder{ FileInfo{} };
+
+    auto &remote = fakeFolder.remoteModifier();
+    remote.mkdir("a-media");
+    for (int i = 0; i < largeFiles; ++i)
+        remote.insert(QStringLiteral("a-media/video%1.mp4").arg(i), largeFileSize);
+    remote.mkdir("documents");
+    for (int d = 0; d < smallDirs; ++d) {
+        const QString dir = QStringLiteral("documents/dir%1").arg(d);
+        remote.mkdir(dir);
+        for (int i = 0; i < smallFilesPerDir; ++i)
+            remote.insert(QStringLiteral("%1/doc%2.txt").arg(dir).arg(i), smallFileSize);
+    }
+
+    fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+        if (op != QNetworkAccessManager::GetOperation || request.url().hasQuery())
+            return nullptr;
+        auto info = fakeFolder.remoteModifier().find(getFilePathFromUrl(request.url()));
+        if (!info)
+            return nullptr;
+        return new DelayedReply<FakeGetReply>(latencyMs + info->size / bytesPerMs,
+            fakeFolder.remoteModifier(), op, request, &fakeFolder.syncEngine());
+    });
+
+    QElapsedTimer timer;
+    int smallDone = 0;
+    qint64 firstNMs = -1;
+    qint64 allSmallMs = -1;
+    QObject::connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted,
+        [&](const SyncFileItemPtr &item) {
+            if (item->isDirectory() || !item->_file.startsWith("documents/"))
+                return;
+            ++smallDone;
+            if (smallDone == firstN)
+                firstNMs = timer.elapsed();
+            if (smallDone == smallDirs * smallFilesPerDir)
+                allSmallMs = timer.elapsed();
+        });
+
+    timer.start();
+    bool ok = fakeFolder.syncOnce();
+    const qint64 totalMs = timer.elapsed();
+
+    qDebug() << "FIRST" << firstN << "DOCUMENTS:" << firstNMs << "ms";
+    qDebug() << "ALL" << smallDone << "DOCUMENTS:" << allSmallMs << "ms";
+    qDebug() << "TOTAL SYNC:" << totalMs << "ms";
+
+    ok = ok && fakeFolder.currentLocalState() == fakeFolder.currentRemoteState();
+    qDebug() << "RESULT:" << ok;
+    return ok ? 0 : -1;
+}
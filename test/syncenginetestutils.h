@@ -32,6 +32,9 @@ static const QUrl sRootUrl("owncloud://somehost/owncloud/remote.php/webdav/");
 static const QUrl sRootUrl2("owncloud://somehost/owncloud/remote.php/dav/files/admin/");
 static const QUrl sUploadUrl("owncloud://somehost/owncloud/remote.php/dav/uploads/admin/");
 
+// Set on the requests that a FakeShardQNAM forwards, holds the FakeShardQNAM
+static const auto sShardQnamAttribute = QNetworkRequest::Attribute(QNetworkRequest::User + 1);
+
 inline QString getFilePathFromUrl(const QUrl &url) {
     QString path = url.path();
     if (path.startsWith(sRootUrl.path()))
@@ -400,7 +403,11 @@ public:
                 ? QString(fileInfo.permissions.toString())
                 : fileInfo.isShared ? QStringLiteral("SRDNVCKW") : QStringLiteral("RDNVCKW"));
             xml.writeTextElement(ocUri, QStringLiteral("id"), fileInfo.fileId);
-            xml.writeTextElement(ocUri, QStringLiteral("checksums"), fileInfo.checksums);
+            // Like the server, with the checksums inside a nested element
+            xml.writeStartElement(ocUri, QStringLiteral("checksums"));
+            if (!fileInfo.checksums.isEmpty())
+                xml.writeTextElement(ocUri, QStringLiteral("checksum"), fileInfo.checksums);
+            xml.writeEndElement(); // checksums
             xml.writeTextElement(ocUri, QStringLiteral("zsync"), QStringLiteral("true"));
             buffer.write(fileInfo.extraDavProperties);
             xml.writeEndElement(); // prop
@@ -589,6 +596,81 @@ public:
     qint64 readData(char *, qint64) override { return 0; }
 };
 
+class FakeCopyReply : public QNetworkReply
+{
+    Q_OBJECT
+    int _httpStatus = 201;
+public:
+    FakeCopyReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
+    : QNetworkReply{parent} {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+
+        QString fileName = getFilePathFromUrl(request.url());
+        Q_ASSERT(!fileName.isEmpty());
+        QString dest = getFilePathFromUrl(QUrl::fromEncoded(request.rawHeader("Destination")));
+        Q_ASSERT(!dest.isEmpty());
+        const FileInfo *source = remoteRootFileInfo.find(fileName);
+        const QByteArray ifMatch = request.rawHeader("If-Match");
+        if (!source) {
+            _httpStatus = 404;
+        } else if ((!ifMatch.isEmpty() && ifMatch != '"' + source->etag.toLatin1() + '"')
+            || (request.rawHeader("Overwrite") == "F" && remoteRootFileInfo.find(dest))) {
+            _httpStatus = 412;
+        } else {
+            const FileInfo original = *source;
+            FileInfo *copy = remoteRootFileInfo.create(dest, original.size, original.contentChar);
+            copy->checksums = original.checksums;
+            copy->lastModified = original.lastModified;
+        }
+        QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
+    }
+
+    Q_INVOKABLE void respond() {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _httpStatus);
+        if (_httpStatus / 100 != 2)
+            setError(ContentOperationNotPermittedError, "Copy failed");
+        emit metaDataChanged();
+        emit finished();
+    }
+
+    void abort() override { }
+    qint64 readData(char *, qint64) override { return 0; }
+};
+
+class FakeProppatchReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    FakeProppatchReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &body, QObject *parent)
+    : QNetworkReply{parent} {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+
+        // Only the modification time can be set
+        QString fileName = getFilePathFromUrl(request.url());
+        Q_ASSERT(!fileName.isEmpty());
+        QRegularExpression rx("<lastmodified[^>]*>(\\d+)</lastmodified>");
+        auto match = rx.match(QString::fromUtf8(body));
+        if (match.hasMatch())
+            remoteRootFileInfo.setModTime(fileName, OCC::Utility::qDateTimeFromTime_t(match.captured(1).toLongLong()));
+        QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
+    }
+
+    Q_INVOKABLE void respond() {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 207);
+        emit metaDataChanged();
+        emit finished();
+    }
+
+    void abort() override { }
+    qint64 readData(char *, qint64) override { return 0; }
+};
+
 class FakeGetReply : public QNetworkReply
 {
     Q_OBJECT
@@ -613,7 +695,7 @@ public:
         QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
     }
 
-    Q_INVOKABLE void respond() {
+    Q_INVOKABLE virtual void respond() {
         if (aborted) {
             setError(OperationCanceledError, "Operation Canceled");
             emit metaDataChanged();
@@ -1140,6 +1222,10 @@ protected:
             return new FakeMoveReply{info, op, request, this};
         else if (verb == QLatin1String("MOVE") && isUpload)
             return new FakeChunkMoveReply{ info, _remoteRootFileInfo, op, request, this };
+        else if (verb == QLatin1String("COPY"))
+            return new FakeCopyReply{info, op, request, this};
+        else if (verb == QLatin1String("PROPPATCH"))
+            return new FakeProppatchReply{info, op, request, outgoingData->readAll(), this};
         else {
             qDebug() << verb << outgoingData;
             Q_UNREACHABLE();
@@ -1147,14 +1233,51 @@ protected:
     }
 };
 
+/* Stands in for the separate QNAMs of the NetworkJobClasses: sends the
+ * requests through the FakeQNAM, marked with sShardQnamAttribute. */
+class FakeShardQNAM : public QNetworkAccessManager
+{
+    QNetworkAccessManager *_target;
+public:
+    FakeShardQNAM(QNetworkAccessManager *target) : _target{target} { }
+
+protected:
+    QNetworkReply *createRequest(Operation op, const QNetworkRequest &request,
+                                         QIODevice *outgoingData = 0) override {
+        QNetworkRequest req(request);
+        req.setAttribute(sShardQnamAttribute, QVariant::fromValue<QObject *>(this));
+        switch (op) {
+        case HeadOperation:
+            return _target->head(req);
+        case GetOperation:
+            return _target->get(req);
+        case PutOperation:
+            return _target->put(req, outgoingData);
+        case PostOperation:
+            return _target->post(req, outgoingData);
+        case DeleteOperation:
+            return _target->deleteResource(req);
+        default:
+            return _target->sendCustomRequest(req, req.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray(), outgoingData);
+        }
+    }
+};
+
 class FakeCredentials : public OCC::AbstractCredentials
 {
     QNetworkAccessManager *_qnam;
+    bool _qnamSharding = false;
 public:
     FakeCredentials(QNetworkAccessManager *qnam) : _qnam{qnam} { }
     virtual QString authType() const { return "test"; }
     virtual QString user() const { return "admin"; }
-    virtual QNetworkAccessManager *createQNAM() const { return _qnam; }
+    virtual QNetworkAccessManager *createQNAM() const {
+        // Once the account has its main QNAM, hand out separate ones if asked to
+        if (_qnamSharding && _account && _account->networkAccessManager() == _qnam)
+            return new FakeShardQNAM(_qnam);
+        return _qnam;
+    }
+    void setQnamSharding(bool enabled) { _qnamSharding = enabled; }
     virtual bool ready() const { return true; }
     virtual void fetchFromKeychain() { }
     virtual void askFromUser() { }
@@ -1260,6 +1383,9 @@ public:
     ErrorList serverErrorPaths() { return {_fakeQnam}; }
     void setServerOverride(const FakeQNAM::Override &override) { _fakeQnam->setOverride(override); }
 
+    /// Send the requests of each NetworkJobClass through a separate FakeShardQNAM
+    void setQnamSharding(bool enabled) { static_cast<FakeCredentials *>(_account->credentials())->setQnamSharding(enabled); }
+
     QString localPath() const {
         // SyncEngine wants a trailing slash
         if (_tempDir.path().endsWith('/'))
@@ -0,0 +1,206 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "bandwidthmanager.h"
+
+using namespace OCC;
+
+static const qint64 readBufferSize = 16 * 1024;
+
+/* Transfers that would go faster than the limit: every msec the link delivers
+ * linkRate / 1000 bytes to each of them, and they read from their buffer
+ * whenever they are not waiting for the next round. */
+struct FakeLink
+{
+    struct Transfer : public QObject
+    {
+        qint64 buffered = 0;
+        qint64 received = 0;
+        bool waiting = false;
+        bool active = true;
+    };
+
+    BandwidthLimiter limiter;
+    QList<QSharedPointer<Transfer>> transfers;
+    qint64 linkRate = 0; // per transfer, in bytes per second
+    qint64 now = 0;
+
+    FakeLink(int count, qint64 rate)
+        : linkRate(rate)
+    {
+        for (int i = 0; i < count; ++i) {
+            transfers.append(QSharedPointer<Transfer>::create());
+            limiter.addConsumer(transfers.last().data());
+        }
+    }
+
+    void run(qint64 msec)
+    {
+        for (const qint64 end = now + msec; now < end; ++now) {
+            for (auto &t : transfers) {
+                if (!t->active)
+                    continue;
+                t->buffered = qMin(t->buffered + linkRate / 1000, readBufferSize);
+                while (!t->waiting && t->buffered > 0) {
+                    qint64 got = limiter.take(t.data(), t->buffered, now);
+                    t->waiting = got == 0;
+                    t->buffered -= got;
+                    t->received += got;
+                }
+            }
+            if (now % BandwidthLimiter::roundMsec() == 0 && limiter.hasWaiting()) {
+                for (auto *o : limiter.nextRound(now))
+                    static_cast<Transfer *>(o)->waiting = false;
+            }
+        }
+    }
+
+    qint64 received() const
+    {
+        qint64 total = 0;
+        for (const auto &t : transfers)
+            total += t->received;
+        return total;
+    }
+};
+
+static bool withinPercent(qint64 actual, qint64 expected, qint64 percent)
+{
+    return qAbs(actual - expected) * 100 <= expected * percent;
+}
+
+class TestBandwidthManager : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testUnlimited()
+    {
+        BandwidthLimiter limiter;
+        QObject consumer;
+        limiter.addConsumer(&consumer);
+        QVERIFY(!limiter.isLimited());
+        QCOMPARE(limiter.take(&consumer, 1000000, 0), qint64(1000000));
+        QCOMPARE(limiter.transferred(), qint64(1000000));
+    }
+
+    void testBurst()
+    {
+        BandwidthLimiter limiter;
+        QObject consumer;
+        limiter.addConsumer(&consumer);
+        limiter.setLimit(100000, 1000, 0);
+        QCOMPARE(limiter.burst(), qint64(100000));
+
+        // The bucket starts full and refills with the rate
+        QCOMPARE(limiter.take(&consumer, 1000000, 0), qint64(100000));
+        QCOMPARE(limiter.take(&consumer, 1000000, 0), qint64(0));
+        QVERIFY(limiter.hasWaiting());
+        QCOMPARE(limiter.take(&consumer, 1000000, 500), qint64(50000));
+
+        // ... but never holds more than the burst
+        QCOMPARE(limiter.take(&consumer, 1000000, 10000), qint64(100000));
+
+        // At least what accumulates during two rounds fits
+        limiter.setLimit(100000, 0, 10000);
+        QCOMPARE(limiter.burst(), qint64(100000 * 2 * BandwidthLimiter::roundMsec() / 1000));
+    }
+
+    void testAbsoluteRate_data()
+    {
+        QTest::addColumn<int>("transfers");
+        QTest::addColumn<qint64>("limit");
+
+        QTest::newRow("1 transfer, 100 KB/s") << 1 << qint64(100 * 1000);
+        QTest::newRow("4 transfers, 100 KB/s") << 4 << qint64(100 * 1000);
+        QTest::newRow("4 transfers, 1 MB/s") << 4 << qint64(1000 * 1000);
+        QTest::newRow("16 transfers, 1 MB/s") << 16 << qint64(1000 * 1000);
+        QTest::newRow("16 transfers, 10 MB/s") << 16 << qint64(10 * 1000 * 1000);
+    }
+
+    void testAbsoluteRate()
+    {
+        QFETCH(int, transfers);
+        QFETCH(qint64, limit);
+
+        // Each transfer alone could use four times the limit
+        FakeLink link(transfers, 4 * limit);
+        link.limiter.setLimit(limit, 250, 0);
+        link.run(10000);
+        QVERIFY2(withinPercent(link.received(), limit * 10, 5),
+            qPrintable(QString("received %1 bytes").arg(link.received())));
+
+        // Every transfer gets its share
+        for (const auto &t : link.transfers)
+            QVERIFY(withinPercent(t->received, link.received() / transfers, 10));
+    }
+
+    void testIdleTransfersDontReduceRate()
+    {
+        FakeLink link(4, 1000 * 1000);
+        for (int i = 1; i < 4; ++i)
+            link.transfers[i]->active = false;
+        link.limiter.setLimit(200 * 1000, 250, 0);
+        link.run(10000);
+        QVERIFY(withinPercent(link.transfers[0]->received, 2000 * 1000, 5));
+    }
+
+    void testLimitChange()
+    {
+        FakeLink link(4, 1000 * 1000);
+        link.limiter.setLimit(1000 * 1000, 250, 0);
+        link.run(5000);
+        const qint64 before = link.received();
+        QVERIFY(withinPercent(before, 5000 * 1000, 5));
+
+        link.limiter.setLimit(200 * 1000, 250, link.now);
+        link.run(10000);
+        QVERIFY(withinPercent(link.received() - before, 2000 * 1000, 5));
+    }
+
+    void testRelativeRate()
+    {
+        // The link does 1 MB/s, shared by four transfers
+        FakeLink link(4, 250 * 1000);
+        link.limiter.setLimit(-50, 250, 0);
+
+        link.run(BandwidthLimiter::probeMsec());
+        QCOMPARE(link.limiter.rate(), qint64(0));
+        link.run(1);
+        QVERIFY(link.limiter.rate() > 0);
+        QVERIFY(link.limiter.rate() < 500 * 1000);
+
+        link.run(3 * BandwidthLimiter::relativePeriodMsec() - link.now);
+        QVERIFY2(withinPercent(link.received(), 3 * 40 * 500 * 1000, 5),
+            qPrintable(QString("received %1 bytes").arg(link.received())));
+    }
+
+    void testWaitingConsumerRemoved()
+    {
+        BandwidthLimiter limiter;
+        QObject a;
+        QObject b;
+        limiter.addConsumer(&a);
+        limiter.addConsumer(&b);
+        limiter.setLimit(10000, 250, 0);
+        limiter.take(&a, 1000000, 0);
+        QCOMPARE(limiter.take(&a, 1000, 0), qint64(0));
+        QCOMPARE(limiter.take(&b, 1000, 0), qint64(0));
+        limiter.removeConsumer(&a);
+        QCOMPARE(limiter.nextRound(100), QList<QObject *>() << &b);
+
+        // A woken consumer that doesn't ask again stops waiting
+        QVERIFY(limiter.hasWaiting());
+        QVERIFY(limiter.nextRound(200).isEmpty());
+        QVERIFY(!limiter.hasWaiting());
+    }
+};
+
+QTEST_APPLESS_MAIN(TestBandwidthManager)
+#include "testbandwidthmanager.moc"
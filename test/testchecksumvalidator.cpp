@@ -14,6 +14,7 @@
 #include "common/utility.h"
 #include "filesystem.h"
 #include "propagatorjobs.h"
+#include "propagateupload.h"
 
 using namespace OCC;
 using namespace OCC::Utility;
@@ -174,6 +175,58 @@ using namespace OCC::Utility;
         delete vali;
     }
 
+    void testUploadChecksumsSinglePass() {
+        // Two full zsync blocks and a short last one
+        QString file(_root.path() + "/file_c.bin");
+        {
+            QFile f(file);
+            QVERIFY(f.open(QIODevice::WriteOnly));
+            for (int i = 0; i < 2 * ZSYNC_BLOCKSIZE + 12345; ++i)
+                f.putChar(char(i * 7 % 251));
+        }
+
+        ComputeUploadChecksums compute;
+        compute.setContentChecksumType(OCC::checkSumSHA1C);
+        compute.setTransmissionChecksumType(OCC::checkSumMD5C);
+        compute.setGenerateZsyncMetadata(true);
+
+        QSignalSpy progressSpy(&compute, &ComputeUploadChecksums::progress);
+        QSignalSpy doneSpy(&compute, &ComputeUploadChecksums::done);
+        compute.start(file);
+        QVERIFY(doneSpy.wait());
+
+        auto result = compute.result();
+        QVERIFY(result.errorString.isEmpty());
+        QCOMPARE(result.contentChecksumType, QByteArray(OCC::checkSumSHA1C));
+        QCOMPARE(result.contentChecksum, ComputeChecksum::computeNowOnFile(file, OCC::checkSumSHA1C));
+        QCOMPARE(result.transmissionChecksumType, QByteArray(OCC::checkSumMD5C));
+        QCOMPARE(result.transmissionChecksum, ComputeChecksum::computeNowOnFile(file, OCC::checkSumMD5C));
+        QVERIFY(!progressSpy.isEmpty());
+        QCOMPARE(progressSpy.last()[0].toLongLong(), QFileInfo(file).size());
+
+        // The zsync metadata matches the one of a separate generation pass
+        QString generated;
+        ZsyncGenerateRunnable generate(file);
+        connect(&generate, &ZsyncGenerateRunnable::finishedSignal, [&](const QString &fileName) { generated = fileName; });
+        generate.run();
+        QVERIFY(!generated.isEmpty());
+        QFile singlePassMetadata(result.zsyncMetadataFile);
+        QFile separateMetadata(generated);
+        QVERIFY(singlePassMetadata.open(QIODevice::ReadOnly));
+        QVERIFY(separateMetadata.open(QIODevice::ReadOnly));
+        QCOMPARE(singlePassMetadata.readAll(), separateMetadata.readAll());
+        singlePassMetadata.remove();
+        separateMetadata.remove();
+
+        // Equal types are computed once, and no metadata unless asked for
+        compute.setTransmissionChecksumType(OCC::checkSumSHA1C);
+        compute.setGenerateZsyncMetadata(false);
+        result = compute.computeNow(file);
+        QCOMPARE(result.transmissionChecksumType, QByteArray(OCC::checkSumSHA1C));
+        QCOMPARE(result.transmissionChecksum, result.contentChecksum);
+        QVERIFY(result.zsyncMetadataFile.isEmpty());
+    }
+
     void testDownloadChecksummingAdler() {
 #ifndef ZLIB_FOUND
         QSKIP("ZLIB not found.", SkipSingle);
@@ -75,6 +75,50 @@ private slots:
         QCOMPARE(fakeFolder.uploadState().children.count(), 2); // the transfer was done with chunking
     }
 
+    // Test that a single file keeps several chunks in flight, within the transfer job budget
+    void testParallelChunks() {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ {"chunking", "1.0"} } } });
+        SyncOptions options;
+        options._maxChunkSize = options._initialChunkSize = options._minChunkSize = 1 * 1000 * 1000;
+        options._parallelNetworkJobs = 6; // allows 3 transfers
+        options._parallelChunkUploads = 4;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        const int size = 10 * 1000 * 1000; // 10 MB
+
+        int inFlight = 0;
+        int maxInFlight = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *data) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation && request.url().path().startsWith(sUploadUrl.path())) {
+                auto reply = new FakePutReply{ fakeFolder.uploadState(), op, request, data->readAll(), this };
+                maxInFlight = qMax(maxInFlight, ++inFlight);
+                connect(reply, &QNetworkReply::finished, [&inFlight] { --inFlight; });
+                return reply;
+            }
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert("A/a0", size);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, size);
+        QCOMPARE(maxInFlight, 3);
+
+        // Resuming an interrupted parallel upload still produces the complete file
+        fakeFolder.localModifier().insert("A/a1", size);
+        auto con = QObject::connect(&fakeFolder.syncEngine(), &SyncEngine::transmissionProgress,
+            [&](const ProgressInfo &progress) {
+                if (progress.completedSize() > (progress.totalSize() / 3))
+                    fakeFolder.syncEngine().abort();
+            });
+        QVERIFY(!fakeFolder.syncOnce());
+        QObject::disconnect(con);
+        QVERIFY(fakeFolder.currentRemoteState().find("A/a1") == nullptr);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a1")->size, size);
+    }
+
     // Test resuming when there's a confusing chunk added
     void testResume1() {
         FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
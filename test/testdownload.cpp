@@ -40,6 +40,42 @@ public:
 };
 
 
+/* A FakeGetReply that honours the Range header and sends an OC-Checksum header */
+class RangeFakeGetReply : public FakeGetReply
+{
+    Q_OBJECT
+public:
+    using FakeGetReply::FakeGetReply;
+    QByteArray checksumHeader;
+
+    void respond() override
+    {
+        if (aborted) {
+            setError(OperationCanceledError, "Operation Canceled");
+            emit metaDataChanged();
+            emit finished();
+            return;
+        }
+        qint64 start = 0;
+        sscanf(request().rawHeader("Range").constData(), "bytes=%lld-", &start);
+        payload = fileInfo->contentChar;
+        size = fileInfo->size - start;
+        setHeader(QNetworkRequest::ContentLengthHeader, size);
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, start > 0 ? 206 : 200);
+        if (start > 0)
+            setRawHeader("Content-Range", "bytes " + QByteArray::number(start) + "-"
+                    + QByteArray::number(fileInfo->size - 1) + "/" + QByteArray::number(fileInfo->size));
+        setRawHeader("OC-ETag", fileInfo->etag.toLatin1());
+        setRawHeader("ETag", fileInfo->etag.toLatin1());
+        setRawHeader("OC-FileId", fileInfo->fileId);
+        setRawHeader("OC-Checksum", checksumHeader);
+        emit metaDataChanged();
+        if (bytesAvailable())
+            emit readyRead();
+        emit finished();
+    }
+};
+
 SyncFileItemPtr getItem(const QSignalSpy &spy, const QString &path)
 {
     for (const QList<QVariant> &args : spy) {
@@ -91,6 +127,106 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    void testResumeChecksum_data()
+    {
+        QTest::addColumn<bool>("serverSupportsRange");
+        QTest::addColumn<bool>("goodChecksum");
+
+        QTest::newRow("range, good checksum") << true << true;
+        QTest::newRow("range, bad checksum") << true << false;
+        QTest::newRow("no range, good checksum") << false << true;
+        QTest::newRow("no range, bad checksum") << false << false;
+    }
+
+    void testResumeChecksum()
+    {
+        // The checksum of a resumed download covers the part downloaded before
+        QFETCH(bool, serverSupportsRange);
+        QFETCH(bool, goodChecksum);
+
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        auto size = 8 * 1000 * 1000;
+        fakeFolder.remoteModifier().insert("A/a0", size, 'R');
+
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/a0")) {
+                return new BrokenFakeGetReply(fakeFolder.remoteModifier(), op, request, this);
+            }
+            return nullptr;
+        });
+        QVERIFY(!fakeFolder.syncOnce());
+
+        const QByteArray sha1 = QCryptographicHash::hash(QByteArray(size, goodChecksum ? 'R' : 'X'),
+            QCryptographicHash::Sha1).toHex();
+        QByteArray ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/a0")) {
+                ranges = request.rawHeader("Range");
+                QNetworkRequest withoutRange = request;
+                if (!serverSupportsRange)
+                    withoutRange.setRawHeader("Range", QByteArray());
+                auto reply = new RangeFakeGetReply(fakeFolder.remoteModifier(), op, withoutRange, this);
+                reply->checksumHeader = "SHA1:" + sha1;
+                return reply;
+            }
+            return nullptr;
+        });
+        QCOMPARE(fakeFolder.syncOnce(), goodChecksum);
+        QCOMPARE(ranges, QByteArray("bytes=" + QByteArray::number(stopAfter) + "-"));
+        if (!goodChecksum)
+            return;
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // The content checksum is taken from the download
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArray("A/a0"), &record));
+        QCOMPARE(record._checksumHeader, QByteArray("SHA1:" + sha1));
+    }
+
+    void testLocalCopy()
+    {
+        // A file whose content was already synced to another path is copied locally
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        const int size = 300 * 1000;
+        const QByteArray checksumHeader = "SHA1:" + QCryptographicHash::hash(QByteArray(size, 'Q'), QCryptographicHash::Sha1).toHex();
+        fakeFolder.remoteModifier().insert("A/orig", size, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+
+        int getCount = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation)
+                ++getCount;
+            return nullptr;
+        });
+
+        fakeFolder.remoteModifier().insert("B/copy", size, 'Q');
+        fakeFolder.remoteModifier().find("B/copy")->checksums = checksumHeader;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(getCount, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArray("B/copy"), &record));
+        QCOMPARE(record._checksumHeader, checksumHeader);
+
+        // If the local files were changed without changing their size and mtime,
+        // the copy doesn't have the right checksum and the file is downloaded
+        for (const QString &file : { QString("A/orig"), QString("B/copy") }) {
+            const QString path = fakeFolder.localPath() + file;
+            const auto mtime = FileSystem::getModTime(path);
+            QFile f(path);
+            QVERIFY(f.open(QFile::WriteOnly));
+            f.write(QByteArray(size, 'Y'));
+            f.close();
+            FileSystem::setModTime(path, mtime);
+        }
+        fakeFolder.remoteModifier().insert("C/copy", size, 'Q');
+        fakeFolder.remoteModifier().find("C/copy")->checksums = checksumHeader;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(getCount, 1);
+        QCOMPARE(*fakeFolder.currentLocalState().find("C/copy"), *fakeFolder.currentRemoteState().find("C/copy"));
+    }
+
     void testErrorMessage () {
         // This test's main goal is to test that the error string from the server is shown in the UI
 
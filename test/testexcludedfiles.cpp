@@ -12,6 +12,10 @@
 
 using namespace OCC;
 
+namespace OCC {
+OCSYNC_EXPORT extern bool fsCasePreserving_override;
+}
+
 #define EXCLUDE_LIST_FILE SOURCEDIR "/../../sync-exclude.lst"
 
 // The tests were converted from the old CMocka framework, that's why there is a global
@@ -590,6 +594,94 @@ private slots:
         }
     }
 
+    void check_csync_excluded_traversal_bname_sets()
+    {
+        setup();
+        excludedFiles->addManualExclude("literal");
+        excludedFiles->addManualExclude("*.suffix");
+        excludedFiles->addManualExclude("prefix.*");
+        excludedFiles->addManualExclude("dironly/");
+        excludedFiles->addManualExclude("]*.removed");
+        excludedFiles->addManualExclude("*.both");
+        excludedFiles->addManualExclude("]*.both");
+        excludedFiles->addManualExclude("\\*literal");
+        excludedFiles->addManualExclude("deep/*/tree/*.log");
+
+        QCOMPARE(check_file_traversal("literal"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/b/literal"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("literalX"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(check_file_traversal("a/file.suffix"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal(".suffix"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/file.suffixX"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(check_file_traversal("prefix."), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/prefix.x"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/Xprefix.x"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(check_dir_traversal("a/dironly"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/dironly"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(check_file_traversal("a/file.removed"), CSYNC_FILE_EXCLUDE_AND_REMOVE);
+        QCOMPARE(check_file_traversal("a/file.both"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("*literal"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("Xliteral"), CSYNC_NOT_EXCLUDED);
+
+        // The cached directory decisions must not hide full path patterns
+        QCOMPARE(check_file_traversal("deep/a/tree/x.log"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("deep/a/tree/y.log"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("deep/a/other/x.log"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(check_file_traversal("other/a/tree/x.log"), CSYNC_NOT_EXCLUDED);
+        QCOMPARE(check_file_traversal("deep/a/tree/sub/x.log"), CSYNC_NOT_EXCLUDED);
+
+        // The traversal and full matchers agree
+        for (auto path : { "literal", "a/file.suffix", "a/prefix.x", "a/file.removed", "a/file.both",
+                 "deep/a/tree/x.log", "deep/a/other/x.log", "a/b/c" }) {
+            QCOMPARE(check_file_traversal(path), check_file_full(path));
+        }
+    }
+
+    void check_csync_excluded_traversal_bname_sets_case_insensitive()
+    {
+        QScopedValueRollback<bool> scope(OCC::fsCasePreserving_override, true);
+        setup();
+        excludedFiles->addManualExclude("Literal");
+        excludedFiles->addManualExclude("*.Suffix");
+        excludedFiles->addManualExclude("prefix.*");
+        excludedFiles->addManualExclude("*.ÄÖ");
+
+        QCOMPARE(check_file_traversal("a/LITERAL"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/literal"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/file.suffix"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/PREFIX.x"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/file.äö"), CSYNC_FILE_EXCLUDE_LIST);
+        QCOMPARE(check_file_traversal("a/literalX"), CSYNC_NOT_EXCLUDED);
+
+        for (auto path : { "a/LITERAL", "a/file.suffix", "a/PREFIX.x", "a/file.äö", "a/literalX" })
+            QCOMPARE(check_file_traversal(path), check_file_full(path));
+    }
+
+    void check_csync_excluded_performance_many_patterns()
+    {
+        setup_init();
+        // Something like a large corporate exclude list
+        for (int i = 0; i < 100; ++i) {
+            excludedFiles->addManualExclude(QStringLiteral("*.ext%1").arg(i));
+            excludedFiles->addManualExclude(QStringLiteral("name%1").arg(i));
+            excludedFiles->addManualExclude(QStringLiteral("project%1/build*/*.o").arg(i));
+        }
+        excludedFiles->reloadExcludeFiles();
+
+        QStringList paths;
+        for (int dir = 0; dir < 50; ++dir) {
+            for (int file = 0; file < 20; ++file)
+                paths.append(QStringLiteral("documents/folder%1/sub/file%2.txt").arg(dir).arg(file));
+        }
+
+        int totalRc = 0;
+        QBENCHMARK {
+            for (const auto &path : paths)
+                totalRc += excludedFiles->traversalPatternMatch(path, ItemTypeFile);
+        }
+        QCOMPARE(totalRc, 0); // mainly to avoid optimization
+    }
+
     void check_csync_exclude_expand_escapes()
     {
         extern void csync_exclude_expand_escapes(QByteArray &input);
@@ -219,6 +219,80 @@ private slots:
         QCOMPARE(folderman->findGoodPathForNewSyncFolder(dirPath + "/ownCloud2", url),
             QString(dirPath + "/ownCloud22"));
     }
+
+    // The scheduling only, TestSyncEngine::testConcurrentEngines runs engines side by side
+    void testConcurrentSyncs()
+    {
+        // SETUP
+
+        QTemporaryDir dir;
+        ConfigFile::setConfDir(dir.path()); // we don't want to pollute the user's config file
+        QVERIFY(dir.isValid());
+        QDir dir2(dir.path());
+        QVERIFY(dir2.mkpath("f1"));
+        QVERIFY(dir2.mkpath("f2"));
+        QVERIFY(dir2.mkpath("f3"));
+        QString dirPath = dir2.canonicalPath();
+
+        AccountPtr account = Account::create();
+        account->setCredentials(new HttpCredentialsTest("testuser", "secret"));
+        account->setUrl(QUrl("http://example.de"));
+
+        AccountStatePtr newAccountState(new AccountState(account));
+        newAccountState->setState(AccountState::Connected);
+
+        FolderMan *folderman = FolderMan::instance();
+        QCOMPARE(folderman, &_fm);
+        folderman->unloadAndDeleteAllFolders();
+        folderman->_maxConcurrentSyncs = 3;
+        auto f1 = folderman->addFolder(newAccountState.data(), folderDefinition(dirPath + "/f1"));
+        auto f2 = folderman->addFolder(newAccountState.data(), folderDefinition(dirPath + "/f2"));
+        auto f3 = folderman->addFolder(newAccountState.data(), folderDefinition(dirPath + "/f3"));
+        QVERIFY(f1 && f2 && f3);
+        folderman->_scheduledFolders.clear();
+
+        // TEST
+
+        // Without a full local discovery the changes count as large,
+        // they leave the last slot free
+        folderman->scheduleFolder(f1);
+        folderman->scheduleFolder(f2);
+        folderman->scheduleFolder(f3);
+        folderman->slotStartScheduledFolderSync();
+        QCOMPARE(folderman->currentSyncFolders(), QList<Folder *>({ f1 }));
+        QCOMPARE(f1->parallelNetworkJobs(), 6);
+        folderman->slotStartScheduledFolderSync();
+        folderman->slotStartScheduledFolderSync();
+        QCOMPARE(folderman->currentSyncFolders(), QList<Folder *>({ f1, f2 }));
+        QCOMPARE(folderman->_scheduledFolders.size(), 1);
+        QCOMPARE(folderman->_scheduledFolders.first(), f3);
+
+        // The network jobs are split between the running syncs
+        QCOMPARE(f1->parallelNetworkJobs(), 3);
+        QCOMPARE(f2->parallelNetworkJobs(), 3);
+
+        // A folder scheduled next may take the last slot
+        folderman->scheduleFolderNext(f3);
+        folderman->slotStartScheduledFolderSync();
+        QCOMPARE(folderman->currentSyncFolders(), QList<Folder *>({ f1, f2, f3 }));
+        QVERIFY(folderman->_scheduledFolders.isEmpty());
+        QCOMPARE(f1->parallelNetworkJobs(), 2);
+        QCOMPARE(f3->parallelNetworkJobs(), 2);
+
+        // No more than the maximum
+        folderman->scheduleFolder(f2);
+        folderman->slotStartScheduledFolderSync();
+        QCOMPARE(folderman->currentSyncFolders().size(), 3);
+
+        // A finished sync gives its share back
+        emit f2->syncFinished(SyncResult());
+        QCOMPARE(folderman->currentSyncFolders(), QList<Folder *>({ f1, f3 }));
+        QCOMPARE(f1->parallelNetworkJobs(), 3);
+        QCOMPARE(f2->parallelNetworkJobs(), 6);
+        QCOMPARE(f3->parallelNetworkJobs(), 3);
+
+        folderman->unloadAndDeleteAllFolders();
+    }
 };
 
 QTEST_APPLESS_MAIN(TestFolderMan)
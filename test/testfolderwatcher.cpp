@@ -78,6 +78,7 @@ class TestFolderWatcher : public QObject
     QString _rootPath;
     QScopedPointer<FolderWatcher> _watcher;
     QScopedPointer<QSignalSpy> _pathChangedSpy;
+    QScopedPointer<QSignalSpy> _readySpy;
 
     bool waitForPathChanged(const QString &path)
     {
@@ -87,7 +88,7 @@ class TestFolderWatcher : public QObject
             // Check if it was already reported as changed by the watcher
             for (int i = 0; i < _pathChangedSpy->size(); ++i) {
                 const auto &args = _pathChangedSpy->at(i);
-                if (args.first().toString() == path)
+                if (args.first().value<QSet<QString>>().contains(path))
                     return true;
             }
             // Wait a bit and test again (don't bother checking if we timed out or not)
@@ -120,8 +121,10 @@ public:
         Utility::writeRandomFile( _rootPath+"/a1/movefile");
 
         _watcher.reset(new FolderWatcher);
+        _readySpy.reset(new QSignalSpy(_watcher.data(), &FolderWatcher::ready));
         _watcher->init(_rootPath);
-        _pathChangedSpy.reset(new QSignalSpy(_watcher.data(), SIGNAL(pathChanged(QString))));
+        qRegisterMetaType<QSet<QString>>("QSet<QString>");
+        _pathChangedSpy.reset(new QSignalSpy(_watcher.data(), &FolderWatcher::pathsChanged));
     }
 
     int countFolders(const QString &path)
@@ -133,6 +136,12 @@ public:
     }
 
 private slots:
+    void initTestCase()
+    {
+        // The watches are added in the background
+        QVERIFY(_readySpy->count() > 0 || _readySpy->wait());
+    }
+
     void init()
     {
         _pathChangedSpy->clear();
@@ -11,18 +11,45 @@
 
 using namespace OCC;
 
-class TestInotifyWatcher: public FolderWatcherPrivate
+class TestInotifyWatcher: public QObject
 {
     Q_OBJECT
 
 private:
+    QTemporaryDir _tempDir;
     QString _root;
 
+    // Answers foldersFound() like FolderWatcherPrivate does, with an optional ignored folder
+    static void answerFinds(InotifyWorker &worker, const QString &ignored = QString())
+    {
+        QObject::connect(&worker, &InotifyWorker::foldersFound, &worker, [&worker, ignored](const QStringList &folders) {
+            QStringList accepted;
+            for (const auto &folder : folders) {
+                if (folder != ignored)
+                    accepted.append(folder);
+            }
+            QMetaObject::invokeMethod(&worker, "watchFolders", Qt::QueuedConnection, Q_ARG(QStringList, accepted));
+        });
+    }
+
+    static QSet<QString> collect(QSignalSpy &spy)
+    {
+        QSet<QString> paths;
+        for (const auto &args : spy)
+            paths += args.first().toStringList().toSet();
+        return paths;
+    }
+
+    static void writeFile(const QString &path)
+    {
+        QFile f(path);
+        QVERIFY(f.open(QFile::WriteOnly));
+        f.write("x");
+    }
+
 private slots:
     void initTestCase() {
-        qsrand(QTime::currentTime().msec());
-
-        _root = QDir::tempPath() + "/" + "test_" + QString::number(qrand());
+        _root = QDir(_tempDir.path()).canonicalPath();
         qDebug() << "creating test directory tree in " << _root;
         QDir rootDir(_root);
 
@@ -31,43 +58,72 @@ private slots:
         rootDir.mkpath(_root + "/a1/b2/c1");
         rootDir.mkpath(_root + "/a1/b3/c3");
         rootDir.mkpath(_root + "/a2/b3/c3");
-
     }
 
-    // Test the recursive path listing function findFoldersBelow
-    void testDirsBelowPath() {
-        QStringList dirs;
-
-        bool ok = findFoldersBelow(QDir(_root), dirs);
-        QVERIFY( dirs.indexOf(_root + "/a1")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b1")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b1/c1")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b1/c2")>-1);
+    // The whole tree gets watched, one level per round trip
+    void testWatchFolderTree() {
+        InotifyWorker worker(_root);
+        answerFinds(worker);
+        QSignalSpy readySpy(&worker, &InotifyWorker::ready);
+        worker.start();
+        QVERIFY(readySpy.wait());
+        QCOMPARE(worker.watchCount(), 12);
+    }
 
-        QVERIFY(Utility::writeRandomFile(_root+"/a1/rand1.dat"));
-        QVERIFY(Utility::writeRandomFile(_root+"/a1/b1/rand2.dat"));
-        QVERIFY(Utility::writeRandomFile(_root+"/a1/b1/c1/rand3.dat"));
+    void testIgnoredFolder() {
+        InotifyWorker worker(_root);
+        answerFinds(worker, _root + "/a2");
+        QSignalSpy readySpy(&worker, &InotifyWorker::ready);
+        worker.start();
+        QVERIFY(readySpy.wait());
+        QCOMPARE(worker.watchCount(), 9);
+    }
 
-        QVERIFY( dirs.indexOf(_root + "/a1/b2")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b2/c1")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b3")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b3/c3")>-1);
+    void testNewFolderIsWatched() {
+        InotifyWorker worker(_root);
+        answerFinds(worker);
+        QSignalSpy readySpy(&worker, &InotifyWorker::ready);
+        QSignalSpy changedSpy(&worker, &InotifyWorker::changed);
+        worker.start();
+        QVERIFY(readySpy.wait());
 
-        QVERIFY( dirs.indexOf(_root + "/a2"));
-        QVERIFY( dirs.indexOf(_root + "/a2/b3"));
-        QVERIFY( dirs.indexOf(_root + "/a2/b3/c3"));
+        QVERIFY(QDir(_root).mkpath("a1/new/sub"));
+        QTRY_VERIFY(collect(changedSpy).contains(_root + "/a1/new"));
+        QTRY_COMPARE(worker.watchCount(), 14);
 
-        QVERIFY2(dirs.count() == 11, "Directory count wrong.");
+        writeFile(_root + "/a1/new/sub/file");
+        QTRY_VERIFY(collect(changedSpy).contains(_root + "/a1/new/sub/file"));
 
-        QVERIFY2(ok, "findFoldersBelow failed.");
+        QVERIFY(QDir(_root + "/a1/new").removeRecursively());
+        QTRY_COMPARE(worker.watchCount(), 12);
     }
 
-    void cleanupTestCase() {
-        if( _root.startsWith(QDir::tempPath() )) {
-           system( QString("rm -rf %1").arg(_root).toLocal8Bit() );
+    // Many changes in a short time arrive in few batches, each path once per batch
+    void testCoalescing() {
+        InotifyWorker worker(_root);
+        answerFinds(worker);
+        QSignalSpy readySpy(&worker, &InotifyWorker::ready);
+        QSignalSpy changedSpy(&worker, &InotifyWorker::changed);
+        worker.start();
+        QVERIFY(readySpy.wait());
+
+        const int count = 500;
+        QSet<QString> expected;
+        for (int i = 0; i < count; ++i) {
+            const QString path = _root + QString("/a1/b1/file%1").arg(i);
+            writeFile(path);
+            expected.insert(path);
         }
+        QTRY_COMPARE(collect(changedSpy), expected);
+
+        int reported = 0;
+        for (const auto &args : changedSpy)
+            reported += args.first().toStringList().size();
+        // Creating and closing a file are two events
+        QVERIFY(reported < 2 * count);
+        QVERIFY(changedSpy.count() < count / 10);
     }
 };
 
-QTEST_APPLESS_MAIN(TestInotifyWatcher)
+QTEST_GUILESS_MAIN(TestInotifyWatcher)
 #include "testinotifywatcher.moc"
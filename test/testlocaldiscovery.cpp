@@ -9,6 +9,7 @@
 #include "syncenginetestutils.h"
 #include <syncengine.h>
 #include <localdiscoverytracker.h>
+#include <filesystem.h>
 
 using namespace OCC;
 
@@ -163,6 +164,53 @@ private slots:
         QVERIFY(tracker.localDiscoveryPaths().empty());
     }
 
+    // Check that the tracked paths survive a restart and that directories
+    // modified while the client wasn't running get rediscovered
+    void testTrackerRestore()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        const QString localPath = fakeFolder.localPath();
+        const auto yesterday = Utility::qDateTimeToTime_t(QDateTime::currentDateTimeUtc().addDays(-1));
+        for (const char *dir : { "", "A", "B", "C", "S" })
+            FileSystem::setModTime(localPath + dir, yesterday);
+
+        LocalDiscoveryTracker tracker;
+        tracker.addTouchedPath("A/a1");
+        tracker.startSyncFullDiscovery();
+        QVERIFY(!tracker.saveState(fakeFolder.syncJournal(), 1234));
+        tracker.slotSyncFinished(true);
+        tracker.addTouchedPath("A/a1");
+        QVERIFY(tracker.saveState(fakeFolder.syncJournal(), 1234));
+
+        // Changes while the client is stopped
+        fakeFolder.localModifier().appendByte("A/a1");
+        fakeFolder.localModifier().insert("B/b3");
+        fakeFolder.localModifier().mkdir("C/newDir");
+        fakeFolder.localModifier().insert("C/newDir/file");
+
+        LocalDiscoveryTracker restored;
+        QCOMPARE(restored.restoreState(fakeFolder.syncJournal(), localPath), qint64(1234));
+        auto restoredContains = [&](const char *path) {
+            return restored.localDiscoveryPaths().find(path) != restored.localDiscoveryPaths().end();
+        };
+        QVERIFY(restoredContains("A/a1"));
+        QVERIFY(restoredContains("B/b3"));
+        QVERIFY(restoredContains("C/newDir"));
+        QVERIFY(!restoredContains("A/a2"));
+        QVERIFY(!restoredContains("S/s1"));
+
+        // The state can only be used once
+        LocalDiscoveryTracker again;
+        QCOMPARE(again.restoreState(fakeFolder.syncJournal(), localPath), qint64(-1));
+        QVERIFY(again.localDiscoveryPaths().empty());
+
+        fakeFolder.syncEngine().setLocalDiscoveryOptions(
+            LocalDiscoveryStyle::DatabaseAndFilesystem, restored.localDiscoveryPaths());
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(fakeFolder.currentRemoteState().find("C/newDir/file"));
+    }
+
     void testDirectoryAndSubDirectory()
     {
         FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
@@ -126,6 +126,99 @@ private slots:
         }
     }
 
+    void testTypedBinding() {
+        SqlQuery q(_db);
+        q.prepare("INSERT INTO addresses (id, name, address, entered) VALUES (?1, ?2, ?3, ?4);");
+        q.bindInt64(1, 4);
+        // The query keeps the temporary alive until the bindings are cleared
+        q.bindUtf8(2, QString::fromUtf8("Zoë Ålander").toUtf8());
+        q.bindNull(3);
+        q.bindInt64(4, Q_INT64_C(1403002224000));
+        QVERIFY(q.exec());
+
+        SqlQuery select("SELECT name, address, entered FROM addresses WHERE id=?1;", _db);
+        select.bindInt64(1, 4);
+        QVERIFY(select.next().hasData);
+        QCOMPARE(select.stringValue(0), QString::fromUtf8("Zoë Ålander"));
+        QCOMPARE(select.baValueView(0), QString::fromUtf8("Zoë Ålander").toUtf8());
+        QVERIFY(select.nullValue(1));
+        QCOMPARE(qint64(select.int64Value(2)), Q_INT64_C(1403002224000));
+    }
+
+    // Not a real test: shows how many rows per second go through the
+    // QVariant and the typed binding and column access
+    void benchmarkTypedAccess() {
+        SqlQuery create("CREATE TABLE bench (id INTEGER PRIMARY KEY, path TEXT, etag TEXT, size INTEGER);", _db);
+        QVERIFY(create.exec());
+
+        const int rows = 20000;
+        QVector<QByteArray> paths;
+        for (int i = 0; i < rows; ++i)
+            paths.append("some/directory/below/the/root/file" + QByteArray::number(i));
+        const QByteArray etag = "5b7c5f8e2a1d3";
+
+        auto insertRows = [&](bool typed) {
+            SqlQuery clear("DELETE FROM bench;", _db);
+            clear.exec();
+            _db.transaction();
+            QElapsedTimer timer;
+            timer.start();
+            SqlQuery insert("INSERT INTO bench (id, path, etag, size) VALUES (?1, ?2, ?3, ?4);", _db);
+            for (int i = 0; i < rows; ++i) {
+                insert.reset_and_clear_bindings();
+                if (typed) {
+                    insert.bindInt64(1, i);
+                    insert.bindUtf8(2, paths.at(i));
+                    insert.bindUtf8(3, etag);
+                    insert.bindInt64(4, qint64(i) * 1000);
+                } else {
+                    insert.bindValue(1, i);
+                    insert.bindValue(2, paths.at(i));
+                    insert.bindValue(3, etag);
+                    insert.bindValue(4, qint64(i) * 1000);
+                }
+                if (!insert.exec())
+                    return 0.0;
+            }
+            const double rate = rows * 1000.0 / qMax<qint64>(1, timer.elapsed());
+            _db.commit();
+            return rate;
+        };
+
+        auto readRows = [&](bool typed, int *matching) {
+            QElapsedTimer timer;
+            timer.start();
+            SqlQuery select("SELECT path, etag, size FROM bench WHERE id=?1;", _db);
+            for (int i = 0; i < rows; ++i) {
+                select.reset_and_clear_bindings();
+                if (typed)
+                    select.bindInt64(1, i);
+                else
+                    select.bindValue(1, i);
+                if (!select.next().hasData)
+                    return 0.0;
+                const bool same = typed
+                    ? select.baValueView(0) == paths.at(i) && select.baValueView(1) == etag
+                    : select.baValue(0) == paths.at(i) && select.baValue(1) == etag;
+                if (same && qint64(select.int64Value(2)) == qint64(i) * 1000)
+                    ++*matching;
+            }
+            return rows * 1000.0 / qMax<qint64>(1, timer.elapsed());
+        };
+
+        const double variantInsert = insertRows(false);
+        int variantMatching = 0;
+        const double variantRead = readRows(false, &variantMatching);
+        const double typedInsert = insertRows(true);
+        int typedMatching = 0;
+        const double typedRead = readRows(true, &typedMatching);
+
+        QCOMPARE(variantMatching, rows);
+        QCOMPARE(typedMatching, rows);
+        qInfo() << "Inserted rows/s, QVariant:" << variantInsert << "typed:" << typedInsert;
+        qInfo() << "Selected rows/s, QVariant:" << variantRead << "typed:" << typedRead;
+    }
+
     void testDestructor()
     {
         // This test make sure that the destructor of SqlQuery works even if the SqlDatabase
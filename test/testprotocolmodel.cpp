@@ -0,0 +1,227 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "protocolmodel.h"
+
+using namespace OCC;
+
+static ProtocolEntry makeEntry(int n)
+{
+    ProtocolEntry e;
+    e.path = QString("file%1").arg(n);
+    e.message = QString::number(n);
+    return e;
+}
+
+// The messages of the rows, in row order
+static QStringList rowMessages(const ProtocolModel &model)
+{
+    QStringList result;
+    for (int row = 0; row < model.rowCount(); ++row)
+        result.append(model.entry(row).message);
+    return result;
+}
+
+static QStringList numbers(int from, int to)
+{
+    QStringList result;
+    for (int n = from; n <= to; ++n)
+        result.append(QString::number(n));
+    return result;
+}
+
+class TestProtocolModel : public QObject
+{
+    Q_OBJECT
+
+    QStringList _headers = { "Time", "File", "Folder", "Action", "Size" };
+
+private slots:
+    void testRowsInsertedOncePerFlush()
+    {
+        ProtocolModel model(_headers, 100);
+        QSignalSpy insertedSpy(&model, &QAbstractItemModel::rowsInserted);
+
+        for (int n = 1; n <= 3; ++n)
+            model.append(makeEntry(n));
+        QCOMPARE(model.rowCount(), 0);
+        QCOMPARE(model.entryCount(), 3);
+        QCOMPARE(insertedSpy.count(), 0);
+
+        model.flush();
+        QCOMPARE(insertedSpy.count(), 1);
+        QCOMPARE(insertedSpy[0][1].toInt(), 0);
+        QCOMPARE(insertedSpy[0][2].toInt(), 2);
+        QCOMPARE(rowMessages(model), numbers(1, 3));
+
+        // Nothing pending, nothing inserted
+        model.flush();
+        QCOMPARE(insertedSpy.count(), 1);
+
+        // The timer flushes on its own
+        model.append(makeEntry(4));
+        model.append(makeEntry(5));
+        QTRY_COMPARE(insertedSpy.count(), 2);
+        QCOMPARE(insertedSpy[1][1].toInt(), 3);
+        QCOMPARE(insertedSpy[1][2].toInt(), 4);
+        QCOMPARE(rowMessages(model), numbers(1, 5));
+    }
+
+    void testEvictionWraparound()
+    {
+        ProtocolModel model(_headers, 4);
+        QSignalSpy removedSpy(&model, &QAbstractItemModel::rowsRemoved);
+
+        for (int n = 1; n <= 4; ++n)
+            model.append(makeEntry(n));
+        model.flush();
+        QCOMPARE(rowMessages(model), numbers(1, 4));
+        QCOMPARE(removedSpy.count(), 0);
+
+        // Full, the oldest rows make room and their slots are reused
+        model.append(makeEntry(5));
+        model.append(makeEntry(6));
+        model.flush();
+        QCOMPARE(rowMessages(model), numbers(3, 6));
+        QCOMPARE(removedSpy.count(), 1);
+        QCOMPARE(removedSpy[0][1].toInt(), 0);
+        QCOMPARE(removedSpy[0][2].toInt(), 1);
+
+        // Appending again continues behind the wrapped rows
+        model.append(makeEntry(7));
+        model.flush();
+        QCOMPARE(rowMessages(model), numbers(4, 7));
+
+        // More pending entries than fit, only the newest become rows
+        for (int n = 8; n <= 13; ++n)
+            model.append(makeEntry(n));
+        model.flush();
+        QCOMPARE(rowMessages(model), numbers(10, 13));
+        QCOMPARE(model.entryCount(), 4);
+
+        // The ids keep increasing
+        for (int row = 1; row < model.rowCount(); ++row)
+            QVERIFY(model.entry(row - 1).id < model.entry(row).id);
+    }
+
+    void testRemoveEntry()
+    {
+        ProtocolModel model(_headers, 4);
+        QSignalSpy removedSpy(&model, &QAbstractItemModel::rowsRemoved);
+
+        QVector<quint64> ids;
+        for (int n = 1; n <= 4; ++n)
+            ids.append(model.append(makeEntry(n)));
+        model.flush();
+        for (int n = 5; n <= 6; ++n)
+            ids.append(model.append(makeEntry(n)));
+        model.flush();
+        ids.append(model.append(makeEntry(7)));
+        QCOMPARE(rowMessages(model), numbers(3, 6));
+        removedSpy.clear();
+
+        // A pending entry doesn't touch the rows
+        QVERIFY(model.removeEntry(ids[6]));
+        QCOMPARE(removedSpy.count(), 0);
+        QCOMPARE(model.entryCount(), 4);
+
+        // A row that sits behind the wraparound
+        QVERIFY(model.removeEntry(ids[4]));
+        QCOMPARE(removedSpy.count(), 1);
+        QCOMPARE(removedSpy[0][1].toInt(), 2);
+        QCOMPARE(removedSpy[0][2].toInt(), 2);
+        QCOMPARE(rowMessages(model), QStringList({ "3", "4", "6" }));
+
+        // Evicted, already removed and unknown ids
+        QVERIFY(!model.removeEntry(ids[0]));
+        QVERIFY(!model.removeEntry(ids[4]));
+        QVERIFY(!model.removeEntry(ids[6]));
+        QVERIFY(!model.removeEntry(1000));
+        QCOMPARE(removedSpy.count(), 1);
+
+        model.append(makeEntry(8));
+        model.flush();
+        QCOMPARE(rowMessages(model), QStringList({ "3", "4", "6", "8" }));
+    }
+
+    void testRemoveEntriesBlocks()
+    {
+        ProtocolModel model(_headers, 100);
+        QSignalSpy removedSpy(&model, &QAbstractItemModel::rowsRemoved);
+        QSignalSpy resetSpy(&model, &QAbstractItemModel::modelReset);
+
+        for (int n = 1; n <= 10; ++n)
+            model.append(makeEntry(n));
+        model.flush();
+        model.append(makeEntry(11));
+        model.append(makeEntry(12));
+
+        int calls = 0;
+        model.removeEntries([&](const ProtocolEntry &e) {
+            ++calls;
+            return e.message.toInt() % 2 == 0;
+        });
+        QCOMPARE(calls, 12);
+        QCOMPARE(resetSpy.count(), 0);
+        QCOMPARE(removedSpy.count(), 5);
+        // From the last block to the first one
+        QCOMPARE(removedSpy.first()[1].toInt(), 9);
+        QCOMPARE(removedSpy.last()[1].toInt(), 1);
+        QCOMPARE(rowMessages(model), QStringList({ "1", "3", "5", "7", "9" }));
+        QCOMPARE(model.entryCount(), 6);
+
+        // Neighbouring rows go in one block
+        removedSpy.clear();
+        model.removeEntries([](const ProtocolEntry &e) {
+            return e.message == "3" || e.message == "5";
+        });
+        QCOMPARE(removedSpy.count(), 1);
+        QCOMPARE(removedSpy[0][1].toInt(), 1);
+        QCOMPARE(removedSpy[0][2].toInt(), 2);
+        QCOMPARE(rowMessages(model), QStringList({ "1", "7", "9" }));
+
+        model.flush();
+        QCOMPARE(rowMessages(model), QStringList({ "1", "7", "9", "11" }));
+    }
+
+    void testRemoveEntriesReset()
+    {
+        ProtocolModel model(_headers, 150);
+        QSignalSpy removedSpy(&model, &QAbstractItemModel::rowsRemoved);
+        QSignalSpy resetSpy(&model, &QAbstractItemModel::modelReset);
+
+        // Wrapped around: 51 to 200 are left
+        for (int n = 1; n <= 150; ++n)
+            model.append(makeEntry(n));
+        model.flush();
+        for (int n = 151; n <= 200; ++n)
+            model.append(makeEntry(n));
+        model.flush();
+        QCOMPARE(rowMessages(model), numbers(51, 200));
+        removedSpy.clear();
+
+        // 75 separate blocks are more than maxRemovedBlocks
+        model.removeEntries([](const ProtocolEntry &e) {
+            return e.message.toInt() % 2 == 0;
+        });
+        QCOMPARE(resetSpy.count(), 1);
+        QCOMPARE(removedSpy.count(), 0);
+        QCOMPARE(model.rowCount(), 75);
+        for (int row = 0; row < model.rowCount(); ++row)
+            QCOMPARE(model.entry(row).message, QString::number(51 + 2 * row));
+
+        model.append(makeEntry(201));
+        model.flush();
+        QCOMPARE(model.rowCount(), 76);
+        QCOMPARE(model.entry(75).message, QString("201"));
+    }
+};
+
+QTEST_MAIN(TestProtocolModel)
+#include "testprotocolmodel.moc"
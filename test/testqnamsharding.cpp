@@ -0,0 +1,86 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+/* Records which QNAM sent the discovery requests and the transfers of each file */
+struct QnamRecorder
+{
+    QSet<QObject *> discovery;
+    QHash<QString, QSet<QObject *>> transfers;
+
+    explicit QnamRecorder(FakeFolder &fakeFolder)
+    {
+        fakeFolder.setServerOverride([this](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            // Null for the account's main QNAM
+            auto qnam = request.attribute(sShardQnamAttribute).value<QObject *>();
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PROPFIND")
+                discovery.insert(qnam);
+            else if (op == QNetworkAccessManager::GetOperation || op == QNetworkAccessManager::PutOperation)
+                transfers[getFilePathFromUrl(request.url())].insert(qnam);
+            return nullptr;
+        });
+    }
+};
+
+class TestQnamSharding : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testSeparateQnams()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.setQnamSharding(true);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._initialChunkSize = 10 * 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        QnamRecorder recorder(fakeFolder);
+        fakeFolder.localModifier().insert("A/small", 100);
+        fakeFolder.remoteModifier().insert("B/small", 100);
+        fakeFolder.remoteModifier().insert("C/large", 100 * 1000);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Each class has its own QNAM, none of them is the main one
+        QCOMPARE(recorder.discovery.size(), 1);
+        const auto smallUp = recorder.transfers.value("A/small");
+        const auto smallDown = recorder.transfers.value("B/small");
+        const auto large = recorder.transfers.value("C/large");
+        QCOMPARE(smallUp.size(), 1);
+        QCOMPARE(smallUp, smallDown);
+        QCOMPARE(large.size(), 1);
+
+        QSet<QObject *> all = recorder.discovery + smallUp + large;
+        QCOMPARE(all.size(), 3);
+        QVERIFY(!all.contains(nullptr));
+    }
+
+    void testSingleQnam()
+    {
+        // Credentials that hand out a single QNAM get everything through it
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+
+        QnamRecorder recorder(fakeFolder);
+        fakeFolder.localModifier().insert("A/small", 100);
+        fakeFolder.remoteModifier().insert("B/small", 100);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        QCOMPARE(recorder.discovery, QSet<QObject *>{ nullptr });
+        QCOMPARE(recorder.transfers.value("A/small"), QSet<QObject *>{ nullptr });
+        QCOMPARE(recorder.transfers.value("B/small"), QSet<QObject *>{ nullptr });
+    }
+};
+
+QTEST_GUILESS_MAIN(TestQnamSharding)
+#include "testqnamsharding.moc"
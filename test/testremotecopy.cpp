@@ -0,0 +1,144 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+#include <common/syncjournaldb.h>
+
+using namespace OCC;
+
+static const int fileSize = 1000 * 1000;
+
+/* Counts the uploads and copies the propagator sends */
+struct RequestCounter
+{
+    int puts = 0;
+    int copies = 0;
+
+    explicit RequestCounter(FakeFolder &fakeFolder)
+    {
+        fakeFolder.setServerOverride([this](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto verb = request.attribute(QNetworkRequest::CustomVerbAttribute).toString();
+            if (verb == QLatin1String("PUT") || op == QNetworkAccessManager::PutOperation)
+                ++puts;
+            if (verb == QLatin1String("COPY"))
+                ++copies;
+            return nullptr;
+        });
+    }
+};
+
+class TestRemoteCopy : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testCopyInsteadOfUpload()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().insert("A/orig", fileSize, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+
+        RequestCounter counter(fakeFolder);
+        fakeFolder.localModifier().insert("B/copy", fileSize, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.copies, 1);
+        QCOMPARE(counter.puts, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // The copy got the local modification time, and the journal knows it
+        auto remoteCopy = fakeFolder.currentRemoteState().find("B/copy");
+        QCOMPARE(Utility::qDateTimeToTime_t(remoteCopy->lastModified),
+            qint64(FileSystem::getModTime(fakeFolder.localPath() + "B/copy")));
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArray("B/copy"), &record));
+        QCOMPARE(record._etag, remoteCopy->etag.toLatin1());
+        QCOMPARE(record._fileId, remoteCopy->fileId);
+
+        // Nothing left to do
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.copies, 1);
+        QCOMPARE(counter.puts, 0);
+    }
+
+    void testSmallFilesAreUploaded()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().insert("A/orig", 1000, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+
+        RequestCounter counter(fakeFolder);
+        fakeFolder.localModifier().insert("B/copy", 1000, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.copies, 0);
+        QCOMPARE(counter.puts, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSourceChangedOnServer()
+    {
+        // The server's file was changed since the journal recorded its checksum
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().insert("A/orig", fileSize, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        fakeFolder.remoteModifier().find("A/orig")->etag = "changed";
+
+        RequestCounter counter(fakeFolder);
+        fakeFolder.localModifier().insert("B/copy", fileSize, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.copies, 1);
+        QCOMPARE(counter.puts, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testChecksumMismatch()
+    {
+        // The server reports a different checksum for the copy
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().insert("A/orig", fileSize, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        fakeFolder.remoteModifier().find("A/orig")->checksums = "SHA1:0000000000000000000000000000000000000000";
+
+        RequestCounter counter(fakeFolder);
+        fakeFolder.localModifier().insert("B/copy", fileSize, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.copies, 1);
+        QCOMPARE(counter.puts, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testMtimeNotSet()
+    {
+        // The copy keeps the wrong modification time if the PROPPATCH fails
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().insert("A/orig", fileSize, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+
+        int puts = 0;
+        int copies = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto verb = request.attribute(QNetworkRequest::CustomVerbAttribute).toString();
+            if (op == QNetworkAccessManager::PutOperation)
+                ++puts;
+            if (verb == QLatin1String("COPY"))
+                ++copies;
+            if (verb == QLatin1String("PROPPATCH"))
+                return new FakeErrorReply(op, request, this, 500);
+            return nullptr;
+        });
+        fakeFolder.localModifier().insert("B/copy", fileSize, 'Q');
+        fakeFolder.localModifier().setModTime("B/copy", QDateTime::currentDateTimeUtc().addDays(-2));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(copies, 1);
+        QCOMPARE(puts, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestRemoteCopy)
+#include "testremotecopy.moc"
@@ -0,0 +1,204 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <QLocalSocket>
+#include <QTemporaryDir>
+
+#include "common/syncfilestatus.h"
+#include "folderman.h"
+#include "socketapi.h"
+#include "account.h"
+#include "accountstate.h"
+#include "configfile.h"
+#include "theme.h"
+#include "creds/httpcredentials.h"
+
+using namespace OCC;
+
+class HttpCredentialsTest : public HttpCredentials {
+public:
+    HttpCredentialsTest(const QString& user, const QString& password)
+        : HttpCredentials(user, password)
+    {}
+
+    void askFromUser() Q_DECL_OVERRIDE {
+
+    }
+};
+
+static FolderDefinition folderDefinition(const QString &path) {
+    FolderDefinition d;
+    d.localPath = path;
+    d.targetPath = path;
+    d.alias = path;
+    return d;
+}
+
+/* A shell extension connected to the socket API */
+class FakeListener
+{
+public:
+    explicit FakeListener(const QString &socketPath)
+    {
+        _socket.connectToServer(socketPath);
+    }
+
+    bool isConnected() const { return _socket.state() == QLocalSocket::ConnectedState; }
+
+    void send(const QByteArray &command)
+    {
+        _socket.write(command + '\n');
+        _socket.flush();
+    }
+
+    // Waits for count lines, the REGISTER_PATH lines sent on connect are skipped
+    QStringList readLines(int count)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (_lines.size() < count && timer.elapsed() < 5000) {
+            QTest::qWait(10);
+            while (_socket.canReadLine()) {
+                auto line = QString::fromUtf8(_socket.readLine());
+                line.chop(1);
+                if (!line.startsWith(QLatin1String("REGISTER_PATH:")))
+                    _lines.append(line);
+            }
+        }
+        return _lines.mid(0, count);
+    }
+
+    void clear() { _lines.clear(); }
+
+private:
+    QLocalSocket _socket;
+    QStringList _lines;
+};
+
+class TestSocketApi : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _runtimeDir;
+    QTemporaryDir _dir;
+    QScopedPointer<FolderMan> _fm;
+    AccountStatePtr _accountState;
+    QString _folderPath;
+
+    QString socketPath() const
+    {
+        return _runtimeDir.path() + "/" + Theme::instance()->appName() + "/socket";
+    }
+
+private slots:
+    void initTestCase()
+    {
+        // The socket API listens in the runtime directory
+        QVERIFY(_runtimeDir.isValid());
+        qputenv("XDG_RUNTIME_DIR", _runtimeDir.path().toLocal8Bit());
+
+        QVERIFY(_dir.isValid());
+        ConfigFile::setConfDir(_dir.path()); // we don't want to pollute the user's config file
+        QDir dir(_dir.path());
+        QVERIFY(dir.mkpath("ownCloud/sub"));
+        for (auto name : { "ownCloud/a", "ownCloud/b" }) {
+            QFile f(dir.filePath(name));
+            QVERIFY(f.open(QFile::WriteOnly));
+            f.write("hello");
+        }
+        _folderPath = QDir(dir.filePath("ownCloud")).canonicalPath();
+
+        _fm.reset(new FolderMan);
+
+        AccountPtr account = Account::create();
+        account->setCredentials(new HttpCredentialsTest("testuser", "secret"));
+        account->setUrl(QUrl("http://example.de"));
+        _accountState = AccountStatePtr(new AccountState(account));
+        QVERIFY(_fm->addFolder(_accountState.data(), folderDefinition(_folderPath)));
+    }
+
+    void cleanupTestCase()
+    {
+        _fm.reset();
+    }
+
+    void testVersion()
+    {
+        FakeListener listener(socketPath());
+        QTRY_VERIFY(listener.isConnected());
+
+        listener.send("VERSION:");
+        auto lines = listener.readLines(1);
+        QCOMPARE(lines.size(), 1);
+        QVERIFY(lines[0].startsWith("VERSION:"));
+        QVERIFY(lines[0].endsWith(":1.2"));
+    }
+
+    // Listeners without a version get every push as a single STATUS line
+    void testUnbatchedPushes()
+    {
+        FakeListener listener(socketPath());
+        QTRY_VERIFY(listener.isConnected());
+
+        listener.send("VERSION:");
+        listener.send("RETRIEVE_FILE_STATUS:" + (_folderPath + "/a").toUtf8());
+        QCOMPARE(listener.readLines(2).size(), 2);
+        listener.clear();
+
+        _fm->socketApi()->broadcastStatusPushMessage(_folderPath + "/b", SyncFileStatus(SyncFileStatus::StatusSync));
+        _fm->socketApi()->broadcastStatusPushMessage(_folderPath + "/b", SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(listener.readLines(2), QStringList({ "STATUS:SYNC:" + _folderPath + "/b", "STATUS:OK:" + _folderPath + "/b" }));
+    }
+
+    void testDirectoryStatus()
+    {
+        FakeListener listener(socketPath());
+        QTRY_VERIFY(listener.isConnected());
+
+        listener.send("VERSION:1.2");
+        listener.send("RETRIEVE_DIRECTORY_STATUS:" + _folderPath.toUtf8());
+        auto lines = listener.readLines(6);
+        QCOMPARE(lines.size(), 6);
+        QCOMPARE(lines[1], "STATUS_BATCH:BEGIN:" + _folderPath);
+        QVERIFY(lines[2].startsWith("STATUS:") && lines[2].endsWith(":" + _folderPath + "/a"));
+        QVERIFY(lines[3].startsWith("STATUS:") && lines[3].endsWith(":" + _folderPath + "/b"));
+        QVERIFY(lines[4].startsWith("STATUS:") && lines[4].endsWith(":" + _folderPath + "/sub"));
+        QCOMPARE(lines[5], "STATUS_BATCH:END:" + _folderPath);
+    }
+
+    // Listeners with version 1.2 get the latest status of each path in one batch
+    void testBatchedPushes()
+    {
+        FakeListener listener(socketPath());
+        QTRY_VERIFY(listener.isConnected());
+
+        listener.send("VERSION:1.2");
+        listener.send("RETRIEVE_DIRECTORY_STATUS:" + _folderPath.toUtf8());
+        QCOMPARE(listener.readLines(6).size(), 6);
+        listener.clear();
+
+        auto socketApi = _fm->socketApi();
+        socketApi->broadcastStatusPushMessage(_folderPath + "/a", SyncFileStatus(SyncFileStatus::StatusSync));
+        socketApi->broadcastStatusPushMessage(_folderPath + "/b", SyncFileStatus(SyncFileStatus::StatusSync));
+        socketApi->broadcastStatusPushMessage(_folderPath + "/a", SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        // Not monitored by this listener
+        socketApi->broadcastStatusPushMessage(_folderPath + "/sub/c", SyncFileStatus(SyncFileStatus::StatusSync));
+
+        auto lines = listener.readLines(4);
+        QCOMPARE(lines.size(), 4);
+        QCOMPARE(lines[0], "STATUS_BATCH:BEGIN:" + _folderPath);
+        QCOMPARE(lines.mid(1, 2).toSet(), QSet<QString>({ "STATUS:OK:" + _folderPath + "/a", "STATUS:SYNC:" + _folderPath + "/b" }));
+        QCOMPARE(lines[3], "STATUS_BATCH:END:" + _folderPath);
+
+        // Nothing else arrives
+        QCOMPARE(listener.readLines(5).size(), 4);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSocketApi)
+#include "testsocketapi.moc"
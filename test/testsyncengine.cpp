@@ -738,6 +738,125 @@ private slots:
 
         QCOMPARE(QFileInfo(fakeFolder.localPath() + "foo").lastModified(), datetime);
     }
+
+    // The discovered items reach propagation sorted, with the contents of a
+    // folder directly following it
+    void testDiscoveredItemsOrder()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        fakeFolder.remoteModifier().insert("foo-bar");
+        fakeFolder.remoteModifier().mkdir("foo");
+        fakeFolder.remoteModifier().insert("foo/bar");
+        fakeFolder.remoteModifier().mkdir("foo/sub");
+        fakeFolder.remoteModifier().insert("foo/sub/a");
+        fakeFolder.localModifier().insert("foo.txt");
+        fakeFolder.localModifier().mkdir("foo0");
+        fakeFolder.localModifier().insert("foo0/x");
+
+        QStringList order;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, [&](SyncFileItemVector &items) {
+            QVERIFY(std::is_sorted(items.begin(), items.end()));
+            for (const auto &item : items)
+                order.append(item->destination());
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        QCOMPARE(order, QStringList({ "foo", "foo/bar", "foo/sub", "foo/sub/a", "foo-bar", "foo.txt", "foo0", "foo0/x" }));
+    }
+
+    // Within a folder, the small files are transferred before the large ones
+    void testSmallTransfersFirst()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._initialChunkSize = 1000; // larger files are large transfers
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        fakeFolder.remoteModifier().mkdir("A");
+        for (int i = 0; i < 4; ++i)
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/big%1").arg(i), 5000 - i);
+        for (int i = 0; i < 6; ++i)
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/small%1").arg(i), 10 + i);
+
+        QStringList requested;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation)
+                requested.append(getFilePathFromUrl(request.url()));
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        QCOMPARE(requested, QStringList({ "A/small0", "A/small1", "A/small2", "A/small3", "A/small4", "A/small5",
+                                "A/big3", "A/big2", "A/big1", "A/big0" }));
+    }
+
+    // Blocked large transfers don't hold up the other tasks of their folder
+    void testTasksBehindBlockedLargeTransfers()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._initialChunkSize = 1000; // larger files are large transfers
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        fakeFolder.remoteModifier().mkdir("A");
+        fakeFolder.remoteModifier().insert("A/zz", 10);
+        QVERIFY(fakeFolder.syncOnce());
+
+        // More large downloads than there are large transfer slots
+        for (int i = 0; i < 4; ++i)
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/big%1").arg(i), 5000);
+        fakeFolder.remoteModifier().remove("A/zz");
+
+        QObject parent;
+        int nGET = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation) {
+                ++nGET;
+                return new FakeHangingReply(op, request, &parent);
+            }
+            return nullptr;
+        });
+
+        // The removal sorts after the downloads, it still runs while they hang
+        fakeFolder.scheduleSync();
+        fakeFolder.execUntilItemCompleted("A/zz");
+        QVERIFY(!QFileInfo(fakeFolder.localPath() + "A/zz").exists());
+        QVERIFY(nGET < 4);
+
+        fakeFolder.syncEngine().abort();
+        QVERIFY(!fakeFolder.execUntilFinished());
+    }
+
+    // FolderMan runs the engines of several folders at the same time
+    void testConcurrentEngines()
+    {
+        FakeFolder fakeFolder1{ FileInfo::A12_B12_C12_S12() };
+        FakeFolder fakeFolder2{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder1.remoteModifier().insert("A/new1");
+        fakeFolder2.localModifier().insert("B/new2");
+
+        auto &engine1 = fakeFolder1.syncEngine();
+        auto &engine2 = fakeFolder2.syncEngine();
+        bool bothRunning = false;
+        connect(&engine1, &SyncEngine::aboutToPropagate, [&]() { bothRunning = engine2.isSyncRunning(); });
+        QSignalSpy finished1(&engine1, SIGNAL(finished(bool)));
+        QSignalSpy finished2(&engine2, SIGNAL(finished(bool)));
+
+        fakeFolder1.scheduleSync();
+        fakeFolder2.scheduleSync();
+        QTRY_COMPARE(finished1.count(), 1);
+        QTRY_COMPARE(finished2.count(), 1);
+
+        QVERIFY(bothRunning);
+        QVERIFY(finished1[0][0].toBool());
+        QVERIFY(finished2[0][0].toBool());
+        QCOMPARE(fakeFolder1.currentLocalState(), fakeFolder1.currentRemoteState());
+        QCOMPARE(fakeFolder2.currentLocalState(), fakeFolder2.currentRemoteState());
+        QVERIFY(fakeFolder1.currentLocalState().find("A/new1"));
+        QVERIFY(fakeFolder2.currentRemoteState().find("B/new2"));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncEngine)
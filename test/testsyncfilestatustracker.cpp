@@ -30,6 +30,16 @@ public:
         return SyncFileStatus();
     }
 
+    int countOf(const QString &relativePath) const {
+        QFileInfo file(_syncEngine.localPath(), relativePath);
+        int count = 0;
+        for (int i = 0; i < size(); ++i) {
+            if (QFileInfo(at(i)[0].toString()) == file)
+                ++count;
+        }
+        return count;
+    }
+
     bool statusEmittedBefore(const QString &firstPath, const QString &secondPath) const {
         QFileInfo firstFile(_syncEngine.localPath(), firstPath);
         QFileInfo secondFile(_syncEngine.localPath(), secondPath);
@@ -406,6 +416,45 @@ private slots:
         QCOMPARE(fakeFolder.syncEngine().syncFileStatusTracker().fileStatus("A/a"), SyncFileStatus(SyncFileStatus::StatusUpToDate));
     }
 
+    // Many errors in one directory push the status of its parents once, not once per error
+    void parentStatusPushedOncePerChange() {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        const int errorCount = 20;
+        for (int i = 0; i < errorCount; ++i) {
+            const QString path = QString("A/e%1").arg(i);
+            fakeFolder.serverErrorPaths().append(path);
+            fakeFolder.localModifier().insert(path);
+        }
+        fakeFolder.syncOnce();
+        QCOMPARE(fakeFolder.syncEngine().syncFileStatusTracker().fileStatus("A"), SyncFileStatus(SyncFileStatus::StatusWarning));
+
+        // The errors are blacklisted now and all show up before propagation
+        StatusPushSpy statusSpy(fakeFolder.syncEngine());
+        fakeFolder.scheduleSync();
+        fakeFolder.execUntilBeforePropagation();
+        verifyThatPushMatchesPull(fakeFolder, statusSpy);
+        QCOMPARE(statusSpy.statusOf("A/e0"), SyncFileStatus(SyncFileStatus::StatusError));
+        QCOMPARE(statusSpy.statusOf("A"), SyncFileStatus(SyncFileStatus::StatusWarning));
+        QCOMPARE(statusSpy.statusOf(""), SyncFileStatus(SyncFileStatus::StatusWarning));
+        // Once as an item at most, once for the errors below
+        QVERIFY(statusSpy.countOf("A") <= 2);
+        QVERIFY(statusSpy.statusEmittedBefore("A", ""));
+
+        fakeFolder.execUntilFinished();
+        verifyThatPushMatchesPull(fakeFolder, statusSpy);
+
+        // Deleting the files resolves the errors with the next sync
+        for (int i = 0; i < errorCount; ++i)
+            fakeFolder.localModifier().remove(QString("A/e%1").arg(i));
+        fakeFolder.serverErrorPaths().clear();
+        statusSpy.clear();
+        fakeFolder.syncOnce();
+        verifyThatPushMatchesPull(fakeFolder, statusSpy);
+        QCOMPARE(statusSpy.statusOf("A"), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(statusSpy.statusOf(""), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QVERIFY(statusSpy.countOf("A") < errorCount);
+    }
+
     // Even for status pushes immediately following each other, macOS
     // can sometimes have 1s delays between updates, so make sure that
     // children are marked as OK before their parents do.
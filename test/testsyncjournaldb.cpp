@@ -8,6 +8,12 @@
 
 #include <sqlite3.h>
 
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include "common/syncjournaldb.h"
 #include "common/syncjournalfilerecord.h"
 
@@ -31,6 +37,35 @@ public:
         return Utility::qDateTimeToTime_t(time);
     }
 
+    static SyncJournalFileRecord makeRecord(const QByteArray &path)
+    {
+        SyncJournalFileRecord record;
+        record._path = path;
+        record._inode = 1;
+        record._type = ItemTypeFile;
+        record._etag = "etag";
+        record._fileId = "id_" + path;
+        record._remotePerm = RemotePermissions::fromDbValue("RW");
+        return record;
+    }
+
+    // Reads through a separate connection, which only sees committed changes
+    static bool isCommitted(const QString &dbPath, const QByteArray &path)
+    {
+        sqlite3 *db = nullptr;
+        bool found = false;
+        if (sqlite3_open_v2(dbPath.toUtf8().constData(), &db, SQLITE_OPEN_READWRITE, nullptr) == SQLITE_OK) {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(db, "SELECT 1 FROM metadata WHERE path=?1", -1, &stmt, nullptr) == SQLITE_OK) {
+                sqlite3_bind_text(stmt, 1, path.constData(), path.size(), SQLITE_TRANSIENT);
+                found = sqlite3_step(stmt) == SQLITE_ROW;
+                sqlite3_finalize(stmt);
+            }
+        }
+        sqlite3_close(db);
+        return found;
+    }
+
 private slots:
 
     void initTestCase()
@@ -90,6 +125,34 @@ private slots:
         QVERIFY(!record.isValid());
     }
 
+    void testFileIdentities()
+    {
+        SyncJournalFileRecord record;
+        record._path = "identity/file";
+        record._inode = std::numeric_limits<quint32>::max() + 42ull;
+        record._fileId = "identityid";
+        record._remotePerm = RemotePermissions::fromDbValue("RW");
+        QVERIFY(_db.setFileRecord(record));
+
+        SyncJournalFileRecord storedRecord;
+        QVERIFY(_db.getFileRecordByPHash(SyncJournalDb::getPHash("identity/file"), &storedRecord));
+        QVERIFY(storedRecord == record);
+
+        int found = 0;
+        QVERIFY(_db.listFileIdentities([&](qint64 phash, quint64 inode, const QByteArray &fileId) {
+            if (phash != SyncJournalDb::getPHash("identity/file"))
+                return;
+            QCOMPARE(inode, record._inode);
+            QCOMPARE(fileId, record._fileId);
+            ++found;
+        }));
+        QCOMPARE(found, 1);
+
+        QVERIFY(_db.deleteFileRecord("identity/file"));
+        QVERIFY(_db.getFileRecordByPHash(SyncJournalDb::getPHash("identity/file"), &storedRecord));
+        QVERIFY(!storedRecord.isValid());
+    }
+
     void testFileRecordChecksum()
     {
         // Try with and without a checksum
@@ -170,6 +233,164 @@ private slots:
         QVERIFY(!wipedRecord._valid);
     }
 
+    void testGroupCommit()
+    {
+        const QString dbPath = _tempDir.path() + "/groupcommit.db";
+        SyncJournalDb db(dbPath);
+        db.setGroupCommitLimits(3, 3600 * 1000);
+        QVERIFY(db.open());
+        db.commitIfNeededAndStartNewTransaction("test");
+
+        QVERIFY(db.setFileRecord(makeRecord("group1")));
+        db.groupCommit("test");
+        QVERIFY(db.setFileRecord(makeRecord("group2")));
+        db.groupCommit("test");
+        QVERIFY(!isCommitted(dbPath, "group1"));
+        QVERIFY(!isCommitted(dbPath, "group2"));
+
+        // The count limit commits the group
+        QVERIFY(db.setFileRecord(makeRecord("group3")));
+        db.groupCommit("test");
+        QVERIFY(isCommitted(dbPath, "group1"));
+        QVERIFY(isCommitted(dbPath, "group3"));
+
+        // A normal commit takes the pending changes along
+        QVERIFY(db.setFileRecord(makeRecord("group4")));
+        db.groupCommit("test");
+        QVERIFY(!isCommitted(dbPath, "group4"));
+        db.commit("test");
+        QVERIFY(isCommitted(dbPath, "group4"));
+
+        QVERIFY(db.setFileRecord(makeRecord("group5")));
+        db.groupCommit("test");
+        db.flushGroupCommit("test");
+        QVERIFY(isCommitted(dbPath, "group5"));
+        db.close();
+    }
+
+    void testGroupCommitCrashRecovery()
+    {
+#ifndef Q_OS_UNIX
+        QSKIP("Needs fork()");
+#else
+        const QString dbPath = _tempDir.path() + "/crash.db";
+
+        pid_t pid = fork();
+        QVERIFY(pid >= 0);
+        if (pid == 0) {
+            // Write like the propagator does and get killed with a transaction open
+            SyncJournalDb db(dbPath);
+            db.setGroupCommitLimits(1000, 3600 * 1000);
+            db.open();
+            db.commitIfNeededAndStartNewTransaction("test");
+
+            db.setFileRecord(makeRecord("done/before"));
+            db.groupCommit("test");
+
+            SyncJournalDb::UploadInfo upload;
+            upload._valid = true;
+            upload._transferid = 42;
+            upload._size = 1000;
+            db.setUploadInfo("upload", upload);
+            db.commit("Upload info");
+
+            db.setFileRecord(makeRecord("done/after"));
+            db.groupCommit("test");
+
+            SyncJournalDb::DownloadInfo download;
+            download._valid = true;
+            download._etag = "downloadetag";
+            download._tmpfile = ".download.~1234";
+            db.setDownloadInfo("download", download);
+            db.commit("download file start");
+
+            SyncJournalDb::PollInfo poll;
+            poll._file = "poll";
+            poll._url = "remote.php/poll/1";
+            poll._modtime = 1;
+            poll._fileSize = 2;
+            db.setPollInfo(poll);
+            db.commit("add poll info");
+
+            db.setFileRecord(makeRecord("done/lost"));
+            db.setDownloadInfo("download", SyncJournalDb::DownloadInfo());
+            db.groupCommit("download file finished");
+
+            raise(SIGKILL);
+            _exit(1);
+        }
+        int status = 0;
+        QCOMPARE(waitpid(pid, &status, 0), pid);
+        QVERIFY(WIFSIGNALED(status));
+
+        SyncJournalDb db(dbPath);
+        SyncJournalFileRecord record;
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("done/before"), &record));
+        QVERIFY(record.isValid());
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("done/after"), &record));
+        QVERIFY(record.isValid());
+        // The uncommitted group is lost as a whole...
+        QVERIFY(db.getFileRecord(QByteArrayLiteral("done/lost"), &record));
+        QVERIFY(!record.isValid());
+
+        // ...and the records resuming depends on are as they were committed
+        auto upload = db.getUploadInfo("upload");
+        QVERIFY(upload._valid);
+        QCOMPARE(upload._transferid, 42u);
+        auto download = db.getDownloadInfo("download");
+        QVERIFY(download._valid);
+        QCOMPARE(download._tmpfile, QStringLiteral(".download.~1234"));
+        auto polls = db.getPollInfos();
+        QCOMPARE(polls.size(), 1);
+        QCOMPARE(polls.first()._url, QStringLiteral("remote.php/poll/1"));
+        db.close();
+
+        sqlite3 *check = nullptr;
+        QCOMPARE(sqlite3_open(dbPath.toUtf8().constData(), &check), SQLITE_OK);
+        sqlite3_stmt *stmt = nullptr;
+        QCOMPARE(sqlite3_prepare_v2(check, "PRAGMA integrity_check", -1, &stmt, nullptr), SQLITE_OK);
+        QCOMPARE(sqlite3_step(stmt), SQLITE_ROW);
+        QCOMPARE(QByteArray(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))), QByteArray("ok"));
+        sqlite3_finalize(stmt);
+        sqlite3_close(check);
+#endif
+    }
+
+    void testZsyncMetadata()
+    {
+        SyncJournalFileRecord record;
+        record._path = "zsync-kept";
+        record._type = ItemTypeFile;
+        record._etag = "etag1";
+        record._checksumHeader = "SHA1:abc";
+        QVERIFY(_db.setFileRecord(record));
+
+        const QByteArray metadata("zsync: 0.6.2\n\n\0\1\2", 17);
+        _db.setZsyncMetadata("zsync-kept", "etag1", "SHA1:abc", metadata);
+        QCOMPARE(_db.getZsyncMetadata("zsync-kept", "etag1", "SHA1:abc"), metadata);
+        QVERIFY(_db.getZsyncMetadata("zsync-kept", "etag2", "SHA1:abc").isEmpty());
+        QVERIFY(_db.getZsyncMetadata("zsync-kept", "etag1", "SHA1:def").isEmpty());
+
+        // Entries that don't describe the synced version are stale
+        _db.setZsyncMetadata("zsync-nofile", "etag1", "SHA1:abc", metadata);
+        _db.deleteStaleZsyncMetadata();
+        QCOMPARE(_db.getZsyncMetadata("zsync-kept", "etag1", "SHA1:abc"), metadata);
+        QVERIFY(_db.getZsyncMetadata("zsync-nofile", "etag1", "SHA1:abc").isEmpty());
+
+        // The least recently stored entries are evicted beyond the limit
+        _db.setZsyncMetadataCacheLimit(2 * metadata.size());
+        _db.setZsyncMetadata("zsync-b", "etag1", "SHA1:abc", metadata);
+        _db.setZsyncMetadata("zsync-c", "etag1", "SHA1:abc", metadata);
+        QVERIFY(_db.getZsyncMetadata("zsync-kept", "etag1", "SHA1:abc").isEmpty());
+        QCOMPARE(_db.getZsyncMetadata("zsync-b", "etag1", "SHA1:abc"), metadata);
+        QCOMPARE(_db.getZsyncMetadata("zsync-c", "etag1", "SHA1:abc"), metadata);
+
+        _db.setZsyncMetadataCacheLimit(0);
+        QVERIFY(_db.getZsyncMetadata("zsync-b", "etag1", "SHA1:abc").isEmpty());
+        _db.setZsyncMetadataCacheLimit(32 * 1024 * 1024);
+        QVERIFY(_db.deleteFileRecord("zsync-kept"));
+    }
+
     void testNumericId()
     {
         SyncJournalFileRecord record;
@@ -0,0 +1,199 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "transferconcurrency.h"
+
+using namespace OCC;
+
+/* Drives the controller like the propagator does: a number of transfers
+ * report their progress, and each window ends with the next report. */
+struct FakeTransfers
+{
+    TransferConcurrencyController controller;
+    qint64 now = 0;
+    QHash<QString, qint64> bytes;
+
+    void start(const QString &file)
+    {
+        bytes[file] = 0;
+        controller.transferProgress(file, 0, now);
+    }
+
+    void finish(const QString &file, bool congested = false)
+    {
+        controller.transferFinished(file, bytes.value(file), congested, now);
+        bytes.remove(file);
+    }
+
+    // Lets the running transfers move totalBytes during one window
+    void runWindow(qint64 totalBytes)
+    {
+        const int steps = 4;
+        for (int i = 0; i < steps; ++i) {
+            now += TransferConcurrencyController::windowDuration() / steps;
+            for (auto it = bytes.begin(); it != bytes.end(); ++it) {
+                it.value() += totalBytes / steps / bytes.size();
+                controller.transferProgress(it.key(), it.value(), now);
+            }
+        }
+    }
+
+    // Starts transfers until there are as many as the controller allows
+    void fill()
+    {
+        while (bytes.size() < controller.limit())
+            start(QStringLiteral("file%1").arg(now * 100 + bytes.size()));
+    }
+};
+
+class TestTransferConcurrency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testBounds()
+    {
+        TransferConcurrencyController c;
+        c.reset(2, 4, 10);
+        QCOMPARE(c.limit(), 4);
+        c.reset(2, 4, 0);
+        QCOMPARE(c.limit(), 2);
+        c.reset(0, 0, 3);
+        QCOMPARE(c.minimum(), 1);
+        QCOMPARE(c.maximum(), 1);
+        QCOMPARE(c.limit(), 1);
+    }
+
+    void testSetBounds()
+    {
+        // Another folder starts syncing and the budget shrinks
+        FakeTransfers t;
+        t.controller.reset(1, 6, 6);
+        t.fill();
+        t.runWindow(1000000);
+        t.controller.setBounds(1, 3);
+        QCOMPARE(t.controller.limit(), 3);
+        QCOMPARE(t.controller.running(), 6);
+
+        // ... and grows again when it is done, without jumping to the maximum
+        t.controller.setBounds(1, 6);
+        QCOMPARE(t.controller.limit(), 3);
+        t.runWindow(1000000);
+        QCOMPARE(t.controller.limit(), 4);
+    }
+
+    void testIncreaseWhileThroughputGrows()
+    {
+        FakeTransfers t;
+        t.controller.reset(1, 6, 2);
+        qint64 throughput = 1000000;
+        for (int i = 0; i < 10; ++i) {
+            t.fill();
+            t.runWindow(throughput);
+            throughput *= 2;
+        }
+        QCOMPARE(t.controller.limit(), 6);
+        QVERIFY(t.controller.lastWindow().throughput() > 0);
+        QCOMPARE(t.controller.lastWindow().maxRunning, 6);
+    }
+
+    void testStepBackOnPlateau()
+    {
+        FakeTransfers t;
+        t.controller.reset(1, 10, 2);
+        t.fill();
+        t.runWindow(1000000);
+        QCOMPARE(t.controller.limit(), 3);
+        t.fill();
+        t.runWindow(1000000);
+        QCOMPARE(t.controller.limit(), 4);
+
+        // A fourth transfer doesn't move more bytes
+        t.fill();
+        t.runWindow(1000000);
+        QCOMPARE(t.controller.limit(), 3);
+
+        // ... and the limit is kept for a while even though it is reached
+        for (int i = 0; i < 5; ++i) {
+            t.runWindow(1000000);
+            QCOMPARE(t.controller.limit(), 3);
+        }
+        t.runWindow(1000000);
+        QCOMPARE(t.controller.limit(), 4);
+    }
+
+    void testHoldWhenNotSaturated()
+    {
+        FakeTransfers t;
+        t.controller.reset(1, 6, 3);
+        t.start("a");
+        for (int i = 0; i < 5; ++i)
+            t.runWindow(1000000 * (i + 1));
+        QCOMPARE(t.controller.limit(), 3);
+    }
+
+    void testHalveOnErrors()
+    {
+        FakeTransfers t;
+        t.controller.reset(2, 8, 8);
+        t.fill();
+        t.runWindow(1000000);
+        t.finish("file0");
+        t.finish("file1", true);
+        t.runWindow(1000000);
+        QCOMPARE(t.controller.lastWindow().errors, 1);
+        QCOMPARE(t.controller.limit(), 4);
+
+        // Never below the minimum
+        t.fill();
+        t.finish("file2", true);
+        t.finish("file3", true);
+        t.runWindow(1000000);
+        QCOMPARE(t.controller.limit(), 2);
+        t.fill();
+        t.finish("file4", true);
+        t.runWindow(1000000);
+        QCOMPARE(t.controller.limit(), 2);
+    }
+
+    void testStepBackOnLatency()
+    {
+        TransferConcurrencyController c;
+        c.reset(1, 10, 2);
+
+        // Small files that take one second each
+        c.transferProgress("a", 0, 0);
+        c.transferProgress("b", 0, 0);
+        c.transferFinished("a", 1000, false, 1000);
+        c.transferFinished("b", 1000, false, 1000);
+        c.transferProgress("c", 0, 1000);
+        c.transferProgress("d", 0, 1000);
+        c.transferProgress("c", 500000, 1900);
+        c.transferProgress("d", 500000, 1900);
+        c.transferProgress("c", 500000, 2000);
+        QCOMPARE(c.lastWindow().latency(), qint64(1000));
+        QCOMPARE(c.limit(), 3);
+
+        // With a third transfer more bytes get through, but the small
+        // files take almost three times as long
+        c.transferProgress("e", 0, 2000);
+        c.transferProgress("c", 1000000, 3900);
+        c.transferProgress("d", 1000000, 3900);
+        c.transferProgress("e", 1000000, 3900);
+        c.transferFinished("c", 1000000, false, 3900);
+        c.transferFinished("d", 1000000, false, 3900);
+        c.transferProgress("e", 1000000, 4000);
+        QCOMPARE(c.lastWindow().latency(), qint64(2900));
+        QVERIFY(c.lastWindow().throughput() > 2 * 500000 - 1);
+        QCOMPARE(c.limit(), 2);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestTransferConcurrency)
+#include "testtransferconcurrency.moc"
@@ -473,6 +473,81 @@ private slots:
         QVERIFY(_subdirs.size() == 1);
     }
 
+    void testParserIncremental() {
+        const QByteArray firstResponse = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\">"
+              "<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004213ocobzus5kn6s</oc:id>"
+              "<oc:size>121780</oc:size>"
+              "<d:resourcetype>"
+              "<d:collection/>"
+              "</d:resourcetype>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "</d:response>";
+        const QByteArray rest = "<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/%C3%A4.pdf</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004215ocobzus5kn6s</oc:id>"
+              "<d:getetag>\"\xc3\xa4\xc3\xa4\"</d:getetag>" // a-umlauts, split between chunks below
+              "<d:resourcetype/>"
+              "<d:getcontentlength>121780</d:getcontentlength>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "</d:response>"
+              "</d:multistatus>";
+
+        LsColXMLParser parser;
+        QMap<QString, QString> lastProperties;
+        connect(&parser, &LsColXMLParser::directoryListingSubfolders,
+            this, &TestXmlParse::slotDirectoryListingSubFolders);
+        connect(&parser, &LsColXMLParser::directoryListingIterated,
+            this, [&](const QString &item, const QMap<QString, QString> &properties) {
+                _items.append(item);
+                lastProperties = properties;
+            });
+        connect(&parser, &LsColXMLParser::finishedWithoutError,
+            this, &TestXmlParse::slotFinishedSuccessfully);
+
+        // Feed the response a few bytes at a time, as it would come from the network
+        QHash<QString, qint64> sizes;
+        parser.begin(&sizes, "/oc/remote.php/webdav/sharefolder");
+        for (int i = 0; i < firstResponse.size(); i += 7)
+            QVERIFY(parser.addData(firstResponse.mid(i, 7)));
+
+        // The first entry is available before the rest of the listing arrived
+        QCOMPARE(_items, QStringList{ "/oc/remote.php/webdav/sharefolder" });
+        QCOMPARE(lastProperties.value("id"), QString("00004213ocobzus5kn6s"));
+        QVERIFY(_subdirs.isEmpty());
+        QVERIFY(!_success);
+
+        for (int i = 0; i < rest.size(); i += 3)
+            QVERIFY(parser.addData(rest.mid(i, 3)));
+        QVERIFY(parser.finish());
+        QVERIFY(_success);
+
+        QCOMPARE(_items.size(), 2);
+        QCOMPARE(_items.last(), QString::fromUtf8("/oc/remote.php/webdav/sharefolder/ä.pdf"));
+        QCOMPARE(lastProperties.value("getetag"), QString::fromUtf8("\"ää\""));
+        QCOMPARE(lastProperties.value("getcontentlength"), QString("121780"));
+        QCOMPARE(_subdirs, QStringList{ "/oc/remote.php/webdav/sharefolder/" });
+        QCOMPARE(sizes.size(), 1);
+
+        // A truncated response is an error, even if every piece parsed fine
+        init();
+        parser.begin(&sizes, "/oc/remote.php/webdav/sharefolder");
+        QVERIFY(parser.addData(firstResponse));
+        QVERIFY(!parser.finish());
+        QVERIFY(!_success);
+        QCOMPARE(_items.size(), 1);
+    }
+
 };
 
     QTEST_GUILESS_MAIN(TestXmlParse)
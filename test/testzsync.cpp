@@ -200,6 +200,98 @@ private slots:
         QVERIFY(!downloads.contains("shrinkFewerBlock"));
     }
 
+    void testFileDownloadPipelinedRanges_data()
+    {
+        QTest::addColumn<int>("maxRangeRequests");
+        QTest::addColumn<qint64>("mergeGap");
+        QTest::addColumn<int>("expectedRequests");
+        QTest::addColumn<int>("expectedRounds");
+
+        // 6 modified blocks, two of them only one block apart
+        QTest::newRow("sequential") << 1 << qint64(0) << 6 << 6;
+        QTest::newRow("pipelined") << 4 << qint64(0) << 6 << 1;
+        QTest::newRow("pipelined, merged") << 4 << qint64(ZSYNC_BLOCKSIZE) << 5 << 1;
+    }
+
+    void testFileDownloadPipelinedRanges()
+    {
+        QFETCH(int, maxRangeRequests);
+        QFETCH(qint64, mergeGap);
+        QFETCH(int, expectedRequests);
+        QFETCH(int, expectedRounds);
+
+        FakeFolder fakeFolder{ FileInfo() };
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ { "chunking", "1.0" }, { "zsync", "1.0" } } } });
+
+        SyncOptions opt;
+        opt._deltaSyncEnabled = true;
+        opt._deltaSyncMinFileSize = 0;
+        opt._deltaSyncMaxRangeRequests = maxRangeRequests;
+        opt._deltaSyncRangeMergeGap = mergeGap;
+        fakeFolder.syncEngine().setSyncOptions(opt);
+
+        // Upload a modified file to capture its metadata
+        const int size = 40 * ZSYNC_BLOCKSIZE;
+        fakeFolder.localModifier().insert("a0", size);
+        for (int block : { 1, 3, 10, 20, 30, 39 }) {
+            fakeFolder.localModifier().modifyByte("a0", quint64(block) * ZSYNC_BLOCKSIZE + 7, 'Y');
+        }
+        QFile f(fakeFolder.localPath() + "/a0");
+        QVERIFY(f.open(QIODevice::ReadOnly));
+        QByteArray data = f.readAll();
+        f.close();
+
+        QByteArray metadata;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *body) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation && request.url().toString().endsWith(".zsync")) {
+                metadata = body->readAll();
+                return new FakePutReply{ fakeFolder.uploadState(), op, request, metadata, this };
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(metadata.startsWith("zsync: "));
+
+        // Revert the local file and touch the remote one, so the modified blocks get downloaded
+        fakeFolder.localModifier().remove("a0");
+        fakeFolder.localModifier().insert("a0", size);
+        fakeFolder.remoteModifier().setModTime("a0", QDateTime::currentDateTimeUtc());
+
+        // A round trip starts whenever a request is sent while no other one is in flight
+        int requests = 0;
+        int rounds = 0;
+        int inFlight = 0;
+        int maxInFlight = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation)
+                return nullptr;
+            if (QUrlQuery(request.url()).hasQueryItem("zsync"))
+                return new FakeGetWithDataReply{ fakeFolder.remoteModifier(), metadata, op, request, this };
+
+            auto reply = new FakeGetWithDataReply{ fakeFolder.remoteModifier(), data, op, request, this };
+            if (inFlight == 0)
+                ++rounds;
+            ++requests;
+            maxInFlight = qMax(maxInFlight, ++inFlight);
+            connect(reply, &QNetworkReply::finished, [&inFlight] { --inFlight; });
+            return reply;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+
+        QCOMPARE(requests, expectedRequests);
+        QCOMPARE(rounds, expectedRounds);
+        QVERIFY(maxInFlight <= maxRangeRequests);
+
+        // The file was assembled correctly, no matter in which order the replies arrived
+        QVERIFY(f.open(QIODevice::ReadOnly));
+        QVERIFY(data == f.readAll());
+        f.close();
+        for (const auto &c : findConflicts(fakeFolder.currentLocalState())) {
+            fakeFolder.localModifier().remove(c);
+        }
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void testFileUploadSimple()
     {
         FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
@@ -365,6 +457,76 @@ private slots:
         QVERIFY(putChunks.size() == 1);
         QVERIFY(putChunks[0] == qMakePair(2 * zsyncBlockSize, zsyncBlockSize));
     }
+
+    void testFileUploadCachedMetadata()
+    {
+        FakeFolder fakeFolder{ FileInfo() };
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ { "chunking", "1.0" }, { "zsync", "1.0" } } } });
+
+        SyncOptions opt;
+        opt._deltaSyncEnabled = true;
+        opt._deltaSyncMinFileSize = 0;
+        fakeFolder.syncEngine().setSyncOptions(opt);
+
+        const int zsyncBlockSize = 1024 * 1024;
+
+        QByteArray metadata;
+        int metadataGets = 0;
+        QList<QPair<int, int>> putChunks;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *data) -> QNetworkReply * {
+            QUrlQuery query(request.url());
+            if (request.url().toString().endsWith(".zsync") && op == QNetworkAccessManager::PutOperation) {
+                metadata = data->readAll();
+                return new FakePutReply{ fakeFolder.uploadState(), op, request, metadata, this };
+            }
+            if (op == QNetworkAccessManager::GetOperation && query.hasQueryItem("zsync")) {
+                ++metadataGets;
+                return new FakeGetWithDataReply{ fakeFolder.remoteModifier(), metadata, op, request, this };
+            }
+            if (op == QNetworkAccessManager::PutOperation) {
+                auto payload = data->readAll();
+                putChunks.append({ request.rawHeader("OC-Chunk-Offset").toInt(), payload.size() });
+                return new FakePutReply{ fakeFolder.uploadState(), op, request, payload, this };
+            }
+            return nullptr;
+        });
+
+        auto totalSize = 4 * zsyncBlockSize + 5;
+        fakeFolder.localModifier().insert("a0", totalSize);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(metadataGets, 0);
+
+        // The block sums of the uploaded version are known: no metadata download
+        putChunks.clear();
+        fakeFolder.localModifier().modifyByte("a0", zsyncBlockSize + 5, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(metadataGets, 0);
+        QCOMPARE(putChunks.size(), 1);
+        QCOMPARE(putChunks[0], qMakePair(zsyncBlockSize, zsyncBlockSize));
+
+        // Growing works from the cached metadata of the previous upload too
+        putChunks.clear();
+        totalSize += 1;
+        fakeFolder.localModifier().appendByte("a0", 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(metadataGets, 0);
+        QCOMPARE(putChunks.size(), 1);
+        QCOMPARE(putChunks[0], qMakePair(4 * zsyncBlockSize, 6));
+
+        // Without the cache the metadata is fetched from the server again
+        opt._deltaSyncMetadataCacheSize = 0;
+        fakeFolder.syncEngine().setSyncOptions(opt);
+        putChunks.clear();
+        fakeFolder.localModifier().modifyByte("a0", 5, 'Q');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(metadataGets, 1);
+        QCOMPARE(putChunks.size(), 1);
+        QCOMPARE(putChunks[0], qMakePair(0, zsyncBlockSize));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestZsync)